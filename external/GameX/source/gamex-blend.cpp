@@ -0,0 +1,1381 @@
+//
+// GameX - Blend Kernels Code
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#include "gamex-blend.hpp"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define BLEND_HAS_SSE2
+	#include <emmintrin.h>
+
+	// AVX2 needs a compiler that knows the intrinsics
+	#if (defined(_MSC_VER) && _MSC_VER >= 1700) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+		#define BLEND_HAS_AVX2
+		#include <immintrin.h>
+	#endif
+	#if defined(_MSC_VER) && _MSC_VER >= 1400
+		#include <intrin.h>
+	#endif
+#endif
+
+// gcc only emits vector code for targets it was asked for
+#ifdef __GNUC__
+	#define BLEND_SSE2_FUNC		__attribute__ ((target ("sse2")))
+	#define BLEND_AVX2_FUNC		__attribute__ ((target ("avx2")))
+#else
+	#define BLEND_SSE2_FUNC
+	#define BLEND_AVX2_FUNC
+#endif
+
+static inline int BlendMin (int a, int b)		{ return (a < b) ? a : b; }
+static inline int BlendMax (int a, int b)		{ return (a > b) ? a : b; }
+
+BlendFormat::BlendFormat (int mr, int mg, int mb, int sr, int sg, int sb)
+{
+	maskr = mr;		maskg = mg;		maskb = mb;
+	shiftr = sr;	shiftg = sg;	shiftb = sb;
+	maxr = mr >> sr;
+	maxg = mg >> sg;
+	maxb = mb >> sb;
+}
+
+//-------------------------------------------------------- Level selection
+
+static int blend_level = -1;
+
+static int BlendDetect (void)
+{
+	int level = BLEND_SCALAR;
+
+	#if defined(BLEND_HAS_SSE2) && defined(__GNUC__)
+		__builtin_cpu_init ();
+		if (__builtin_cpu_supports ("sse2")) level = BLEND_SSE2;
+		#ifdef BLEND_HAS_AVX2
+			if (__builtin_cpu_supports ("avx2")) level = BLEND_AVX2;
+		#endif
+	#elif defined(BLEND_HAS_SSE2) && defined(_MSC_VER)
+		int edx_bits = 0;
+		#if _MSC_VER >= 1400
+			int info[4];
+			__cpuid (info, 1);
+			edx_bits = info[3];
+		#else
+			__asm {
+				mov eax, 1
+				cpuid
+				mov edx_bits, edx
+			}
+		#endif
+		if (edx_bits & (1 << 26)) level = BLEND_SSE2;
+		#ifdef BLEND_HAS_AVX2
+			// AVX2 also needs the OS to save the ymm registers
+			int ext[4];
+			__cpuidex (ext, 7, 0);
+			if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (ext[1] & (1 << 5))
+				&& (_xgetbv (0) & 6) == 6) level = BLEND_AVX2;
+		#endif
+	#endif
+
+	return level;
+}
+
+int BlendGetLevel (void)
+{
+	if (blend_level < 0) blend_level = BlendDetect ();
+	return blend_level;
+}
+
+void BlendSetLevel (int level)
+{
+	int best = BlendDetect ();
+	blend_level = (level < best) ? level : best;
+}
+
+// The vector kernels work in 16-bit lanes, so the channels must be
+// small enough that channel * 255 (or * 512 for adds) cannot overflow
+static int BlendVectorFormat (const BlendFormat &fmt)
+{
+	return (fmt.maskr | fmt.maskg | fmt.maskb) <= 0xFFFF
+		&& fmt.maxr <= 63 && fmt.maxg <= 63 && fmt.maxb <= 63;
+}
+
+//-------------------------------------------------------- Gathers
+
+void BlendGather16 (XBYTE2 *out, XBYTE2 *src_row, int x, int count, int src_width, int dst_width)
+{
+	for (int n=0; n < count; n++)
+		out[n] = src_row[(x+n)*src_width/dst_width];
+}
+
+void BlendGather32 (XBYTE4 *out, XBYTE4 *src_row, int x, int count, int src_width, int dst_width)
+{
+	for (int n=0; n < count; n++)
+		out[n] = src_row[(x+n)*src_width/dst_width];
+}
+
+//-------------------------------------------------------- Scalar reference
+// These are the per-pixel formulas of the WindowsDX software blitters.
+
+void BlendPlainRef (XBYTE2 *dst, XBYTE2 *src, int count, int nomask)
+{
+	if (nomask) {
+		memcpy (dst, src, count<<1);
+		return;
+	}
+	for (int x=0; x < count; x++) {
+		if (src[x]) dst[x] = src[x];
+	}
+}
+
+void BlendAlphaMergedRef (XBYTE2 *dst, XBYTE4 *src, int count, const BlendFormat &fmt)
+{
+	for (int x=0; x < count; x++) {
+		int i = src[x];
+		int a = ((i & 0xFF000000) >> 24);
+		if (a) {
+			int r = ((i & 0x00FF0000) >> 16);
+			int g = ((i & 0x0000FF00) >> 8);
+			int b = ((i & 0x000000FF) >> 0);
+			i = ((r >> 3) << fmt.shiftr) | ((g >> 2) << fmt.shiftg) | ((b >> 3) << fmt.shiftb);
+			int v = dst[x];
+			dst[x] = (((((v & fmt.maskb) * (255-a)) >> 8) & fmt.maskb) + ((((i & fmt.maskb) * a) >> 8) & fmt.maskb))
+				   | (((((v & fmt.maskg) * (255-a)) >> 8) & fmt.maskg) + ((((i & fmt.maskg) * a) >> 8) & fmt.maskg))
+				   | (((((v & fmt.maskr) * (255-a)) >> 8) & fmt.maskr) + ((((i & fmt.maskr) * a) >> 8) & fmt.maskr));
+		}
+	}
+}
+
+void BlendAddedRef (XBYTE2 *dst, XBYTE2 *src, int count, int ri, int gi, int bi, const BlendFormat &fmt)
+{
+	if (ri==255 && gi==255 && bi==255) {	// Fully additive, no scaling
+		for (int x=0; x < count; x++) {
+			int i, v;
+			if ((i = src[x]) && ((v = dst[x]) != 65535)) {
+				dst[x] = BlendMin (((v & fmt.maskb) + (i & fmt.maskb)), fmt.maskb)
+					   | BlendMin (((v & fmt.maskg) + (i & fmt.maskg)), fmt.maskg)
+					   | BlendMin (((v & fmt.maskr) + (i & fmt.maskr)), fmt.maskr);
+			}
+		}
+		return;
+	}
+	for (int x=0; x < count; x++) {
+		int i, v;
+		if ((i = src[x])) {
+			v = dst[x];
+			int blue  = ((v & fmt.maskb) + (((((i & fmt.maskb) >> fmt.shiftb) * bi) >> 8) << fmt.shiftb));
+			int green = ((v & fmt.maskg) + (((((i & fmt.maskg) >> fmt.shiftg) * gi) >> 8) << fmt.shiftg));
+			int red   = ((v & fmt.maskr) + (((((i & fmt.maskr) >> fmt.shiftr) * ri) >> 8) << fmt.shiftr));
+			dst[x] = ((bi < 0) ? BlendMax (0, blue)  : BlendMin (fmt.maskb, blue))
+				   | ((gi < 0) ? BlendMax (0, green) : BlendMin (fmt.maskg, green))
+				   | ((ri < 0) ? BlendMax (0, red)   : BlendMin (fmt.maskr, red));
+		}
+	}
+}
+
+void BlendBlendedRef (XBYTE2 *dst, XBYTE2 *src, int count, int r, int g, int b, int a, int nomask, const BlendFormat &fmt)
+{
+	for (int x=0; x < count; x++) {
+		int i, v;
+		if ((i = src[x]) || nomask) {
+			v = dst[x];
+			dst[x] =
+				  ((((((v & fmt.maskb) >> fmt.shiftb) *   (255-a)) >> 8) << fmt.shiftb)
+				 + (((((i & fmt.maskb) >> fmt.shiftb) * (b*a/255)) >> 8) << fmt.shiftb))
+				| ((((((v & fmt.maskg) >> fmt.shiftg) *   (255-a)) >> 8) << fmt.shiftg)
+				 + (((((i & fmt.maskg) >> fmt.shiftg) * (g*a/255)) >> 8) << fmt.shiftg))
+				| ((((((v & fmt.maskr) >> fmt.shiftr) *   (255-a)) >> 8) << fmt.shiftr)
+				 + (((((i & fmt.maskr) >> fmt.shiftr) * (r*a/255)) >> 8) << fmt.shiftr));
+		}
+	}
+}
+
+void BlendMasked32Ref (XBYTE4 *dst, XBYTE4 *src, int count)
+{
+	for (int x=0; x < count; x++) {
+		if (src[x] & 0x00FFFFFF) dst[x] = src[x];
+	}
+}
+
+void BlendBlur32Ref (XBYTE4 *dst, XBYTE4 **rows, int count, const short *weights, int taps)
+{
+	for (int x=0; x < count; x++) {
+		int sum[4] = { 0, 0, 0, 0 };
+		for (int k=0; k < taps; k++) {
+			XBYTE4 v = rows[k][x];
+			const short *w = weights + k*4;
+			sum[0] += w[0] * (int) (v & 0xFF);
+			sum[1] += w[1] * (int) ((v >> 8) & 0xFF);
+			sum[2] += w[2] * (int) ((v >> 16) & 0xFF);
+			sum[3] += w[3] * (int) (v >> 24);
+		}
+		XBYTE4 out = 0;
+		for (int c=0; c < 4; c++) {
+			int ch = (sum[c] + (1 << (BLEND_BLUR_SHIFT-1))) >> BLEND_BLUR_SHIFT;
+			out |= (XBYTE4) BlendMin (ch, 255) << (c*8);
+		}
+		dst[x] = out;
+	}
+}
+
+void BlendOver32Ref (XBYTE4 *dst, XBYTE4 *src, int count)
+{
+	for (int x=0; x < count; x++) {
+		XBYTE4 s = src[x] | 0xFF000000;
+		XBYTE4 d = dst[x];
+		int a = src[x] >> 24;
+		if (a == 0) continue;
+		XBYTE4 out = 0;
+		for (int shift=0; shift < 32; shift += 8) {
+			int sc = (s >> shift) & 0xFF;
+			int dc = (d >> shift) & 0xFF;
+			out |= (XBYTE4) ((sc*a + dc*(255-a) + 127) / 255) << shift;
+		}
+		dst[x] = out;
+	}
+}
+
+//-------------------------------------------------------- SSE2 (8 pixels)
+
+#ifdef BLEND_HAS_SSE2
+
+// One channel of a packed pixel, shifted down to bit 0
+BLEND_SSE2_FUNC static inline __m128i ChanSSE2 (__m128i v, __m128i mask, __m128i shift)
+{
+	return _mm_srl_epi16 (_mm_and_si128 (v, mask), shift);
+}
+
+// (v * (255-a)) >> 8 + (i * k) >> 8, moved back into place
+BLEND_SSE2_FUNC static inline __m128i MixSSE2 (__m128i v, __m128i i, __m128i va, __m128i ia, __m128i mask, __m128i shift)
+{
+	__m128i vc = _mm_srli_epi16 (_mm_mullo_epi16 (ChanSSE2 (v, mask, shift), va), 8);
+	__m128i ic = _mm_srli_epi16 (_mm_mullo_epi16 (ChanSSE2 (i, mask, shift), ia), 8);
+	return _mm_sll_epi16 (_mm_add_epi16 (vc, ic), shift);
+}
+
+// Keep v where skip is set, res elsewhere
+BLEND_SSE2_FUNC static inline __m128i SelectSSE2 (__m128i skip, __m128i v, __m128i res)
+{
+	return _mm_or_si128 (_mm_and_si128 (skip, v), _mm_andnot_si128 (skip, res));
+}
+
+BLEND_SSE2_FUNC static void BlendPlainSSE2 (XBYTE2 *dst, XBYTE2 *src, int count)
+{
+	__m128i zero = _mm_setzero_si128 ();
+	int n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m128i s = _mm_loadu_si128 ((__m128i *) (src + n));
+		__m128i v = _mm_loadu_si128 ((__m128i *) (dst + n));
+		_mm_storeu_si128 ((__m128i *) (dst + n), SelectSSE2 (_mm_cmpeq_epi16 (s, zero), v, s));
+	}
+	BlendPlainRef (dst + n, src + n, count - n, 0);
+}
+
+BLEND_SSE2_FUNC static void BlendAlphaMergedSSE2 (XBYTE2 *dst, XBYTE4 *src, int count, const BlendFormat &fmt)
+{
+	__m128i mr = _mm_set1_epi16 ((short) fmt.maskr), sr = _mm_cvtsi32_si128 (fmt.shiftr);
+	__m128i mg = _mm_set1_epi16 ((short) fmt.maskg), sg = _mm_cvtsi32_si128 (fmt.shiftg);
+	__m128i mb = _mm_set1_epi16 ((short) fmt.maskb), sb = _mm_cvtsi32_si128 (fmt.shiftb);
+	__m128i byte = _mm_set1_epi32 (0xFF);
+	__m128i full = _mm_set1_epi16 (255);
+	__m128i zero = _mm_setzero_si128 ();
+	int n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m128i s0 = _mm_loadu_si128 ((__m128i *) (src + n));
+		__m128i s1 = _mm_loadu_si128 ((__m128i *) (src + n + 4));
+		__m128i a = _mm_packs_epi32 (_mm_srli_epi32 (s0, 24), _mm_srli_epi32 (s1, 24));
+		__m128i r = _mm_packs_epi32 (_mm_and_si128 (_mm_srli_epi32 (s0, 16), byte), _mm_and_si128 (_mm_srli_epi32 (s1, 16), byte));
+		__m128i g = _mm_packs_epi32 (_mm_and_si128 (_mm_srli_epi32 (s0, 8), byte), _mm_and_si128 (_mm_srli_epi32 (s1, 8), byte));
+		__m128i b = _mm_packs_epi32 (_mm_and_si128 (s0, byte), _mm_and_si128 (s1, byte));
+
+		// The source in the surface format, built the same 5-6-5 way
+		__m128i i = _mm_or_si128 (_mm_or_si128 (_mm_sll_epi16 (_mm_srli_epi16 (r, 3), sr),
+												_mm_sll_epi16 (_mm_srli_epi16 (g, 2), sg)),
+												_mm_sll_epi16 (_mm_srli_epi16 (b, 3), sb));
+		__m128i v = _mm_loadu_si128 ((__m128i *) (dst + n));
+		__m128i na = _mm_sub_epi16 (full, a);
+		__m128i res = _mm_or_si128 (_mm_or_si128 (MixSSE2 (v, i, na, a, mb, sb),
+												  MixSSE2 (v, i, na, a, mg, sg)),
+												  MixSSE2 (v, i, na, a, mr, sr));
+		_mm_storeu_si128 ((__m128i *) (dst + n), SelectSSE2 (_mm_cmpeq_epi16 (a, zero), v, res));
+	}
+	BlendAlphaMergedRef (dst + n, src + n, count - n, fmt);
+}
+
+// Saturating add of one channel (the fully additive case)
+BLEND_SSE2_FUNC static inline __m128i AddFullSSE2 (__m128i v, __m128i i, __m128i mask, __m128i shift, __m128i max)
+{
+	__m128i sum = _mm_add_epi16 (ChanSSE2 (v, mask, shift), ChanSSE2 (i, mask, shift));
+	return _mm_sll_epi16 (_mm_min_epi16 (sum, max), shift);
+}
+
+// v + (i * k) >> 8, clamped to the channel
+BLEND_SSE2_FUNC static inline __m128i AddScaledSSE2 (__m128i v, __m128i i, __m128i k, __m128i mask, __m128i shift, __m128i max)
+{
+	__m128i add = _mm_srai_epi16 (_mm_mullo_epi16 (ChanSSE2 (i, mask, shift), k), 8);
+	__m128i sum = _mm_add_epi16 (ChanSSE2 (v, mask, shift), add);
+	sum = _mm_min_epi16 (_mm_max_epi16 (sum, _mm_setzero_si128 ()), max);
+	return _mm_sll_epi16 (sum, shift);
+}
+
+BLEND_SSE2_FUNC static void BlendAddedSSE2 (XBYTE2 *dst, XBYTE2 *src, int count, int ri, int gi, int bi, const BlendFormat &fmt)
+{
+	__m128i mr = _mm_set1_epi16 ((short) fmt.maskr), sr = _mm_cvtsi32_si128 (fmt.shiftr), xr = _mm_set1_epi16 ((short) fmt.maxr);
+	__m128i mg = _mm_set1_epi16 ((short) fmt.maskg), sg = _mm_cvtsi32_si128 (fmt.shiftg), xg = _mm_set1_epi16 ((short) fmt.maxg);
+	__m128i mb = _mm_set1_epi16 ((short) fmt.maskb), sb = _mm_cvtsi32_si128 (fmt.shiftb), xb = _mm_set1_epi16 ((short) fmt.maxb);
+	__m128i zero = _mm_setzero_si128 ();
+	__m128i white = _mm_cmpeq_epi16 (zero, zero);
+	int full = (ri==255 && gi==255 && bi==255);
+	__m128i kr = _mm_set1_epi16 ((short) ri), kg = _mm_set1_epi16 ((short) gi), kb = _mm_set1_epi16 ((short) bi);
+	int n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m128i i = _mm_loadu_si128 ((__m128i *) (src + n));
+		__m128i v = _mm_loadu_si128 ((__m128i *) (dst + n));
+		__m128i res, skip = _mm_cmpeq_epi16 (i, zero);
+		if (full) {
+			res = _mm_or_si128 (_mm_or_si128 (AddFullSSE2 (v, i, mb, sb, xb), AddFullSSE2 (v, i, mg, sg, xg)), AddFullSSE2 (v, i, mr, sr, xr));
+			skip = _mm_or_si128 (skip, _mm_cmpeq_epi16 (v, white));
+		} else {
+			res = _mm_or_si128 (_mm_or_si128 (AddScaledSSE2 (v, i, kb, mb, sb, xb), AddScaledSSE2 (v, i, kg, mg, sg, xg)), AddScaledSSE2 (v, i, kr, mr, sr, xr));
+		}
+		_mm_storeu_si128 ((__m128i *) (dst + n), SelectSSE2 (skip, v, res));
+	}
+	BlendAddedRef (dst + n, src + n, count - n, ri, gi, bi, fmt);
+}
+
+BLEND_SSE2_FUNC static void BlendBlendedSSE2 (XBYTE2 *dst, XBYTE2 *src, int count, int r, int g, int b, int a, int nomask, const BlendFormat &fmt)
+{
+	__m128i mr = _mm_set1_epi16 ((short) fmt.maskr), sr = _mm_cvtsi32_si128 (fmt.shiftr);
+	__m128i mg = _mm_set1_epi16 ((short) fmt.maskg), sg = _mm_cvtsi32_si128 (fmt.shiftg);
+	__m128i mb = _mm_set1_epi16 ((short) fmt.maskb), sb = _mm_cvtsi32_si128 (fmt.shiftb);
+	__m128i na = _mm_set1_epi16 ((short) (255-a));
+	__m128i kr = _mm_set1_epi16 ((short) (r*a/255)), kg = _mm_set1_epi16 ((short) (g*a/255)), kb = _mm_set1_epi16 ((short) (b*a/255));
+	__m128i zero = _mm_setzero_si128 ();
+	int n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m128i i = _mm_loadu_si128 ((__m128i *) (src + n));
+		__m128i v = _mm_loadu_si128 ((__m128i *) (dst + n));
+		__m128i res = _mm_or_si128 (_mm_or_si128 (MixSSE2 (v, i, na, kb, mb, sb),
+												  MixSSE2 (v, i, na, kg, mg, sg)),
+												  MixSSE2 (v, i, na, kr, mr, sr));
+		if (!nomask) res = SelectSSE2 (_mm_cmpeq_epi16 (i, zero), v, res);
+		_mm_storeu_si128 ((__m128i *) (dst + n), res);
+	}
+	BlendBlendedRef (dst + n, src + n, count - n, r, g, b, a, nomask, fmt);
+}
+
+// Two pixels of 16-bit channels: (s*a + d*(255-a) + 127) / 255, where
+// t / 255 == (t + 1 + (t >> 8)) >> 8 for every t this can produce
+BLEND_SSE2_FUNC static inline __m128i Over2SSE2 (__m128i s, __m128i d)
+{
+	__m128i a = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (s, 0xFF), 0xFF);
+	__m128i opaque = _mm_set_epi16 (255, 0, 0, 0, 255, 0, 0, 0);
+	s = _mm_or_si128 (s, opaque);
+	__m128i t = _mm_add_epi16 (_mm_mullo_epi16 (s, a), _mm_mullo_epi16 (d, _mm_sub_epi16 (_mm_set1_epi16 (255), a)));
+	t = _mm_add_epi16 (t, _mm_set1_epi16 (127));
+	return _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (t, _mm_set1_epi16 (1)), _mm_srli_epi16 (t, 8)), 8);
+}
+
+BLEND_SSE2_FUNC static void BlendMasked32SSE2 (XBYTE4 *dst, XBYTE4 *src, int count)
+{
+	__m128i color = _mm_set1_epi32 (0x00FFFFFF);
+	__m128i zero = _mm_setzero_si128 ();
+	int n = 0;
+	for (; n + 4 <= count; n += 4) {
+		__m128i s = _mm_loadu_si128 ((__m128i *) (src + n));
+		__m128i v = _mm_loadu_si128 ((__m128i *) (dst + n));
+		__m128i skip = _mm_cmpeq_epi32 (_mm_and_si128 (s, color), zero);
+		_mm_storeu_si128 ((__m128i *) (dst + n), SelectSSE2 (skip, v, s));
+	}
+	BlendMasked32Ref (dst + n, src + n, count - n);
+}
+
+BLEND_SSE2_FUNC static void BlendOver32SSE2 (XBYTE4 *dst, XBYTE4 *src, int count)
+{
+	__m128i zero = _mm_setzero_si128 ();
+	int n = 0;
+	for (; n + 4 <= count; n += 4) {
+		__m128i s = _mm_loadu_si128 ((__m128i *) (src + n));
+		__m128i v = _mm_loadu_si128 ((__m128i *) (dst + n));
+		__m128i lo = Over2SSE2 (_mm_unpacklo_epi8 (s, zero), _mm_unpacklo_epi8 (v, zero));
+		__m128i hi = Over2SSE2 (_mm_unpackhi_epi8 (s, zero), _mm_unpackhi_epi8 (v, zero));
+		__m128i skip = _mm_cmpeq_epi32 (_mm_srli_epi32 (s, 24), zero);
+		_mm_storeu_si128 ((__m128i *) (dst + n), SelectSSE2 (skip, v, _mm_packus_epi16 (lo, hi)));
+	}
+	BlendOver32Ref (dst + n, src + n, count - n);
+}
+
+// Four pixels at a time. Taps go in pairs: the bytes of two rows are
+// interleaved so one madd multiplies and adds both taps of a channel
+BLEND_SSE2_FUNC static void BlendBlur32SSE2 (XBYTE4 *dst, XBYTE4 **rows, int count, const short *weights, int taps)
+{
+	__m128i zero = _mm_setzero_si128 ();
+	__m128i round = _mm_set1_epi32 (1 << (BLEND_BLUR_SHIFT-1));
+	int pairs = (taps + 1) / 2;
+	short *w2 = new short[pairs*8];						// (tap, next tap) per channel
+	for (int p=0; p < pairs; p++) {
+		const short *a = weights + p*8;
+		for (int c=0; c < 4; c++) {
+			w2[p*8 + c*2] = a[c];
+			w2[p*8 + c*2 + 1] = (p*2+1 < taps) ? a[4+c] : 0;
+		}
+	}
+
+	int n = 0;
+	for (; n + 4 <= count; n += 4) {
+		__m128i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+		for (int p=0; p < pairs; p++) {
+			__m128i a = _mm_loadu_si128 ((__m128i *) (rows[p*2] + n));
+			__m128i b = (p*2+1 < taps) ? _mm_loadu_si128 ((__m128i *) (rows[p*2+1] + n)) : zero;
+			__m128i alo = _mm_unpacklo_epi8 (a, zero), blo = _mm_unpacklo_epi8 (b, zero);
+			__m128i ahi = _mm_unpackhi_epi8 (a, zero), bhi = _mm_unpackhi_epi8 (b, zero);
+			__m128i w = _mm_loadu_si128 ((__m128i *) (w2 + p*8));
+			acc0 = _mm_add_epi32 (acc0, _mm_madd_epi16 (_mm_unpacklo_epi16 (alo, blo), w));
+			acc1 = _mm_add_epi32 (acc1, _mm_madd_epi16 (_mm_unpackhi_epi16 (alo, blo), w));
+			acc2 = _mm_add_epi32 (acc2, _mm_madd_epi16 (_mm_unpacklo_epi16 (ahi, bhi), w));
+			acc3 = _mm_add_epi32 (acc3, _mm_madd_epi16 (_mm_unpackhi_epi16 (ahi, bhi), w));
+		}
+		acc0 = _mm_srai_epi32 (_mm_add_epi32 (acc0, round), BLEND_BLUR_SHIFT);
+		acc1 = _mm_srai_epi32 (_mm_add_epi32 (acc1, round), BLEND_BLUR_SHIFT);
+		acc2 = _mm_srai_epi32 (_mm_add_epi32 (acc2, round), BLEND_BLUR_SHIFT);
+		acc3 = _mm_srai_epi32 (_mm_add_epi32 (acc3, round), BLEND_BLUR_SHIFT);
+		__m128i out = _mm_packus_epi16 (_mm_packs_epi32 (acc0, acc1), _mm_packs_epi32 (acc2, acc3));
+		_mm_storeu_si128 ((__m128i *) (dst + n), out);
+	}
+	delete [] w2;
+
+	if (n < count) {
+		XBYTE4 *tail[256], **t = (taps <= 256) ? tail : new XBYTE4*[taps];
+		for (int k=0; k < taps; k++) t[k] = rows[k] + n;
+		BlendBlur32Ref (dst + n, t, count - n, weights, taps);
+		if (t != tail) delete [] t;
+	}
+}
+
+#endif
+
+//-------------------------------------------------------- AVX2 (16 pixels)
+
+#ifdef BLEND_HAS_AVX2
+
+BLEND_AVX2_FUNC static inline __m256i ChanAVX2 (__m256i v, __m256i mask, __m128i shift)
+{
+	return _mm256_srl_epi16 (_mm256_and_si256 (v, mask), shift);
+}
+
+BLEND_AVX2_FUNC static inline __m256i MixAVX2 (__m256i v, __m256i i, __m256i va, __m256i ia, __m256i mask, __m128i shift)
+{
+	__m256i vc = _mm256_srli_epi16 (_mm256_mullo_epi16 (ChanAVX2 (v, mask, shift), va), 8);
+	__m256i ic = _mm256_srli_epi16 (_mm256_mullo_epi16 (ChanAVX2 (i, mask, shift), ia), 8);
+	return _mm256_sll_epi16 (_mm256_add_epi16 (vc, ic), shift);
+}
+
+BLEND_AVX2_FUNC static inline __m256i SelectAVX2 (__m256i skip, __m256i v, __m256i res)
+{
+	return _mm256_blendv_epi8 (res, v, skip);
+}
+
+// 32-bit lanes of two registers packed into 16 pixels in order
+BLEND_AVX2_FUNC static inline __m256i PackAVX2 (__m256i lo, __m256i hi)
+{
+	return _mm256_permute4x64_epi64 (_mm256_packs_epi32 (lo, hi), 0xD8);
+}
+
+BLEND_AVX2_FUNC static void BlendPlainAVX2 (XBYTE2 *dst, XBYTE2 *src, int count)
+{
+	__m256i zero = _mm256_setzero_si256 ();
+	int n = 0;
+	for (; n + 16 <= count; n += 16) {
+		__m256i s = _mm256_loadu_si256 ((__m256i *) (src + n));
+		__m256i v = _mm256_loadu_si256 ((__m256i *) (dst + n));
+		_mm256_storeu_si256 ((__m256i *) (dst + n), SelectAVX2 (_mm256_cmpeq_epi16 (s, zero), v, s));
+	}
+	BlendPlainRef (dst + n, src + n, count - n, 0);
+}
+
+BLEND_AVX2_FUNC static void BlendAlphaMergedAVX2 (XBYTE2 *dst, XBYTE4 *src, int count, const BlendFormat &fmt)
+{
+	__m256i mr = _mm256_set1_epi16 ((short) fmt.maskr);	__m128i sr = _mm_cvtsi32_si128 (fmt.shiftr);
+	__m256i mg = _mm256_set1_epi16 ((short) fmt.maskg);	__m128i sg = _mm_cvtsi32_si128 (fmt.shiftg);
+	__m256i mb = _mm256_set1_epi16 ((short) fmt.maskb);	__m128i sb = _mm_cvtsi32_si128 (fmt.shiftb);
+	__m256i byte = _mm256_set1_epi32 (0xFF);
+	__m256i full = _mm256_set1_epi16 (255);
+	__m256i zero = _mm256_setzero_si256 ();
+	int n = 0;
+	for (; n + 16 <= count; n += 16) {
+		__m256i s0 = _mm256_loadu_si256 ((__m256i *) (src + n));
+		__m256i s1 = _mm256_loadu_si256 ((__m256i *) (src + n + 8));
+		__m256i a = PackAVX2 (_mm256_srli_epi32 (s0, 24), _mm256_srli_epi32 (s1, 24));
+		__m256i r = PackAVX2 (_mm256_and_si256 (_mm256_srli_epi32 (s0, 16), byte), _mm256_and_si256 (_mm256_srli_epi32 (s1, 16), byte));
+		__m256i g = PackAVX2 (_mm256_and_si256 (_mm256_srli_epi32 (s0, 8), byte), _mm256_and_si256 (_mm256_srli_epi32 (s1, 8), byte));
+		__m256i b = PackAVX2 (_mm256_and_si256 (s0, byte), _mm256_and_si256 (s1, byte));
+
+		__m256i i = _mm256_or_si256 (_mm256_or_si256 (_mm256_sll_epi16 (_mm256_srli_epi16 (r, 3), sr),
+													  _mm256_sll_epi16 (_mm256_srli_epi16 (g, 2), sg)),
+													  _mm256_sll_epi16 (_mm256_srli_epi16 (b, 3), sb));
+		__m256i v = _mm256_loadu_si256 ((__m256i *) (dst + n));
+		__m256i na = _mm256_sub_epi16 (full, a);
+		__m256i res = _mm256_or_si256 (_mm256_or_si256 (MixAVX2 (v, i, na, a, mb, sb),
+														MixAVX2 (v, i, na, a, mg, sg)),
+														MixAVX2 (v, i, na, a, mr, sr));
+		_mm256_storeu_si256 ((__m256i *) (dst + n), SelectAVX2 (_mm256_cmpeq_epi16 (a, zero), v, res));
+	}
+	BlendAlphaMergedRef (dst + n, src + n, count - n, fmt);
+}
+
+BLEND_AVX2_FUNC static inline __m256i AddFullAVX2 (__m256i v, __m256i i, __m256i mask, __m128i shift, __m256i max)
+{
+	__m256i sum = _mm256_add_epi16 (ChanAVX2 (v, mask, shift), ChanAVX2 (i, mask, shift));
+	return _mm256_sll_epi16 (_mm256_min_epi16 (sum, max), shift);
+}
+
+BLEND_AVX2_FUNC static inline __m256i AddScaledAVX2 (__m256i v, __m256i i, __m256i k, __m256i mask, __m128i shift, __m256i max)
+{
+	__m256i add = _mm256_srai_epi16 (_mm256_mullo_epi16 (ChanAVX2 (i, mask, shift), k), 8);
+	__m256i sum = _mm256_add_epi16 (ChanAVX2 (v, mask, shift), add);
+	sum = _mm256_min_epi16 (_mm256_max_epi16 (sum, _mm256_setzero_si256 ()), max);
+	return _mm256_sll_epi16 (sum, shift);
+}
+
+BLEND_AVX2_FUNC static void BlendAddedAVX2 (XBYTE2 *dst, XBYTE2 *src, int count, int ri, int gi, int bi, const BlendFormat &fmt)
+{
+	__m256i mr = _mm256_set1_epi16 ((short) fmt.maskr), xr = _mm256_set1_epi16 ((short) fmt.maxr);	__m128i sr = _mm_cvtsi32_si128 (fmt.shiftr);
+	__m256i mg = _mm256_set1_epi16 ((short) fmt.maskg), xg = _mm256_set1_epi16 ((short) fmt.maxg);	__m128i sg = _mm_cvtsi32_si128 (fmt.shiftg);
+	__m256i mb = _mm256_set1_epi16 ((short) fmt.maskb), xb = _mm256_set1_epi16 ((short) fmt.maxb);	__m128i sb = _mm_cvtsi32_si128 (fmt.shiftb);
+	__m256i zero = _mm256_setzero_si256 ();
+	__m256i white = _mm256_cmpeq_epi16 (zero, zero);
+	int full = (ri==255 && gi==255 && bi==255);
+	__m256i kr = _mm256_set1_epi16 ((short) ri), kg = _mm256_set1_epi16 ((short) gi), kb = _mm256_set1_epi16 ((short) bi);
+	int n = 0;
+	for (; n + 16 <= count; n += 16) {
+		__m256i i = _mm256_loadu_si256 ((__m256i *) (src + n));
+		__m256i v = _mm256_loadu_si256 ((__m256i *) (dst + n));
+		__m256i res, skip = _mm256_cmpeq_epi16 (i, zero);
+		if (full) {
+			res = _mm256_or_si256 (_mm256_or_si256 (AddFullAVX2 (v, i, mb, sb, xb), AddFullAVX2 (v, i, mg, sg, xg)), AddFullAVX2 (v, i, mr, sr, xr));
+			skip = _mm256_or_si256 (skip, _mm256_cmpeq_epi16 (v, white));
+		} else {
+			res = _mm256_or_si256 (_mm256_or_si256 (AddScaledAVX2 (v, i, kb, mb, sb, xb), AddScaledAVX2 (v, i, kg, mg, sg, xg)), AddScaledAVX2 (v, i, kr, mr, sr, xr));
+		}
+		_mm256_storeu_si256 ((__m256i *) (dst + n), SelectAVX2 (skip, v, res));
+	}
+	BlendAddedRef (dst + n, src + n, count - n, ri, gi, bi, fmt);
+}
+
+BLEND_AVX2_FUNC static void BlendBlendedAVX2 (XBYTE2 *dst, XBYTE2 *src, int count, int r, int g, int b, int a, int nomask, const BlendFormat &fmt)
+{
+	__m256i mr = _mm256_set1_epi16 ((short) fmt.maskr);	__m128i sr = _mm_cvtsi32_si128 (fmt.shiftr);
+	__m256i mg = _mm256_set1_epi16 ((short) fmt.maskg);	__m128i sg = _mm_cvtsi32_si128 (fmt.shiftg);
+	__m256i mb = _mm256_set1_epi16 ((short) fmt.maskb);	__m128i sb = _mm_cvtsi32_si128 (fmt.shiftb);
+	__m256i na = _mm256_set1_epi16 ((short) (255-a));
+	__m256i kr = _mm256_set1_epi16 ((short) (r*a/255)), kg = _mm256_set1_epi16 ((short) (g*a/255)), kb = _mm256_set1_epi16 ((short) (b*a/255));
+	__m256i zero = _mm256_setzero_si256 ();
+	int n = 0;
+	for (; n + 16 <= count; n += 16) {
+		__m256i i = _mm256_loadu_si256 ((__m256i *) (src + n));
+		__m256i v = _mm256_loadu_si256 ((__m256i *) (dst + n));
+		__m256i res = _mm256_or_si256 (_mm256_or_si256 (MixAVX2 (v, i, na, kb, mb, sb),
+														MixAVX2 (v, i, na, kg, mg, sg)),
+														MixAVX2 (v, i, na, kr, mr, sr));
+		if (!nomask) res = SelectAVX2 (_mm256_cmpeq_epi16 (i, zero), v, res);
+		_mm256_storeu_si256 ((__m256i *) (dst + n), res);
+	}
+	BlendBlendedRef (dst + n, src + n, count - n, r, g, b, a, nomask, fmt);
+}
+
+#endif
+
+//-------------------------------------------------------- Dispatch
+
+void BlendPlain (XBYTE2 *dst, XBYTE2 *src, int count, int nomask)
+{
+	if (nomask) {
+		memcpy (dst, src, count<<1);
+		return;
+	}
+	#ifdef BLEND_HAS_AVX2
+		if (BlendGetLevel () >= BLEND_AVX2) { BlendPlainAVX2 (dst, src, count); return; }
+	#endif
+	#ifdef BLEND_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) { BlendPlainSSE2 (dst, src, count); return; }
+	#endif
+	BlendPlainRef (dst, src, count, nomask);
+}
+
+void BlendAlphaMerged (XBYTE2 *dst, XBYTE4 *src, int count, const BlendFormat &fmt)
+{
+	if (BlendVectorFormat (fmt)) {
+		#ifdef BLEND_HAS_AVX2
+			if (BlendGetLevel () >= BLEND_AVX2) { BlendAlphaMergedAVX2 (dst, src, count, fmt); return; }
+		#endif
+		#ifdef BLEND_HAS_SSE2
+			if (BlendGetLevel () >= BLEND_SSE2) { BlendAlphaMergedSSE2 (dst, src, count, fmt); return; }
+		#endif
+	}
+	BlendAlphaMergedRef (dst, src, count, fmt);
+}
+
+void BlendAdded (XBYTE2 *dst, XBYTE2 *src, int count, int ri, int gi, int bi, const BlendFormat &fmt)
+{
+	// channel * intensity has to fit a signed 16-bit lane
+	int fits = ri >= -512 && ri <= 512 && gi >= -512 && gi <= 512 && bi >= -512 && bi <= 512;
+
+	if (fits && BlendVectorFormat (fmt)) {
+		#ifdef BLEND_HAS_AVX2
+			if (BlendGetLevel () >= BLEND_AVX2) { BlendAddedAVX2 (dst, src, count, ri, gi, bi, fmt); return; }
+		#endif
+		#ifdef BLEND_HAS_SSE2
+			if (BlendGetLevel () >= BLEND_SSE2) { BlendAddedSSE2 (dst, src, count, ri, gi, bi, fmt); return; }
+		#endif
+	}
+	BlendAddedRef (dst, src, count, ri, gi, bi, fmt);
+}
+
+void BlendBlended (XBYTE2 *dst, XBYTE2 *src, int count, int r, int g, int b, int a, int nomask, const BlendFormat &fmt)
+{
+	// out of range tints overflow the channels, only the reference gets those right
+	int fits = a > 0 && a <= 255 && r >= 0 && r <= 255 && g >= 0 && g <= 255 && b >= 0 && b <= 255;
+
+	if (fits && BlendVectorFormat (fmt)) {
+		#ifdef BLEND_HAS_AVX2
+			if (BlendGetLevel () >= BLEND_AVX2) { BlendBlendedAVX2 (dst, src, count, r, g, b, a, nomask, fmt); return; }
+		#endif
+		#ifdef BLEND_HAS_SSE2
+			if (BlendGetLevel () >= BLEND_SSE2) { BlendBlendedSSE2 (dst, src, count, r, g, b, a, nomask, fmt); return; }
+		#endif
+	}
+	BlendBlendedRef (dst, src, count, r, g, b, a, nomask, fmt);
+}
+
+void BlendFill32 (XBYTE4 *dst, XBYTE4 color, int count)
+{
+	for (int x=0; x < count; x++) dst[x] = color;
+}
+
+void BlendMasked32 (XBYTE4 *dst, XBYTE4 *src, int count)
+{
+	#ifdef BLEND_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) { BlendMasked32SSE2 (dst, src, count); return; }
+	#endif
+	BlendMasked32Ref (dst, src, count);
+}
+
+void BlendOver32 (XBYTE4 *dst, XBYTE4 *src, int count)
+{
+	#ifdef BLEND_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) { BlendOver32SSE2 (dst, src, count); return; }
+	#endif
+	BlendOver32Ref (dst, src, count);
+}
+
+void BlendBlur32 (XBYTE4 *dst, XBYTE4 **rows, int count, const short *weights, int taps)
+{
+	#ifdef BLEND_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) { BlendBlur32SSE2 (dst, rows, count, weights, taps); return; }
+	#endif
+	BlendBlur32Ref (dst, rows, count, weights, taps);
+}
+
+//-------------------------------------------------------- Blurs
+
+// Sampled Gaussian of each channel over taps = 2*radius+1, rounded to
+// fixed point. Rounding error goes to the center tap so the weights add
+// up exactly and flat areas stay flat
+static void BlendGaussianWeights (short *weights, int radius, const float sigma[4])
+{
+	int taps = radius*2 + 1;
+	for (int c=0; c < 4; c++) {
+		float *f = new float[taps];
+		float total = 0.0f;
+		for (int k=0; k < taps; k++) {
+			float d = (float) (k - radius);
+			f[k] = (sigma[c] > 0.0f) ? expf (-d*d / (2.0f*sigma[c]*sigma[c])) : ((k == radius) ? 1.0f : 0.0f);
+			total += f[k];
+		}
+		int sum = 0;
+		for (int k=0; k < taps; k++) {
+			weights[k*4+c] = (short) (f[k] / total * (1 << BLEND_BLUR_SHIFT) + 0.5f);
+			sum += weights[k*4+c];
+		}
+		weights[radius*4+c] = (short) (weights[radius*4+c] + (1 << BLEND_BLUR_SHIFT) - sum);
+		delete [] f;
+	}
+}
+
+void BlendGaussianBlur32 (XBYTE4 *pixels, int xres, int yres, int pitch, const float sigma[4])
+{
+	float most = 0.0f;
+	for (int c=0; c < 4; c++) if (sigma[c] > most) most = sigma[c];
+	int radius = (int) ceilf (most * 3.0f);			// the weights past 3 sigma round to 0
+	if (radius <= 0 || xres <= 0 || yres <= 0) return;
+
+	int taps = radius*2 + 1;
+	short *weights = new short[taps*4];
+	BlendGaussianWeights (weights, radius, sigma);
+
+	XBYTE4 *temp = new XBYTE4[xres * yres];
+	XBYTE4 *line = new XBYTE4[xres + radius*2];
+	XBYTE4 **rows = new XBYTE4*[taps];
+
+	// down the columns, into temp
+	for (int y=0; y < yres; y++) {
+		for (int k=0; k < taps; k++)
+			rows[k] = pixels + BlendMin (BlendMax (y + k - radius, 0), yres-1) * pitch;
+		BlendBlur32 (temp + y*xres, rows, xres, weights, taps);
+	}
+
+	// along the rows, back out of temp through an edge-padded line
+	for (int k=0; k < taps; k++) rows[k] = line + k;
+	for (int y=0; y < yres; y++) {
+		XBYTE4 *src = temp + y*xres;
+		for (int x=0; x < radius; x++) {
+			line[x] = src[0];
+			line[radius + xres + x] = src[xres-1];
+		}
+		memcpy (line + radius, src, xres*sizeof (XBYTE4));
+		BlendBlur32 (pixels + y*pitch, rows, xres, weights, taps);
+	}
+
+	delete [] rows;
+	delete [] line;
+	delete [] temp;
+	delete [] weights;
+}
+
+// Box radii of three passes whose combined variance is closest to sigma^2
+// (two widths, the smaller used first)
+static void BlendBoxRadii (int radii[3], float sigma)
+{
+	const int n = 3;
+	float ideal = sqrtf (12.0f*sigma*sigma/n + 1.0f);
+	int wl = (int) floorf (ideal);
+	if (wl % 2 == 0) wl--;
+	int wu = wl + 2;
+	int m = (int) floorf ((12.0f*sigma*sigma - n*wl*wl - 4.0f*n*wl - 3.0f*n) / (-4.0f*wl - 4.0f) + 0.5f);
+	for (int i=0; i < n; i++) radii[i] = ((i < m) ? wl : wu) / 2;
+}
+
+void BlendBoxBlur32 (XBYTE4 *pixels, int xres, int yres, int pitch, const float sigma[4])
+{
+	if (xres <= 0 || yres <= 0) return;
+
+	int radii[4][3];
+	for (int c=0; c < 4; c++) {
+		if (sigma[c] > 0.0f) BlendBoxRadii (radii[c], sigma[c]);
+		else radii[c][0] = radii[c][1] = radii[c][2] = 0;
+	}
+
+	XBYTE4 *temp = new XBYTE4[xres * yres];
+	int longest = BlendMax (xres, yres);
+	int *sums = new int[xres*4];
+
+	for (int pass=0; pass < 3; pass++) {
+		int r[4];
+		unsigned int recip[4];
+		for (int c=0; c < 4; c++) {
+			r[c] = BlendMin (radii[c][pass], longest);
+			int w = r[c]*2 + 1;
+			recip[c] = ((1u << 24) + w/2) / w;				// sum * recip >> 24 is sum / w
+		}
+
+		// down the columns: a running sum per channel, into temp
+		for (int x=0; x < xres; x++) {
+			for (int c=0; c < 4; c++) {
+				int s = 0;
+				for (int k=-r[c]; k <= r[c]; k++)
+					s += (pixels[BlendMin (BlendMax (k, 0), yres-1) * pitch + x] >> (c*8)) & 0xFF;
+				sums[x*4+c] = s;
+			}
+		}
+		for (int y=0; y < yres; y++) {
+			XBYTE4 *out = temp + y*xres;
+			for (int c=0; c < 4; c++) {
+				XBYTE4 *add = pixels + BlendMin (y + r[c] + 1, yres-1) * pitch;
+				XBYTE4 *sub = pixels + BlendMax (y - r[c], 0) * pitch;
+				int shift = c*8;
+				for (int x=0; x < xres; x++) {
+					int &s = sums[x*4+c];
+					XBYTE4 v = ((unsigned int) s * recip[c] + (1u << 23)) >> 24;
+					out[x] = (c == 0) ? v : (out[x] | (v << shift));
+					s += (int) ((add[x] >> shift) & 0xFF) - (int) ((sub[x] >> shift) & 0xFF);
+				}
+			}
+		}
+
+		// along the rows, back out of temp
+		for (int y=0; y < yres; y++) {
+			XBYTE4 *line = temp + y*xres;
+			XBYTE4 *out = pixels + y*pitch;
+			for (int c=0; c < 4; c++) {
+				int shift = c*8, s = 0;
+				for (int k=-r[c]; k <= r[c]; k++)
+					s += (line[BlendMin (BlendMax (k, 0), xres-1)] >> shift) & 0xFF;
+				for (int x=0; x < xres; x++) {
+					XBYTE4 v = ((unsigned int) s * recip[c] + (1u << 23)) >> 24;
+					out[x] = (c == 0) ? v : (out[x] | (v << shift));
+					s += (int) ((line[BlendMin (x + r[c] + 1, xres-1)] >> shift) & 0xFF)
+						- (int) ((line[BlendMax (x - r[c], 0)] >> shift) & 0xFF);
+				}
+			}
+		}
+	}
+
+	delete [] sums;
+	delete [] temp;
+}
+
+//-------------------------------------------------------- Format conversions
+
+BlendConverter::BlendConverter (int from_bpp, int to_bpp, int r, int g, int b)
+{
+	from = from_bpp;
+	to = to_bpp;
+	sr = r; sg = g; sb = b;
+	valid = from != to && (from == 16 || from == 24 || from == 32) && (to == 16 || to == 24 || to == 32);
+
+	// The channels of a 5-6-5 pixel, decoded and shifted into place, are
+	// bit fields that don't overlap, so each byte can be looked up on its
+	// own and the two added. A 24-bit result is looked up as r,g,b
+	int tr = (to == 24) ? 16 : sr, tg = (to == 24) ? 8 : sg, tb = (to == 24) ? 0 : sb;
+	for (int v=0; v < 256; v++) {
+		XBYTE4 lo = v, hi = v << 8;
+		low[v] = (((lo & 0x001F) << 3) << tb) + (((lo & 0x07E0) >> 3) << tg);
+		high[v] = (((hi & 0x07E0) >> 3) << tg) + (((hi & 0xF800) >> 8) << tr);
+	}
+}
+
+void BlendConverter::RowRef (void *dst, void *src, int count)
+{
+	XBYTE2 *s16 = (XBYTE2 *) src, *d16 = (XBYTE2 *) dst;
+	XBYTE *s24 = (XBYTE *) src, *d24 = (XBYTE *) dst;
+	XBYTE4 *s32 = (XBYTE4 *) src, *d32 = (XBYTE4 *) dst;
+	if (!valid) return;
+
+	for (int n=0; n < count; n++) {
+		int r, g, b;
+		if (from == 16) {
+			int clr = s16[n];
+			b = ((clr & 0x001F) >> 0 ) << 3;
+			g = ((clr & 0x07E0) >> 5 ) << 2;
+			r = ((clr & 0xF800) >> 11) << 3;
+		} else if (from == 24) {
+			r = s24[n*3]; g = s24[n*3+1]; b = s24[n*3+2];
+		} else {
+			r = (s32[n] >> 16) & 0xFF; g = (s32[n] >> 8) & 0xFF; b = s32[n] & 0xFF;
+		}
+
+		if (to == 16) {
+			if (from == 32) d16[n] = (XBYTE2) (((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+			else d16[n] = (XBYTE2) (((r >> 3) << sr) | ((g >> 2) << sg) | ((b >> 3) << sb));
+		} else if (to == 24) {
+			d24[n*3] = (XBYTE) r; d24[n*3+1] = (XBYTE) g; d24[n*3+2] = (XBYTE) b;
+		} else if (from == 16) {
+			d32[n] = (r << sr) + (g << sg) + (b << sb);
+		} else {
+			d32[n] = (r << sr) | (g << sg) | (b << sb);
+		}
+	}
+}
+
+#ifdef BLEND_HAS_SSE2
+
+BLEND_SSE2_FUNC static int BlendConvert16To32SSE2 (XBYTE4 *dst, XBYTE2 *src, int count, int sr, int sg, int sb)
+{
+	__m128i shr = _mm_cvtsi32_si128 (sr), shg = _mm_cvtsi32_si128 (sg), shb = _mm_cvtsi32_si128 (sb);
+	__m128i mr = _mm_set1_epi32 (0xF800), mg = _mm_set1_epi32 (0x07E0), mb = _mm_set1_epi32 (0x001F);
+	__m128i zero = _mm_setzero_si128 ();
+	int n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m128i v = _mm_loadu_si128 ((__m128i *) (src + n));
+		for (int h=0; h < 2; h++) {
+			__m128i c = (h == 0) ? _mm_unpacklo_epi16 (v, zero) : _mm_unpackhi_epi16 (v, zero);
+			__m128i r = _mm_sll_epi32 (_mm_srli_epi32 (_mm_and_si128 (c, mr), 8), shr);
+			__m128i g = _mm_sll_epi32 (_mm_srli_epi32 (_mm_and_si128 (c, mg), 3), shg);
+			__m128i b = _mm_sll_epi32 (_mm_slli_epi32 (_mm_and_si128 (c, mb), 3), shb);
+			_mm_storeu_si128 ((__m128i *) (dst + n + h*4), _mm_add_epi32 (_mm_add_epi32 (r, g), b));
+		}
+	}
+	return n;
+}
+
+// 8-8-8 to 5-6-5, sign extended so the signed pack keeps all 16 bits
+BLEND_SSE2_FUNC static inline __m128i Pack565SSE2 (__m128i p)
+{
+	__m128i c = _mm_or_si128 (_mm_or_si128 (_mm_and_si128 (_mm_srli_epi32 (p, 8), _mm_set1_epi32 (0xF800)),
+											_mm_and_si128 (_mm_srli_epi32 (p, 5), _mm_set1_epi32 (0x07E0))),
+											_mm_and_si128 (_mm_srli_epi32 (p, 3), _mm_set1_epi32 (0x001F)));
+	return _mm_srai_epi32 (_mm_slli_epi32 (c, 16), 16);
+}
+
+BLEND_SSE2_FUNC static int BlendConvert32To16SSE2 (XBYTE2 *dst, XBYTE4 *src, int count)
+{
+	int n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m128i lo = Pack565SSE2 (_mm_loadu_si128 ((__m128i *) (src + n)));
+		__m128i hi = Pack565SSE2 (_mm_loadu_si128 ((__m128i *) (src + n + 4)));
+		_mm_storeu_si128 ((__m128i *) (dst + n), _mm_packs_epi32 (lo, hi));
+	}
+	return n;
+}
+
+BLEND_SSE2_FUNC static int BlendAlphaToMask16SSE2 (XBYTE2 *pixels, XBYTE *alpha, int count)
+{
+	__m128i zero = _mm_setzero_si128 (), one = _mm_set1_epi16 (1), cutoff = _mm_set1_epi16 (16);
+	int n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m128i d = _mm_loadu_si128 ((__m128i *) (pixels + n));
+		__m128i a = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((__m128i *) (alpha + n)), zero);
+		d = _mm_or_si128 (d, _mm_and_si128 (_mm_cmpeq_epi16 (d, zero), one));
+		d = _mm_andnot_si128 (_mm_cmplt_epi16 (a, cutoff), d);
+		_mm_storeu_si128 ((__m128i *) (pixels + n), d);
+	}
+	return n;
+}
+
+BLEND_SSE2_FUNC static int BlendMaskToAlpha16SSE2 (XBYTE *alpha, XBYTE2 *pixels, int count)
+{
+	__m128i zero = _mm_setzero_si128 ();
+	int n = 0;
+	for (; n + 16 <= count; n += 16) {
+		__m128i z0 = _mm_cmpeq_epi16 (_mm_loadu_si128 ((__m128i *) (pixels + n)), zero);
+		__m128i z1 = _mm_cmpeq_epi16 (_mm_loadu_si128 ((__m128i *) (pixels + n + 8)), zero);
+		_mm_storeu_si128 ((__m128i *) (alpha + n), _mm_andnot_si128 (_mm_packs_epi16 (z0, z1), _mm_set1_epi8 ((char) 0xFF)));
+	}
+	return n;
+}
+
+#endif
+
+void BlendConverter::Row (void *dst, void *src, int count)
+{
+	int n = 0;
+	if (!valid) return;
+
+	if (from == 16) {
+		XBYTE2 *s = (XBYTE2 *) src;
+		if (to == 32) {
+			XBYTE4 *d = (XBYTE4 *) dst;
+			#ifdef BLEND_HAS_SSE2
+				if (BlendGetLevel () >= BLEND_SSE2) n = BlendConvert16To32SSE2 (d, s, count, sr, sg, sb);
+			#endif
+			for (; n < count; n++) d[n] = low[s[n] & 0xFF] + high[s[n] >> 8];
+		} else if (to == 24) {
+			XBYTE *d = (XBYTE *) dst;
+			for (; n < count; n++) {
+				XBYTE4 v = low[s[n] & 0xFF] + high[s[n] >> 8];
+				d[n*3] = (XBYTE) (v >> 16); d[n*3+1] = (XBYTE) (v >> 8); d[n*3+2] = (XBYTE) v;
+			}
+		} else {
+			RowRef (dst, src, count);
+		}
+		return;
+	}
+
+	if (from == 24) {
+		XBYTE *s = (XBYTE *) src;
+		if (to == 32) {
+			XBYTE4 *d = (XBYTE4 *) dst;
+			for (; n < count; n++, s += 3) d[n] = (s[0] << sr) | (s[1] << sg) | (s[2] << sb);
+		} else {
+			XBYTE2 *d = (XBYTE2 *) dst;
+			for (; n < count; n++, s += 3) d[n] = (XBYTE2) (((s[0] >> 3) << sr) | ((s[1] >> 2) << sg) | ((s[2] >> 3) << sb));
+		}
+		return;
+	}
+
+	if (to == 16) {
+		XBYTE4 *s = (XBYTE4 *) src;
+		XBYTE2 *d = (XBYTE2 *) dst;
+		#ifdef BLEND_HAS_SSE2
+			if (BlendGetLevel () >= BLEND_SSE2) n = BlendConvert32To16SSE2 (d, s, count);
+		#endif
+		for (; n < count; n++) d[n] = (XBYTE2) (((s[n] >> 8) & 0xF800) | ((s[n] >> 5) & 0x07E0) | ((s[n] >> 3) & 0x001F));
+		return;
+	}
+
+	// 32 to 24 is a byte shuffle either way
+	RowRef (dst, src, count);
+}
+
+void BlendAlphaToMask16Ref (XBYTE2 *pixels, XBYTE *alpha, int count)
+{
+	for (int n=0; n < count; n++) {
+		if (pixels[n] == 0) pixels[n] = 1;
+		if (alpha[n] < 16) pixels[n] = 0;
+	}
+}
+
+void BlendMaskToAlpha16Ref (XBYTE *alpha, XBYTE2 *pixels, int count)
+{
+	for (int n=0; n < count; n++) alpha[n] = (pixels[n] == 0) ? 0 : 255;
+}
+
+void BlendAlphaToMask16 (XBYTE2 *pixels, XBYTE *alpha, int count)
+{
+	int n = 0;
+	#ifdef BLEND_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) n = BlendAlphaToMask16SSE2 (pixels, alpha, count);
+	#endif
+	BlendAlphaToMask16Ref (pixels + n, alpha + n, count - n);
+}
+
+void BlendMaskToAlpha16 (XBYTE *alpha, XBYTE2 *pixels, int count)
+{
+	int n = 0;
+	#ifdef BLEND_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) n = BlendMaskToAlpha16SSE2 (alpha, pixels, count);
+	#endif
+	BlendMaskToAlpha16Ref (alpha + n, pixels + n, count - n);
+}
+
+#ifdef BLEND_TESTER
+
+	// Checks every level against the reference formulas, then reports
+	// throughput. Plain C so it also builds and runs off Windows:
+	//   g++ -O2 -DBLEND_TESTER gamex-blend.cpp -o blendtest
+
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <time.h>
+
+	static int Rand (int lo, int hi)	{ return lo + rand () % (hi - lo + 1); }
+
+	static void Fill16 (XBYTE2 *p, int count)
+	{
+		for (int n=0; n < count; n++) p[n] = (rand () % 4 == 0) ? 0 : (XBYTE2) (rand () ^ (rand () << 8));
+		if (count > 2) p[count/2] = 0xFFFF;
+	}
+
+	static void Fill32 (XBYTE4 *p, int count)
+	{
+		for (int n=0; n < count; n++) {
+			p[n] = (XBYTE4) rand () ^ ((XBYTE4) rand () << 16);
+			if (rand () % 4 == 0) p[n] &= 0x00FFFFFF;
+		}
+	}
+
+	static int Test (int level, const BlendFormat &fmt, const char *fmt_name)
+	{
+		const int kMax = 300;
+		XBYTE2 src[kMax], dst[kMax], ref[kMax];
+		XBYTE4 src32[kMax];
+		int fails = 0;
+
+		BlendSetLevel (level);
+		for (int t=0; t < 20000; t++) {
+			int count = Rand (0, kMax);
+			int kind = t % 6;
+			Fill16 (src, count);
+			Fill16 (dst, count);
+			Fill32 (src32, count);
+			memcpy (ref, dst, count<<1);
+
+			if (kind == 0) {
+				int nomask = Rand (0, 1);
+				BlendPlain (dst, src, count, nomask);
+				BlendPlainRef (ref, src, count, nomask);
+			} else if (kind == 1) {
+				BlendAlphaMerged (dst, src32, count, fmt);
+				BlendAlphaMergedRef (ref, src32, count, fmt);
+			} else if (kind == 2) {
+				int ri = (t % 8 == 2) ? 255 : Rand (-600, 600);
+				int gi = (t % 8 == 2) ? 255 : Rand (-600, 600);
+				int bi = (t % 8 == 2) ? 255 : Rand (-600, 600);
+				BlendAdded (dst, src, count, ri, gi, bi, fmt);
+				BlendAddedRef (ref, src, count, ri, gi, bi, fmt);
+			} else if (kind >= 4) {
+				XBYTE4 dst32[kMax], ref32[kMax];
+				Fill32 (dst32, count);
+				memcpy (ref32, dst32, count<<2);
+				if (kind == 4) {
+					BlendMasked32 (dst32, src32, count);
+					BlendMasked32Ref (ref32, src32, count);
+				} else {
+					BlendOver32 (dst32, src32, count);
+					BlendOver32Ref (ref32, src32, count);
+				}
+				if (memcmp (dst32, ref32, count<<2) != 0) {
+					if (fails++ < 5) printf ("  level %d: 32-bit kernel %d differs (count %d)\n", level, kind, count);
+				}
+				continue;
+			} else {
+				int r = Rand (0, 300), g = Rand (0, 255), b = Rand (0, 255), a = Rand (1, 255), nomask = Rand (0, 1);
+				BlendBlended (dst, src, count, r, g, b, a, nomask, fmt);
+				BlendBlendedRef (ref, src, count, r, g, b, a, nomask, fmt);
+			}
+			if (memcmp (dst, ref, count<<1) != 0) {
+				if (fails++ < 5) printf ("  level %d %s: kernel %d differs (count %d)\n", level, fmt_name, kind, count);
+			}
+		}
+		return fails;
+	}
+
+	static void Bench (int level, const char *name)
+	{
+		const int kWidth = 1024, kHeight = 768, kFrames = 20;
+		XBYTE2 *src = new XBYTE2[kWidth*kHeight], *dst = new XBYTE2[kWidth*kHeight];
+		XBYTE4 *src32 = new XBYTE4[kWidth*kHeight];
+		BlendFormat fmt (0xF800, 0x07E0, 0x001F, 11, 5, 0);
+		Fill16 (src, kWidth*kHeight);
+		Fill16 (dst, kWidth*kHeight);
+		Fill32 (src32, kWidth*kHeight);
+
+		BlendSetLevel (level);
+		printf ("%-7s", name);
+		for (int kind=0; kind < 4; kind++) {
+			clock_t start = clock ();
+			for (int f=0; f < kFrames; f++) {
+				for (int y=0; y < kHeight; y++) {
+					XBYTE2 *d = dst + y*kWidth, *s = src + y*kWidth;
+					switch (kind) {
+					case 0: BlendPlain (d, s, kWidth, 0); break;
+					case 1: BlendAlphaMerged (d, src32 + y*kWidth, kWidth, fmt); break;
+					case 2: BlendAdded (d, s, kWidth, 200, 128, -64, fmt); break;
+					case 3: BlendBlended (d, s, kWidth, 255, 200, 128, 160, 0, fmt); break;
+					}
+				}
+			}
+			double secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+			printf ("  %8.1f", secs > 0 ? kWidth * kHeight * (double) kFrames / secs / 1e6 : 0.0);
+		}
+		printf ("\n");
+		delete [] src; delete [] dst; delete [] src32;
+	}
+
+	static int TestBlur (int level)
+	{
+		const int kMax = 300, kTaps = 40;
+		XBYTE4 src[kTaps][kMax], dst[kMax], ref[kMax];
+		XBYTE4 *rows[kTaps];
+		short weights[kTaps*4];
+		int fails = 0;
+
+		BlendSetLevel (level);
+		for (int t=0; t < 5000; t++) {
+			int count = Rand (0, kMax), taps = Rand (1, kTaps);
+			for (int k=0; k < taps; k++) {
+				Fill32 (src[k], count);
+				rows[k] = src[k];
+			}
+			for (int c=0; c < 4; c++) {						// random weights adding up to one
+				int left = 1 << BLEND_BLUR_SHIFT;
+				for (int k=0; k < taps; k++) {
+					int w = (k == taps-1) ? left : Rand (0, left);
+					weights[k*4+c] = (short) w;
+					left -= w;
+				}
+			}
+			BlendBlur32 (dst, rows, count, weights, taps);
+			BlendBlur32Ref (ref, rows, count, weights, taps);
+			if (memcmp (dst, ref, count<<2) != 0) {
+				if (fails++ < 5) printf ("  level %d: blur differs (count %d, taps %d)\n", level, count, taps);
+			}
+		}
+		return fails;
+	}
+
+	// Every pair of 16, 24 and 32 bits, with 5-6-5, 5-5-5 and 32-bit
+	// screen shifts, against the old formulas in RowRef. Going 16 to 32
+	// and back, or 24 to 32 and back, must also give the pixels back
+	static int TestConvert (int level)
+	{
+		const int kMax = 300;
+		const int shifts[3][3] = { {11, 5, 0}, {10, 5, 0}, {16, 8, 0} };
+		const int bpps[3] = { 16, 24, 32 };
+		XBYTE4 src[kMax], dst[kMax], ref[kMax], back[kMax];
+		XBYTE alpha[kMax];
+		XBYTE2 mask[kMax], mask_ref[kMax];
+		int fails = 0;
+
+		BlendSetLevel (level);
+		for (int t=0; t < 3000; t++) {
+			int count = Rand (0, kMax);
+			const int *sh = shifts[t % 3];
+			Fill32 (src, count);
+			for (int f=0; f < 3; f++)
+				for (int g=0; g < 3; g++) {
+					if (f == g) continue;
+					BlendConverter conv (bpps[f], bpps[g], sh[0], sh[1], sh[2]), ref_conv (bpps[f], bpps[g], sh[0], sh[1], sh[2]);
+					memset (dst, 0xCD, sizeof (dst));
+					memset (ref, 0xCD, sizeof (ref));
+					conv.Row (dst, src, count);
+					ref_conv.RowRef (ref, src, count);
+					if (memcmp (dst, ref, sizeof (dst)) != 0) {
+						if (fails++ < 5) printf ("  level %d: %d to %d bit differs (count %d, shifts %d %d %d)\n", level, bpps[f], bpps[g], count, sh[0], sh[1], sh[2]);
+					}
+				}
+			if (t % 3 == 2) {
+				BlendConverter up16 (16, 32, 16, 8, 0), down16 (32, 16, 16, 8, 0), up24 (24, 32, 16, 8, 0), down24 (32, 24, 16, 8, 0);
+				up16.Row (dst, src, count);
+				down16.Row (back, dst, count);
+				if (memcmp (back, src, count*2) != 0) {
+					if (fails++ < 5) printf ("  level %d: 16 to 32 to 16 bit loses pixels (count %d)\n", level, count);
+				}
+				up24.Row (dst, src, count);
+				down24.Row (back, dst, count);
+				if (memcmp (back, src, count*3) != 0) {
+					if (fails++ < 5) printf ("  level %d: 24 to 32 to 24 bit loses pixels (count %d)\n", level, count);
+				}
+			}
+
+			Fill16 (mask, count);
+			memcpy (mask_ref, mask, count*2);
+			for (int n=0; n < count; n++) alpha[n] = (XBYTE) ((rand () % 3 == 0) ? Rand (0, 20) : rand ());
+			BlendAlphaToMask16 (mask, alpha, count);
+			BlendAlphaToMask16Ref (mask_ref, alpha, count);
+			if (memcmp (mask, mask_ref, count*2) != 0) {
+				if (fails++ < 5) printf ("  level %d: alpha to mask differs (count %d)\n", level, count);
+			}
+			Fill16 (mask, count);
+			BlendMaskToAlpha16 (alpha, mask, count);
+			BlendMaskToAlpha16Ref ((XBYTE *) ref, mask, count);
+			if (memcmp (alpha, ref, count) != 0) {
+				if (fails++ < 5) printf ("  level %d: mask to alpha differs (count %d)\n", level, count);
+			}
+		}
+		return fails;
+	}
+
+	// A test card: gradients, hard edges and a little noise
+	static void FillCard (XBYTE4 *p, int xres, int yres)
+	{
+		for (int y=0; y < yres; y++)
+			for (int x=0; x < xres; x++) {
+				int r = (x * 255) / xres, g = (y * 255) / yres;
+				int b = (((x / 16) + (y / 16)) & 1) ? 220 : 30;
+				int a = (x*x + y*y < xres*yres / 4) ? 255 : 40;
+				b = BlendMin (255, BlendMax (0, b + Rand (-20, 20)));
+				p[y*xres + x] = ((XBYTE4) a << 24) | (r << 16) | (g << 8) | b;
+			}
+	}
+
+	// Straight 2D Gaussian in floats with the same clamped edges and cutoff
+	static void GaussianRef (XBYTE4 *dst, XBYTE4 *src, int xres, int yres, const float sigma[4])
+	{
+		float most = 0.0f;
+		for (int c=0; c < 4; c++) if (sigma[c] > most) most = sigma[c];
+		int radius = (int) ceilf (most * 3.0f);
+		for (int y=0; y < yres; y++)
+			for (int x=0; x < xres; x++) {
+				XBYTE4 out = 0;
+				for (int c=0; c < 4; c++) {
+					float sum = 0.0f, total = 0.0f;
+					for (int j=-radius; j <= radius; j++)
+						for (int i=-radius; i <= radius; i++) {
+							float w = (sigma[c] > 0.0f) ? expf (-(float) (i*i + j*j) / (2.0f*sigma[c]*sigma[c])) : ((i == 0 && j == 0) ? 1.0f : 0.0f);
+							int sx = BlendMin (BlendMax (x+i, 0), xres-1), sy = BlendMin (BlendMax (y+j, 0), yres-1);
+							sum += w * (float) ((src[sy*xres + sx] >> (c*8)) & 0xFF);
+							total += w;
+						}
+					out |= (XBYTE4) (sum / total + 0.5f) << (c*8);
+				}
+				dst[y*xres + x] = out;
+			}
+	}
+
+	static void Diff (XBYTE4 *a, XBYTE4 *b, int count, int &most, double &mean)
+	{
+		most = 0; mean = 0.0;
+		for (int n=0; n < count; n++)
+			for (int c=0; c < 4; c++) {
+				int d = (int) ((a[n] >> (c*8)) & 0xFF) - (int) ((b[n] >> (c*8)) & 0xFF);
+				if (d < 0) d = -d;
+				if (d > most) most = d;
+				mean += d;
+			}
+		mean /= count * 4.0;
+	}
+
+	// The separable fixed point blur must stay within a couple of levels
+	// of the float one; the box blur is only meant to be close
+	static int DiffBlur (void)
+	{
+		const int kWidth = 96, kHeight = 80;
+		const float sigmas[4][4] = { {0.8f, 0.8f, 0.8f, 0.8f}, {2.0f, 2.0f, 2.0f, 0.0f}, {5.0f, 1.0f, 3.0f, 2.0f}, {9.0f, 9.0f, 9.0f, 9.0f} };
+		XBYTE4 *card = new XBYTE4[kWidth*kHeight], *ref = new XBYTE4[kWidth*kHeight], *img = new XBYTE4[kWidth*kHeight];
+		int fails = 0;
+
+		FillCard (card, kWidth, kHeight);
+		printf ("sigma (b,g,r,a)        gauss max/mean   box max/mean\n");
+		for (int s=0; s < 4; s++) {
+			int most, box_most;
+			double mean, box_mean;
+			GaussianRef (ref, card, kWidth, kHeight, sigmas[s]);
+
+			memcpy (img, card, kWidth*kHeight*4);
+			BlendGaussianBlur32 (img, kWidth, kHeight, kWidth, sigmas[s]);
+			Diff (img, ref, kWidth*kHeight, most, mean);
+
+			memcpy (img, card, kWidth*kHeight*4);
+			BlendBoxBlur32 (img, kWidth, kHeight, kWidth, sigmas[s]);
+			Diff (img, ref, kWidth*kHeight, box_most, box_mean);
+
+			printf ("%4.1f %4.1f %4.1f %4.1f    %6d %6.2f    %6d %6.2f\n", sigmas[s][0], sigmas[s][1], sigmas[s][2], sigmas[s][3],
+				most, mean, box_most, box_mean);
+			if (most > 2 || box_mean > 4.0) fails++;
+		}
+		delete [] card; delete [] ref; delete [] img;
+		return fails;
+	}
+
+	static void BenchBlur (void)
+	{
+		const int kWidth = 1024, kHeight = 768;
+		const char *names[3] = { "scalar", "sse2", "avx2" };
+		const float sizes[4] = { 1.0f, 4.0f, 16.0f, 64.0f };
+		XBYTE4 *img = new XBYTE4[kWidth*kHeight];
+		FillCard (img, kWidth, kHeight);
+
+		printf ("blur ms     sigma 1  sigma 4 sigma 16 sigma 64\n");
+		for (int kind=0; kind < 3; kind++) {
+			if (kind < 2) BlendSetLevel (kind);
+			if (kind == BLEND_SSE2 && BlendDetect () < BLEND_SSE2) continue;
+			printf ("%-10s", (kind < 2) ? names[kind] : "box");
+			for (int s=0; s < 4; s++) {
+				float sigma[4] = { sizes[s], sizes[s], sizes[s], sizes[s] };
+				clock_t start = clock ();
+				if (kind < 2) BlendGaussianBlur32 (img, kWidth, kHeight, kWidth, sigma);
+				else BlendBoxBlur32 (img, kWidth, kHeight, kWidth, sigma);
+				printf ("  %7.1f", (double) (clock () - start) * 1000.0 / CLOCKS_PER_SEC);
+			}
+			printf ("\n");
+		}
+		delete [] img;
+	}
+
+	int main (void)
+	{
+		BlendFormat fmt565 (0xF800, 0x07E0, 0x001F, 11, 5, 0);
+		BlendFormat fmt555 (0x7C00, 0x03E0, 0x001F, 10, 5, 0);
+		const char *names[3] = { "scalar", "sse2", "avx2" };
+		int best = BlendDetect (), fails = 0;
+
+		srand (1234);
+		for (int level=BLEND_SSE2; level <= best; level++) {
+			fails += Test (level, fmt565, "565");
+			fails += Test (level, fmt555, "555");
+			fails += TestBlur (level);
+		}
+		for (int level=BLEND_SCALAR; level <= best; level++) fails += TestConvert (level);
+		printf ("%s: %d mismatches against the reference, best level %s\n", fails ? "FAILED" : "OK", fails, names[best]);
+
+		BlendSetLevel (best);
+		int blur_fails = DiffBlur ();
+		printf ("%s: %d blurs off the float reference\n", blur_fails ? "FAILED" : "OK", blur_fails);
+
+		printf ("MP/s      plain    alpha    added  blended\n");
+		for (int level=BLEND_SCALAR; level <= best; level++) Bench (level, names[level]);
+		BenchBlur ();
+		return (fails || blur_fails) ? 1 : 0;
+	}
+
+#endif
@@ -0,0 +1,131 @@
+//
+// GameX - Blend Kernels Header
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#ifndef BLEND_DEF
+	#define BLEND_DEF
+
+	// #define BLEND_TESTER
+
+	// Row kernels for the software blitters. They work on plain pixel
+	// buffers so nothing here depends on DirectX or Windows. Each kernel
+	// has a scalar reference (the formulas the blitters always used) and
+	// SSE2/AVX2 versions that must match it bit for bit.
+
+	#ifndef XBYTE
+		#ifdef _MSC_VER
+			#define XBYTE				unsigned __int8
+			#define XBYTE2				unsigned __int16
+			#define XBYTE4				unsigned __int32
+			#define XBYTE8				__int64
+		#else
+			#define XBYTE				unsigned char
+			#define XBYTE2				unsigned short
+			#define XBYTE4				unsigned int
+			#define XBYTE8				long long
+		#endif
+	#endif
+
+	#define BLEND_SCALAR		0
+	#define BLEND_SSE2			1
+	#define BLEND_AVX2			2
+
+	#define BLEND_CHUNK			256			// Pixels gathered at a time by stretched draws
+	#define BLEND_BLUR_SHIFT	14			// Blur weights are fixed point, 1 << 14 is 1.0
+
+	// Layout of a 16-bit destination surface
+	class BlendFormat {
+	public:
+		BlendFormat (int mr, int mg, int mb, int sr, int sg, int sb);
+
+		int maskr, maskg, maskb;
+		int shiftr, shiftg, shiftb;
+		int maxr, maxg, maxb;					// Largest channel values (mask >> shift)
+	};
+
+	int BlendGetLevel (void);								// Best level this CPU supports
+	void BlendSetLevel (int level);							// Force a level (capped to what the CPU has)
+
+	// Nearest-neighbor gather of 'count' pixels starting at dest column 'x'
+	void BlendGather16 (XBYTE2 *out, XBYTE2 *src_row, int x, int count, int src_width, int dst_width);
+	void BlendGather32 (XBYTE4 *out, XBYTE4 *src_row, int x, int count, int src_width, int dst_width);
+
+	// Copy src over dst, skipping black (0) pixels unless nomask
+	void BlendPlain (XBYTE2 *dst, XBYTE2 *src, int count, int nomask);
+	void BlendPlainRef (XBYTE2 *dst, XBYTE2 *src, int count, int nomask);
+
+	// Blend 32-bit ARGB src into dst by its alpha, skipping alpha 0
+	void BlendAlphaMerged (XBYTE2 *dst, XBYTE4 *src, int count, const BlendFormat &fmt);
+	void BlendAlphaMergedRef (XBYTE2 *dst, XBYTE4 *src, int count, const BlendFormat &fmt);
+
+	// Add src to dst scaled by ri,gi,bi (255 = full add, negative subtracts)
+	void BlendAdded (XBYTE2 *dst, XBYTE2 *src, int count, int ri, int gi, int bi, const BlendFormat &fmt);
+	void BlendAddedRef (XBYTE2 *dst, XBYTE2 *src, int count, int ri, int gi, int bi, const BlendFormat &fmt);
+
+	// Blend src tinted by r,g,b into dst with opacity a
+	void BlendBlended (XBYTE2 *dst, XBYTE2 *src, int count, int r, int g, int b, int a, int nomask, const BlendFormat &fmt);
+	void BlendBlendedRef (XBYTE2 *dst, XBYTE2 *src, int count, int r, int g, int b, int a, int nomask, const BlendFormat &fmt);
+
+	// 32-bit ARGB spans, used by the software renderer (gamex-soft)
+	void BlendFill32 (XBYTE4 *dst, XBYTE4 color, int count);
+
+	// Copy src over dst, skipping pixels whose color is black
+	void BlendMasked32 (XBYTE4 *dst, XBYTE4 *src, int count);
+	void BlendMasked32Ref (XBYTE4 *dst, XBYTE4 *src, int count);
+
+	// Source-over by the source alpha, rounded to nearest. dst alpha
+	// is blended as if the source were opaque
+	void BlendOver32 (XBYTE4 *dst, XBYTE4 *src, int count);
+	void BlendOver32Ref (XBYTE4 *dst, XBYTE4 *src, int count);
+
+	// One blur pass: channel c of dst[x] is the rounded sum over k of
+	// weights[k*4+c] * channel c of rows[k][x]. Channels are in byte order
+	// (b,g,r,a) and each one's weights add up to 1 << BLEND_BLUR_SHIFT.
+	// rows[k] = src+k blurs along a row, rows[k] = row y+k down a column
+	void BlendBlur32 (XBYTE4 *dst, XBYTE4 **rows, int count, const short *weights, int taps);
+	void BlendBlur32Ref (XBYTE4 *dst, XBYTE4 **rows, int count, const short *weights, int taps);
+
+	// Blur a whole 32-bit ARGB buffer in place, with edges clamped. sigma
+	// is per channel, in byte order. The Gaussian is done in two separable
+	// passes, O(sigma) per pixel; the box version approximates it with
+	// three box blurs, O(1) per pixel whatever the sigma
+	void BlendGaussianBlur32 (XBYTE4 *pixels, int xres, int yres, int pitch, const float sigma[4]);
+	void BlendBoxBlur32 (XBYTE4 *pixels, int xres, int yres, int pitch, const float sigma[4]);
+
+	// Rows of ImageX::ConvertFormat, with the formulas it always used:
+	// 16-bit pixels are read as 5-6-5, 24-bit ones are r,g,b bytes and
+	// sr,sg,sb place the channels of a 16 or 32-bit result (the screen's
+	// shifts; 32 to 16 always writes 5-6-5). 16-bit sources go through
+	// two 256 entry tables, one per byte, built once per converter
+	class BlendConverter {
+	public:
+		BlendConverter (int from_bpp, int to_bpp, int sr, int sg, int sb);
+
+		bool IsValid (void)		{ return valid; }			// false for formats it can't convert
+
+		void Row (void *dst, void *src, int count);
+		void RowRef (void *dst, void *src, int count);
+
+	private:
+		int from, to;
+		int sr, sg, sb;
+		bool valid;
+		XBYTE4 low[256], high[256];				// A 16-bit source pixel becomes low[v & 0xFF] + high[v >> 8]
+	};
+
+	// The 16-bit mask/alpha swaps. AlphaToMask clears pixels whose alpha
+	// is under 16 and turns other black pixels to 1 so they stay solid;
+	// MaskToAlpha gives black pixels alpha 0 and the rest 255
+	void BlendAlphaToMask16 (XBYTE2 *pixels, XBYTE *alpha, int count);
+	void BlendAlphaToMask16Ref (XBYTE2 *pixels, XBYTE *alpha, int count);
+	void BlendMaskToAlpha16 (XBYTE *alpha, XBYTE2 *pixels, int count);
+	void BlendMaskToAlpha16Ref (XBYTE *alpha, XBYTE2 *pixels, int count);
+
+#endif
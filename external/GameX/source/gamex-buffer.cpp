@@ -9,8 +9,20 @@
 // distribution and re-release. 
 // 
 
+#include "gamex-blend.hpp"
 #include "gamex-buffer.hpp"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define BUFFER_HAS_SSE2
+	#include <emmintrin.h>
+#endif
+
+#ifdef __GNUC__
+	#define BUFFER_SSE2_FUNC	__attribute__ ((target ("sse2")))
+#else
+	#define BUFFER_SSE2_FUNC
+#endif
+
 Buffer::Buffer (void)
 {
 	buf_type = BUFFER_EMPTY;
@@ -136,7 +148,7 @@ void Buffer::Scale (XBYTE *in, int width, int scale)
 		*in_pnt *= scale;
 }
 
-int Buffer::PackBits (XBYTE *in, XBYTE *out, int width)
+int Buffer::PackBitsRef (XBYTE *in, XBYTE *out, int width)
 {
 	int len, wid, cnt;
 
@@ -205,7 +217,7 @@ int Buffer::PackBits (XBYTE *in, XBYTE *out, int width)
 	return len;
 }
 
-int Buffer::UnpackBits (XBYTE *in, XBYTE *out, int width)
+int Buffer::UnpackBitsRef (XBYTE *in, XBYTE *out, int width)
 {
 	int len, wid;
 	unsigned char run;
@@ -233,6 +245,120 @@ int Buffer::UnpackBits (XBYTE *in, XBYTE *out, int width)
 	return len;	
 }
 
+// The lowest set bit of a 16-bit compare mask
+static inline int BufferFirstBit (int mask)
+{
+	int n = 0;
+	while (!(mask & 1)) mask >>= 1, n++;
+	return n;
+}
+
+#ifdef BUFFER_HAS_SSE2
+
+// Where a run of 3 starts, checked 16 places at a pass: each byte
+// against the next one and the one after. Stops while the loads still
+// fit in 'wid'; returns where it got to, or 'limit' if it found one
+// that far on
+BUFFER_SSE2_FUNC static int BufferRunStartSSE2 (const XBYTE *in, int c, int limit, int wid, int *found)
+{
+	for (; c < limit && c + 18 <= wid; c += 16) {
+		__m128i a = _mm_loadu_si128 ((__m128i *) (in + c));
+		__m128i b = _mm_loadu_si128 ((__m128i *) (in + c + 1));
+		__m128i d = _mm_loadu_si128 ((__m128i *) (in + c + 2));
+		int mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (a, b), _mm_cmpeq_epi8 (b, d)));
+		if (mask != 0) {
+			c += BufferFirstBit (mask);
+			*found = (c < limit) ? c : limit;
+			return *found;
+		}
+	}
+	return (c < limit) ? c : limit;
+}
+
+// How far bytes equal to in[0] go, 16 at a pass
+BUFFER_SSE2_FUNC static int BufferRunLengthSSE2 (const XBYTE *in, int c, int limit, int *found)
+{
+	__m128i v = _mm_set1_epi8 ((char) in[0]);
+	for (; c + 16 <= limit; c += 16) {
+		int mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((__m128i *) (in + c)), v)) ^ 0xFFFF;
+		if (mask != 0) {
+			*found = c + BufferFirstBit (mask);
+			return *found;
+		}
+	}
+	return c;
+}
+
+#endif
+
+// Same output as PackBitsRef, one span at a time: SSE2 finds where
+// each run or literal span ends, and literals are copied in one go.
+// Spans are at most 127 bytes, and 3 equal bytes start a run. Unlike
+// the original this never reads past the end of 'in'
+int Buffer::PackBits (XBYTE *in, XBYTE *out, int width)
+{
+	int len = 0, wid = width, cnt, limit, found;
+	bool sse2 = BlendGetLevel () >= BLEND_SSE2;
+
+	while (wid > 0) {
+		limit = (wid < 127) ? wid : 127;
+		found = -1;
+		if (wid >= 3 && in[0] == in[1] && in[1] == in[2]) {
+			cnt = 3;
+			#ifdef BUFFER_HAS_SSE2
+				if (sse2) cnt = BufferRunLengthSSE2 (in, cnt, limit, &found);
+			#endif
+			if (found < 0)
+				while (cnt < limit && in[cnt] == in[0]) cnt++;
+			else cnt = found;
+			out[0] = (XBYTE) (257 - cnt);	// Repeated bytes (as neg. number)
+			out[1] = in[0];
+			out += 2;
+			len += 2;
+		} else {
+			cnt = 1;						// in[0] can't start a run here
+			if (wid > 3) {
+				#ifdef BUFFER_HAS_SSE2
+					if (sse2) cnt = BufferRunStartSSE2 (in, cnt, limit, wid, &found);
+				#endif
+				if (found < 0)
+					while (cnt < limit && !(cnt + 2 < wid && in[cnt] == in[cnt+1] && in[cnt+1] == in[cnt+2])) cnt++;
+				else cnt = found;
+			} else cnt = wid;				// Last 1-3 bytes, not all same
+			out[0] = (XBYTE) (cnt - 1);		// Bytes stored
+			memcpy (out + 1, in, cnt);
+			out += cnt + 1;
+			len += cnt + 1;
+		}
+		in += cnt;
+		wid -= cnt;
+	}
+	return len;
+}
+
+// UnpackBitsRef with each span filled or copied whole
+int Buffer::UnpackBits (XBYTE *in, XBYTE *out, int width)
+{
+	int len = 0, wid = width, run;
+
+	while (wid > 0) {
+		run = *in++;
+		if (run >= 128) {
+			run = 257 - run;
+			memset (out, *in++, run);
+			wid -= 2;
+		} else {
+			run++;
+			memcpy (out, in, run);
+			in += run;
+			wid -= run + 1;
+		}
+		out += run;
+		len += run;
+	}
+	return len;
+}
+
 int Buffer::UnstuffEachBit (XBYTE *in, XBYTE *out, int width)
 {
 	XBYTE *in_pnt = in;
@@ -300,7 +426,120 @@ int Buffer::ReadWord (char *line, char *word, char delim)
 }
 
 #ifdef BUFFER_TESTER
-	void main (void)
+
+	// Besides the old checks this fuzzes PackBits and UnpackBits against
+	// the originals (under both blend levels) and times them. Builds off
+	// Windows with a conio.h that has getch, for example:
+	//   g++ -O2 -DBUFFER_TESTER -Ishim gamex-buffer.cpp gamex-blend.cpp gamex-debug.cpp
+
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <sys/time.h>
+	#endif
+
+	static double Seconds (void)
+	{
+		#ifdef _WIN32
+			LARGE_INTEGER freq, now;
+			QueryPerformanceFrequency (&freq);
+			QueryPerformanceCounter (&now);
+			return (double) now.QuadPart / (double) freq.QuadPart;
+		#else
+			struct timeval tv;
+			gettimeofday (&tv, NULL);
+			return tv.tv_sec + tv.tv_usec / 1e6;
+		#endif
+	}
+
+	static int Rand (int lo, int hi)	{ return lo + rand () % (hi - lo + 1); }
+
+	#define PACK_MAX		3000
+	#define GUARD			0xA5
+
+	// Noise, long runs (around the 3 that starts one, the 16 a pass and
+	// the 127 a span), or mostly short ones, from alphabets small enough
+	// that runs of 2 and 3 also turn up by chance
+	static void MakeRow (XBYTE *row, int width, int kind)
+	{
+		int alphabet = (kind == 0) ? 256 : (kind == 1) ? 3 : 16;
+		for (int n=0; n < width; ) {
+			int run = (kind == 0) ? 1 : (kind == 1) ? (Rand (0, 3) == 0 ? Rand (1, 300) : Rand (1, 20)) :
+					  (Rand (0, 7) == 0 ? Rand (1, 40) : Rand (1, 3));
+			XBYTE v = (XBYTE) Rand (0, alphabet - 1);
+			for (int r=0; r < run && n < width; r++) row[n++] = v;
+		}
+	}
+
+	static int TestPackBits (void)
+	{
+		static XBYTE row[PACK_MAX + 2], pack[PACK_MAX * 2 + 16], ref[PACK_MAX * 2 + 16];
+		static XBYTE unpack[PACK_MAX + 16], unref[PACK_MAX + 16];
+		Buffer code;
+		int fails = 0;
+
+		for (int t=0; t < 100000; t++) {
+			int width = (t < 50) ? t : Rand (1, (t % 10 == 0) ? PACK_MAX : 300);
+			MakeRow (row, width, t % 3);
+			// PackBitsRef looks 2 bytes past the end; keep those from
+			// finishing a run so it packs only what's in the row
+			row[width] = (XBYTE) ((width > 0 ? row[width-1] : 0) ^ 0x55);
+			row[width+1] = (XBYTE) (row[width] ^ 0x55);
+
+			memset (pack, GUARD, sizeof (pack)); memset (ref, GUARD, sizeof (ref));
+			int num = code.PackBits (row, pack, width);
+			int num_ref = code.PackBitsRef (row, ref, width);
+			if ((num != num_ref || memcmp (pack, ref, sizeof (pack)) != 0) && fails++ < 5)
+				printf ("  PackBits of %d bytes differs: %d, %d\n", width, num, num_ref);
+
+			memset (unpack, GUARD, sizeof (unpack)); memset (unref, GUARD, sizeof (unref));
+			int got = code.UnpackBits (pack, unpack, num);
+			int got_ref = code.UnpackBitsRef (pack, unref, num);
+			if ((got != width || got_ref != width || memcmp (unpack, row, width) != 0 ||
+				 memcmp (unpack, unref, sizeof (unpack)) != 0) && fails++ < 5)
+				printf ("  UnpackBits of %d bytes differs: %d, %d\n", width, got, got_ref);
+		}
+		return fails;
+	}
+
+	// MB/s of unpacked bytes, through rows as wide as a big image's
+	static void BenchPackBits (int kind, const char *name)
+	{
+		const int width = 4096 * 3, rows = 64, passes = 40;
+		XBYTE *img = new XBYTE[width * rows + 2], *pack = new XBYTE[(width * 2 + 16) * rows], *out = new XBYTE[width + 16];
+		int *sizes = new int[rows];
+		Buffer code;
+		MakeRow (img, width * rows, kind);
+		img[width * rows] = (XBYTE) (img[width * rows - 1] ^ 0x55);
+		img[width * rows + 1] = (XBYTE) (img[width * rows] ^ 0x55);
+
+		double mb = (double) width * rows * passes / 1048576.0, secs[4];
+		int total = 0;
+		for (int way=0; way < 4; way++) {
+			double start = Seconds ();
+			for (int p=0; p < passes; p++) {
+				for (int y=0; y < rows; y++) {
+					XBYTE *in = img + y * width, *packed = pack + y * (width * 2 + 16);
+					switch (way) {
+					case 0: sizes[y] = code.PackBitsRef (in, packed, width); break;
+					case 1: sizes[y] = code.PackBits (in, packed, width); break;
+					case 2: code.UnpackBitsRef (packed, out, sizes[y]); break;
+					case 3: code.UnpackBits (packed, out, sizes[y]); break;
+					}
+				}
+			}
+			secs[way] = Seconds () - start;
+		}
+		for (int y=0; y < rows; y++) total += sizes[y];
+		printf ("%-8s (packs to %3d%%)  %8.0f  %8.0f  %8.0f  %8.0f\n", name, (int) (100.0 * total / (width * rows)),
+				mb / secs[0], mb / secs[1], mb / secs[2], mb / secs[3]);
+		delete [] img;
+		delete [] pack;
+		delete [] out;
+		delete [] sizes;
+	}
+
+	int main (void)
 	{
 		Buffer code;
 		
@@ -322,6 +561,20 @@ int Buffer::ReadWord (char *line, char *word, char delim)
 		num = code.UnpackBits ((XBYTE*) buf_pack, (XBYTE*) buf_unpack, num);
 		buf_unpack[num] = '\0';
 		printf ("Unpacked: %s\n\n", buf_unpack);
+
+		// Fuzz and time PackBits / UnpackBits
+		int best = BlendGetLevel (), fails = 0;
+		srand (1234);
+		if (best >= BLEND_SSE2) fails += TestPackBits ();
+		BlendSetLevel (BLEND_SCALAR);
+		fails += TestPackBits ();
+		BlendSetLevel (best);
+		printf ("PackBits: %s, %d mismatches\n", fails ? "FAILED" : "OK", fails);
+		printf ("MB/s                       pack old  pack new  unpk old  unpk new\n");
+		BenchPackBits (0, "noise");
+		BenchPackBits (2, "mixed");
+		BenchPackBits (1, "runs");
+		printf ("\n");
 		
 		// Test Byte Decoding (LBF/MBF)
 		
@@ -341,5 +594,6 @@ int Buffer::ReadWord (char *line, char *word, char delim)
 
 		printf ("Buffer testing finished.\n");
 		getch();
+		return fails ? 1 : 0;
 	}
 #endif
@@ -59,6 +59,8 @@
 
 		int PackBits (XBYTE *in, XBYTE *out, int width);		// Simple RLE encoding/decoding
 		int UnpackBits (XBYTE *in, XBYTE *out, int width);
+		int PackBitsRef (XBYTE *in, XBYTE *out, int width);		// The byte at a time originals, which
+		int UnpackBitsRef (XBYTE *in, XBYTE *out, int width);	// they must match. PackBitsRef peeks 2 bytes past the end
 ///		int UnstuffBits (XBYTE *in, XBYTE *out, int width, unsigned char *stuff_info);
 		int UnstuffEachBit (XBYTE *in, XBYTE *out, int width);
 
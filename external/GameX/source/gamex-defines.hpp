@@ -37,6 +37,7 @@
 		VIDEO_32BIT 			  = 0x00008000l, // (MOSTLY IMPLEMENTED) run game in 32 bit color mode -- supported but may be slow depending on video card
 		// audio flags for advanced users:
 		AUDIO_DISABLE			  = 0x00010000l, // disable all audio support, so sounds and music will not play -- only possible use is to mute a game when debugging to make debugging easier or something
+		AUDIO_MIXER 			  = 0x00020000l, // mix 16-bit sounds in software into one DirectSound buffer instead of giving each sound a buffer of its own -- better for games that play many sounds at once
 		// other flags for advanced users:
 		RUN_NOMOUSEINPUT		  = 0x20000000l, // prevent GameX from keeping track of mouse movement and clicks
 		RUN_BACKGROUND			  = 0x40000000l, // allow game to keep running even in the background by preventing GameX from automatically pausing the game -- possible uses are for networked games or cheat prevention, maybe
@@ -360,6 +361,7 @@
 	#define INPUT_PRESSED	0x80 // (must be 0x80 = 128, it's part of DirectInput functions for pressed states)
 
 	#define WINDX_BUFSIZE	1024 // Keyboard Buffer Size, newest data is lost if buffer overflows
+	#define WINDX_BATCHSIZE	2048 // Most quads drawn by one call while batching (must keep 4x under 65536 vertices)
 
 
 	enum _COLOR_SET_COND {
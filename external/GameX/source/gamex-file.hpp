@@ -11,7 +11,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <conio.h>
+#include <string.h>
+#ifdef _WIN32
+	#include <conio.h>
+#endif
 
 #include "gamex-debug.hpp"			// Access debugging
 
@@ -25,13 +28,23 @@
 
 	#ifndef XCHAR
 		#define XCHAR				char
-		#define XBYTE				unsigned __int8
-		#define XBYTE2				unsigned __int16
-		#define XBYTE4				unsigned __int32
-		#define XBYTE8				__int64
+	#endif
+	#ifndef XBYTE
+		#ifdef _MSC_VER
+			#define XBYTE				unsigned __int8
+			#define XBYTE2				unsigned __int16
+			#define XBYTE4				unsigned __int32
+			#define XBYTE8				__int64
+		#else
+			#define XBYTE				unsigned char
+			#define XBYTE2				unsigned short
+			#define XBYTE4				unsigned int
+			#define XBYTE8				long long
+		#endif
 	#endif
 
 	#define FILE_BUFFER			2000
+	#define FILE_BLOCK			65536		// Default read-ahead of a FileReader
 	#define FILE_NAMELEN		260
 	#define FILE_LINELEN		500
 
@@ -107,6 +120,63 @@
 		long buffer_pos;		
 	};
 
+	// Reads a file through a buffer of 'block' bytes, so loaders that
+	// walk a file a field at a time ask the OS for one block instead of
+	// each field. Reads of a block or more go straight to the caller.
+	// Read only, with the same reads as File; they return
+	// FILE_STATUS_EOF when there weren't 'num' bytes left.
+	class FileReader {
+	public:
+		FileReader ();
+		~FileReader ();
+
+		int Open (char *fname, int block = FILE_BLOCK);	// FILE_STATUS_OK, or FILE_EXIST_NO
+		void Close (void);
+
+		int ReadC (int num, XCHAR *buf)		{ return Read (num, (XBYTE *) buf); }
+		int Read (int num, XBYTE *buf);
+		inline int Read (XBYTE &c)			{ return ReadSmall (1, &c); }
+		inline int Read2 (XBYTE2 &c)		{ return ReadSmall (2, (XBYTE *) &c); }
+		inline int Read4 (XBYTE4 &c)		{ return ReadSmall (4, (XBYTE *) &c); }
+
+		void SetPosition (long pos);		// Or FILE_POS_BEGIN, FILE_POS_END
+		inline long GetPosition (void)		{ return m_pos; }
+		inline long GetSize (void)			{ return m_size; }
+		inline int EndOfFile (void)			{ return m_pos >= m_size; }
+
+		// The whole file, if it's mapped into memory (see FileMapped);
+		// otherwise NULL
+		inline const XBYTE *GetData (void)	{ return m_mapped ? m_buf : NULL; }
+		inline int GetNumReads (void)		{ return m_reads; }	// Reads asked of the OS
+
+	protected:
+		inline int ReadSmall (int num, XBYTE *buf) {
+			long at = m_pos - m_start;
+			if (at < 0 || at + num > m_len) return Read (num, buf);
+			memcpy (buf, m_buf + at, num);
+			m_pos += num;
+			return FILE_STATUS_OK;
+		}
+		bool Fill (void);					// Reads the block at m_pos
+
+		FILE *m_fp;
+		XBYTE *m_buf;
+		long m_start, m_len;				// Where the buffer is in the file, and bytes in it
+		long m_pos, m_fpos, m_size;			// Read position, and where m_fp is
+		int m_block, m_reads;
+		bool m_mapped;
+		void *m_map_file, *m_map;			// Handles of the mapping, on Windows
+	};
+
+	// A FileReader with the whole file mapped into memory instead, so
+	// reads are copies out of the mapping and GetData gives all of it
+	// to decode in place. Falls back to reading through a buffer if the
+	// file can't be mapped
+	class FileMapped : public FileReader {
+	public:
+		int Open (char *fname, int block = FILE_BLOCK);
+	};
+
 #endif
 
 
@@ -15,7 +15,7 @@
 // NOTE: CURRENT CAPABILITIES:
 //		- Load supports:
 //					1 bits/channel			BW
-//					8,16,32 bit/channel		Grayscale (no alpha)
+//					8,16,32 bit/channel		Grayscale (with or without alpha)
 //					8,16,32 bit/channel		RGB (with or without alpha)
 //		- Save supports:
 //					8 bit					RGB (without alpha)
@@ -24,394 +24,70 @@
 
 #include "gamex-image-tiff.hpp"
 
-bool ImageExt::LoadTiffData (File &tiff, Buffer &code, unsigned long count, unsigned long offset, int row)
-{
-	XBYTE in[TIFF_BUFFER];
-	XBYTE out[TIFF_BUFFER];
-	XBYTE *pData, *pAlpha;
-	int x, y, lastrow;	
-
-	pData = m_pImg->m_data;							// Get ImageX color data
-	pAlpha = m_pImg->m_alpha;						// Get ImageX alpha data 
-	
-	tiff.SetPosition (offset);						// Set file position to TIFF data
-	lastrow = row + m_rps - 1;
-	if (lastrow > m_yres-1) lastrow = m_yres-1;		// Determine last row to process
-	
-	switch (m_mode) {
-	case TIFF_MODE_BW: {							// Black & White TIFF		
-		XBYTE* pIn;
-		for (y = row; y <= lastrow; y++) {			// Assume 1 Bit Per Pixel
-			tiff.Read (m_bpr, in);					// Read row in TIFF
-			code.UnstuffEachBit (in, out, m_bpr);	// Unstuff row from bits to bytes
-			code.Scale (out, m_bpr*8, 255);			// Rescale row from 0-1 to 0-255
-			if (m_photo == TIFF_PHOTO_WHITEZERO)	// Invert if photometrically stored
-				code.Invert (out, m_bpr*8);			
-			pIn = (XBYTE *) in;
-			for (x=0; x < m_xres; x++) {
-				*pData++ = (XBYTE) *pIn;				// Copy Black/White byte data 
-				*pData++ = (XBYTE) *pIn;				// into Red, Green and Blue bytes.
-				*pData++ = (XBYTE) *pIn++;
-			}
-		}		
-	} break;
-	case TIFF_MODE_GRAY: {							// Grayscale TIFF
-		switch (m_bpc[CHAN_GRAY]) {
-		case 8: {									// 8 Bits per Channel			
-			XBYTE *pIn;			
-			for (y = row; y <= lastrow; y++) {
-				tiff.Read (m_bpr, in);
-				pIn = (XBYTE *) in;
-				for (x=0; x < m_xres; x++) {
-					*pData++ = (XBYTE) *pIn;			// Copy Gray byte data 
-					*pData++ = (XBYTE) *pIn;			// into Red, Green and Blue bytes.
-					*pData++ = (XBYTE) *pIn++;
-				}
-			}
-		} break;
-		case 16: {									// 16 Bits per Channel			
-			XBYTE2 *pIn;
-			for (y = row; y <= lastrow;	y++) {
-				tiff.Read (m_bpr, in);
-				pIn = (XBYTE2 *) in;
-				for (x=0; x < m_xres; x++) {
-					*pData++ = (XBYTE) (*pIn >> 8);		// Copy Gray 2-byte data 
-					*pData++ = (XBYTE) (*pIn >> 8);		// into Red, Green and Blue bytes.
-					*pData++ = (XBYTE) (*pIn++ >> 8);
-				}
-			}
-		 } break;
-		case 32: {									// 32 Bits per Channel
- 			XBYTE4 *pIn;
-			for (y = row; y <= lastrow;	y++) {
-				tiff.Read (m_bpr, in);
-				pIn = (XBYTE4 *) in;
-				for (x=0; x < m_xres; x++) {
-					*pData++ = (XBYTE) (*pIn >> 24);		// Copy Gray 4-byte data
-					*pData++ = (XBYTE) (*pIn >> 24);		// into Red, Green and Blue bytes.
-					*pData++ = (XBYTE) (*pIn++ >> 24);
-				}
-			}
-		} break;
-		}
-	} break;
-	case TIFF_MODE_RGB: case TIFF_MODE_RGBA: {							// Full Color TIFF
-		switch (m_bpc[CHAN_RED]) {					
-		case 8: {									// 8 Bits per Channel
-			XBYTE *pIn;							
-			if (m_alpha==TIFF_ALPHA_YES) {					// Alpha included.
-				for (y = row; y <= lastrow;	y++) {
-					tiff.Read (m_bpr, in);
-					pIn = (XBYTE *) in;
-					for (x=0; x < m_xres; x++) {
-						*pData++ = (XBYTE) *pIn++; 
-						*pData++ = (XBYTE) *pIn++; 
-						*pData++ = (XBYTE) *pIn++; 
-						*pAlpha++ = (XBYTE) *pIn++;
-					}
-				}
-			} else {										// No Alpha.
-				for (y = row; y <= lastrow; y++) {
-					tiff.Read (m_bpr, in);				
-					pIn = (XBYTE *) in;
-					for (x=0; x < m_xres; x++) {
-						*pData++ = (XBYTE) *pIn++; 
-						*pData++ = (XBYTE) *pIn++; 
-						*pData++ = (XBYTE) *pIn++;					
-					}
-				}
-			}
-		} break;
-		case 16: {									// 16 Bits per Channel
-			XBYTE2 *pIn;
-			if (m_alpha==TIFF_ALPHA_YES) {					// Alpha included.
-				for (y = row; y <= lastrow;	y++) {
-					tiff.Read (m_bpr, in);
-					pIn = (XBYTE2 *) in;
-					for (x=0; x < m_xres; x++) {
-						*pData++ = (XBYTE) (*pIn++ >> 8); 
-						*pData++ = (XBYTE) (*pIn++ >> 8);
-						*pData++ = (XBYTE) (*pIn++ >> 8); 
-						*pAlpha++ = (XBYTE) (*pIn++ >> 8);
-					}
-				}
-			} else {
-				for (y = row; y <= lastrow; y++) {			// No Alpha.
-					tiff.Read (m_bpr, in);
-					pIn = (XBYTE2 *) in;
-					for (x=0; x < m_xres; x++) {
-						*pData++ = (XBYTE) (*pIn++ >> 8); 
-						*pData++ = (XBYTE) (*pIn++ >> 8);
-						*pData++ = (XBYTE) (*pIn++ >> 8);					
-					}
-				}
-			}
-		} break;
-		case 32: {									// 32 Bits per Channel
- 			XBYTE4 *pIn;
-			if (m_alpha==TIFF_ALPHA_YES) {				
-				for (y = row; y <= lastrow;	y++) {
-					tiff.Read (m_bpr, in);
-					pIn = (XBYTE4 *) in;
-					for (x=0; x < m_xres; x++) {
-						*pData++ = (XBYTE) (*pIn++ >> 24); 
-						*pData++ = (XBYTE) (*pIn++ >> 24);
-						*pData++ = (XBYTE) (*pIn++ >> 24); 
-						*pAlpha++ = (XBYTE) (*pIn++ >> 24);
-					}
-				}
-			} else {
-				for (y = row; y <= lastrow; y++) {
-					tiff.Read (m_bpr, in);
-					pIn = (XBYTE4 *) in;
-					for (x=0; x < m_xres; x++) {
-						*pData++ = (XBYTE) (*pIn++ >> 24); 
-						*pData++ = (XBYTE) (*pIn++ >> 24);
-						*pData++ = (XBYTE) (*pIn++ >> 24);					
-					}
-				}
-			}
-		} break;
-		}
-	} break;
-	}
-
-	return true;
-}
-
-bool ImageExt::LoadTiffStrips (File &tiff, Buffer &code)
-{	
-	XBYTE2 twobytes;
-	XBYTE4 fourbytes;
-	int pos, row;	
-	unsigned long pos_offsets, pos_counts;
-	unsigned long count, offset, strip;
-	
-	pos = tiff.GetPosition ();
-	pos_counts = m_strip_counts;
-	pos_offsets = m_strip_offsets;
-	if (m_num_strips==1) {		
-		count = pos_counts;
-		offset = pos_offsets;
-		row = 0;			
-		LoadTiffData (tiff, code, count, offset, row);
-	} else {		
-		row = 0;
-		for (strip=0; strip < m_num_strips; strip++) {
-			tiff.SetPosition (pos_counts);
-			tiff.Read2 (twobytes); count = code.ReadI (twobytes);
-			tiff.SetPosition (pos_offsets);
-			tiff.Read4 (fourbytes); offset = code.ReadL (fourbytes);
-
-			LoadTiffData (tiff, code, count, offset, row);
-			
-			row += m_rps;
-			pos_counts++;
-			pos_offsets++;
-		}
-	}				
-	tiff.SetPosition (pos);
-
-	return true;
-}
-
-bool ImageExt::LoadTiffEntry (File &tiff, Buffer &code)
-{
-	XBYTE2 twobytes;
-	XBYTE4 fourbytes;
-	unsigned int tag, typ;
-	unsigned long int count, offset;	
-		
-	// Read Entry Tag (WIDTH, HEIGHT, EXTRASAMPLES, BITSPERSAMPLE, COMPRESSION, etc.)
-	tiff.Read2(twobytes); tag = code.ReadI(twobytes);
-	// Read Entry Type and Count (SHORT or LONG)
-	tiff.Read2(twobytes); typ = code.ReadI(twobytes);	
-	tiff.Read4(fourbytes); count = code.ReadL(fourbytes);
-	if (typ==TIFF_TYPE_SHORT && count==1) {
-		tiff.Read2(twobytes); offset = code.ReadI(twobytes);
-		tiff.Read2(twobytes);
-	} else {
-		tiff.Read4(fourbytes); offset = code.ReadL(fourbytes);
-	}
-	// DEBUG OUTPUT
-	// printf ("tag:%u type:%u count:%lu offset:%lu\n", tag, typ, count, offset);
-	
-	// Add information to ImageFormat info based on Entry Tag
-	switch (tag) {	
-	case TIFF_TAG_IMAGEWIDTH: m_xres = offset; break;
-	case TIFF_TAG_IMAGEHEIGHT: 	m_yres = offset; break;		
-	case TIFF_TAG_EXTRASAMPLES: m_alpha = TIFF_ALPHA_YES; break;	
-	case TIFF_TAG_BITSPERSAMPLE: {
-		// NOTE: The TIFF specification defines 'samples',
-		// while the Image class defines 'channels'.
-		// Thus, bits-per-sample (in TIFF) is the same as bits-per-channel
-		// And, samples-per-pixel (in TIFF) is the same as channels-per-pixel
-		
-		// Detemine samples-per-pixel here 
-		// (this is just "count" of how many bits-per-sample 
-		//  entries are present)		
-		m_num_chan = count;
-		switch (count) {		
-		case 1: {			// One channel: B&W or GRAYSCALE
-			m_bpc[CHAN_GRAY] = offset;
-			m_bpcoff = 0;
-			if (offset==1)	m_mode = TIFF_MODE_BW;
-			else			m_mode = TIFF_MODE_GRAY;			
-		} break;
-		case 2: {			// Two channels: GRAYSCALE with ALPHA
-			m_bpc[CHAN_GRAY] = offset;
-			m_bpcoff = offset;
-			m_mode = TIFF_MODE_GRAY;
-		} break;		
-		case 3: {			// Three channels: RGB
-			m_bpcoff = offset;
-			m_mode = TIFF_MODE_RGB;
-		} break;
-		case 4: {			// Four channels: RGB with ALPHA
-			m_bpcoff = offset;	
-			m_mode = TIFF_MODE_RGBA;
-		} break;
-		default: {
-			printf ("Load:Tiff: Unknown TIFF mode.\n");
-			return false;
-		} break;
-		}		
-	} break;
-	case TIFF_TAG_COMPRESSION: {
-		m_compress = offset;
-		if (m_compress!=1) {
-#ifdef _DEBUG
-			MessageBox (NULL, "TIF Load Error: LZW Compression not supported.\n\nGameX does not support LZW compressed TIF images. Save your TIF image again and be sure that the LZW compression option is turned off.\n", "GameX Error", MB_OK|MB_ICONSTOP);
-#endif
-			return false;
-		}
-	} break;	
-	case TIFF_TAG_PHOTOMETRIC: {		
-		m_photo = offset;
-		if (m_photo==TIFF_PHOTO_RGBPAL)
-			m_mode = TIFF_MODE_INDEX;
-	} break;
-	case TIFF_TAG_STRIPOFFSETS: m_strip_offsets = offset; break;
-	case TIFF_TAG_ROWSPERSTRIP: {
-		m_rps = offset;
-		m_num_strips = (unsigned long ) ((m_yres+m_rps-1) / m_rps);
-	} break;
-	case TIFF_TAG_STRIPBYTECOUNTS: m_strip_counts = offset; break;
-	}
-
-	return true;
-}
-
-bool ImageExt::LoadTiffDirectory (File &tiff, Buffer &code)
-{
-	XBYTE2 twobytes;
-	XBYTE4 fourbytes;
-	unsigned int num;	
-	unsigned long offset, pos;	
-		
-	// Read Number of TIFF Directory Entries
-	tiff.Read2(twobytes);
-	num = code.ReadI(twobytes);
-
-	// Read TIFF Directory Entries to fill ImageFormat Info
-	for (unsigned int n = 0; n<num; n++)	
-		LoadTiffEntry (tiff, code);
-
-	// Use ImageFormat to allocate and prepare ImageX 
-	switch (m_mode) {						
-	case TIFF_MODE_RGB: case TIFF_MODE_RGBA: {					// RGB TIFF Image
-		pos = tiff.GetPosition();			
-		tiff.SetPosition (m_bpcoff);		// Get bits per channel
-		tiff.Read2 (twobytes); m_bpc[CHAN_RED] = code.ReadI(twobytes);
-		tiff.Read2 (twobytes); m_bpc[CHAN_GREEN] = code.ReadI(twobytes);
-		tiff.Read2 (twobytes); m_bpc[CHAN_BLUE] = code.ReadI(twobytes);
-		if (m_alpha==TIFF_ALPHA_YES) {		// Get bits for alpha channel
-			tiff.Read2 (twobytes); m_bpc[CHAN_ALPHA] = code.ReadI(twobytes);
-		} else {
-			m_bpc[CHAN_ALPHA] = 0;			// No alpha channel.
-		}
-		tiff.SetPosition (pos);
-			
-		m_ops = IMG_TRUECOLOR;				// Determine proper ImageX Pixel-Format options
-		if (m_alpha==TIFF_ALPHA_YES) m_ops |= IMG_ALPHA;
-		
-		m_pImg->Size (m_xres, m_yres, m_ops);	// Resize the ImageX for loading
-		
-											// Calculate bits per pixel
-		m_bpp = m_bpc[CHAN_RED] + m_bpc[CHAN_GREEN] + m_bpc[CHAN_BLUE] + m_bpc[CHAN_ALPHA];		
-											// Calculate bytes per row
-		m_bpr = (m_xres*m_bpp) / 8;
-	} break;
-	}
-
-	// Load actual TIFF Image Data into ImageX	
-	LoadTiffStrips (tiff, code);
-
-	// Check if there are multiple images present in TIFF file
-	tiff.Read4(fourbytes);
-	offset = code.ReadL(fourbytes);	
-	if (offset!=0)
-		printf ("Load:Tiff: (Warning only) File contains multiple tiff images - reading only first.\n");
-
-	return true;
-}
-
 // Function: LoadTiff
 //
 // Input:
-//		m_name				Set to TIFF_FORMAT 
 //		m_filename			Name of TIFF file to load
 // Output:
-//		m_success			Set to TRUE of FALSE
-//		m_mode				Format mode (BW, GRAY, RGB, INDEX)
+//		m_status			TIFF_STATUS_OK, or NOMAGIC if not a TIFF this can load
+//		m_mode				Format mode (BW, GRAY, RGB, RGBA)
 //		m_num_chan			Number of channels present
 //		m_bpc[n]			Bits per channel for channel [n]
-//		m_compress			Compression mode (NONE, PACKBITS, LZW)
-//		m_photo			Photometric interpretation
+//		m_compress			Compression mode (only NONE loads)
+//		m_photo				Photometric interpretation
 //		m_num_strips		Number of strips
 //		m_rps				Rows per strip
+//
+// The file is mapped, the directory and the whole strip table are read
+// first (see gamex-tiff.cpp), then the strips are decoded on the thread
+// pool straight from the mapping into the ImageX.
 
 bool ImageExt::LoadTiff (char *filename, ImageX *img)
 {
-	XBYTE2 twobytes;
-	XBYTE4 fourbytes;
-	unsigned long pnt;
-
-	File tiff;
-	Buffer code;
+	TIFFInfo info;
+	FileMapped tiff;
 
 	m_pImg = img;
 	strcpy (m_filename, filename);
-	if (tiff.Open (m_filename, FILE_READ | FILE_RANDOM) != FILE_EXIST_NO) {
+	if (tiff.Open (m_filename) != FILE_STATUS_OK) return false;
 
-		m_alpha = TIFF_ALPHA_NO;
-		m_xres = 0;
-		m_yres = 0;
-		
-		tiff.Read2 (twobytes);	
-		if (twobytes == (XBYTE2) TIFF_BYTEORDER) {
-			tiff.Read2(twobytes);
-		} else {
-			code.SetOrder (BUFFER_ORDER_MBF);		
-			tiff.Read2(twobytes);
-		}
-		if (code.ReadI(twobytes) == TIFF_MAGIC) {
-			tiff.Read4(fourbytes); 
-			pnt = code.ReadL(fourbytes);
-		
-			tiff.SetPosition (pnt);
-			LoadTiffDirectory (tiff, code);
-		} else {
-			printf ("Load:Tiff: File is corrupted, or is not a .TIFF file.\n");
-			exit (-1);
-			m_status = TIFF_STATUS_NOMAGIC;
-		} 
-		tiff.Close ();
-		m_status = TIFF_STATUS_OK;	
-		return true;
-	} else {
+	if (!TIFFReadHeader (info, tiff)) {
+#ifdef _DEBUG
+		if (info.compression != TIFF_COMPRESS_NONE)
+			MessageBox (NULL, "TIF Load Error: LZW Compression not supported.\n\nGameX does not support LZW compressed TIF images. Save your TIF image again and be sure that the LZW compression option is turned off.\n", "GameX Error", MB_OK|MB_ICONSTOP);
+#endif
+		printf ("Load:Tiff: File is corrupted, or is not a .TIFF file GameX can load.\n");
+		m_status = TIFF_STATUS_NOMAGIC;
 		return false;
-	}	
+	}
+
+	m_xres = info.xres;
+	m_yres = info.yres;
+	m_num_chan = info.channels;
+	m_bpc[CHAN_RED] = m_bpc[CHAN_GREEN] = m_bpc[CHAN_BLUE] = info.bits;
+	m_bpc[CHAN_ALPHA] = info.alpha ? info.bits : 0;
+	m_compress = info.compression;
+	m_photo = info.photometric;
+	m_rps = info.rows_per_strip;
+	m_num_strips = (unsigned long) ((m_yres + m_rps - 1) / m_rps);
+	m_alpha = info.alpha ? TIFF_ALPHA_YES : TIFF_ALPHA_NO;
+	switch (m_num_chan) {
+	case 1: m_mode = (info.bits == 1) ? TIFF_MODE_BW : TIFF_MODE_GRAY; break;
+	case 2: m_mode = TIFF_MODE_GRAY; break;
+	case 3: m_mode = TIFF_MODE_RGB; break;
+	default: m_mode = TIFF_MODE_RGBA; break;
+	}
+
+	m_ops = IMG_TRUECOLOR;					// Determine proper ImageX Pixel-Format options
+	if (m_alpha==TIFF_ALPHA_YES) m_ops |= IMG_ALPHA;
+	m_pImg->Size (m_xres, m_yres, m_ops);	// Resize the ImageX for loading
+
+	if (!TIFFDecode (info, tiff, m_pImg->m_data, info.alpha ? m_pImg->m_alpha : NULL))
+		printf ("Load:Tiff: (Warning only) File is cut short - rest of the image left blank.\n");
+	tiff.Close ();
+
+	m_status = TIFF_STATUS_OK;
+	return true;
 }
 
 bool ImageExt::SaveTiffData (File &tiff, Buffer &code)
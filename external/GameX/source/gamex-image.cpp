@@ -13,6 +13,7 @@
 #include <string.h>
 
 #include "gamex-image.hpp"
+#include "gamex-pixelop.hpp"
 
 ImageX::ImageX (void)
 {
@@ -42,6 +43,8 @@ void ImageX::Reset (void)
 	m_surface = NULL;
 	m_device = NULL;
 	ResetFilterRect();
+	m_view_page = NULL;
+	m_view_x = m_view_y = 0;
 	m_non_empty = false;
 }
 
@@ -101,6 +104,34 @@ void ImageX::CreateWithUse (int xr, int yr, ImageUsage use)
 	m_non_empty = false;
 }
 
+void ImageX::CreateView (ImageX * page, int x, int y, int xr, int yr)
+{
+	Destroy();
+	Reset();
+
+	if(page == NULL || page->status != IMG_OK) return;
+	if(page->m_view_page != NULL) { // a view of a view is a view of its page
+		x += page->m_view_x;
+		y += page->m_view_y;
+		page = page->m_view_page;
+	}
+
+	strcpy(m_filename,"ImageX View");
+	m_view_page = page;
+	m_view_x = x;
+	m_view_y = y;
+	m_xres = xr;
+	m_yres = yr;
+	m_size = xr*yr;
+	m_xmult = 1.0f;
+	m_ymult = 1.0f;
+	m_options = page->m_options;
+	m_usage = page->m_usage;
+	ResetFilterRect();
+	m_non_empty = page->m_non_empty;
+	status = IMG_OK;
+}
+
 void ImageX::Destroy (void)
 {
 	if(m_surface != NULL) {
@@ -727,147 +758,160 @@ void ImageX::SwapColors (ColorSwapType type) // rotates or swaps the image's col
 		case COLOR_SWAP_NANA: ChangeColors(COLOR_SET_A,COLOR_SET_A, -1.0f,-1.0f); return;
 	}
 
-	// otherwise, plain color component swapping:
-	
-	GameX.AccessPixels(this);
-	for(int y = m_fy1 ; y < m_fy2 ; y++) {
-		if(m_ymult != 1.0f && y != m_fy1 && (int)(m_ymult * (float)(y-1)) == (int)(m_ymult * (float)(y))) continue;
-		for(int x = m_fx1 ; x < m_fx2 ; x++) {
-			if(m_xmult != 1.0f && x != m_fx1 && (int)(m_xmult * (float)(x-1)) == (int)(m_xmult * (float)(x))) continue;
-			int r,g,b,a;
-			GameX.ReadPixel(x,y,r,g,b,a);
-			if(r == 0 && g == 0 && b == 0) continue;
-			switch(type) {
-				case COLOR_SWAP_ROTATE120: GameX.DrawPixel(x,y,b,r,g,a); break; // rotate 120 degrees
-				case COLOR_SWAP_ROTATE240: GameX.DrawPixel(x,y,g,b,r,a); break; // rotate 240 degrees
-				case COLOR_SWAP_REDGREEN:  GameX.DrawPixel(x,y,g,r,b,a); break; // swap red and green
-				case COLOR_SWAP_REDBLUE:   GameX.DrawPixel(x,y,b,g,r,a); break; // swap red and blue
-				case COLOR_SWAP_GREENBLUE: GameX.DrawPixel(x,y,r,b,g,a); break; // swap green and blue
-			}
-		}
+	// otherwise, plain color component swapping (black stays black, so
+	// it no longer needs skipping). PixelSwap takes where each of b,g,r
+	// comes from, 0,1,2 = b,g,r
+	int from[3];
+	switch(type) {
+		case COLOR_SWAP_ROTATE120: from[0] = 1; from[1] = 2; from[2] = 0; break; // rotate 120 degrees
+		case COLOR_SWAP_ROTATE240: from[0] = 2; from[1] = 0; from[2] = 1; break; // rotate 240 degrees
+		case COLOR_SWAP_REDGREEN:  from[0] = 0; from[1] = 2; from[2] = 1; break; // swap red and green
+		case COLOR_SWAP_REDBLUE:   from[0] = 2; from[1] = 1; from[2] = 0; break; // swap red and blue
+		case COLOR_SWAP_GREENBLUE: from[0] = 1; from[1] = 0; from[2] = 2; break; // swap green and blue
+		default: ResetFilterRect(); return;
 	}
-	GameX.EndPixelAccess();
-	ResetFilterRect();
+	PixelSwap op(from[0],from[1],from[2]);
+	ApplyPixelOp(op);
 }
 
-
-void ImageX::ChangeColors(ColorSetType a_settype, ColorSetType b_settype, float a_set_mult, float b_set_mult, float a_app_alpha, float b_app_alpha, ColorSetCondition a_acond, ColorSetCondition a_bcond, ColorSetCondition b_acond, ColorSetCondition b_bcond) {
- 	int types [2], conditions [4];
+// ChangeColors' LAB remapping. LAB has no vector version, but running
+// it as a PixelOp still gets it the row access and the threads
+class ImageChangeColorsOp : public PixelOp {
+public:
+	ImageX * img;
+	int types [2], conditions [4];
 	float mult [2], alpha [2];
-	types[0] = a_settype;
-	types[1] = b_settype;
-	mult[0] = a_set_mult;
-	mult[1] = b_set_mult;
-	alpha[0] = a_app_alpha;
-	alpha[1] = b_app_alpha;
-	conditions[0] = a_acond;
-	conditions[1] = a_bcond;
-	conditions[2] = b_acond;
-	conditions[3] = b_bcond;
-	GameX.AccessPixels(this);
-	for(int y = m_fy1 ; y < m_fy2 ; y++) {
-		if(m_ymult != 1.0f && y != m_fy1 && (int)(m_ymult * (float)(y-1)) == (int)(m_ymult * (float)(y))) continue;
-		for(int x = m_fx1 ; x < m_fx2 ; x++) {
-			if(m_xmult != 1.0f && x != m_fx1 && (int)(m_xmult * (float)(x-1)) == (int)(m_xmult * (float)(x))) continue;
-			int r,g,b,a;
-			GameX.ReadPixel(x,y,r,g,b,a);
-			if(r == 0 && g == 0 && b == 0) continue;
-			int L, c[2], o[2], match [2]; // c for color, o for original
-			ConvertRGBToLab(r,g,b,L,o[0],o[1]);
-			c[0] = o[0];
-			c[1] = o[1];
-			match[0] = 0;
-			match[1] = 0;
-			for(int s = 0 ; s < 2 ; s++) { // setting match
-				for(int t = 0 ; t < 2 ; t++) { // being tested
-					switch(conditions[s + t+t]) {
-						case COLOR_COND_NEGATIVE: if(o[s] < 0) match[t]++; break; // < 0
-						case COLOR_COND_POSITIVE: if(o[s] > 0) match[t]++; break; // > 0
-						case COLOR_COND_ANYTHING: match[t]++; break; // anything
-						case COLOR_COND_NEUTRAL:  if(o[s] > -50 && o[s] < 50) match[t]++; break; // -50 to 50
-						case COLOR_COND_GREATER: if(o[s] > o[1-s]) match[t]++; break; // > other
-						case COLOR_COND_LESS: if(o[s] < o[1-s]) match[t]++; break; // < other
-						case COLOR_COND_NEAR: if(o[s] > o[1-s]-50 && o[s] < o[1-s]+50) match[t]++; break; // other-50 to other+50
-					}
+
+	void Row (XBYTE4 *row, int y, int count) { RowRef(row,y,count); }
+	void RowRef (XBYTE4 *row, int y, int count) { for(int x = 0 ; x < count ; x++) row[x] = Pixel(row[x]); }
+
+	XBYTE4 Pixel (XBYTE4 p)
+	{
+		int r = (p >> 16) & 0xFF, g = (p >> 8) & 0xFF, b = p & 0xFF;
+		if(r == 0 && g == 0 && b == 0) return p;
+		int L, c[2], o[2], match [2]; // c for color, o for original
+		img->ConvertRGBToLab(r,g,b,L,o[0],o[1]);
+		c[0] = o[0];
+		c[1] = o[1];
+		match[0] = 0;
+		match[1] = 0;
+		for(int s = 0 ; s < 2 ; s++) { // setting match
+			for(int t = 0 ; t < 2 ; t++) { // being tested
+				switch(conditions[s + t+t]) {
+					case COLOR_COND_NEGATIVE: if(o[s] < 0) match[t]++; break; // < 0
+					case COLOR_COND_POSITIVE: if(o[s] > 0) match[t]++; break; // > 0
+					case COLOR_COND_ANYTHING: match[t]++; break; // anything
+					case COLOR_COND_NEUTRAL:  if(o[s] > -50 && o[s] < 50) match[t]++; break; // -50 to 50
+					case COLOR_COND_GREATER: if(o[s] > o[1-s]) match[t]++; break; // > other
+					case COLOR_COND_LESS: if(o[s] < o[1-s]) match[t]++; break; // < other
+					case COLOR_COND_NEAR: if(o[s] > o[1-s]-50 && o[s] < o[1-s]+50) match[t]++; break; // other-50 to other+50
 				}
 			}
-			if(match[0] < 2 && match[1] < 2) continue;
-			for(int t = 0 ; t < 2 ; t++) {
-				if(match[t] < 2) continue;
-				switch(types[t]) {
-					case COLOR_SET_CONSTANT: c[t] = 50; break;
-					case COLOR_SET_A: c[t] = o[0]; break;
-					case COLOR_SET_B: c[t] = o[1]; break;
-					case COLOR_SET_ABS_A: c[t] = abs(o[0]); break;
-					case COLOR_SET_ABS_B: c[t] = abs(o[1]); break;
-					case COLOR_SET_MAX: c[t] = max(o[0],o[1]); break;
-					case COLOR_SET_MIN: c[t] = min(o[0],o[1]); break;
-					case COLOR_SET_A_PLUS_B: c[t] = o[0]+o[1]; break;
-					case COLOR_SET_A_MINUS_B: c[t] = o[0]-o[1]; break;
-					case COLOR_SET_ABS_A_PLUS_ABS_B: c[t] = abs(o[0])+abs(o[1]); break;
-					case COLOR_SET_ABS_A_MINUS_ABS_B: c[t] = abs(o[0])-abs(o[1]); break;
-					case COLOR_SET_L: c[t] = (int)((float)(L*L*L)/(100.0f*100.0f)); break;
-					case COLOR_SET_L_SMOOTH: c[t] = (int)(((float)(L*L*L)/(100.0f*100.0f)-50)*2); break;
-					case COLOR_SET_SIN_A: c[t] = (int)(sinf((float)o[0]*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
-					case COLOR_SET_SIN_B: c[t] = (int)(sinf((float)o[1]*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
-					case COLOR_SET_COS_A: c[t] = (int)(cosf((float)o[0]*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
-					case COLOR_SET_COS_B: c[t] = (int)(cosf((float)o[1]*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
-					case COLOR_SET_SIN_L: c[t] = (int)(sinf((float)(L*L*L)/(100.0f*100.0f)*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
-					case COLOR_SET_COS_L: c[t] = (int)(cosf((float)(L*L*L)/(100.0f*100.0f)*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
-				}
-				if(mult[t] != 1.0f) {
-					if(mult[t] == 0.0f)
-						c[t] = 0;
-					else if(mult[t] == -1.0f)
-						c[t] = -c[t];
-					else
-						c[t] = (int)((float)c[t] * mult[t]);
-				}
-				if(alpha[t] != 1.0f) {
-					if(alpha[t] == 0.0f)
-						c[t] = o[t];
-					else
-						c[t] = (int)((float)c[t]*alpha[t] + (float)o[t]*(1.0f-alpha[t]));
-				}
+		}
+		if(match[0] < 2 && match[1] < 2) return p;
+		for(int t = 0 ; t < 2 ; t++) {
+			if(match[t] < 2) continue;
+			switch(types[t]) {
+				case COLOR_SET_CONSTANT: c[t] = 50; break;
+				case COLOR_SET_A: c[t] = o[0]; break;
+				case COLOR_SET_B: c[t] = o[1]; break;
+				case COLOR_SET_ABS_A: c[t] = abs(o[0]); break;
+				case COLOR_SET_ABS_B: c[t] = abs(o[1]); break;
+				case COLOR_SET_MAX: c[t] = max(o[0],o[1]); break;
+				case COLOR_SET_MIN: c[t] = min(o[0],o[1]); break;
+				case COLOR_SET_A_PLUS_B: c[t] = o[0]+o[1]; break;
+				case COLOR_SET_A_MINUS_B: c[t] = o[0]-o[1]; break;
+				case COLOR_SET_ABS_A_PLUS_ABS_B: c[t] = abs(o[0])+abs(o[1]); break;
+				case COLOR_SET_ABS_A_MINUS_ABS_B: c[t] = abs(o[0])-abs(o[1]); break;
+				case COLOR_SET_L: c[t] = (int)((float)(L*L*L)/(100.0f*100.0f)); break;
+				case COLOR_SET_L_SMOOTH: c[t] = (int)(((float)(L*L*L)/(100.0f*100.0f)-50)*2); break;
+				case COLOR_SET_SIN_A: c[t] = (int)(sinf((float)o[0]*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
+				case COLOR_SET_SIN_B: c[t] = (int)(sinf((float)o[1]*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
+				case COLOR_SET_COS_A: c[t] = (int)(cosf((float)o[0]*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
+				case COLOR_SET_COS_B: c[t] = (int)(cosf((float)o[1]*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
+				case COLOR_SET_SIN_L: c[t] = (int)(sinf((float)(L*L*L)/(100.0f*100.0f)*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
+				case COLOR_SET_COS_L: c[t] = (int)(cosf((float)(L*L*L)/(100.0f*100.0f)*((360.0f/100.0f)*DEGtoRAD))*100.0f); break;
+			}
+			if(mult[t] != 1.0f) {
+				if(mult[t] == 0.0f)
+					c[t] = 0;
+				else if(mult[t] == -1.0f)
+					c[t] = -c[t];
+				else
+					c[t] = (int)((float)c[t] * mult[t]);
+			}
+			if(alpha[t] != 1.0f) {
+				if(alpha[t] == 0.0f)
+					c[t] = o[t];
+				else
+					c[t] = (int)((float)c[t]*alpha[t] + (float)o[t]*(1.0f-alpha[t]));
 			}
-			ConvertLabToRGB(L,c[0],c[1],r,g,b);
-			GameX.DrawPixel(x,y,r,g,b,a);
 		}
+		img->ConvertLabToRGB(L,c[0],c[1],r,g,b);
+		return (p & 0xFF000000) | (r << 16) | (g << 8) | b;
 	}
-	GameX.EndPixelAccess();
-	ResetFilterRect();
-}
+};
 
-void ImageX::Invert (bool preserve_color) // inverts the image
-{
-	int rmin = GameX.win_maskminr;
-	int gmin = GameX.win_maskming;
-	int bmin = GameX.win_maskminb;
-	GameX.AccessPixels(this);
-	int maxl = 1000;
-	for(int y = m_fy1 ; y < m_fy2 ; y++)
-		for(int x = m_fx1 ; x < m_fx2 ; x++) {
-			int r,g,b,a;
-			GameX.ReadPixel(x,y,r,g,b,a);
+void ImageX::ChangeColors(ColorSetType a_settype, ColorSetType b_settype, float a_set_mult, float b_set_mult, float a_app_alpha, float b_app_alpha, ColorSetCondition a_acond, ColorSetCondition a_bcond, ColorSetCondition b_acond, ColorSetCondition b_bcond) {
+	ImageChangeColorsOp op;
+	op.img = this;
+	op.types[0] = a_settype;
+	op.types[1] = b_settype;
+	op.mult[0] = a_set_mult;
+	op.mult[1] = b_set_mult;
+	op.alpha[0] = a_app_alpha;
+	op.alpha[1] = b_app_alpha;
+	op.conditions[0] = a_acond;
+	op.conditions[1] = a_bcond;
+	op.conditions[2] = b_acond;
+	op.conditions[3] = b_bcond;
+	ApplyPixelOp(op);
+}
 
-			if(m_usage & LOAD_MASKED && r<rmin && g<gmin && b<bmin)
+// Invert's color preserving flavor, which flips L in LAB
+class ImageLabInvertOp : public PixelOp {
+public:
+	ImageX * img;
+	int rmin, gmin, bmin;
+
+	void Row (XBYTE4 *row, int y, int count) { RowRef(row,y,count); }
+	void RowRef (XBYTE4 *row, int y, int count)
+	{
+		for(int x = 0 ; x < count ; x++) {
+			int r = (row[x] >> 16) & 0xFF, g = (row[x] >> 8) & 0xFF, b = row[x] & 0xFF;
+			if(r<rmin && g<gmin && b<bmin)
 				continue;
-
-			if(m_usage & LOAD_MASKED && r>255-rmin && g>255-gmin && b>255-bmin) {
+			if(r>255-rmin && g>255-gmin && b>255-bmin) {
 				r = 255-rmin;
 				g = 255-gmin;
 				b = 255-bmin;
 			}
-			if(preserve_color) {
-				int L,A,B;
-				ConvertRGBToLab(r,g,b,L,A,B);
-				ConvertLabToRGB(150-L,A,B,r,g,b);
-				GameX.DrawPixel(x,y,r,g,b,a);
-			} else
-				GameX.DrawPixel(x,y,255-r,255-g,255-b,a);
+			int L,A,B;
+			img->ConvertRGBToLab(r,g,b,L,A,B);
+			img->ConvertLabToRGB(150-L,A,B,r,g,b);
+			row[x] = (row[x] & 0xFF000000) | (r << 16) | (g << 8) | b;
 		}
-	GameX.EndPixelAccess();
-	ResetFilterRect();
+	}
+};
+
+void ImageX::Invert (bool preserve_color) // inverts the image
+{
+	int rmin = (m_usage & LOAD_MASKED) ? GameX.win_maskminr : 0;
+	int gmin = (m_usage & LOAD_MASKED) ? GameX.win_maskming : 0;
+	int bmin = (m_usage & LOAD_MASKED) ? GameX.win_maskminb : 0;
+	if(preserve_color) {
+		ImageLabInvertOp op;
+		op.img = this;
+		op.rmin = rmin;
+		op.gmin = gmin;
+		op.bmin = bmin;
+		ApplyPixelOp(op);
+	} else {
+		// a color that would invert into the mask is pinned at the mask's edge
+		PixelInvert op;
+		op.SetMask(rmin,gmin,bmin,0xFF000000,(rmin << 16) | (gmin << 8) | bmin);
+		ApplyPixelOp(op);
+	}
 }
 
 void ImageX::ChangeBrightness (int brightness, float contrast)
@@ -881,46 +925,12 @@ void ImageX::ChangeBrightnesses (int brightness_r, int brightness_g, int brightn
 	int offset_g = brightness_g + (contrast_g ? (int)(255.0f*(1.0f - contrast_g)/2.0f) : 0);
 	int offset_b = brightness_b + (contrast_b ? (int)(255.0f*(1.0f - contrast_b)/2.0f) : 0);
 	int offset_a = brightness_a + (contrast_a ? (int)(255.0f*(1.0f - contrast_a)/2.0f) : 0);
-	int rmin = GameX.win_maskminr;
-	int gmin = GameX.win_maskming;
-	int bmin = GameX.win_maskminb;
-	GameX.AccessPixels(this);
-	for(int y = m_fy1 ; y < m_fy2 ; y++) {
-		if(m_ymult != 1.0f && y != m_fy1 && (int)(m_ymult * (float)(y-1)) == (int)(m_ymult * (float)(y))) continue;
-		for(int x = m_fx1 ; x < m_fx2 ; x++) {
-			if(m_xmult != 1.0f && x != m_fx1 && (int)(m_xmult * (float)(x-1)) == (int)(m_xmult * (float)(x))) continue;
-			int r,g,b,a;
-			GameX.ReadPixel(x,y,r,g,b,a);
-
-			if(m_usage & LOAD_MASKED && r<rmin && g<gmin && b<bmin)
-				continue;
-
-			if(contrast_r != 1.0f) r = (int)((float)r * contrast_r);
-			if(contrast_g != 1.0f) g = (int)((float)g * contrast_g);
-			if(contrast_b != 1.0f) b = (int)((float)b * contrast_b);
-			if(contrast_a != 1.0f) a = (int)((float)a * contrast_a);
-			r += offset_r;
-			g += offset_g;
-			b += offset_b;
-			a += offset_a;
-
-			if(r > 255) r = 255;
-			if(g > 255) g = 255;
-			if(b > 255) b = 255;
-			if(a > 255) a = 255;
-			if(r < 0) r = 0;
-			if(g < 0) g = 0;
-			if(b < 0) b = 0;
-			if(a < 0) a = 0;
-
-			if(m_usage & LOAD_MASKED && r<rmin && g<gmin && b<bmin)
-				b = bmin;
-
-			GameX.DrawPixel(x,y,r,g,b,a);
-		}
-	}
-	GameX.EndPixelAccess();
-	ResetFilterRect();
+	float contrast[4] = {contrast_b, contrast_g, contrast_r, contrast_a}; // in pixel byte order
+	int offset[4] = {offset_b, offset_g, offset_r, offset_a};
+	PixelLevels op(contrast,offset);
+	if(m_usage & LOAD_MASKED) // what would turn transparent gets a little blue
+		op.SetMask(GameX.win_maskminr,GameX.win_maskming,GameX.win_maskminb,0xFFFFFF00,GameX.win_maskminb);
+	ApplyPixelOp(op);
 }
 
 void ImageX::ChangeSaturation (float sat)
@@ -930,52 +940,14 @@ void ImageX::ChangeSaturation (float sat)
 
 void ImageX::ChangeSaturations (float sat_r, float sat_g, float sat_b) // reduces or enhances color while keeping brightness the same
 {
-	int rmin = GameX.win_maskminr;
-	int gmin = GameX.win_maskming;
-	int bmin = GameX.win_maskminb;
-	GameX.AccessPixels(this);
-	for(int y = m_fy1 ; y < m_fy2 ; y++) {
-		if(m_ymult != 1.0f && y != m_fy1 && (int)(m_ymult * (float)(y-1)) == (int)(m_ymult * (float)(y))) continue;
-		for(int x = m_fx1 ; x < m_fx2 ; x++) {
-			if(m_xmult != 1.0f && x != m_fx1 && (int)(m_xmult * (float)(x-1)) == (int)(m_xmult * (float)(x))) continue;
-			int r,g,b,a;
-			GameX.ReadPixel(x,y,r,g,b,a);
-
-			if(m_usage & LOAD_MASKED && r<rmin && g<gmin && b<bmin)
-				continue;
-			
-			float red, green, blue;
-			red = (float)r/255.0f;
-			green = (float)g/255.0f;
-			blue = (float)b/255.0f;
-			float gray = red*RED_LUMINANCE + green*GREEN_LUMINANCE + blue*BLUE_LUMINANCE;
-			
-			red = (red*sat_r + gray*(1.0f-sat_r));
-			green = (green*sat_g + gray*(1.0f-sat_g));
-			blue = (blue*sat_b + gray*(1.0f-sat_b));
-			
-			r = (int)(red*255.0f);
-			g = (int)(green*255.0f);
-			b = (int)(blue*255.0f);
-
-			if(r > 255) r = 255;
-			if(g > 255) g = 255;
-			if(b > 255) b = 255;
-			if(r < 0) r = 0;
-			if(g < 0) g = 0;
-			if(b < 0) b = 0;
-
-			if(m_usage & LOAD_MASKED && r<rmin && g<gmin && b<bmin) {
-				r = rmin;
-				g = gmin;
-				b = bmin;
-			}
-
-			GameX.DrawPixel(x,y,r,g,b,a);
-		}
+	PixelSaturate op(sat_r,sat_g,sat_b,RED_LUMINANCE,GREEN_LUMINANCE,BLUE_LUMINANCE);
+	if(m_usage & LOAD_MASKED) { // what would turn transparent is pinned at the mask's edge
+		int rmin = GameX.win_maskminr;
+		int gmin = GameX.win_maskming;
+		int bmin = GameX.win_maskminb;
+		op.SetMask(rmin,gmin,bmin,0xFF000000,(rmin << 16) | (gmin << 8) | bmin);
 	}
-	GameX.EndPixelAccess();
-	ResetFilterRect();
+	ApplyPixelOp(op);
 }
 
 void ImageX::ConvertToGrayscale (void)
@@ -1026,159 +998,108 @@ void ImageX::AddNoise (int noise)
 
 void ImageX::AddNoise (int noise_r, int noise_g, int noise_b, int noise_a) // adds random noise to the image
 {
-	int rmin = GameX.win_maskminr;
-	int gmin = GameX.win_maskming;
-	int bmin = GameX.win_maskminb;
+	int noise[4] = {noise_b, noise_g, noise_r, noise_a}; // in pixel byte order
+	XBYTE4 seed = (GameX.GetRandomInt(0,0x7FFF) << 16) ^ GameX.GetRandomInt(0,0x7FFF);
+	PixelNoise op(noise,seed);
+	if(m_usage & LOAD_MASKED) // what would turn transparent gets a little blue
+		op.SetMask(GameX.win_maskminr,GameX.win_maskming,GameX.win_maskminb,0xFFFFFF00,GameX.win_maskminb);
+	ApplyPixelOp(op);
+}
 
-	GameX.AccessPixels(this);
-	for(int y = m_fy1 ; y < m_fy2 ; y++) {
-		if(m_ymult != 1.0f && y != m_fy1 && (int)(m_ymult * (float)(y-1)) == (int)(m_ymult * (float)(y))) continue;
-		for(int x = m_fx1 ; x < m_fx2 ; x++) {
-			if(m_xmult != 1.0f && x != m_fx1 && (int)(m_xmult * (float)(x-1)) == (int)(m_xmult * (float)(x))) continue;
-			int r,g,b,a;
-			GameX.ReadPixel(x,y,r,g,b,a);
+void ImageX::GaussianBlur (float radius)
+{
+	GaussianBlur(radius,radius,radius,radius);
+}
 
-			if(m_usage & LOAD_MASKED && r<rmin && g<gmin && b<bmin)
-				continue;
+void ImageX::GaussianBlur (float red_radius, float green_radius, float blue_radius, float alpha_radius)
+{
+	// the kernel reaches out twice the radius, which is 3 sigma
+	float sigma[4] = {blue_radius*2.0f/3.0f, green_radius*2.0f/3.0f, red_radius*2.0f/3.0f, alpha_radius*2.0f/3.0f}; // in pixel byte order
+	float most = max(sigma[0],max(sigma[1],max(sigma[2],sigma[3])));
+	Blur(sigma, most > IMAGEX_BOXBLUR_SIGMA);
+}
 
-			if(noise_r < 0) r += GameX.GetRandomInt(noise_r,0);
-			else if(noise_r > 0) r += GameX.GetRandomInt(-noise_r,noise_r);
-			if(noise_g < 0) g += GameX.GetRandomInt(noise_g,0);
-			else if(noise_r > 0) g += GameX.GetRandomInt(-noise_g,noise_g);
-			if(noise_b < 0) b += GameX.GetRandomInt(noise_b,0);
-			else if(noise_r > 0) b += GameX.GetRandomInt(-noise_b,noise_b);
-			if(noise_a < 0) a += GameX.GetRandomInt(noise_a,0);
-			else if(noise_a > 0) a += GameX.GetRandomInt(-noise_a,noise_a);
-
-			if(r > 255) r = 255;
-			if(g > 255) g = 255;
-			if(b > 255) b = 255;
-			if(a > 255) a = 255;
-			if(r < 0) r = 0;
-			if(g < 0) g = 0;
-			if(b < 0) b = 0;
-			if(a < 0) a = 0;
-
-			if(m_usage & LOAD_MASKED && r<rmin && g<gmin && b<bmin)
-				b = bmin;
-
-			GameX.DrawPixel(x,y,r,g,b,a);
-		}
+void ImageX::BoxBlur (float radius)
+{
+	float sigma[4] = {radius*2.0f/3.0f, radius*2.0f/3.0f, radius*2.0f/3.0f, radius*2.0f/3.0f};
+	Blur(sigma, true);
+}
+
+void ImageX::Blur (float sigma[4], bool box)
+{
+	int pitch;
+	XBYTE4 * copy;
+	XBYTE4 * pixels = BeginPixels32(pitch,copy);
+	if(pixels != NULL) {
+		if(box)
+			BlendBoxBlur32(pixels, m_fx2-m_fx1, m_fy2-m_fy1, pitch, sigma);
+		else
+			BlendGaussianBlur32(pixels, m_fx2-m_fx1, m_fy2-m_fy1, pitch, sigma);
+		EndPixels32(copy);
 	}
-	GameX.EndPixelAccess();
 	ResetFilterRect();
 }
 
-void ImageX::GaussianBlur (float radius)
+void ImageX::ApplyPixelOp (PixelOp &op)
 {
-	GaussianBlur(radius,radius,radius,radius);
+	int pitch;
+	XBYTE4 * copy;
+	XBYTE4 * pixels = BeginPixels32(pitch,copy);
+	if(pixels != NULL) {
+		PixelOpRun(op, pixels, m_fx2-m_fx1, m_fy2-m_fy1, pitch);
+		EndPixels32(copy);
+	}
+	ResetFilterRect();
 }
 
-void ImageX::GaussianBlur (float red_radius, float green_radius, float blue_radius, float alpha_radius)
+XBYTE4 * ImageX::BeginPixels32 (int &pitch, XBYTE4 * &copy, bool read)
 {
 	int xWidth = m_fx2-m_fx1;
-	int size = (xWidth)*(m_fy2-m_fy1)*4;
-	XBYTE * data = new XBYTE[size];
+	int yHeight = m_fy2-m_fy1;
+	copy = NULL;
+	if(status != IMG_OK || m_view_page != NULL || xWidth <= 0 || yHeight <= 0)
+		return NULL;
 
 	GameX.AccessPixels(this);
-	for(int y1 = m_fy1 ; y1 < m_fy2 ; y1++) {
-		if(m_ymult != 1.0f && y1 != m_fy1 && (int)(m_ymult * (float)(y1-1)) == (int)(m_ymult * (float)(y1))) continue;
-		for(int x1 = m_fx1 ; x1 < m_fx2 ; x1++) {
-			if(m_xmult != 1.0f && x1 != m_fx1 && (int)(m_xmult * (float)(x1-1)) == (int)(m_xmult * (float)(x1))) continue;
-			int c[4];
-			GameX.ReadPixel(x1,y1,c[0],c[1],c[2],c[3]);
-			for(int i = 0 ; i < 4 ; i++)
-				data[i+4*(x1-m_fx1+(xWidth)*(y1-m_fy1))] = (XBYTE)c[i];
-		}
-	}
-	
-	float rMaxDistSq = red_radius*red_radius*4.0f;
-	float gMaxDistSq = green_radius*green_radius*4.0f;
-	float bMaxDistSq = blue_radius*blue_radius*4.0f;
-	float aMaxDistSq = alpha_radius*alpha_radius*4.0f;
-	float maxDistSq = max(rMaxDistSq,max(gMaxDistSq,max(bMaxDistSq,aMaxDistSq)));
-	int radInt = (int)ceil(sqrtf(maxDistSq));
-
-	float est = (float)(radInt)*(float)(radInt)*(float)size;
-
-	if(est > 32000000.0f) { // cap the blurring time at estimated 32x10^6 loops
-		est = 32000000.0f/est;
-		rMaxDistSq *= est;
-		gMaxDistSq *= est;
-		bMaxDistSq *= est;
-		aMaxDistSq *= est;
-		maxDistSq = max(rMaxDistSq,max(gMaxDistSq,max(bMaxDistSq,aMaxDistSq)));
-		radInt = (int)ceil(sqrtf(maxDistSq));
-	}
 
-	int rmin = GameX.win_maskminr;
-	int gmin = GameX.win_maskming;
-	int bmin = GameX.win_maskminb;
+	if(m_surface != NULL && m_surf_bpp == 32 && m_xmult == 1.0f && m_ymult == 1.0f) {
+		// a 32-bit surface already holds ARGB pixels, so work on them where they are
+		pitch = GameX.win_pixel_dest_pitch;
+		return (XBYTE4 *) GameX.win_pixel_dest_data + GameX.win_pixel_dest_ytable[m_fy1] + m_fx1;
+	}
 
+	// anything else is worked on in a 32-bit copy. A stretched surface
+	// gives the copy the same pixel more than once, but every copy of it
+	// comes out the same, so writing them all back is harmless
+	copy = new XBYTE4[xWidth*yHeight];
+	pitch = xWidth;
+	if(!read) {
+		memset(copy, 0, xWidth*yHeight*4);
+		return copy;
+	}
 	for(int y = m_fy1 ; y < m_fy2 ; y++) {
-		if(m_ymult != 1.0f && y != m_fy1 && (int)(m_ymult * (float)(y-1)) == (int)(m_ymult * (float)(y))) continue;
 		for(int x = m_fx1 ; x < m_fx2 ; x++) {
-			if(m_xmult != 1.0f && x != m_fx1 && (int)(m_xmult * (float)(x-1)) == (int)(m_xmult * (float)(x))) continue;
-			int offset = 4*((x-m_fx1)+(xWidth)*(y-m_fy1));
-			float rSum=0, gSum=0, bSum=0, aSum=0; // sum of color values read times current amount
-			float rTot=0, gTot=0, bTot=0, aTot=0; // sum of current amounts
-			for(int y2 = y-radInt ; y2 <= y+radInt ; y2++) {
-				for(int x2 = x-radInt ; x2 <= x+radInt ; x2++) {
-					if(x2<m_fx1||y2<m_fy1||x2>=m_fx2||y2>=m_fy2)
-						continue;
-					float xdiff = (float)(x2-x);
-					float ydiff = (float)(y2-y);
-					float distSq = xdiff*xdiff+ydiff*ydiff;
-					if(distSq > maxDistSq+0.001f)
-						continue;
-					if(distSq < 0.005f)
-						distSq = 1.0f;
-					int r,g,b,a;
-					GameX.ReadPixel(x2,y2,r,g,b,a);
-					if(a < gmin || (m_usage&LOAD_MASKED && (r<rmin && g<gmin && b<bmin))) {
-						r = (int)data[0+offset];
-						g = (int)data[1+offset];
-						b = (int)data[2+offset];
-					}
-					if(distSq < rMaxDistSq+0.001f) {
-						float r_amount = (float)red_radius / distSq;
-						rTot += r_amount;
-						if(r>=rmin) rSum += (float)r * r_amount;
-					}
-					if(distSq < gMaxDistSq+0.001f) {
-						float g_amount = (float)green_radius / distSq;
-						gTot += g_amount;
-						if(g>=gmin) gSum += (float)g * g_amount;
-					}
-					if(distSq < bMaxDistSq+0.001f) {
-						float b_amount = (float)blue_radius / distSq;
-						bTot += b_amount;
-						if(b>=bmin) bSum += (float)b * b_amount;
-					}
-					if(distSq < aMaxDistSq+0.001f) {
-						float a_amount = (float)alpha_radius / distSq;
-						aTot += a_amount;
-						if(a>=gmin) aSum += (float)a * a_amount;
-					}
-				}
-			}
-			if(rTot) data[0+offset] = (XBYTE)(rSum/rTot);
-			if(gTot) data[1+offset] = (XBYTE)(gSum/gTot);
-			if(bTot) data[2+offset] = (XBYTE)(bSum/bTot);
-			if(aTot) data[3+offset] = (XBYTE)(aSum/aTot);
+			int r,g,b,a;
+			GameX.ReadPixel(x,y,r,g,b,a);
+			copy[(x-m_fx1)+xWidth*(y-m_fy1)] = (a << 24) | (r << 16) | (g << 8) | b;
 		}
 	}
-	for(int y3 = m_fy1 ; y3 < m_fy2 ; y3++) {
-		for(int x3 = m_fx1 ; x3 < m_fx2 ; x3++) {
-			int offset = 4*(x3-m_fx1+xWidth*(y3-m_fy1));
-			GameX.DrawPixel(x3,y3,(int)data[0+offset],(int)data[1+offset],(int)data[2+offset],(int)data[3+offset]);
+	return copy;
+}
+
+void ImageX::EndPixels32 (XBYTE4 * copy)
+{
+	if(copy != NULL) {
+		int xWidth = m_fx2-m_fx1;
+		for(int y = m_fy1 ; y < m_fy2 ; y++) {
+			for(int x = m_fx1 ; x < m_fx2 ; x++) {
+				XBYTE4 v = copy[(x-m_fx1)+xWidth*(y-m_fy1)];
+				GameX.DrawPixel(x,y,(v >> 16) & 0xFF,(v >> 8) & 0xFF,v & 0xFF,v >> 24);
+			}
 		}
+		delete [] copy;
 	}
 	GameX.EndPixelAccess();
-
-	delete [] data; data = NULL;
-
-	ResetFilterRect();
 }
 
 void ImageX::CopyTo (ImageX * dest)
@@ -1408,6 +1329,15 @@ void ImageX::UseWith (ImageUsage use)
 	ResetFilterRect();
 }
 
+// A band of ConvertMaskToAlpha's rows
+class ImageMaskToAlphaRows : public PixelRows {
+public:
+	XBYTE *alpha;
+	XBYTE2 *pixels;
+	int xres;
+	void Rows (int y1, int y2)	{ BlendMaskToAlpha16 (alpha + y1*xres, pixels + y1*xres, (y2-y1)*xres); }
+};
+
 void ImageX::ConvertMaskToAlpha (void)
 {
 	// main reason for doing this:
@@ -1417,16 +1347,11 @@ void ImageX::ConvertMaskToAlpha (void)
 	if (GetAlpha(m_options)!=IMG_ALPHA) {
 		if (m_alpha!=NULL) {delete [] m_alpha; m_alpha = NULL;}
 		m_alpha = new XBYTE[m_xres * m_yres];
-		XBYTE *pAlphaData;
-		XBYTE2 *pData;
-		pData = (XBYTE2*) m_data;
-		pAlphaData = m_alpha;
-		for (int n=0; n<m_size; n++) {
-			if(*pData == 0) *pAlphaData = 0;
-			else			*pAlphaData = 255;
-			*pAlphaData++;
-			*pData++;
-		}
+		ImageMaskToAlphaRows rows;
+		rows.alpha = m_alpha;
+		rows.pixels = (XBYTE2*) m_data;
+		rows.xres = m_xres;
+		PixelRowsRun(rows, m_xres, m_yres);
 		m_options |= IMG_ALPHA;
 	}
 }
@@ -1461,194 +1386,88 @@ void ImageX::GetPixel (int x, int y, int &r, int &g, int &b, int &a)
 	GameX.EndPixelAccess();
 }
 
+static int ImageFormatBits (int format)
+{
+	switch (format) {
+		case IMG_INDEXED:		return 8;
+		case IMG_HIGHCOLOR:		return 16;
+		case IMG_TRUECOLOR:		return 24;
+		case IMG_TRUECOLORX:	return 32;
+	}
+	return 0;
+}
+
+// A band of ConvertFormat's rows
+class ImageConvertRows : public PixelRows {
+public:
+	BlendConverter *conv;
+	XBYTE *src, *dst;
+	int xres, src_bytes, dst_bytes;
+	void Rows (int y1, int y2)	{ conv->Row (dst + y1*xres*dst_bytes, src + y1*xres*src_bytes, (y2-y1)*xres); }
+};
+
 void ImageX::ConvertFormat (ImageOps ops)
 {	
-	XBYTE * newdata;
-	
-	switch (GetFormat(m_options)) {			// Source Format:
-		case IMG_INDEXED:					//   Indexed Color (8 bit)
-			switch (GetFormat(ops))	{	// Target Format:
-				case IMG_HIGHCOLOR:	//   High Color (16 bit)
-					GameX.ErrorDialog("Unsupported color conversion operation (8 to 16 bit).") ;
-					break;
-				case IMG_TRUECOLOR:	//   True Color (24 bit)
-					GameX.ErrorDialog("Unsupported color conversion operation (8 to 24 bit).") ;
-					break;
-				case IMG_TRUECOLORX:	//   True Color with X channel (32 bit)
-					GameX.ErrorDialog("Unsupported color conversion operation (8 to 32 bit).") ;
-					break;
-			}
-			break;
-		case IMG_HIGHCOLOR:					//   High Color (16 bit)
-			switch (GetFormat(ops))	{	// Target Format:
-				case IMG_INDEXED:	//   High Color (8 bit)
-					MessageBox(GameX.GetWindow(), "Error: Unsupported color conversion operation (16 to 8 bit).", "GameX Error",MB_OK|MB_ICONSTOP) ;
-					break; // not yet supported
-				case IMG_TRUECOLOR:	{ //   True Color (24 bit)
-					XBYTE2 *pDataOld;
-					XBYTE *pDataNew;
-					newdata = new XBYTE[m_size * GetBytesPerPixel(ops)];			
-					pDataOld = (XBYTE2 *) m_data; 
-					pDataNew = (XBYTE *) newdata;
-
-					if(!GameX.win_shiftr)
-						GameX.ReportProblem(GAMEX_NO_INIT) ;
-
-					for (int n=0; n<m_size; n++) {
-						int clr = *pDataOld++;
-						int blue  = (((clr & 0x001F) >> 0 ) << 3);
-						int green = (((clr & 0x07E0) >> 5 ) << 2);
-						int red   = (((clr & 0xF800) >> 11) << 3);
-						*pDataNew++ = red;
-						*pDataNew++ = green;
-						*pDataNew++ = blue;
-					}
-					delete [] m_data; m_data = NULL;
-					m_data = newdata; newdata = NULL;		
-					break;
-				}
-				case IMG_TRUECOLORX: {	//   True Color with X channel (32 bit)
-					XBYTE2 *pDataOld;
-					XBYTE4 *pDataNew;
-					newdata = new XBYTE[m_size * GetBytesPerPixel(ops)];			
-					pDataOld = (XBYTE2 *) m_data; 
-					pDataNew = (XBYTE4 *) newdata;
-
-					if(!GameX.win_shiftr)
-						GameX.ReportProblem(GAMEX_NO_INIT) ;
-
-					for (int n=0; n<m_size; n++) {
-						int clr = *pDataOld++;
-						int blue  = (((clr & 0x001F) >> 0 ) << 3);
-						int green = (((clr & 0x07E0) >> 5 ) << 2);
-						int red   = (((clr & 0xF800) >> 11) << 3);
-						*pDataNew++ = (red << GameX.win_shiftr) + (green << GameX.win_shiftg) + (blue << GameX.win_shiftb);
-					}
-					delete [] m_data; m_data = NULL;
-					m_data = newdata; newdata = NULL;
-					break;
-				}
-			}
-			break;							// Source Format:
-		case IMG_TRUECOLOR:					//   True Color (24 bit)
-			switch (GetFormat(ops))	{			// Target Format:
-				case IMG_INDEXED:			//   Indexed Color (8 bit)
-					MessageBox(GameX.GetWindow(), "Error: Unsupported color conversion operation (24 to 8 bit).", "GameX Error",MB_OK|MB_ICONSTOP) ;
-					break;
-				case IMG_HIGHCOLOR:	{			//   High Color (16 bit)
-					XBYTE *pDataOld;
-					XBYTE2 *pDataNew;
-					newdata = new XBYTE[m_size * GetBytesPerPixel(ops)];			
-					pDataOld = (XBYTE *) m_data; 
-					pDataNew = (XBYTE2 *) newdata;
-
-					if(!GameX.win_shiftr)
-						GameX.ReportProblem(GAMEX_NO_INIT) ;
-
-					for (int n=0; n<m_size; n++) {
-						*pDataNew = (*pDataOld++ >> 3) << GameX.win_shiftr;
-						*pDataNew |= (*pDataOld++ >> 2) << GameX.win_shiftg;
-						*pDataNew++ |= (*pDataOld++ >> 3) << GameX.win_shiftb;
-					}
-					delete [] m_data; m_data = NULL;
-					m_data = newdata; newdata = NULL;
-					break;
-				}
-				case IMG_TRUECOLORX: {	//   True Color with X channel (32 bit)
-					XBYTE *pDataOld;
-					XBYTE4 *pDataNew;
-					newdata = new XBYTE[m_size * GetBytesPerPixel(ops)];			
-					pDataOld = (XBYTE *) m_data; 
-					pDataNew = (XBYTE4 *) newdata;
-
-					if(!GameX.win_shiftr)
-						GameX.ReportProblem(GAMEX_NO_INIT) ;
-
-					for (int n=0; n<m_size; n++) {
-						int newPixel = 0;
-						newPixel |= *pDataOld++ << GameX.win_shiftr;
-						newPixel |= *pDataOld++ << GameX.win_shiftg;
-						newPixel |= *pDataOld++ << GameX.win_shiftb;
-						*pDataNew++ = newPixel;
-					}
-					delete [] m_data; m_data = NULL;
-					m_data = newdata; newdata = NULL;
-					break;
-				}
-			}
-			break;							// Source Format:
-		case IMG_TRUECOLORX:				//   True Color with X channel (32 bit)
-			switch (GetFormat(ops))	{		// Target Format:
-				case IMG_INDEXED:			//   Indexed Color (8 bit)
-					MessageBox(GameX.GetWindow(), "Error: Unsupported color conversion operation (32 to 8 bit).", "GameX Error",MB_OK|MB_ICONSTOP) ;
-					break;
-				case IMG_HIGHCOLOR: {			//   High Color (16 bit)
-					XBYTE4 *pDataOld;
-					XBYTE2 *pDataNew;
-					newdata = new XBYTE[m_size * GetBytesPerPixel(ops)];			
-					pDataOld = (XBYTE4 *) m_data; 
-					pDataNew = (XBYTE2 *) newdata;
-
-					if(!GameX.win_shiftr)
-						GameX.ReportProblem(GAMEX_NO_INIT) ;
-
-					for (int n=0; n<m_size; n++) {
-						int oldPixel = *pDataOld++;
-						int red = ((oldPixel & 0x00FF0000) >> 16);
-						int green = ((oldPixel & 0x0000FF00) >> 8);
-						int blue = ((oldPixel & 0x000000FF) >> 0);
-						int newPixel = ((red >> 3) << 11) | ((green >> 2) << 5) | ((blue >> 3) << 0);
-						*pDataNew++ = newPixel;
-					}
-					delete [] m_data; m_data = NULL;
-					m_data = newdata; newdata = NULL;
-					break;
-				}
-				case IMG_TRUECOLOR: {			//   True Color (24 bit)
-					XBYTE4 *pDataOld;
-					XBYTE *pDataNew;
-					newdata = new XBYTE[m_size * GetBytesPerPixel(ops)];			
-					pDataOld = (XBYTE4 *) m_data; 
-					pDataNew = (XBYTE *) newdata;
-
-					if(!GameX.win_shiftr)
-						GameX.ReportProblem(GAMEX_NO_INIT) ;
-
-					for (int n=0; n<m_size; n++) {
-						int oldPixel = *pDataOld++;
-						int red = ((oldPixel & 0x00FF0000) >> 16);
-						int green = ((oldPixel & 0x0000FF00) >> 8);
-						int blue = ((oldPixel & 0x000000FF) >> 0);
-						*pDataNew++ = red;
-						*pDataNew++ = green;
-						*pDataNew++ = blue;
-					}
-					delete [] m_data; m_data = NULL;
-					m_data = newdata; newdata = NULL;
-					break;
-				}
+	int from = ImageFormatBits(GetFormat(m_options));	// Source Format
+	int to = ImageFormatBits(GetFormat(ops));			// Target Format
+
+	if (from != 0 && to != 0 && from != to) {
+		if (from == 8 || to == 8) {						// Indexed Color isn't supported either way
+			char msg[128];
+			if (from == 8) {
+				sprintf(msg, "Unsupported color conversion operation (%d to %d bit).", from, to);
+				GameX.ErrorDialog(msg) ;
+			} else {
+				sprintf(msg, "Error: Unsupported color conversion operation (%d to %d bit).", from, to);
+				MessageBox(GameX.GetWindow(), msg, "GameX Error",MB_OK|MB_ICONSTOP) ;
 			}
-			break;
+		} else {
+			// The formulas are the same as the old per-pixel loops; 16 bit
+			// sources are looked up a byte at a time, and 16 <-> 32 bit
+			// uses SSE2 when the CPU has it. Big images are split over
+			// threads a band of rows at a time
+			BlendConverter conv(from, to, GameX.win_shiftr, GameX.win_shiftg, GameX.win_shiftb);
+			XBYTE * newdata = new XBYTE[m_size * GetBytesPerPixel(ops)];
+
+			if(!GameX.win_shiftr)
+				GameX.ReportProblem(GAMEX_NO_INIT) ;
+
+			ImageConvertRows rows;
+			rows.conv = &conv;
+			rows.src = m_data;
+			rows.dst = newdata;
+			rows.xres = m_xres;
+			rows.src_bytes = from / 8;
+			rows.dst_bytes = to / 8;
+			PixelRowsRun(rows, m_xres, m_yres);
+
+			delete [] m_data; m_data = NULL;
+			m_data = newdata; newdata = NULL;
+		}
 	}
 	TurnOff (GetFormat(m_options));
 	TurnOn (ops);
 }
 
+// A band of ConvertAlphaToMask's rows
+class ImageAlphaToMaskRows : public PixelRows {
+public:
+	XBYTE2 *pixels;
+	XBYTE *alpha;
+	int xres;
+	void Rows (int y1, int y2)	{ BlendAlphaToMask16 (pixels + y1*xres, alpha + y1*xres, (y2-y1)*xres); }
+};
+
 void ImageX::ConvertAlphaToMask (void)
 {
 	if (GetAlpha(m_options)==IMG_ALPHA) {
 		switch (GetFormat(m_options)) {
 		case IMG_HIGHCOLOR: {
-			XBYTE2 *pData;
-			XBYTE *pAlphaData;
-			pData = (XBYTE2*) m_data;
-			pAlphaData = m_alpha;
-			for (int n=0; n<m_size; n++) {
-				if (*pData==0) *pData = 1;
-				if (*pAlphaData < 16) *pData = 0;
-				*pData++;
-				*pAlphaData++;
-			}
+			ImageAlphaToMaskRows rows;
+			rows.pixels = (XBYTE2*) m_data;
+			rows.alpha = m_alpha;
+			rows.xres = m_xres;
+			PixelRowsRun(rows, m_xres, m_yres);
 		} break;
 		}
 
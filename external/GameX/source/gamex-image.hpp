@@ -25,10 +25,13 @@
 	//#define IMAGEX_SUPPORT_RAW		// Image support for RAW file load/save
 	#define IMAGEX_SUPPORT_TIFF			// Image support for TIFF file load/save
 	#define IMAGEX_SUPPORT_BMP			// Image support for BMP file load/save
+
+	#define IMAGEX_BOXBLUR_SIGMA		8.0f	// GaussianBlur uses box passes for wider blurs
 	
 	typedef unsigned char		ImageOps;	
 
 	class ImageExt; // forward referencing
+	class PixelOp;
 
 	class ImageX {
 	public:		
@@ -48,6 +51,15 @@
 
 		// Creates a blank image to be drawn after you draw into it
 		void Create (int xr, int yr, bool alpha=false);
+
+		// Makes this image a view of the xr by yr part of page at x,y. A view
+		// has no pixels or surface of its own: DrawImage on it draws that part
+		// of the page, so views of one page (an atlas) share a texture and can
+		// share a draw batch. Don't access a view's pixels; the page must
+		// outlive it.
+		void CreateView (ImageX * page, int x, int y, int xr, int yr);
+		inline bool IsView (void) {return m_view_page != NULL;}
+		inline ImageX * GetTexture (void) {return (m_view_page != NULL) ? m_view_page : this;} // the image really drawn from
 		void Destroy (void); // deallocates image memory
 
 		// Saves the image to file
@@ -89,8 +101,9 @@
 		void ConvertToGrayscale (void);
 		void AddNoise (int noise); // adds random noise to the image's red, green, and blue
 		void AddNoise (int noise_r, int noise_g, int noise_b, int noise_a=0); // adds random noise to the image
-		void GaussianBlur (float radius);
+		void GaussianBlur (float radius); // separable, past IMAGEX_BOXBLUR_SIGMA it switches to BoxBlur
 		void GaussianBlur (float red_radius, float green_radius, float blue_radius, float alpha_radius=0.0f);
+		void BoxBlur (float radius); // close to GaussianBlur, and as fast for any radius
 
 		// Image copying functions (slow, but these don't require LOAD_TARGETABLE)
 		void CopyTo (ImageX * dest);
@@ -104,6 +117,14 @@
 		void SetFilterRect(int xLeft, int yTop, int xRight, int yBottom) {m_fx1=xLeft; m_fy1=yTop; m_fx2=xRight; m_fy2=yBottom;}
 		void ResetFilterRect(void) {m_fx1 = 0; m_fy1 = 0; m_fx2 = m_xres; m_fy2 = m_yres;}
 
+		// Direct access to the filter rect as 32-bit ARGB rows 'pitch' pixels
+		// apart, for filters and loaders. NULL if the image can't be changed.
+		// An unscaled 32-bit surface is handed over as it is; anything else
+		// goes through a copy (read from the image unless read is false) that
+		// EndPixels32 writes back. Much faster than SetPixel per pixel
+		XBYTE4 * BeginPixels32 (int &pitch, XBYTE4 * &copy, bool read=true);
+		void EndPixels32 (XBYTE4 * copy);
+
 		void ConvertRGBToLab(int r, int g, int b, int &L, int &A, int &B); // converts one RGB color to LAB
 		void ConvertLabToRGB(int L, int A, int B, int &r, int &g, int &b); // converts one LAB color to RGB
 
@@ -138,6 +159,8 @@
 		int m_fx1, m_fy1, m_fx2, m_fy2; // filter rectangle
 		ImageX * m_internal_compatibility_img[3]; // used for certain video card workarounds
 		float m_xmult, m_ymult; // resolution multipliers -- 0.5 means image is stored at half resolution, for example
+		ImageX * m_view_page; // for views, the image this is part of
+		int m_view_x, m_view_y; // and where in it
 		bool m_non_empty; // true if a file was loaded into this image or if its pixels were accessed by GameX.AccessPixels (which everything that can change the image calls), false otherwise
 
 	private:
@@ -149,6 +172,8 @@
 ///		void RotateAlpha (ImageX *dest, float ang, float scale);
 		inline void AddUsage (ImageUsage u) {m_usage |= u;}
 		inline void RemoveUsage (ImageUsage u) {m_usage ^= u;}
+		void Blur (float sigma[4], bool box);
+		void ApplyPixelOp (PixelOp &op); // runs op over the filter rect
 		void ConvertFormat (ImageOps pf);
 		void ConvertAlphaToMask (void);
 		void ConvertMaskToAlpha (void);
@@ -182,12 +207,6 @@
 		bool SaveBmp (char *filename, HBITMAP hBitmap); // implemented in gamex-image-bmp.cpp
 		bool LoadJPGorGIF (char *filename, ImageX *img); // currently implemented in gamex-image-bmp.cpp
 
-		// helper methods for LoadTiff
-		bool LoadTiffDirectory (File &tiff, Buffer &code);
-		bool LoadTiffEntry (File &tiff, Buffer &code);
-		bool LoadTiffStrips (File &tiff, Buffer &code);
-		bool LoadTiffData (File &tiff, Buffer &code, unsigned long count, unsigned long offset, int row);
-
 		// helper methods for SaveTiff:
 		bool SaveTiffDirectory (File &tiff, Buffer &code);
 		bool SaveTiffEntry (File &tiff, Buffer &code, unsigned int tag);
@@ -0,0 +1,851 @@
+//
+// GameX - Sound Mixer Code
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#include "gamex-mixer.hpp"
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define MIXER_HAS_SSE2
+	#include <emmintrin.h>
+#endif
+
+#ifdef __GNUC__
+	#define MIXER_SSE2_FUNC	__attribute__ ((target ("sse2")))
+#else
+	#define MIXER_SSE2_FUNC
+#endif
+
+//---------------------------------------------------------------- Kernels
+
+void MixerAdd16Ref (float *acc, const short *src, int frames, int channels, float left, float right)
+{
+	if (channels == 1) {
+		for (int n=0; n < frames; n++) {
+			acc[n*2] += (float) src[n] * left;
+			acc[n*2+1] += (float) src[n] * right;
+		}
+	} else {
+		for (int n=0; n < frames; n++) {
+			acc[n*2] += (float) src[n*2] * left;
+			acc[n*2+1] += (float) src[n*2+1] * right;
+		}
+	}
+}
+
+void MixerClamp16Ref (short *dst, const float *acc, int count)
+{
+	for (int n=0; n < count; n++) {
+		float v = acc[n];
+		if (!(v <= 32767.0f)) v = 32767.0f;			// as _mm_min_ps, which also takes NaN to the top
+		if (v < -32768.0f) v = -32768.0f;
+		dst[n] = (short) (int) v;
+	}
+}
+
+#ifdef MIXER_HAS_SSE2
+
+// Samples sign extended to 32 bits, then to float
+MIXER_SSE2_FUNC static inline __m128 MixerLow (__m128i s)	{ return _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (s, s), 16)); }
+MIXER_SSE2_FUNC static inline __m128 MixerHigh (__m128i s)	{ return _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpackhi_epi16 (s, s), 16)); }
+
+MIXER_SSE2_FUNC static inline void MixerAcc (float *acc, __m128 v, __m128 gain)
+{
+	_mm_storeu_ps (acc, _mm_add_ps (_mm_loadu_ps (acc), _mm_mul_ps (v, gain)));
+}
+
+// 8 mono frames a pass, each doubled into a left, right pair
+MIXER_SSE2_FUNC static int MixerAddMonoSSE2 (float *acc, const short *src, int frames, float left, float right)
+{
+	__m128 gain = _mm_setr_ps (left, right, left, right);
+	int n = 0;
+	for (; n + 8 <= frames; n += 8) {
+		__m128i s = _mm_loadu_si128 ((__m128i *) (src + n));
+		__m128 lo = MixerLow (s), hi = MixerHigh (s);
+		float *a = acc + n*2;
+		MixerAcc (a, _mm_unpacklo_ps (lo, lo), gain);
+		MixerAcc (a + 4, _mm_unpackhi_ps (lo, lo), gain);
+		MixerAcc (a + 8, _mm_unpacklo_ps (hi, hi), gain);
+		MixerAcc (a + 12, _mm_unpackhi_ps (hi, hi), gain);
+	}
+	return n;
+}
+
+// 4 stereo frames a pass, already in the order acc is
+MIXER_SSE2_FUNC static int MixerAddStereoSSE2 (float *acc, const short *src, int frames, float left, float right)
+{
+	__m128 gain = _mm_setr_ps (left, right, left, right);
+	int n = 0;
+	for (; n + 4 <= frames; n += 4) {
+		__m128i s = _mm_loadu_si128 ((__m128i *) (src + n*2));
+		MixerAcc (acc + n*2, MixerLow (s), gain);
+		MixerAcc (acc + n*2 + 4, MixerHigh (s), gain);
+	}
+	return n;
+}
+
+MIXER_SSE2_FUNC static int MixerClamp16SSE2 (short *dst, const float *acc, int count)
+{
+	__m128 top = _mm_set1_ps (32767.0f), bottom = _mm_set1_ps (-32768.0f);
+	int n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m128i lo = _mm_cvttps_epi32 (_mm_max_ps (_mm_min_ps (_mm_loadu_ps (acc + n), top), bottom));
+		__m128i hi = _mm_cvttps_epi32 (_mm_max_ps (_mm_min_ps (_mm_loadu_ps (acc + n + 4), top), bottom));
+		_mm_storeu_si128 ((__m128i *) (dst + n), _mm_packs_epi32 (lo, hi));
+	}
+	return n;
+}
+
+#endif
+
+void MixerAdd16 (float *acc, const short *src, int frames, int channels, float left, float right)
+{
+	int n = 0;
+	#ifdef MIXER_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) {
+			if (channels == 1) n = MixerAddMonoSSE2 (acc, src, frames, left, right);
+			else n = MixerAddStereoSSE2 (acc, src, frames, left, right);
+		}
+	#endif
+	MixerAdd16Ref (acc + n*2, src + n*channels, frames - n, channels, left, right);
+}
+
+void MixerClamp16 (short *dst, const float *acc, int count)
+{
+	int n = 0;
+	#ifdef MIXER_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) n = MixerClamp16SSE2 (dst, acc, count);
+	#endif
+	MixerClamp16Ref (dst + n, acc + n, count - n);
+}
+
+//---------------------------------------------------------------- Mixer
+
+Mixer::Mixer (int voices, int rate)
+{
+	m_num_voices = (voices > 0) ? voices : 1;
+	m_rate = (rate > 0) ? rate : MIXER_RATE;
+	m_voices = new MixerVoice[m_num_voices];
+	m_order = 0;
+	m_time = 0;
+	m_stolen = 0;
+	m_merged = 0;
+	m_dropped = 0;
+	m_window = MIXER_WINDOW;
+	m_copies = MIXER_COPIES;
+	for (int n=0; n < m_num_voices; n++) {
+		m_voices[n].key = NULL;
+		m_voices[n].active = false;
+	}
+}
+
+Mixer::~Mixer ()
+{
+	delete [] m_voices;
+}
+
+// Whether a matters less than b, so should be the one to go
+static bool MixerLess (const MixerVoice &a, const MixerVoice &b)
+{
+	if (a.priority != b.priority) return a.priority < b.priority;
+	float ga = (a.gain[0] > a.gain[1]) ? a.gain[0] : a.gain[1];
+	float gb = (b.gain[0] > b.gain[1]) ? b.gain[0] : b.gain[1];
+	if (ga != gb) return ga < gb;
+	return a.order < b.order;
+}
+
+// A sound's frames per output frame, in fixed point, kept to
+// something that neither stalls nor skips most of the sound
+static int MixerStep (int rate, float freq, int out_rate)
+{
+	double step = (double) rate * freq / out_rate * MIXER_ONE;
+	if (step < 1.0) return 1;
+	if (step > 64.0 * MIXER_ONE) return 64 * MIXER_ONE;
+	return (int) (step + 0.5);
+}
+
+// The voice a new sound goes on: the key's own if 'reuse', or a free
+// one, or one taken over
+int Mixer::Allocate (const void *key, int priority, bool reuse)
+{
+	int voice = (key != NULL && reuse) ? Find (key) : -1;
+	for (int n=0; n < m_num_voices && voice < 0; n++)
+		if (!m_voices[n].active) voice = n;
+
+	// All busy: take over the one that matters least, if it matters
+	// no more than this one. Lowest priority goes first, then the
+	// quietest, then the oldest
+	if (voice < 0) {
+		int least = 0;
+		for (int n=1; n < m_num_voices; n++)
+			if (MixerLess (m_voices[n], m_voices[least])) least = n;
+		if (m_voices[least].priority > priority) return -1;
+		voice = least;
+		m_stolen++;
+	}
+	return voice;
+}
+
+void Mixer::Start (int voice, const void *key, const short *data, int frames, int channels, int rate, int priority)
+{
+	MixerVoice &v = m_voices[voice];
+	v.key = key;
+	v.data = data;
+	v.source = NULL;
+	v.frames = frames;
+	v.channels = channels;
+	v.rate = rate;
+	v.pos = 0;
+	v.frac = 0;
+	v.step = MixerStep (rate, 1.0f, m_rate);
+	v.gain[0] = v.gain[1] = 1.0f;
+	v.priority = priority;
+	v.order = m_order++;
+	v.start = m_time;
+	v.loop = false;
+	v.active = true;
+}
+
+int Mixer::Play (const void *key, const short *data, int frames, int channels, int rate, int priority)
+{
+	if (data == NULL || frames <= 0 || (channels != 1 && channels != 2) || rate <= 0) return -1;
+
+	int voice = Allocate (key, priority, true);
+	if (voice >= 0) Start (voice, key, data, frames, channels, rate, priority);
+	return voice;
+}
+
+int Mixer::Trigger (const void *key, const short *data, int frames, int channels, int rate,
+					float left, float right, float freq, int priority)
+{
+	if (data == NULL || frames <= 0 || (channels != 1 && channels != 2) || rate <= 0) return -1;
+
+	int newest = -1, copies = 0;
+	for (int n=0; n < m_num_voices; n++) {
+		MixerVoice &v = m_voices[n];
+		if (!v.active || v.key != key) continue;
+		copies++;
+		if (newest < 0 || v.order > m_voices[newest].order) newest = n;
+	}
+
+	if (newest >= 0 && m_time - m_voices[newest].start < (XBYTE4) m_window) {
+		MixerVoice &v = m_voices[newest];
+		if (left > v.gain[0]) v.gain[0] = left;
+		if (right > v.gain[1]) v.gain[1] = right;
+		m_merged++;
+		return newest;
+	}
+
+	int voice = (copies < m_copies) ? Allocate (key, priority, false) : -1;
+	if (voice < 0) {
+		m_dropped++;
+		return -1;
+	}
+	Start (voice, key, data, frames, channels, rate, priority);
+	Set (voice, left, right, freq);
+	return voice;
+}
+
+int Mixer::Stream (const void *key, MixerSource *source, int channels, int priority)
+{
+	if (source == NULL || (channels != 1 && channels != 2)) return -1;
+
+	int voice = Allocate (key, priority, true);
+	if (voice >= 0) {
+		Start (voice, key, NULL, 0, channels, m_rate, priority);
+		m_voices[voice].source = source;
+	}
+	return voice;
+}
+
+void Mixer::SetThrottle (int window, int copies)
+{
+	m_window = (window > 0) ? window : 0;
+	m_copies = (copies > 1) ? copies : 1;
+}
+
+int Mixer::Find (const void *key)
+{
+	for (int n=0; n < m_num_voices; n++)
+		if (m_voices[n].active && m_voices[n].key == key) return n;
+	return -1;
+}
+
+int Mixer::Count (const void *key)
+{
+	int count = 0;
+	for (int n=0; n < m_num_voices; n++)
+		if (m_voices[n].active && m_voices[n].key == key) count++;
+	return count;
+}
+
+void Mixer::Set (int voice, float left, float right, float freq)
+{
+	if (voice < 0 || voice >= m_num_voices) return;
+	MixerVoice &v = m_voices[voice];
+	v.gain[0] = left;
+	v.gain[1] = right;
+	v.step = MixerStep (v.rate, freq, m_rate);
+}
+
+void Mixer::SetLoop (int voice, bool loop)
+{
+	if (voice >= 0 && voice < m_num_voices) m_voices[voice].loop = loop;
+}
+
+void Mixer::Rewind (int voice)
+{
+	if (voice >= 0 && voice < m_num_voices) m_voices[voice].pos = m_voices[voice].frac = 0;
+}
+
+void Mixer::Stop (int voice)
+{
+	if (voice >= 0 && voice < m_num_voices) m_voices[voice].active = false;
+}
+
+void Mixer::StopAll (void)
+{
+	for (int n=0; n < m_num_voices; n++) m_voices[n].active = false;
+}
+
+bool Mixer::IsPlaying (int voice)
+{
+	return voice >= 0 && voice < m_num_voices && m_voices[voice].active;
+}
+
+float Mixer::GetGain (int voice)
+{
+	if (!IsPlaying (voice)) return 0.0f;
+	MixerVoice &v = m_voices[voice];
+	return (v.gain[0] > v.gain[1]) ? v.gain[0] : v.gain[1];
+}
+
+int Mixer::GetNumPlaying (void)
+{
+	int count = 0;
+	for (int n=0; n < m_num_voices; n++)
+		if (m_voices[n].active) count++;
+	return count;
+}
+
+// A silent voice only needs to move along
+void Mixer::Skip (MixerVoice &v, int frames)
+{
+	if (v.source != NULL) {
+		if (v.source->Read (m_tmp, frames) < 0) v.active = false;
+		return;
+	}
+	XBYTE8 end = (XBYTE8) v.frames * MIXER_ONE;
+	XBYTE8 pos = (XBYTE8) v.pos * MIXER_ONE + v.frac + (XBYTE8) v.step * frames;
+	if (pos >= end) {
+		if (!v.loop) { v.active = false; return; }
+		pos %= end;
+	}
+	v.pos = (int) (pos / MIXER_ONE);
+	v.frac = (int) (pos % MIXER_ONE);
+}
+
+// Each output frame falls between two of the sound's, weighted by how
+// near it is to each. The last frame is held rather than run into the
+// loop start. Returns the frames made, up to 'frames' or the sound's end
+static int MixerResample (short *dst, MixerVoice &v, int frames)
+{
+	const short *data = v.data;
+	int pos = v.pos, frac = v.frac, step = v.step, last = v.frames - 1;
+	int count = 0;
+
+	if (v.channels == 1) {
+		for (; count < frames && pos < last; count++) {
+			int s0 = data[pos];
+			dst[count] = (short) (s0 + (((data[pos+1] - s0) * (frac >> 1)) >> 15));
+			frac += step;
+			pos += frac >> 16;
+			frac &= MIXER_ONE - 1;
+		}
+	} else {
+		for (; count < frames && pos < last; count++) {
+			const short *s = data + pos*2;
+			int w = frac >> 1;
+			dst[count*2] = (short) (s[0] + (((s[2] - s[0]) * w) >> 15));
+			dst[count*2+1] = (short) (s[1] + (((s[3] - s[1]) * w) >> 15));
+			frac += step;
+			pos += frac >> 16;
+			frac &= MIXER_ONE - 1;
+		}
+	}
+
+	// On the last frame there's nothing to weigh it against
+	for (; count < frames && pos == last; count++) {
+		for (int c=0; c < v.channels; c++) dst[count*v.channels + c] = data[pos*v.channels + c];
+		frac += step;
+		pos += frac >> 16;
+		frac &= MIXER_ONE - 1;
+	}
+
+	v.pos = pos;
+	v.frac = frac;
+	return count;
+}
+
+void Mixer::MixVoice (MixerVoice &v, float *acc, int frames)
+{
+	int ch = v.channels, done = 0;
+
+	// A source that's run short leaves a gap rather than holding up the rest
+	if (v.source != NULL) {
+		int count = v.source->Read (m_tmp, frames);
+		if (count < 0) v.active = false;
+		else MixerAdd16 (acc, m_tmp, count, ch, v.gain[0], v.gain[1]);
+		return;
+	}
+
+	while (done < frames && v.active) {
+		int count;
+		if (v.step == MIXER_ONE && v.frac == 0) {
+			// At the output's rate the samples go straight in
+			count = v.frames - v.pos;
+			if (count > frames - done) count = frames - done;
+			MixerAdd16 (acc + done*2, v.data + v.pos*ch, count, ch, v.gain[0], v.gain[1]);
+			v.pos += count;
+		} else {
+			count = MixerResample (m_tmp, v, frames - done);
+			MixerAdd16 (acc + done*2, m_tmp, count, ch, v.gain[0], v.gain[1]);
+		}
+		done += count;
+		if (v.pos >= v.frames) {
+			if (v.loop) v.pos %= v.frames;
+			else v.active = false;
+		}
+	}
+}
+
+void Mixer::Mix (short *dst, int frames)
+{
+	while (frames > 0) {
+		int count = (frames < MIXER_BLOCK) ? frames : MIXER_BLOCK;
+		memset (m_acc, 0, count * 2 * sizeof (float));
+		for (int n=0; n < m_num_voices; n++) {
+			MixerVoice &v = m_voices[n];
+			if (!v.active) continue;
+			if (v.gain[0] == 0.0f && v.gain[1] == 0.0f) Skip (v, count);
+			else MixVoice (v, m_acc, count);
+		}
+		MixerClamp16 (dst, m_acc, count * 2);
+		dst += count * 2;
+		frames -= count;
+		m_time += count;
+	}
+}
+
+//---------------------------------------------------------------- Ring
+
+MixerRing::MixerRing (int frames)
+{
+	m_size = (frames > 0) ? frames : 1;
+	m_buf = new short[m_size * 2];
+	m_read = 0;
+	m_count = 0;
+}
+
+MixerRing::~MixerRing ()
+{
+	delete [] m_buf;
+}
+
+int MixerRing::Fill (Mixer &mixer, int frames)
+{
+	if (frames > GetFree ()) frames = GetFree ();
+	if (frames <= 0) return 0;
+	int write = (m_read + m_count) % m_size;
+	int first = (frames < m_size - write) ? frames : m_size - write;
+	mixer.Mix (m_buf + write*2, first);
+	mixer.Mix (m_buf, frames - first);					// wrapped around
+	m_count += frames;
+	return frames;
+}
+
+int MixerRing::Read (short *dst, int frames)
+{
+	if (frames > m_count) frames = m_count;
+	if (frames <= 0) return 0;
+	int first = (frames < m_size - m_read) ? frames : m_size - m_read;
+	memcpy (dst, m_buf + m_read*2, first * 2 * sizeof (short));
+	memcpy (dst + first*2, m_buf, (frames - first) * 2 * sizeof (short));
+	m_read = (m_read + frames) % m_size;
+	m_count -= frames;
+	return frames;
+}
+
+//---------------------------------------------------------------- WAV sink
+
+static void MixerPut4 (XBYTE *p, XBYTE4 v)	{ p[0] = (XBYTE) v; p[1] = (XBYTE) (v >> 8); p[2] = (XBYTE) (v >> 16); p[3] = (XBYTE) (v >> 24); }
+static void MixerPut2 (XBYTE *p, int v)		{ p[0] = (XBYTE) v; p[1] = (XBYTE) (v >> 8); }
+
+MixerWavSink::MixerWavSink ()
+{
+	m_fp = NULL;
+	m_frames = 0;
+}
+
+MixerWavSink::~MixerWavSink ()
+{
+	Close ();
+}
+
+bool MixerWavSink::Open (const char *filename, int rate)
+{
+	Close ();
+	m_fp = fopen (filename, "wb");
+	if (m_fp == NULL) return false;
+	m_frames = 0;
+
+	XBYTE head[44];
+	memcpy (head, "RIFF", 4);
+	MixerPut4 (head + 4, 36);
+	memcpy (head + 8, "WAVEfmt ", 8);
+	MixerPut4 (head + 16, 16);
+	MixerPut2 (head + 20, 1);							// PCM
+	MixerPut2 (head + 22, 2);
+	MixerPut4 (head + 24, rate);
+	MixerPut4 (head + 28, rate * 4);
+	MixerPut2 (head + 32, 4);
+	MixerPut2 (head + 34, 16);
+	memcpy (head + 36, "data", 4);
+	MixerPut4 (head + 40, 0);
+	fwrite (head, 44, 1, m_fp);
+	return true;
+}
+
+// Samples are written as they are in memory, which is the little
+// endian a .wav wants on everything GameX runs on
+void MixerWavSink::Write (const short *frames, int count)
+{
+	if (m_fp == NULL || count <= 0) return;
+	fwrite (frames, 4, count, m_fp);
+	m_frames += count;
+}
+
+void MixerWavSink::Close (void)
+{
+	if (m_fp == NULL) return;
+	XBYTE size[4];
+	MixerPut4 (size, 36 + m_frames * 4);
+	fseek (m_fp, 4, SEEK_SET);
+	fwrite (size, 4, 1, m_fp);
+	MixerPut4 (size, m_frames * 4);
+	fseek (m_fp, 40, SEEK_SET);
+	fwrite (size, 4, 1, m_fp);
+	fclose (m_fp);
+	m_fp = NULL;
+}
+
+#ifdef MIXER_TESTER
+
+	// Checks SSE2 against the reference, the mixer's voices (rates,
+	// loops, stealing, throttling) and the ring against mixing straight
+	// out, then times waves of triggers and mixing 10 seconds of many
+	// voices into a .wav with no sound device. Builds off Windows:
+	//   g++ -O2 -DMIXER_TESTER gamex-mixer.cpp gamex-blend.cpp
+
+	#include <stdlib.h>
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <sys/time.h>
+	#endif
+
+	static double Seconds (void)
+	{
+		#ifdef _WIN32
+			LARGE_INTEGER freq, now;
+			QueryPerformanceFrequency (&freq);
+			QueryPerformanceCounter (&now);
+			return (double) now.QuadPart / (double) freq.QuadPart;
+		#else
+			struct timeval tv;
+			gettimeofday (&tv, NULL);
+			return tv.tv_sec + tv.tv_usec / 1e6;
+		#endif
+	}
+
+	static int Rand (int lo, int hi)	{ return lo + rand () % (hi - lo + 1); }
+	static float RandF (float lo, float hi)	{ return lo + (hi - lo) * (rand () % 10001) / 10000.0f; }
+
+	static int TestKernels (void)
+	{
+		short src[2*300], out[2*300], ref[2*300];
+		float acc[2*300], acc_ref[2*300];
+		int fails = 0;
+
+		for (int t=0; t < 20000; t++) {
+			int frames = Rand (0, 300), channels = Rand (1, 2);
+			float left = RandF (-2.0f, 2.0f), right = RandF (-2.0f, 2.0f);
+			for (int n=0; n < 2*300; n++) {
+				src[n] = (short) Rand (-32768, 32767);
+				acc[n] = acc_ref[n] = RandF (-40000.0f, 40000.0f);
+			}
+			MixerAdd16 (acc, src, frames, channels, left, right);
+			MixerAdd16Ref (acc_ref, src, frames, channels, left, right);
+			if (memcmp (acc, acc_ref, sizeof (acc)) != 0) {
+				if (fails++ < 5) printf ("  add of %d frames x %d differs\n", frames, channels);
+			}
+			int count = frames * channels;
+			memset (out, 0, sizeof (out)); memset (ref, 0, sizeof (ref));
+			MixerClamp16 (out, acc, count);
+			MixerClamp16Ref (ref, acc, count);
+			if (memcmp (out, ref, sizeof (out)) != 0) {
+				if (fails++ < 5) printf ("  clamp of %d differs\n", count);
+			}
+		}
+		return fails;
+	}
+
+	static int Check (bool ok, const char *what)
+	{
+		if (!ok) printf ("  %s\n", what);
+		return ok ? 0 : 1;
+	}
+
+	static int TestVoices (void)
+	{
+		const int kFrames = 1000;
+		short *ramp = new short[kFrames*2], *out = new short[kFrames*8];
+		int fails = 0, n;
+		for (n=0; n < kFrames*2; n++) ramp[n] = (short) (n * 30 - 30000);
+
+		// Straight through, to both sides, then nothing once it's done
+		Mixer mixer (8);
+		int v = mixer.Play (ramp, ramp, kFrames, 1, MIXER_RATE);
+		mixer.Mix (out, kFrames + 10);
+		bool ok = true;
+		for (n=0; n < kFrames; n++) ok = ok && out[n*2] == ramp[n] && out[n*2+1] == ramp[n];
+		for (n=kFrames; n < kFrames + 10; n++) ok = ok && out[n*2] == 0 && out[n*2+1] == 0;
+		fails += Check (ok && !mixer.IsPlaying (v), "mono at the output rate isn't the sound itself");
+
+		// Stereo with gains: the sum clamps at the top
+		v = mixer.Play (ramp, ramp, kFrames, 2, MIXER_RATE);
+		mixer.Set (v, 0.5f, 2.0f, 1.0f);
+		mixer.Mix (out, kFrames);
+		ok = true;
+		for (n=0; n < kFrames; n++) {
+			float r = ramp[n*2+1] * 2.0f;
+			ok = ok && out[n*2] == (short) (ramp[n*2] * 0.5f) && out[n*2+1] == (short) (r > 32767.0f ? 32767.0f : r < -32768.0f ? -32768.0f : r);
+		}
+		fails += Check (ok, "stereo gains are off");
+
+		// Recorded at half the rate: every other frame is halfway between
+		v = mixer.Play (ramp, ramp, kFrames, 1, MIXER_RATE / 2);
+		mixer.Mix (out, kFrames * 2);
+		ok = true;
+		for (n=0; n < kFrames*2 - 2; n++) ok = ok && out[n*2] == ramp[n/2] + ((n & 1) ? 15 : 0);
+		fails += Check (ok, "half rate doesn't interpolate");
+
+		// The same through freq, and looped
+		v = mixer.Play (ramp, ramp, 100, 1, MIXER_RATE);
+		mixer.Set (v, 1.0f, 1.0f, 0.5f);
+		mixer.SetLoop (v, true);
+		mixer.Mix (out, 1000);
+		ok = mixer.IsPlaying (v);
+		for (n=0; n < 1000; n++) {
+			int k = (n / 2) % 100;
+			int want = ramp[k] + (((n & 1) && k < 99) ? 15 : 0);
+			ok = ok && out[n*2] == want;
+		}
+		fails += Check (ok, "looping at half speed is off");
+
+		// Silent voices move along like the rest
+		mixer.Set (v, 0.0f, 0.0f, 1.0f);
+		mixer.Mix (out, 150);
+		mixer.Set (v, 1.0f, 1.0f, 1.0f);
+		mixer.Mix (out, 1);
+		fails += Check (out[0] == ramp[50] || out[0] == ramp[50] + 15, "silent voices don't keep their place");
+		mixer.StopAll ();
+
+		// Stealing: lowest priority, then quietest, then oldest
+		Mixer pool (4);
+		int keys[8];
+		int a = pool.Play (&keys[0], ramp, kFrames, 1, MIXER_RATE, 1);
+		int b = pool.Play (&keys[1], ramp, kFrames, 1, MIXER_RATE, 0);
+		int c = pool.Play (&keys[2], ramp, kFrames, 1, MIXER_RATE, 0);
+		int d = pool.Play (&keys[3], ramp, kFrames, 1, MIXER_RATE, 2);
+		pool.Set (c, 0.5f, 0.25f, 1.0f);
+		fails += Check (pool.GetNumPlaying () == 4 && pool.GetStolen () == 0, "pool didn't fill");
+		int e = pool.Play (&keys[4], ramp, kFrames, 1, MIXER_RATE, 0);
+		fails += Check (e == c && pool.Find (&keys[2]) < 0 && pool.Find (&keys[4]) == e, "didn't steal the quietest of the lowest");
+		int f = pool.Play (&keys[5], ramp, kFrames, 1, MIXER_RATE, 0);
+		fails += Check (f == b, "didn't steal the oldest of the lowest");
+		fails += Check (pool.Play (&keys[6], ramp, kFrames, 1, MIXER_RATE, -1) < 0, "stole from something more important");
+		fails += Check (pool.Play (&keys[0], ramp, kFrames, 1, MIXER_RATE, 1) == a && pool.GetStolen () == 2, "same key didn't reuse its voice");
+		fails += Check (pool.Play (&keys[7], ramp, kFrames, 1, MIXER_RATE, 5) >= 0 && pool.Find (&keys[3]) == d, "priority 5 stole the wrong voice");
+
+		delete [] ramp;
+		delete [] out;
+		return fails;
+	}
+
+	static int TestThrottle (void)
+	{
+		short *sound = new short[1000], *out = new short[2*100];
+		int fails = 0, key;
+		for (int n=0; n < 1000; n++) sound[n] = (short) Rand (-1000, 1000);
+
+		// A burst all at once is one copy, taking the loudest gains
+		Mixer mixer (16);
+		mixer.SetThrottle (100, 3);
+		int v = mixer.Trigger (&key, sound, 1000, 1, MIXER_RATE, 0.2f, 0.1f, 1.0f);
+		for (int n=0; n < 4; n++) mixer.Trigger (&key, sound, 1000, 1, MIXER_RATE, 0.8f, 0.1f, 1.0f);
+		fails += Check (mixer.Count (&key) == 1 && mixer.GetMerged () == 4 && mixer.GetGain (v) == 0.8f, "burst didn't merge into one copy");
+
+		// Out of the window, more copies up to the limit
+		mixer.Mix (out, 100);
+		fails += Check (mixer.Trigger (&key, sound, 1000, 1, MIXER_RATE, 1.0f, 1.0f, 1.0f) != v && mixer.Count (&key) == 2, "second copy didn't start");
+		mixer.Mix (out, 100);
+		mixer.Trigger (&key, sound, 1000, 1, MIXER_RATE, 1.0f, 1.0f, 1.0f);
+		mixer.Mix (out, 100);
+		fails += Check (mixer.Trigger (&key, sound, 1000, 1, MIXER_RATE, 1.0f, 1.0f, 1.0f) < 0 && mixer.Count (&key) == 3 && mixer.GetDropped () == 1, "copies past the limit weren't dropped");
+		fails += Check (mixer.Trigger (sound, sound, 1000, 1, MIXER_RATE, 1.0f, 1.0f, 1.0f) >= 0, "another key was held back");
+
+		// No window, no merging
+		Mixer open (16);
+		open.SetThrottle (0, 8);
+		for (int n=0; n < 5; n++) open.Trigger (&key, sound, 1000, 1, MIXER_RATE, 1.0f, 1.0f, 1.0f);
+		fails += Check (open.Count (&key) == 5 && open.GetMerged () == 0, "no window still merged");
+
+		delete [] sound;
+		delete [] out;
+		return fails;
+	}
+
+	// Filled and drained in odd sized pieces, the ring must give what
+	// mixing straight out does
+	static int TestRing (void)
+	{
+		const int kFrames = 20000;
+		short *sound = new short[kFrames], *direct = new short[kFrames*2], *ringed = new short[kFrames*2];
+		for (int n=0; n < kFrames; n++) sound[n] = (short) Rand (-20000, 20000);
+
+		Mixer one (4), two (4);
+		int v1 = one.Play (sound, sound, kFrames, 1, 32000), v2 = two.Play (sound, sound, kFrames, 1, 32000);
+		one.Set (v1, 0.7f, 0.3f, 1.1f);
+		two.Set (v2, 0.7f, 0.3f, 1.1f);
+		one.Mix (direct, kFrames);
+
+		MixerRing ring (777);
+		int got = 0;
+		while (got < kFrames) {
+			ring.Fill (two, Rand (1, 1000));
+			int want = Rand (1, 900);
+			if (want > kFrames - got) want = kFrames - got;
+			got += ring.Read (ringed + got*2, want);
+		}
+		int fails = Check (memcmp (direct, ringed, kFrames * 4) == 0, "ring doesn't match mixing straight out");
+		delete [] sound;
+		delete [] direct;
+		delete [] ringed;
+		return fails;
+	}
+
+	// Voices at once, mixed for 10 seconds through a ring into a .wav,
+	// as a game with no sound device would
+	static double Bench (int voices, bool resample, const short *sound, int frames)
+	{
+		Mixer mixer (voices);
+		for (int n=0; n < voices; n++) {
+			int v = mixer.Play (NULL, sound + Rand (0, frames / 2), frames / 2, 1, MIXER_RATE);
+			mixer.Set (v, RandF (0.1f, 0.5f), RandF (0.1f, 0.5f), resample ? RandF (0.5f, 2.0f) : 1.0f);
+			mixer.SetLoop (v, true);
+		}
+
+		MixerRing ring (MIXER_RATE / 10);
+		MixerWavSink sink;
+		sink.Open ("mixtest.wav", MIXER_RATE);
+		short chunk[2*1024];
+		double start = Seconds ();
+		while (sink.GetFrames () < MIXER_RATE * 10) {
+			ring.Fill (mixer, ring.GetFree ());
+			int got;
+			while ((got = ring.Read (chunk, 1024)) > 0) sink.Write (chunk, got);
+		}
+		double secs = Seconds () - start;
+		sink.Close ();
+		remove ("mixtest.wav");
+		return secs;
+	}
+
+	// 10 s of a level at 60 ticks a second: a couple of arrows spawn
+	// most ticks, and every 2 s a wave of 500 at once. Each spawn
+	// triggers one of 5 half second sounds. Times the triggers and the
+	// mixing, throttled or not
+	static void BenchBurst (bool throttle)
+	{
+		const int kSounds = 5, kFrames = MIXER_RATE / 2, kTick = MIXER_RATE / 60;
+		short *sounds = new short[kSounds * kFrames], *out = new short[kTick * 2];
+		for (int n=0; n < kSounds * kFrames; n++) sounds[n] = (short) Rand (-8000, 8000);
+
+		Mixer mixer (1024);
+		if (!throttle) mixer.SetThrottle (0, 1024);
+		int triggers = 0, most = 0;
+		srand (99);
+		double start = Seconds ();
+		for (int tick=0; tick < 600; tick++) {
+			int spawns = (tick % 120 == 60) ? 500 : Rand (0, 2);
+			for (int n=0; n < spawns; n++, triggers++) {
+				int s = Rand (0, kSounds - 1);
+				mixer.Trigger (sounds + s*kFrames, sounds + s*kFrames, kFrames, 1, MIXER_RATE, 0.3f, 0.3f, 1.0f);
+			}
+			if (mixer.GetNumPlaying () > most) most = mixer.GetNumPlaying ();
+			mixer.Mix (out, kTick);
+		}
+		double secs = Seconds () - start;
+		printf ("%-10s %8.1f ms  %5d triggers  %4d voices at most  %5d merged  %5d dropped\n", throttle ? "throttled" : "every one",
+				secs * 1000.0, triggers, most, mixer.GetMerged (), mixer.GetDropped ());
+		delete [] sounds;
+		delete [] out;
+	}
+
+	int main (void)
+	{
+		int best = BlendGetLevel (), fails = 0;
+		srand (1234);
+		if (best >= BLEND_SSE2) fails += TestKernels () + TestVoices () + TestThrottle () + TestRing ();
+		BlendSetLevel (BLEND_SCALAR);
+		fails += TestKernels () + TestVoices () + TestThrottle () + TestRing ();
+		printf ("%s: %d mismatches\n", fails ? "FAILED" : "OK", fails);
+
+		BlendSetLevel (best);
+		printf ("Spawn waves, 10 s of audio\n");
+		BenchBurst (false);
+		BenchBurst (true);
+
+		const int kFrames = MIXER_RATE * 2;
+		short *sound = new short[kFrames];
+		for (int n=0; n < kFrames; n++) sound[n] = (short) Rand (-20000, 20000);
+
+		const int counts[4] = { 16, 64, 256, 1024 };
+		printf ("10 s of output, ms to mix (voice-ms mixed per ms)\n");
+		printf ("voices   rate   scalar              sse2\n");
+		for (int c=0; c < 4; c++) {
+			for (int resample=0; resample < 2; resample++) {
+				printf ("%6d   %s", counts[c], resample ? "vary" : "1:1 ");
+				for (int level=0; level < 2; level++) {
+					if (level == 1 && best < BLEND_SSE2) continue;
+					BlendSetLevel (level ? BLEND_SSE2 : BLEND_SCALAR);
+					double secs = Bench (counts[c], resample != 0, sound, kFrames);
+					printf ("   %7.1f (%6.0f)", secs * 1000.0, counts[c] * 10000.0 / (secs * 1000.0));
+				}
+				printf ("\n");
+			}
+		}
+		delete [] sound;
+		return fails ? 1 : 0;
+	}
+
+#endif
@@ -0,0 +1,172 @@
+//
+// GameX - Sound Mixer Header
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#ifndef MIXER_DEF
+	#define MIXER_DEF
+
+	// #define MIXER_TESTER
+
+	// Mixes every playing sound in software into one stream of 16-bit
+	// stereo, so many sounds at once need one output buffer instead of
+	// one each. Sounds play on voices from a fixed pool; once it's full
+	// a new sound takes over the least important voice. Samples are
+	// summed as floats, SSE2 doing 8 at a time, and clamped back to 16
+	// bits at the end. Like the blend kernels this has no DirectX or
+	// Windows in it, so it also runs headless into a .wav file.
+
+	#include "gamex-blend.hpp"
+
+	#include <stdio.h>
+
+	#define MIXER_VOICES		32			// Default size of the voice pool
+	#define MIXER_RATE			44100		// Output frames per second
+	#define MIXER_BLOCK			256			// Frames mixed per pass
+	#define MIXER_ONE			65536		// Positions and steps are fixed point, this is 1 frame
+	#define MIXER_WINDOW		(MIXER_RATE/20)	// Default throttle: triggers this many frames apart merge
+	#define MIXER_COPIES		4			// and a key has no more voices than this
+
+	// Frames made as they're wanted rather than held in memory, such as
+	// music read off disk a piece at a time
+	class MixerSource {
+	public:
+		virtual ~MixerSource () {}
+
+		// Takes up to 'frames' frames at the mixer's rate. Returns how
+		// many; fewer if it has run short for now, or -1 once it's ended
+		virtual int Read (short *dst, int frames) = 0;
+	};
+
+	class MixerVoice {
+	public:
+		const void *key;						// Whoever started it; playing the same key again reuses the voice
+		const short *data;						// 16-bit samples, 'channels' to a frame
+		MixerSource *source;					// or where they come from, if streamed
+		int frames, channels, rate;
+		int pos, frac;							// Frame it's at, and MIXER_ONEths of the way to the next
+		int step;								// Source frames per output frame, fixed point
+		float gain[2];							// Left, right
+		int priority;
+		XBYTE4 order;							// When it started, for breaking ties
+		XBYTE4 start;							// The mixer's time when it started
+		bool loop, active;
+	};
+
+	class Mixer {
+	public:
+		Mixer (int voices = MIXER_VOICES, int rate = MIXER_RATE);
+		~Mixer ();
+
+		// Starts 'frames' frames of 16-bit mono or stereo recorded at
+		// 'rate' frames a second, at full volume and played once. Returns
+		// the voice, or -1 if all are busy with more important sounds.
+		// A key that's already playing gets its own voice, restarted.
+		// The data must stay put until the voice is done with it
+		int Play (const void *key, const short *data, int frames, int channels, int rate, int priority = 0);
+
+		// Play for sounds that get started in bursts, such as one for
+		// each of a crowd of things. Each trigger of a key starts another
+		// copy alongside those playing, unless a copy started within the
+		// throttle's window (the trigger merges into it, which keeps the
+		// louder gains) or the key has as many copies as it may (the
+		// trigger is dropped). Returns the voice, or -1 if dropped
+		int Trigger (const void *key, const short *data, int frames, int channels, int rate,
+					 float left, float right, float freq, int priority = 0);
+
+		// Plays frames from a source for as long as it has them, at full
+		// volume. The source must be at the mixer's rate, and stay put
+		// until the voice is stopped or the source ends. Set's freq and
+		// SetLoop are the source's business. Returns the voice
+		int Stream (const void *key, MixerSource *source, int channels, int priority = 0);
+		void SetThrottle (int window, int copies);				// window is in output frames
+
+		int Find (const void *key);								// Voice playing for key, or -1
+		int Count (const void *key);							// Voices playing for key
+		void Set (int voice, float left, float right, float freq);	// freq is relative to the sound's own rate
+		void SetLoop (int voice, bool loop);
+		void Rewind (int voice);
+		void Stop (int voice);
+		void StopAll (void);
+		bool IsPlaying (int voice);
+		float GetGain (int voice);								// The louder of left and right
+
+		int GetNumPlaying (void);
+		inline int GetNumVoices (void)	{ return m_num_voices; }
+		inline int GetRate (void)		{ return m_rate; }
+		inline int GetStolen (void)		{ return m_stolen; }	// Voices taken from sounds still playing
+		inline int GetMerged (void)		{ return m_merged; }	// Triggers merged into a copy just started
+		inline int GetDropped (void)	{ return m_dropped; }	// Triggers that found too many copies playing
+		inline XBYTE4 GetTime (void)	{ return m_time; }		// Frames mixed so far
+
+		// Mixes the next 'frames' frames of every voice into dst, as
+		// interleaved left and right, and moves them along
+		void Mix (short *dst, int frames);
+
+	private:
+		int Allocate (const void *key, int priority, bool reuse);
+		void Start (int voice, const void *key, const short *data, int frames, int channels, int rate, int priority);
+		void MixVoice (MixerVoice &v, float *acc, int frames);
+		void Skip (MixerVoice &v, int frames);
+
+		MixerVoice *m_voices;
+		int m_num_voices, m_rate;
+		XBYTE4 m_order, m_time;
+		int m_stolen, m_merged, m_dropped;
+		int m_window, m_copies;
+		float m_acc[MIXER_BLOCK*2];
+		short m_tmp[MIXER_BLOCK*2];					// A voice's frames, resampled
+	};
+
+	// Mixed frames waiting to be played, for output that takes them at
+	// its own pace
+	class MixerRing {
+	public:
+		MixerRing (int frames);
+		~MixerRing ();
+
+		int Fill (Mixer &mixer, int frames);		// Mixes up to 'frames' more into the free space; returns how many
+		int Read (short *dst, int frames);			// Takes up to 'frames' of the oldest; returns how many
+
+		inline int GetAvail (void)		{ return m_count; }
+		inline int GetFree (void)		{ return m_size - m_count; }
+
+	private:
+		short *m_buf;
+		int m_size, m_read, m_count;
+	};
+
+	// Writes 16-bit stereo to a .wav file, for running with no sound
+	// device. The sizes in the header are filled in by Close
+	class MixerWavSink {
+	public:
+		MixerWavSink ();
+		~MixerWavSink ();
+
+		bool Open (const char *filename, int rate);
+		void Write (const short *frames, int count);
+		void Close (void);
+
+		inline int GetFrames (void)		{ return m_frames; }
+
+	private:
+		FILE *m_fp;
+		int m_frames;
+	};
+
+	// acc += src * gain, with mono src going to both sides. acc is
+	// interleaved left and right, 'frames' pairs of it
+	void MixerAdd16 (float *acc, const short *src, int frames, int channels, float left, float right);
+	void MixerAdd16Ref (float *acc, const short *src, int frames, int channels, float left, float right);
+
+	// 'count' floats, clamped and cut to 16 bits
+	void MixerClamp16 (short *dst, const float *acc, int count);
+	void MixerClamp16Ref (short *dst, const float *acc, int count);
+
+#endif
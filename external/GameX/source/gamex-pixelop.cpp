@@ -0,0 +1,925 @@
+//
+// GameX - Pixel Operations Code
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#include "gamex-pixelop.hpp"
+#include "gamex-thread.hpp"
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define PIXELOP_HAS_SSE2
+	#include <emmintrin.h>
+#endif
+
+#ifdef __GNUC__
+	#define PIXELOP_SSE2_FUNC	__attribute__ ((target ("sse2")))
+#else
+	#define PIXELOP_SSE2_FUNC
+#endif
+
+static inline int PixelClamp (int v)		{ return (v < 0) ? 0 : ((v > 255) ? 255 : v); }
+
+// Channel c (0,1,2,3 = b,g,r,a) of a pixel
+static inline int PixelChan (XBYTE4 p, int c)	{ return (int) ((p >> (c*8)) & 0xFF); }
+
+static inline XBYTE4 PixelPack (int b, int g, int r, int a)
+{
+	return ((XBYTE4) a << 24) | ((XBYTE4) r << 16) | ((XBYTE4) g << 8) | (XBYTE4) b;
+}
+
+//-------------------------------------------------------- PixelOp
+
+PixelOp::PixelOp (void)
+{
+	mask_min = 0;
+	mask_keep = 0xFFFFFFFF;
+	mask_set = 0;
+}
+
+void PixelOp::SetMask (int rmin, int gmin, int bmin, XBYTE4 keep, XBYTE4 set)
+{
+	mask_min = PixelPack (PixelClamp (bmin), PixelClamp (gmin), PixelClamp (rmin), 0);
+	mask_keep = keep;
+	mask_set = set;
+}
+
+static inline bool PixelMasked (XBYTE4 p, XBYTE4 min)
+{
+	return (p & 0xFF0000) < (min & 0xFF0000) && (p & 0xFF00) < (min & 0xFF00) && (p & 0xFF) < (min & 0xFF);
+}
+
+XBYTE4 PixelOp::Mask (XBYTE4 src, XBYTE4 res)
+{
+	if (PixelMasked (src, mask_min)) return src;
+	if (PixelMasked (res, mask_min)) return (res & mask_keep) | mask_set;
+	return res;
+}
+
+//-------------------------------------------------------- SSE2 helpers (4 pixels)
+
+#ifdef PIXELOP_HAS_SSE2
+
+// Keep a where sel is set, b elsewhere
+PIXELOP_SSE2_FUNC static inline __m128i SelectSSE2 (__m128i sel, __m128i a, __m128i b)
+{
+	return _mm_or_si128 (_mm_and_si128 (sel, a), _mm_andnot_si128 (sel, b));
+}
+
+// All ones for the pixels whose b, g and r are below min. Alpha's
+// minimum is 0, so its byte always compares as not below
+PIXELOP_SSE2_FUNC static inline __m128i MaskedSSE2 (__m128i p, __m128i min)
+{
+	__m128i ge = _mm_cmpeq_epi8 (_mm_max_epu8 (p, min), p);
+	return _mm_cmpeq_epi32 (ge, _mm_set1_epi32 ((int) 0xFF000000));
+}
+
+class PixelMaskSSE2 {
+public:
+	PIXELOP_SSE2_FUNC PixelMaskSSE2 (XBYTE4 min, XBYTE4 keep, XBYTE4 set)
+	{
+		m_min = _mm_set1_epi32 ((int) min);
+		m_keep = _mm_set1_epi32 ((int) keep);
+		m_set = _mm_set1_epi32 ((int) set);
+	}
+
+	// The vector PixelOp::Mask
+	PIXELOP_SSE2_FUNC inline __m128i Apply (__m128i src, __m128i res) const
+	{
+		__m128i fix = _mm_or_si128 (_mm_and_si128 (res, m_keep), m_set);
+		res = SelectSSE2 (MaskedSSE2 (res, m_min), fix, res);
+		return SelectSSE2 (MaskedSSE2 (src, m_min), src, res);
+	}
+
+private:
+	__m128i m_min, m_keep, m_set;
+};
+
+// Four pixels to one vector of 32-bit ints per channel
+PIXELOP_SSE2_FUNC static inline void SplitSSE2 (__m128i p, __m128i c[4])
+{
+	__m128i byte = _mm_set1_epi32 (0xFF);
+	c[0] = _mm_and_si128 (p, byte);
+	c[1] = _mm_and_si128 (_mm_srli_epi32 (p, 8), byte);
+	c[2] = _mm_and_si128 (_mm_srli_epi32 (p, 16), byte);
+	c[3] = _mm_srli_epi32 (p, 24);
+}
+
+// Back to four pixels, each channel clamped to 0..255 by the packs
+PIXELOP_SSE2_FUNC static inline __m128i MergeSSE2 (const __m128i c[4])
+{
+	__m128i v = _mm_packus_epi16 (_mm_packs_epi32 (c[0], c[2]), _mm_packs_epi32 (c[1], c[3]));	// b0-3 r0-3 g0-3 a0-3
+	v = _mm_unpacklo_epi8 (v, _mm_srli_si128 (v, 8));												// b g b g ... r a r a
+	return _mm_unpacklo_epi16 (v, _mm_srli_si128 (v, 8));
+}
+
+#endif
+
+//-------------------------------------------------------- PixelLevels
+
+PixelLevels::PixelLevels (const float contrast[4], const int offset[4])
+{
+	for (int c=0; c < 4; c++) {
+		m_contrast[c] = contrast[c];
+		m_offset[c] = offset[c];
+	}
+}
+
+void PixelLevels::RowRef (XBYTE4 *row, int, int count)
+{
+	for (int x=0; x < count; x++) {
+		XBYTE4 p = row[x];
+		int v[4];
+		for (int c=0; c < 4; c++) v[c] = PixelClamp ((int) ((float) PixelChan (p, c) * m_contrast[c]) + m_offset[c]);
+		row[x] = Mask (p, PixelPack (v[0], v[1], v[2], v[3]));
+	}
+}
+
+#ifdef PIXELOP_HAS_SSE2
+PIXELOP_SSE2_FUNC static int PixelLevelsSSE2 (XBYTE4 *row, int count, const float contrast[4], const int offset[4], XBYTE4 mask_min, XBYTE4 mask_keep, XBYTE4 mask_set)
+{
+	PixelMaskSSE2 mask (mask_min, mask_keep, mask_set);
+	__m128 k[4];
+	__m128i off[4];
+	for (int c=0; c < 4; c++) {
+		k[c] = _mm_set1_ps (contrast[c]);
+		off[c] = _mm_set1_epi32 (offset[c]);
+	}
+	int n = 0;
+	for (; n + 4 <= count; n += 4) {
+		__m128i p = _mm_loadu_si128 ((__m128i *) (row + n));
+		__m128i ch[4];
+		SplitSSE2 (p, ch);
+		for (int c=0; c < 4; c++)
+			ch[c] = _mm_add_epi32 (_mm_cvttps_epi32 (_mm_mul_ps (_mm_cvtepi32_ps (ch[c]), k[c])), off[c]);
+		_mm_storeu_si128 ((__m128i *) (row + n), mask.Apply (p, MergeSSE2 (ch)));
+	}
+	return n;
+}
+#endif
+
+void PixelLevels::Row (XBYTE4 *row, int y, int count)
+{
+	int n = 0;
+	#ifdef PIXELOP_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2)
+			n = PixelLevelsSSE2 (row, count, m_contrast, m_offset, mask_min, mask_keep, mask_set);
+	#endif
+	RowRef (row + n, y, count - n);
+}
+
+//-------------------------------------------------------- PixelSaturate
+
+PixelSaturate::PixelSaturate (float sat_r, float sat_g, float sat_b, float lum_r, float lum_g, float lum_b)
+{
+	m_sat[0] = sat_b;	m_sat[1] = sat_g;	m_sat[2] = sat_r;
+	m_lum[0] = lum_b;	m_lum[1] = lum_g;	m_lum[2] = lum_r;
+	for (int c=0; c < 3; c++) m_gray[c] = 1.0f - m_sat[c];
+}
+
+// Done in floats the way ImageX always did it, so the vector version
+// matches as long as the compiler keeps floats in single precision
+void PixelSaturate::RowRef (XBYTE4 *row, int, int count)
+{
+	for (int x=0; x < count; x++) {
+		XBYTE4 p = row[x];
+		float f[3];
+		for (int c=0; c < 3; c++) f[c] = (float) PixelChan (p, c) / 255.0f;
+		float gray = f[2]*m_lum[2] + f[1]*m_lum[1] + f[0]*m_lum[0];
+		int v[3];
+		for (int c=0; c < 3; c++) v[c] = PixelClamp ((int) ((f[c]*m_sat[c] + gray*m_gray[c]) * 255.0f));
+		row[x] = Mask (p, PixelPack (v[0], v[1], v[2], PixelChan (p, 3)));
+	}
+}
+
+#ifdef PIXELOP_HAS_SSE2
+PIXELOP_SSE2_FUNC static int PixelSaturateSSE2 (XBYTE4 *row, int count, const float sat[3], const float gray_mix[3], const float lum[3], XBYTE4 mask_min, XBYTE4 mask_keep, XBYTE4 mask_set)
+{
+	PixelMaskSSE2 mask (mask_min, mask_keep, mask_set);
+	__m128 s[3], g[3], l[3];
+	for (int c=0; c < 3; c++) {
+		s[c] = _mm_set1_ps (sat[c]);
+		g[c] = _mm_set1_ps (gray_mix[c]);
+		l[c] = _mm_set1_ps (lum[c]);
+	}
+	__m128 full = _mm_set1_ps (255.0f);
+	int n = 0;
+	for (; n + 4 <= count; n += 4) {
+		__m128i p = _mm_loadu_si128 ((__m128i *) (row + n));
+		__m128i ch[4];
+		__m128 f[3];
+		SplitSSE2 (p, ch);
+		for (int c=0; c < 3; c++) f[c] = _mm_div_ps (_mm_cvtepi32_ps (ch[c]), full);
+		__m128 gray = _mm_add_ps (_mm_add_ps (_mm_mul_ps (f[2], l[2]), _mm_mul_ps (f[1], l[1])), _mm_mul_ps (f[0], l[0]));
+		for (int c=0; c < 3; c++)
+			ch[c] = _mm_cvttps_epi32 (_mm_mul_ps (_mm_add_ps (_mm_mul_ps (f[c], s[c]), _mm_mul_ps (gray, g[c])), full));
+		_mm_storeu_si128 ((__m128i *) (row + n), mask.Apply (p, MergeSSE2 (ch)));
+	}
+	return n;
+}
+#endif
+
+void PixelSaturate::Row (XBYTE4 *row, int y, int count)
+{
+	int n = 0;
+	#ifdef PIXELOP_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2)
+			n = PixelSaturateSSE2 (row, count, m_sat, m_gray, m_lum, mask_min, mask_keep, mask_set);
+	#endif
+	RowRef (row + n, y, count - n);
+}
+
+//-------------------------------------------------------- PixelInvert
+
+void PixelInvert::RowRef (XBYTE4 *row, int, int count)
+{
+	for (int x=0; x < count; x++) row[x] = Mask (row[x], row[x] ^ 0x00FFFFFF);
+}
+
+#ifdef PIXELOP_HAS_SSE2
+PIXELOP_SSE2_FUNC static int PixelInvertSSE2 (XBYTE4 *row, int count, XBYTE4 mask_min, XBYTE4 mask_keep, XBYTE4 mask_set)
+{
+	PixelMaskSSE2 mask (mask_min, mask_keep, mask_set);
+	__m128i rgb = _mm_set1_epi32 (0x00FFFFFF);
+	int n = 0;
+	for (; n + 4 <= count; n += 4) {
+		__m128i p = _mm_loadu_si128 ((__m128i *) (row + n));
+		_mm_storeu_si128 ((__m128i *) (row + n), mask.Apply (p, _mm_xor_si128 (p, rgb)));
+	}
+	return n;
+}
+#endif
+
+void PixelInvert::Row (XBYTE4 *row, int y, int count)
+{
+	int n = 0;
+	#ifdef PIXELOP_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2)
+			n = PixelInvertSSE2 (row, count, mask_min, mask_keep, mask_set);
+	#endif
+	RowRef (row + n, y, count - n);
+}
+
+//-------------------------------------------------------- PixelSwap
+
+PixelSwap::PixelSwap (int from_b, int from_g, int from_r)
+{
+	m_from[0] = from_b % 3;
+	m_from[1] = from_g % 3;
+	m_from[2] = from_r % 3;
+}
+
+void PixelSwap::RowRef (XBYTE4 *row, int, int count)
+{
+	for (int x=0; x < count; x++) {
+		XBYTE4 p = row[x];
+		row[x] = Mask (p, PixelPack (PixelChan (p, m_from[0]), PixelChan (p, m_from[1]), PixelChan (p, m_from[2]), PixelChan (p, 3)));
+	}
+}
+
+#ifdef PIXELOP_HAS_SSE2
+PIXELOP_SSE2_FUNC static int PixelSwapSSE2 (XBYTE4 *row, int count, const int from[3], XBYTE4 mask_min, XBYTE4 mask_keep, XBYTE4 mask_set)
+{
+	PixelMaskSSE2 mask (mask_min, mask_keep, mask_set);
+	__m128i alpha = _mm_set1_epi32 ((int) 0xFF000000);
+	int n = 0;
+	for (; n + 4 <= count; n += 4) {
+		__m128i p = _mm_loadu_si128 ((__m128i *) (row + n));
+		__m128i ch[4];
+		SplitSSE2 (p, ch);
+		__m128i res = _mm_or_si128 (_mm_and_si128 (p, alpha), ch[from[0]]);
+		res = _mm_or_si128 (res, _mm_slli_epi32 (ch[from[1]], 8));
+		res = _mm_or_si128 (res, _mm_slli_epi32 (ch[from[2]], 16));
+		_mm_storeu_si128 ((__m128i *) (row + n), mask.Apply (p, res));
+	}
+	return n;
+}
+#endif
+
+void PixelSwap::Row (XBYTE4 *row, int y, int count)
+{
+	int n = 0;
+	#ifdef PIXELOP_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2)
+			n = PixelSwapSSE2 (row, count, m_from, mask_min, mask_keep, mask_set);
+	#endif
+	RowRef (row + n, y, count - n);
+}
+
+//-------------------------------------------------------- PixelNoise
+
+// The numbers are four xorshift32 generators, one per pixel of a group
+// of four, each stepped once per channel. The top 16 bits scaled by the
+// span give 0 to span-1, which is what the vector code gets from mulhi
+
+PixelNoise::PixelNoise (const int noise[4], XBYTE4 seed)
+{
+	for (int c=0; c < 4; c++) {
+		int n = noise[c];
+		if (n > 32767) n = 32767;
+		if (n < -32767) n = -32767;
+		m_low[c] = (n > 0) ? -n : n;
+		m_span[c] = (n > 0) ? n*2 + 1 : 1 - n;
+	}
+	m_seed = seed;
+}
+
+// Murmur3's finalizer, to spread the seed and row over the generators
+static inline XBYTE4 PixelHash (XBYTE4 h)
+{
+	h ^= h >> 16;	h *= 0x85EBCA6B;
+	h ^= h >> 13;	h *= 0xC2B2AE35;
+	h ^= h >> 16;
+	return h;
+}
+
+static inline XBYTE4 PixelXorshift (XBYTE4 s)
+{
+	s ^= s << 13;
+	s ^= s >> 17;
+	s ^= s << 5;
+	return s;
+}
+
+void PixelNoise::Start (int y, XBYTE4 state[4])
+{
+	XBYTE4 h = m_seed ^ ((XBYTE4) y * 0x9E3779B9);
+	for (int l=0; l < 4; l++) {
+		state[l] = PixelHash (h + (XBYTE4) l * 0x632BE5AB);
+		if (state[l] == 0) state[l] = 0x6D2B79F5;		// xorshift sticks at 0
+	}
+}
+
+// Up to four pixels
+void PixelNoise::Block (XBYTE4 *p, int count, XBYTE4 state[4])
+{
+	int add[4][4];
+	for (int c=0; c < 4; c++)
+		for (int l=0; l < 4; l++) {
+			state[l] = PixelXorshift (state[l]);
+			add[l][c] = m_low[c] + (int) (((state[l] >> 16) * (XBYTE4) m_span[c]) >> 16);
+		}
+	for (int l=0; l < count; l++) {
+		int v[4];
+		for (int c=0; c < 4; c++) v[c] = PixelClamp (PixelChan (p[l], c) + add[l][c]);
+		p[l] = Mask (p[l], PixelPack (v[0], v[1], v[2], v[3]));
+	}
+}
+
+void PixelNoise::RowRef (XBYTE4 *row, int y, int count)
+{
+	XBYTE4 state[4];
+	Start (y, state);
+	for (int n=0; n < count; n += 4) Block (row + n, (count - n < 4) ? count - n : 4, state);
+}
+
+#ifdef PIXELOP_HAS_SSE2
+PIXELOP_SSE2_FUNC static int PixelNoiseSSE2 (XBYTE4 *row, int count, XBYTE4 state[4], const int low[4], const int span[4], XBYTE4 mask_min, XBYTE4 mask_keep, XBYTE4 mask_set)
+{
+	PixelMaskSSE2 mask (mask_min, mask_keep, mask_set);
+	__m128i s = _mm_loadu_si128 ((__m128i *) state);
+	__m128i lo[4], sp[4];
+	for (int c=0; c < 4; c++) {
+		lo[c] = _mm_set1_epi32 (low[c]);
+		sp[c] = _mm_set1_epi32 (span[c]);		// At most 65535, so the top halves stay 0
+	}
+	int n = 0;
+	for (; n + 4 <= count; n += 4) {
+		__m128i p = _mm_loadu_si128 ((__m128i *) (row + n));
+		__m128i ch[4];
+		SplitSSE2 (p, ch);
+		for (int c=0; c < 4; c++) {
+			s = _mm_xor_si128 (s, _mm_slli_epi32 (s, 13));
+			s = _mm_xor_si128 (s, _mm_srli_epi32 (s, 17));
+			s = _mm_xor_si128 (s, _mm_slli_epi32 (s, 5));
+			__m128i r = _mm_mulhi_epu16 (_mm_srli_epi32 (s, 16), sp[c]);
+			ch[c] = _mm_add_epi32 (ch[c], _mm_add_epi32 (r, lo[c]));
+		}
+		_mm_storeu_si128 ((__m128i *) (row + n), mask.Apply (p, MergeSSE2 (ch)));
+	}
+	_mm_storeu_si128 ((__m128i *) state, s);
+	return n;
+}
+#endif
+
+void PixelNoise::Row (XBYTE4 *row, int y, int count)
+{
+	XBYTE4 state[4];
+	int n = 0;
+	Start (y, state);
+	#ifdef PIXELOP_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2)
+			n = PixelNoiseSSE2 (row, count, state, m_low, m_span, mask_min, mask_keep, mask_set);
+	#endif
+	for (; n < count; n += 4) Block (row + n, (count - n < 4) ? count - n : 4, state);
+}
+
+//-------------------------------------------------------- Running
+
+class PixelRowsJob : public ThreadJob {
+public:
+	PixelRows *work;
+	int y1, y2;
+	void Run (void)		{ work->Rows (y1, y2); }
+};
+
+// PixelOpRun's rows
+class PixelOpRows : public PixelRows {
+public:
+	PixelOp *op;
+	XBYTE4 *pixels;
+	int xres, pitch;
+	void Rows (int y1, int y2)	{ for (int y=y1; y < y2; y++) op->Row (pixels + y*pitch, y, xres); }
+};
+
+// Started the first time an image is big enough to split, and stopped
+// with the program. Image ops only run on the main thread, so creating
+// it needs no lock
+static ThreadPool *pixelop_pool = NULL;
+
+static class PixelOpPoolOwner {
+public:
+	~PixelOpPoolOwner ()	{ delete pixelop_pool; pixelop_pool = NULL; }
+} pixelop_pool_owner;
+
+void PixelRowsRun (PixelRows &work, int xres, int yres)
+{
+	if (xres <= 0 || yres <= 0) return;
+
+	if (xres * yres < PIXELOP_SPLIT || ThreadPool::GetNumProcessors () < 2) {
+		work.Rows (0, yres);
+		return;
+	}
+
+	if (pixelop_pool == NULL) pixelop_pool = new ThreadPool;
+
+	// A few bands per thread, so one slow band doesn't hold up the rest
+	int bands = pixelop_pool->GetNumThreads () * 4;
+	if (bands > yres) bands = yres;
+	PixelRowsJob *jobs = new PixelRowsJob[bands];
+	for (int n=0; n < bands; n++) {
+		jobs[n].work = &work;
+		jobs[n].y1 = yres * n / bands;
+		jobs[n].y2 = yres * (n+1) / bands;
+		pixelop_pool->AddJob (&jobs[n]);
+	}
+	pixelop_pool->Wait ();
+	delete [] jobs;
+}
+
+void PixelOpRun (PixelOp &op, XBYTE4 *pixels, int xres, int yres, int pitch)
+{
+	PixelOpRows rows;
+	rows.op = &op;
+	rows.pixels = pixels;
+	rows.xres = xres;
+	rows.pitch = pitch;
+	PixelRowsRun (rows, xres, yres);
+}
+
+#ifdef PIXELOP_TESTER
+
+	// Checks SSE2 against the references and the references against the
+	// old per-pixel ImageX loops, then times them all on a 4K image.
+	// Given the texture pack's .tga files, also times ConvertFormat's
+	// conversions over it. Builds off Windows:
+	//   g++ -O2 -DPIXELOP_TESTER gamex-pixelop.cpp gamex-blend.cpp gamex-thread.cpp -lpthread
+	//   ./a.out build/textures/*.tga
+
+	#include <stdio.h>
+	#include <stdlib.h>
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <sys/time.h>
+	#endif
+
+	#define TEST_RED_LUMINANCE		0.3086f				// gamex-defines.hpp's, which needs DirectX
+	#define TEST_GREEN_LUMINANCE	0.6094f
+	#define TEST_BLUE_LUMINANCE		0.0820f
+
+	static double Seconds (void)
+	{
+		#ifdef _WIN32
+			LARGE_INTEGER freq, now;
+			QueryPerformanceFrequency (&freq);
+			QueryPerformanceCounter (&now);
+			return (double) now.QuadPart / (double) freq.QuadPart;
+		#else
+			struct timeval tv;
+			gettimeofday (&tv, NULL);
+			return tv.tv_sec + tv.tv_usec / 1e6;
+		#endif
+	}
+
+	static int Rand (int lo, int hi)	{ return lo + rand () % (hi - lo + 1); }
+
+	// Random pixels, a quarter of them dark enough to fall under a mask
+	static void Fill32 (XBYTE4 *p, int count)
+	{
+		for (int n=0; n < count; n++) {
+			p[n] = (XBYTE4) rand () ^ ((XBYTE4) rand () << 16);
+			if (rand () % 4 == 0) p[n] &= 0xFF0F0F0F;
+		}
+	}
+
+	// The ops and their mask rules, the way ImageX sets them up
+	enum { OP_LEVELS, OP_SATURATE, OP_GRAY, OP_INVERT, OP_SWAP, OP_NOISE, OP_COUNT };
+	static const char *op_names[OP_COUNT] = { "levels", "saturate", "gray", "invert", "swap", "noise" };
+
+	static PixelOp *MakeOp (int kind, bool random, int rmin, int gmin, int bmin)
+	{
+		PixelOp *op = NULL;
+		bool blue_fix = false;
+		if (kind == OP_LEVELS) {
+			float contrast[4] = { 1.3f, 0.8f, 1.0f, 1.0f };
+			int offset[4] = { -20, 25, 7, 0 };
+			if (random)
+				for (int c=0; c < 4; c++) {
+					contrast[c] = Rand (0, 300) / 100.0f;
+					offset[c] = Rand (-300, 300);
+				}
+			op = new PixelLevels (contrast, offset);
+			blue_fix = true;
+		} else if (kind == OP_SATURATE || kind == OP_GRAY) {
+			float sat = (kind == OP_GRAY) ? 0.0f : 1.6f;
+			float sr = sat, sg = sat, sb = sat;
+			if (random) { sr = Rand (0, 300) / 100.0f; sg = Rand (0, 300) / 100.0f; sb = Rand (0, 300) / 100.0f; }
+			op = new PixelSaturate (sr, sg, sb, TEST_RED_LUMINANCE, TEST_GREEN_LUMINANCE, TEST_BLUE_LUMINANCE);
+		} else if (kind == OP_INVERT) {
+			op = new PixelInvert;
+		} else if (kind == OP_SWAP) {
+			int from[3] = { 1, 2, 0 };						// COLOR_SWAP_ROTATE120
+			if (random) for (int c=0; c < 3; c++) from[c] = Rand (0, 2);
+			op = new PixelSwap (from[0], from[1], from[2]);
+		} else {
+			int noise[4] = { 30, 30, 30, 0 };
+			if (random) for (int c=0; c < 4; c++) noise[c] = Rand (-300, 300);
+			op = new PixelNoise (noise, (XBYTE4) rand ());
+			blue_fix = true;
+		}
+		if (kind != OP_SWAP) {
+			if (blue_fix) op->SetMask (rmin, gmin, bmin, 0xFFFFFF00, PixelPack (bmin, 0, 0, 0));
+			else op->SetMask (rmin, gmin, bmin, 0xFF000000, PixelPack (bmin, gmin, rmin, 0));
+		}
+		return op;
+	}
+
+	static int Test (void)
+	{
+		const int kMax = 300;
+		XBYTE4 dst[kMax], ref[kMax];
+		int fails = 0;
+
+		BlendSetLevel (BLEND_SSE2);
+		for (int t=0; t < 20000; t++) {
+			int kind = t % OP_COUNT, count = Rand (0, kMax), y = Rand (0, 5000);
+			bool masked = (rand () % 2) == 0;
+			PixelOp *op = MakeOp (kind, true, masked ? Rand (1, 40) : 0, masked ? Rand (1, 40) : 0, masked ? Rand (1, 40) : 0);
+			Fill32 (dst, count);
+			memcpy (ref, dst, count<<2);
+			op->Row (dst, y, count);
+			op->RowRef (ref, y, count);
+			if (memcmp (dst, ref, count<<2) != 0) {
+				if (fails++ < 5) printf ("  %s differs (count %d)\n", op_names[kind], count);
+			}
+			delete op;
+		}
+		return fails;
+	}
+
+	//---------------------------------------- The old ImageX loops
+
+	// ImageX went through GameX's ReadPixel / DrawPixel function pointers
+	// for every pixel; these stand in for them over a plain buffer
+	static XBYTE4 *old_data;
+	static int old_pitch;
+
+	static void OldReadPixel32 (int x, int y, int &r, int &g, int &b, int &a)
+	{
+		XBYTE4 v = old_data[x + y*old_pitch];
+		a = v >> 24; r = (v >> 16) & 0xFF; g = (v >> 8) & 0xFF; b = v & 0xFF;
+	}
+
+	static void OldDrawPixel32 (int x, int y, int r, int g, int b, int a)
+	{
+		old_data[x + y*old_pitch] = (a << 24) + (r << 16) + (g << 8) + b;
+	}
+
+	static void (*ReadPixel) (int x, int y, int &r, int &g, int &b, int &a) = OldReadPixel32;
+	static void (*DrawPixel) (int x, int y, int r, int g, int b, int a) = OldDrawPixel32;
+
+	static void OldLevels (int xres, int yres, const int bright[4], const float contrast[4], int rmin, int gmin, int bmin)
+	{
+		int offset[4];
+		for (int c=0; c < 4; c++) offset[c] = bright[c] + (contrast[c] ? (int) (255.0f*(1.0f - contrast[c])/2.0f) : 0);
+		for (int y=0; y < yres; y++)
+			for (int x=0; x < xres; x++) {
+				int r,g,b,a;
+				ReadPixel (x,y,r,g,b,a);
+				if (r<rmin && g<gmin && b<bmin) continue;
+				if (contrast[2] != 1.0f) r = (int) ((float) r * contrast[2]);
+				if (contrast[1] != 1.0f) g = (int) ((float) g * contrast[1]);
+				if (contrast[0] != 1.0f) b = (int) ((float) b * contrast[0]);
+				if (contrast[3] != 1.0f) a = (int) ((float) a * contrast[3]);
+				r += offset[2]; g += offset[1]; b += offset[0]; a += offset[3];
+				r = PixelClamp (r); g = PixelClamp (g); b = PixelClamp (b); a = PixelClamp (a);
+				if (r<rmin && g<gmin && b<bmin) b = bmin;
+				DrawPixel (x,y,r,g,b,a);
+			}
+	}
+
+	static void OldSaturate (int xres, int yres, float sat, int rmin, int gmin, int bmin)
+	{
+		for (int y=0; y < yres; y++)
+			for (int x=0; x < xres; x++) {
+				int r,g,b,a;
+				ReadPixel (x,y,r,g,b,a);
+				if (r<rmin && g<gmin && b<bmin) continue;
+				float red = (float) r/255.0f, green = (float) g/255.0f, blue = (float) b/255.0f;
+				float gray = red*TEST_RED_LUMINANCE + green*TEST_GREEN_LUMINANCE + blue*TEST_BLUE_LUMINANCE;
+				red = (red*sat + gray*(1.0f-sat));
+				green = (green*sat + gray*(1.0f-sat));
+				blue = (blue*sat + gray*(1.0f-sat));
+				r = PixelClamp ((int) (red*255.0f)); g = PixelClamp ((int) (green*255.0f)); b = PixelClamp ((int) (blue*255.0f));
+				if (r<rmin && g<gmin && b<bmin) { r = rmin; g = gmin; b = bmin; }
+				DrawPixel (x,y,r,g,b,a);
+			}
+	}
+
+	static void OldInvert (int xres, int yres, int rmin, int gmin, int bmin)
+	{
+		for (int y=0; y < yres; y++)
+			for (int x=0; x < xres; x++) {
+				int r,g,b,a;
+				ReadPixel (x,y,r,g,b,a);
+				if (r<rmin && g<gmin && b<bmin) continue;
+				if (r>255-rmin && g>255-gmin && b>255-bmin) { r = 255-rmin; g = 255-gmin; b = 255-bmin; }
+				DrawPixel (x,y,255-r,255-g,255-b,a);
+			}
+	}
+
+	static void OldSwap (int xres, int yres)				// COLOR_SWAP_ROTATE120
+	{
+		for (int y=0; y < yres; y++)
+			for (int x=0; x < xres; x++) {
+				int r,g,b,a;
+				ReadPixel (x,y,r,g,b,a);
+				if (r == 0 && g == 0 && b == 0) continue;
+				DrawPixel (x,y,b,r,g,a);
+			}
+	}
+
+	static void OldNoise (int xres, int yres, int noise, int rmin, int gmin, int bmin)
+	{
+		for (int y=0; y < yres; y++)
+			for (int x=0; x < xres; x++) {
+				int r,g,b,a;
+				ReadPixel (x,y,r,g,b,a);
+				if (r<rmin && g<gmin && b<bmin) continue;
+				r += -noise + rand () % (noise*2 + 1);
+				g += -noise + rand () % (noise*2 + 1);
+				b += -noise + rand () % (noise*2 + 1);
+				r = PixelClamp (r); g = PixelClamp (g); b = PixelClamp (b);
+				if (r<rmin && g<gmin && b<bmin) b = bmin;
+				DrawPixel (x,y,r,g,b,a);
+			}
+	}
+
+	// The same default ops as MakeOp, the old way
+	static void RunOld (int kind, XBYTE4 *pixels, int xres, int yres, int rmin, int gmin, int bmin)
+	{
+		const int bright[4] = { -20, 25, 7, 0 };
+		float contrast[4] = { 1.3f, 0.8f, 1.0f, 1.0f };
+		int bright_in[4];
+		for (int c=0; c < 4; c++) bright_in[c] = bright[c] - ((contrast[c] != 0.0f) ? (int) (255.0f*(1.0f - contrast[c])/2.0f) : 0);
+		old_data = pixels;
+		old_pitch = xres;
+		switch (kind) {
+			case OP_LEVELS:   OldLevels (xres, yres, bright_in, contrast, rmin, gmin, bmin); break;
+			case OP_SATURATE: OldSaturate (xres, yres, 1.6f, rmin, gmin, bmin); break;
+			case OP_GRAY:     OldSaturate (xres, yres, 0.0f, rmin, gmin, bmin); break;
+			case OP_INVERT:   OldInvert (xres, yres, rmin, gmin, bmin); break;
+			case OP_SWAP:     OldSwap (xres, yres); break;
+			case OP_NOISE:    OldNoise (xres, yres, 30, rmin, gmin, bmin); break;
+		}
+	}
+
+	// Everything but the noise must come out exactly as it used to
+	static int TestOld (void)
+	{
+		const int kWidth = 257, kHeight = 64, rmin = 8, gmin = 8, bmin = 8;
+		XBYTE4 *img = new XBYTE4[kWidth*kHeight], *ref = new XBYTE4[kWidth*kHeight];
+		int fails = 0;
+		for (int kind=0; kind < OP_NOISE; kind++) {
+			Fill32 (img, kWidth*kHeight);
+			memcpy (ref, img, kWidth*kHeight*4);
+			PixelOp *op = MakeOp (kind, false, rmin, gmin, bmin);
+			PixelOpRun (*op, img, kWidth, kHeight, kWidth);
+			RunOld (kind, ref, kWidth, kHeight, rmin, gmin, bmin);
+			if (memcmp (img, ref, kWidth*kHeight*4) != 0) {
+				fails++;
+				printf ("  %s differs from the old loop\n", op_names[kind]);
+			}
+			delete op;
+		}
+		delete [] img; delete [] ref;
+		return fails;
+	}
+
+	// Banding over threads must not change anything, noise included
+	static int TestThreads (XBYTE4 *card, int xres, int yres)
+	{
+		XBYTE4 *img = new XBYTE4[xres*yres], *ref = new XBYTE4[xres*yres];
+		int fails = 0;
+		for (int kind=0; kind < OP_COUNT; kind++) {
+			srand (kind);
+			PixelOp *op = MakeOp (kind, true, 8, 8, 8);
+			memcpy (img, card, xres*yres*4);
+			memcpy (ref, card, xres*yres*4);
+			PixelOpRun (*op, img, xres, yres, xres);
+			for (int y=0; y < yres; y++) op->Row (ref + y*xres, y, xres);
+			if (memcmp (img, ref, xres*yres*4) != 0) {
+				fails++;
+				printf ("  %s changes when threaded\n", op_names[kind]);
+			}
+			delete op;
+		}
+		delete [] img; delete [] ref;
+		return fails;
+	}
+
+	static void Bench (XBYTE4 *card, int xres, int yres, int best)
+	{
+		XBYTE4 *img = new XBYTE4[xres*yres];
+		const char *names[4] = { "old", "scalar", "sse2", "threads" };
+
+		printf ("%dx%d ms   ", xres, yres);
+		for (int kind=0; kind < OP_COUNT; kind++) printf ("%9s", op_names[kind]);
+		printf ("\n");
+		for (int way=0; way < 4; way++) {
+			if (way >= 2 && best < BLEND_SSE2) continue;
+			BlendSetLevel ((way >= 2) ? BLEND_SSE2 : BLEND_SCALAR);
+			printf ("%-14s", names[way]);
+			for (int kind=0; kind < OP_COUNT; kind++) {
+				PixelOp *op = MakeOp (kind, false, 8, 8, 8);
+				memcpy (img, card, xres*yres*4);
+				double start = Seconds ();
+				if (way == 0) RunOld (kind, img, xres, yres, 8, 8, 8);
+				else if (way == 3) PixelOpRun (*op, img, xres, yres, xres);
+				else for (int y=0; y < yres; y++) op->Row (img + y*xres, y, xres);
+				printf ("  %7.1f", (Seconds () - start) * 1000.0);
+				delete op;
+			}
+			printf ("\n");
+		}
+		delete [] img;
+	}
+
+	// ImageX::ConvertFormat's old per-pixel loops, for the pack timing.
+	// shifts are 32-bit screen ones, or 5-6-5 for a 16-bit target
+	static void ConvertOld (int kind, XBYTE *src, XBYTE *dst, XBYTE *alpha, int size)
+	{
+		XBYTE2 *p16 = (XBYTE2 *) src, *d16 = (XBYTE2 *) dst;
+		XBYTE4 *p32 = (XBYTE4 *) src, *d32 = (XBYTE4 *) dst;
+		for (int n=0; n < size; n++) {
+			if (kind == 0) {										// 16 to 32
+				int clr = *p16++;
+				int blue  = (((clr & 0x001F) >> 0 ) << 3);
+				int green = (((clr & 0x07E0) >> 5 ) << 2);
+				int red   = (((clr & 0xF800) >> 11) << 3);
+				*d32++ = (red << 16) + (green << 8) + (blue << 0);
+			} else if (kind == 1) {									// 32 to 16
+				int oldPixel = *p32++;
+				int red = ((oldPixel & 0x00FF0000) >> 16);
+				int green = ((oldPixel & 0x0000FF00) >> 8);
+				int blue = ((oldPixel & 0x000000FF) >> 0);
+				*d16++ = ((red >> 3) << 11) | ((green >> 2) << 5) | ((blue >> 3) << 0);
+			} else if (kind == 2) {									// 24 to 32
+				int newPixel = 0;
+				newPixel |= *src++ << 16;
+				newPixel |= *src++ << 8;
+				newPixel |= *src++ << 0;
+				*d32++ = newPixel;
+			} else if (kind == 3) {									// 24 to 16
+				*d16 = (*src++ >> 3) << 11;
+				*d16 |= (*src++ >> 2) << 5;
+				*d16++ |= (*src++ >> 3) << 0;
+			} else if (kind == 4) {									// alpha to mask
+				if (*p16 == 0) *p16 = 1;
+				if (alpha[n] < 16) *p16 = 0;
+				p16++;
+			} else {												// mask to alpha
+				alpha[n] = (*p16++ == 0) ? 0 : 255;
+			}
+		}
+	}
+
+	class PackRows : public PixelRows {
+	public:
+		BlendConverter *conv;
+		XBYTE *src, *dst, *alpha;
+		int kind, xres, src_bytes, dst_bytes;
+		void Rows (int y1, int y2) {
+			int count = (y2-y1)*xres;
+			if (kind == 4) BlendAlphaToMask16 ((XBYTE2 *) src + y1*xres, alpha + y1*xres, count);
+			else if (kind == 5) BlendMaskToAlpha16 (alpha + y1*xres, (XBYTE2 *) src + y1*xres, count);
+			else conv->Row (dst + y1*xres*dst_bytes, src + y1*xres*src_bytes, count);
+		}
+	};
+
+	// Times every conversion over the sizes of the .tga files given,
+	// the way UseWith runs them when the pack is loaded
+	static void BenchPack (int argc, char **argv, int best)
+	{
+		const int kPasses = 10;
+		const int froms[6] = { 16, 32, 24, 24, 16, 16 }, tos[6] = { 32, 16, 32, 16, 16, 16 };
+		const char *kinds[6] = { "16->32", "32->16", "24->32", "24->16", "a->mask", "mask->a" };
+		const char *names[4] = { "old", "scalar", "sse2", "threads" };
+		int xres[64], yres[64], files = 0, most = 0;
+		double pixels = 0.0;
+
+		for (int f=1; f < argc && files < 64; f++) {
+			XBYTE hdr[18];
+			FILE *fp = fopen (argv[f], "rb");
+			if (fp == NULL) continue;
+			if (fread (hdr, 1, 18, fp) == 18) {
+				xres[files] = hdr[12] | (hdr[13] << 8);
+				yres[files] = hdr[14] | (hdr[15] << 8);
+				if (xres[files] * yres[files] > most) most = xres[files] * yres[files];
+				pixels += (double) xres[files] * yres[files];
+				files++;
+			}
+			fclose (fp);
+		}
+		if (files == 0) {
+			printf ("pass the texture pack's .tga files to time a pack load\n");
+			return;
+		}
+
+		XBYTE *src = new XBYTE[most*4], *dst = new XBYTE[most*4], *alpha = new XBYTE[most];
+		for (int n=0; n < most*4; n++) src[n] = (XBYTE) rand ();
+		for (int n=0; n < most; n++) alpha[n] = (XBYTE) rand ();
+
+		printf ("pack of %d, %.1f MP, ms ", files, pixels / 1e6);
+		for (int kind=0; kind < 6; kind++) printf ("%9s", kinds[kind]);
+		printf ("\n");
+		for (int way=0; way < 4; way++) {
+			if (way >= 2 && best < BLEND_SSE2) continue;
+			BlendSetLevel ((way >= 2) ? BLEND_SSE2 : BLEND_SCALAR);
+			printf ("%-24s", names[way]);
+			for (int kind=0; kind < 6; kind++) {
+				int screen16 = (kind == 1 || kind == 3);
+				double start = Seconds ();
+				for (int pass=0; pass < kPasses; pass++)
+					for (int f=0; f < files; f++) {
+						int size = xres[f] * yres[f];
+						BlendConverter conv (froms[kind], tos[kind], screen16 ? 11 : 16, screen16 ? 5 : 8, 0);
+						if (way == 0) { ConvertOld (kind, src, dst, alpha, size); continue; }
+						PackRows rows;
+						rows.conv = &conv;
+						rows.src = src; rows.dst = dst; rows.alpha = alpha;
+						rows.kind = kind;
+						rows.xres = xres[f];
+						rows.src_bytes = froms[kind] / 8;
+						rows.dst_bytes = tos[kind] / 8;
+						if (way == 3) PixelRowsRun (rows, xres[f], yres[f]);
+						else rows.Rows (0, yres[f]);
+					}
+				printf ("  %7.2f", (Seconds () - start) * 1000.0 / kPasses);
+			}
+			printf ("\n");
+		}
+		delete [] src; delete [] dst; delete [] alpha;
+	}
+
+	int main (int argc, char **argv)
+	{
+		const int kWidth = 3840, kHeight = 2160;
+		int best = BlendGetLevel (), fails = 0;
+
+		srand (1234);
+		if (best >= BLEND_SSE2) fails += Test ();
+		BlendSetLevel (BLEND_SCALAR);
+		fails += TestOld ();
+
+		XBYTE4 *card = new XBYTE4[kWidth*kHeight];
+		Fill32 (card, kWidth*kHeight);
+		BlendSetLevel (best);
+		fails += TestThreads (card, kWidth, kHeight);
+		printf ("%s: %d mismatches, %d processors\n", fails ? "FAILED" : "OK", fails, ThreadPool::GetNumProcessors ());
+
+		Bench (card, kWidth, kHeight, best);
+		delete [] card;
+		BenchPack (argc, argv, best);
+		return fails ? 1 : 0;
+	}
+
+#endif
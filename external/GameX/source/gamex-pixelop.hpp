@@ -0,0 +1,124 @@
+//
+// GameX - Pixel Operations Header
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#ifndef PIXELOP_DEF
+	#define PIXELOP_DEF
+
+	// #define PIXELOP_TESTER
+
+	// Per-pixel image filters (brightness, saturation, invert, ...) run
+	// a row of 32-bit ARGB pixels at a time instead of one ReadPixel and
+	// DrawPixel per pixel. Like the blend kernels, each op has a scalar
+	// reference and an SSE2 version that must match it bit for bit, and
+	// the level comes from BlendGetLevel. Big images are cut into bands
+	// and handed to a thread pool.
+
+	#include "gamex-blend.hpp"
+
+	#define PIXELOP_SPLIT		65536		// Images with fewer pixels than this stay on one thread
+
+	// An operation on rows of pixels. Row must only touch the row it is
+	// given, since PixelOpRun may call it for several rows at once
+	class PixelOp {
+	public:
+		PixelOp (void);
+		virtual ~PixelOp ()			{}
+
+		virtual void Row (XBYTE4 *row, int y, int count) = 0;
+		virtual void RowRef (XBYTE4 *row, int y, int count) = 0;
+
+		// The LOAD_MASKED rule: pixels whose red, green and blue are all
+		// below the minimums are transparent and left alone. A result
+		// that would turn transparent keeps the bits in 'keep' and gets
+		// 'set' ORed in instead. Minimums of 0 turn the rule off
+		void SetMask (int rmin, int gmin, int bmin, XBYTE4 keep, XBYTE4 set);
+
+	protected:
+		XBYTE4 Mask (XBYTE4 src, XBYTE4 res);		// Apply the rule to one pixel
+
+		XBYTE4 mask_min;							// Minimums, packed as a pixel
+		XBYTE4 mask_keep, mask_set;
+	};
+
+	// Run op over xres x yres pixels, rows 'pitch' pixels apart
+	void PixelOpRun (PixelOp &op, XBYTE4 *pixels, int xres, int yres, int pitch);
+
+	// Any other work done a band of rows at a time, such as converting
+	// formats. Rows (y1, y2) does rows y1 up to y2 and may run on any
+	// thread, alongside other bands
+	class PixelRows {
+	public:
+		virtual ~PixelRows ()		{}
+		virtual void Rows (int y1, int y2) = 0;
+	};
+
+	// Split yres rows of xres pixels over the pool like PixelOpRun
+	void PixelRowsRun (PixelRows &work, int xres, int yres);
+
+	// c' = (int) (c * contrast) + offset, clamped. Per channel, in byte
+	// order (b,g,r,a)
+	class PixelLevels : public PixelOp {
+	public:
+		PixelLevels (const float contrast[4], const int offset[4]);
+		void Row (XBYTE4 *row, int y, int count);
+		void RowRef (XBYTE4 *row, int y, int count);
+	private:
+		float m_contrast[4];
+		int m_offset[4];
+	};
+
+	// Mix each of r,g,b with the pixel's luminance (weighted by lum_r,
+	// lum_g, lum_b); sat 0 is grayscale, 1 leaves the color alone and
+	// above 1 boosts it
+	class PixelSaturate : public PixelOp {
+	public:
+		PixelSaturate (float sat_r, float sat_g, float sat_b, float lum_r, float lum_g, float lum_b);
+		void Row (XBYTE4 *row, int y, int count);
+		void RowRef (XBYTE4 *row, int y, int count);
+	private:
+		float m_sat[3], m_gray[3], m_lum[3];		// sat, 1-sat and luminance, in byte order
+	};
+
+	// 255 - c for r, g and b
+	class PixelInvert : public PixelOp {
+	public:
+		void Row (XBYTE4 *row, int y, int count);
+		void RowRef (XBYTE4 *row, int y, int count);
+	};
+
+	// Moves r,g,b around: channel c of the result is channel from[c] of
+	// the source, with 0,1,2 = b,g,r
+	class PixelSwap : public PixelOp {
+	public:
+		PixelSwap (int from_b, int from_g, int from_r);
+		void Row (XBYTE4 *row, int y, int count);
+		void RowRef (XBYTE4 *row, int y, int count);
+	private:
+		int m_from[3];
+	};
+
+	// Adds a random amount to each channel: -n to n for n > 0, n to 0
+	// for n < 0. The numbers come from a seed and the row, not from
+	// rand(), so banding the image over threads gives the same result
+	class PixelNoise : public PixelOp {
+	public:
+		PixelNoise (const int noise[4], XBYTE4 seed);
+		void Row (XBYTE4 *row, int y, int count);
+		void RowRef (XBYTE4 *row, int y, int count);
+	private:
+		void Start (int y, XBYTE4 state[4]);
+		void Block (XBYTE4 *p, int count, XBYTE4 state[4]);
+
+		int m_low[4], m_span[4];					// Each channel adds low + [0, span)
+		XBYTE4 m_seed;
+	};
+
+#endif
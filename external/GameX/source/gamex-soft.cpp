@@ -0,0 +1,852 @@
+//
+// GameX - Software Renderer Code
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#include "gamex-soft.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define SOFT_DEGtoRAD		0.017453292519943f
+
+// 5x7 glyphs for ASCII 32-126, one byte per row, bit 4 is the left column
+static const unsigned char soft_font[95][7] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// space
+	{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 },	// !
+	{ 0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00 },	// "
+	{ 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A },	// #
+	{ 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04 },	// $
+	{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },	// %
+	{ 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D },	// &
+	{ 0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 },	// '
+	{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },	// (
+	{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },	// )
+	{ 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 },	// *
+	{ 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 },	// +
+	{ 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 },	// ,
+	{ 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },	// -
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },	// .
+	{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },	// /
+	{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },	// 0
+	{ 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },	// 1
+	{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },	// 2
+	{ 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },	// 3
+	{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },	// 4
+	{ 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },	// 5
+	{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },	// 6
+	{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },	// 7
+	{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },	// 8
+	{ 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },	// 9
+	{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },	// :
+	{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 },	// ;
+	{ 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },	// <
+	{ 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 },	// =
+	{ 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },	// >
+	{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },	// ?
+	{ 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E },	// @
+	{ 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },	// A
+	{ 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },	// B
+	{ 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },	// C
+	{ 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },	// D
+	{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },	// E
+	{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },	// F
+	{ 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },	// G
+	{ 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },	// H
+	{ 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },	// I
+	{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },	// J
+	{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },	// K
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },	// L
+	{ 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },	// M
+	{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },	// N
+	{ 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// O
+	{ 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },	// P
+	{ 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },	// Q
+	{ 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },	// R
+	{ 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },	// S
+	{ 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// T
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// U
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },	// V
+	{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },	// W
+	{ 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },	// X
+	{ 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 },	// Y
+	{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },	// Z
+	{ 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E },	// [
+	{ 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 },	// backslash
+	{ 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E },	// ]
+	{ 0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00 },	// ^
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F },	// _
+	{ 0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00 },	// `
+	{ 0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F },	// a
+	{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E },	// b
+	{ 0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E },	// c
+	{ 0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F },	// d
+	{ 0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E },	// e
+	{ 0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08 },	// f
+	{ 0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E },	// g
+	{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11 },	// h
+	{ 0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E },	// i
+	{ 0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C },	// j
+	{ 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 },	// k
+	{ 0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },	// l
+	{ 0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11 },	// m
+	{ 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 },	// n
+	{ 0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E },	// o
+	{ 0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10 },	// p
+	{ 0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01 },	// q
+	{ 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 },	// r
+	{ 0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E },	// s
+	{ 0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06 },	// t
+	{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D },	// u
+	{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04 },	// v
+	{ 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A },	// w
+	{ 0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11 },	// x
+	{ 0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E },	// y
+	{ 0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F },	// z
+	{ 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02 },	// {
+	{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// |
+	{ 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08 },	// }
+	{ 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00 },	// ~
+};
+
+// WindowsDX placement: the scaled image turns about its center. Gives the
+// inverse steps (screen offset from the center -> source pixels) and the
+// half extents of the turned image
+static void SoftRotation (SoftImage *img, float angle, float scale, float &ux, float &uy, float &vx, float &vy, float &ex, float &ey)
+{
+	float w = scale * img->GetWidth(), h = scale * img->GetHeight();
+	float a = (360.0f - angle) * SOFT_DEGtoRAD;
+	float c = cosf (a), s = sinf (a);
+
+	ux = c / scale;		uy = -s / scale;
+	vx = s / scale;		vy = c / scale;
+
+	ex = (fabsf (c) * w + fabsf (s) * h) / 2.0f;
+	ey = (fabsf (s) * w + fabsf (c) * h) / 2.0f;
+}
+
+//-------------------------------------------------------- SoftImage
+
+SoftImage::SoftImage (void)
+{
+	m_data = NULL;
+	m_xres = m_yres = m_pitch = 0;
+	m_owned = false;
+}
+
+SoftImage::~SoftImage ()
+{
+	Destroy ();
+}
+
+void SoftImage::Create (int xres, int yres)
+{
+	Destroy ();
+	m_data = new XBYTE4[xres * yres];
+	memset (m_data, 0, xres * yres * 4);
+	m_xres = xres; m_yres = yres; m_pitch = xres;
+	m_owned = true;
+}
+
+void SoftImage::Wrap (XBYTE4 *pixels, int xres, int yres, int pitch)
+{
+	Destroy ();
+	m_data = pixels;
+	m_xres = xres; m_yres = yres; m_pitch = pitch;
+	m_owned = false;
+}
+
+void SoftImage::Destroy (void)
+{
+	if (m_owned && m_data != NULL) delete [] m_data;
+	m_data = NULL;
+	m_xres = m_yres = m_pitch = 0;
+	m_owned = false;
+}
+
+bool SoftImage::SaveTGA (char *filename)
+{
+	FILE *fp = fopen (filename, "wb");
+	if (fp == NULL) return false;
+
+	XBYTE header[18];
+	memset (header, 0, 18);
+	header[2] = 2;										// Uncompressed true color
+	header[12] = (XBYTE) (m_xres & 0xFF);	header[13] = (XBYTE) (m_xres >> 8);
+	header[14] = (XBYTE) (m_yres & 0xFF);	header[15] = (XBYTE) (m_yres >> 8);
+	header[16] = 32;
+	header[17] = 0x28;									// 8 alpha bits, top-left origin
+	fwrite (header, 18, 1, fp);
+
+	// 0xAARRGGBB in memory is the B,G,R,A byte order TGA wants (on x86)
+	for (int y=0; y < m_yres; y++)
+		fwrite (GetRow (y), m_xres * 4, 1, fp);
+
+	fclose (fp);
+	return true;
+}
+
+static XBYTE4 soft_crc_table[256];
+static bool soft_crc_ready = false;
+
+static XBYTE4 SoftCRC (XBYTE4 crc, XBYTE *buf, int len)
+{
+	if (!soft_crc_ready) {
+		for (XBYTE4 n=0; n < 256; n++) {
+			XBYTE4 c = n;
+			for (int k=0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			soft_crc_table[n] = c;
+		}
+		soft_crc_ready = true;
+	}
+	crc ^= 0xFFFFFFFF;
+	for (int n=0; n < len; n++) crc = soft_crc_table[(crc ^ buf[n]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFF;
+}
+
+static void SoftPut32 (XBYTE *p, XBYTE4 v)
+{
+	p[0] = (XBYTE) (v >> 24); p[1] = (XBYTE) (v >> 16); p[2] = (XBYTE) (v >> 8); p[3] = (XBYTE) v;
+}
+
+// Writes one PNG chunk: length, type, data, crc
+static void SoftChunk (FILE *fp, const char *type, XBYTE *data, int len)
+{
+	XBYTE buf[4];
+	SoftPut32 (buf, len);
+	fwrite (buf, 4, 1, fp);
+	fwrite (type, 4, 1, fp);
+	if (len > 0) fwrite (data, len, 1, fp);
+	XBYTE4 crc = SoftCRC (0, (XBYTE *) type, 4);
+	crc = SoftCRC (crc, data, len);
+	SoftPut32 (buf, crc);
+	fwrite (buf, 4, 1, fp);
+}
+
+bool SoftImage::SavePNG (char *filename)
+{
+	FILE *fp = fopen (filename, "wb");
+	if (fp == NULL) return false;
+
+	static const XBYTE signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	fwrite (signature, 8, 1, fp);
+
+	XBYTE ihdr[13];
+	SoftPut32 (ihdr, m_xres);
+	SoftPut32 (ihdr + 4, m_yres);
+	ihdr[8] = 8;										// 8 bits per channel
+	ihdr[9] = 2;										// RGB
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+	SoftChunk (fp, "IHDR", ihdr, 13);
+
+	// Raw scanlines (filter byte 0 + RGB), stored in deflate blocks of
+	// up to 65535 bytes. No compression, so no zlib is needed
+	int row_len = 1 + m_xres * 3;
+	int raw_len = row_len * m_yres;
+	XBYTE *raw = new XBYTE[raw_len];
+	for (int y=0; y < m_yres; y++) {
+		XBYTE *out = raw + y * row_len;
+		XBYTE4 *in = GetRow (y);
+		*out++ = 0;
+		for (int x=0; x < m_xres; x++) {
+			*out++ = (XBYTE) (in[x] >> 16);
+			*out++ = (XBYTE) (in[x] >> 8);
+			*out++ = (XBYTE) in[x];
+		}
+	}
+
+	int blocks = (raw_len + 65534) / 65535;
+	int idat_len = 2 + raw_len + blocks * 5 + 4;
+	XBYTE *idat = new XBYTE[idat_len];
+	XBYTE *out = idat;
+	*out++ = 0x78; *out++ = 0x01;						// zlib header
+	XBYTE4 s1 = 1, s2 = 0;
+	for (int pos=0; pos < raw_len; pos += 65535) {
+		int len = (raw_len - pos < 65535) ? raw_len - pos : 65535;
+		*out++ = (pos + len >= raw_len) ? 1 : 0;		// Final block flag, stored
+		*out++ = (XBYTE) (len & 0xFF);	*out++ = (XBYTE) (len >> 8);
+		*out++ = (XBYTE) (~len & 0xFF);	*out++ = (XBYTE) ((~len >> 8) & 0xFF);
+		memcpy (out, raw + pos, len);
+		out += len;
+		for (int n=0; n < len; n++) {
+			s1 = (s1 + raw[pos+n]) % 65521;
+			s2 = (s2 + s1) % 65521;
+		}
+	}
+	SoftPut32 (out, (s2 << 16) | s1);					// Adler-32
+	SoftChunk (fp, "IDAT", idat, idat_len);
+	SoftChunk (fp, "IEND", NULL, 0);
+
+	delete [] idat;
+	delete [] raw;
+	fclose (fp);
+	return true;
+}
+
+//-------------------------------------------------------- SoftRenderer
+
+class SoftRenderer::TileJob : public ThreadJob {
+public:
+	SoftRenderer *renderer;
+	int x1, y1, x2, y2;
+	int bin;
+	void Run (void)		{ renderer->RasterTile (x1, y1, x2, y2, renderer->m_bins[bin]); }
+};
+
+SoftRenderer::SoftRenderer (int xres, int yres, int threads) : m_pool (threads)
+{
+	m_rotcache = NULL;
+	m_frame.Create (xres, yres);
+	m_tilesx = (xres + SOFT_TILE - 1) / SOFT_TILE;
+	m_tilesy = (yres + SOFT_TILE - 1) / SOFT_TILE;
+	m_bins.resize (m_tilesx * m_tilesy);
+
+	for (int ty=0; ty < m_tilesy; ty++) {
+		for (int tx=0; tx < m_tilesx; tx++) {
+			TileJob *job = new TileJob;
+			job->renderer = this;
+			job->x1 = tx * SOFT_TILE;
+			job->y1 = ty * SOFT_TILE;
+			job->x2 = (job->x1 + SOFT_TILE < xres) ? job->x1 + SOFT_TILE : xres;
+			job->y2 = (job->y1 + SOFT_TILE < yres) ? job->y1 + SOFT_TILE : yres;
+			job->bin = ty * m_tilesx + tx;
+			m_jobs.push_back (job);
+		}
+	}
+}
+
+SoftRenderer::~SoftRenderer ()
+{
+	m_pool.Wait ();
+	for (int n=0; n < (int) m_jobs.size(); n++) delete m_jobs[n];
+}
+
+// Clips the command to the frame and adds it to the bins of the tiles it touches
+void SoftRenderer::Queue (Command &cmd)
+{
+	if (cmd.x1 < 0) cmd.x1 = 0;
+	if (cmd.y1 < 0) cmd.y1 = 0;
+	if (cmd.x2 > m_frame.GetWidth()) cmd.x2 = m_frame.GetWidth();
+	if (cmd.y2 > m_frame.GetHeight()) cmd.y2 = m_frame.GetHeight();
+	if (cmd.x1 >= cmd.x2 || cmd.y1 >= cmd.y2) return;
+
+	int index = (int) m_cmds.size();
+	m_cmds.push_back (cmd);
+
+	for (int ty = cmd.y1 / SOFT_TILE; ty <= (cmd.y2-1) / SOFT_TILE; ty++)
+		for (int tx = cmd.x1 / SOFT_TILE; tx <= (cmd.x2-1) / SOFT_TILE; tx++)
+			m_bins[ty * m_tilesx + tx].push_back (index);
+}
+
+void SoftRenderer::ClearScreen (int r, int g, int b)
+{
+	// Everything queued so far would be covered anyway
+	m_cmds.clear ();
+	m_text.clear ();
+	for (int n=0; n < (int) m_bins.size(); n++) m_bins[n].clear ();
+
+	Command cmd;
+	cmd.type = CMD_CLEAR;
+	cmd.x1 = 0; cmd.y1 = 0;
+	cmd.x2 = m_frame.GetWidth(); cmd.y2 = m_frame.GetHeight();
+	cmd.color = 0xFF000000 | (r << 16) | (g << 8) | b;
+	Queue (cmd);
+}
+
+void SoftRenderer::DrawImage (SoftImage *img, int x, int y, int mode)
+{
+	DrawImage (img, x, y, 0.0f, 1.0f, mode);
+}
+
+void SoftRenderer::DrawImage (SoftImage *img, int x, int y, float angle, float scale, int mode)
+{
+	if (img == NULL || img->GetPixels() == NULL || scale <= 0.0f) return;
+
+	// A cached copy turns the draw into a blit. Opaque draws would also
+	// copy the copy's empty corners, so those always resample
+	if (m_rotcache != NULL && mode != SOFT_OPAQUE && !(angle == 0.0f && scale == 1.0f)) {
+		SoftImage *copy = m_rotcache->Get (img, angle, scale);
+		if (copy != NULL) {
+			float cx = x + scale * img->GetWidth() / 2.0f, cy = y + scale * img->GetHeight() / 2.0f;
+			DrawImage (copy, (int) floorf (cx + 0.5f) - copy->GetWidth() / 2, (int) floorf (cy + 0.5f) - copy->GetHeight() / 2, mode);
+			return;
+		}
+	}
+
+	Command cmd;
+	cmd.type = CMD_IMAGE;
+	cmd.mode = mode;
+	cmd.img = img;
+
+	cmd.ox = x; cmd.oy = y;
+	cmd.fast = (angle == 0.0f && scale == 1.0f);
+
+	if (cmd.fast) {
+		// Straight copy, the source rows are the spans
+		cmd.x1 = x; cmd.y1 = y;
+		cmd.x2 = x + img->GetWidth(); cmd.y2 = y + img->GetHeight();
+		Queue (cmd);
+		return;
+	}
+
+	// x,y is the top-left of the scaled image
+	float ex, ey;
+	SoftRotation (img, angle, scale, cmd.ux, cmd.uy, cmd.vx, cmd.vy, ex, ey);
+	cmd.cx = x + scale * img->GetWidth() / 2.0f;
+	cmd.cy = y + scale * img->GetHeight() / 2.0f;
+	cmd.x1 = (int) floorf (cmd.cx - ex);	cmd.x2 = (int) ceilf (cmd.cx + ex);
+	cmd.y1 = (int) floorf (cmd.cy - ey);	cmd.y2 = (int) ceilf (cmd.cy + ey);
+	Queue (cmd);
+}
+
+void SoftRenderer::DrawLine (int r, int g, int b, int x1, int y1, int x2, int y2)
+{
+	Command cmd;
+	cmd.type = CMD_LINE;
+	cmd.color = 0xFF000000 | (r << 16) | (g << 8) | b;
+	cmd.lx1 = x1; cmd.ly1 = y1; cmd.lx2 = x2; cmd.ly2 = y2;
+	cmd.x1 = (x1 < x2) ? x1 : x2;		cmd.x2 = ((x1 > x2) ? x1 : x2) + 1;
+	cmd.y1 = (y1 < y2) ? y1 : y2;		cmd.y2 = ((y1 > y2) ? y1 : y2) + 1;
+	Queue (cmd);
+}
+
+void SoftRenderer::DrawText (int x, int y, char *msg, int r, int g, int b)
+{
+	if (msg == NULL || msg[0] == '\0') return;
+
+	Command cmd;
+	cmd.type = CMD_TEXT;
+	cmd.color = 0xFF000000 | (r << 16) | (g << 8) | b;
+	cmd.text = (int) m_text.size();
+	cmd.ox = x; cmd.oy = y;
+	int len = (int) strlen (msg);
+	m_text.insert (m_text.end(), msg, msg + len + 1);
+	cmd.x1 = x; cmd.y1 = y;
+	cmd.x2 = x + len * SOFT_FONT_WIDTH; cmd.y2 = y + SOFT_FONT_HEIGHT;
+	Queue (cmd);
+}
+
+void SoftRenderer::Flush (void)
+{
+	for (int n=0; n < (int) m_jobs.size(); n++) {
+		if (!m_bins[m_jobs[n]->bin].empty()) m_pool.AddJob (m_jobs[n]);
+	}
+	m_pool.Wait ();
+
+	m_cmds.clear ();
+	m_text.clear ();
+	for (int n=0; n < (int) m_bins.size(); n++) m_bins[n].clear ();
+
+	if (m_rotcache != NULL) m_rotcache->NextFrame ();
+}
+
+void SoftRenderer::SetRotationCache (SoftRotationCache *cache)
+{
+	m_rotcache = cache;
+}
+
+SoftImage *SoftRenderer::GetFrame (void)
+{
+	return &m_frame;
+}
+
+// Draws the tile's commands in the order they were queued
+void SoftRenderer::RasterTile (int tx1, int ty1, int tx2, int ty2, std::vector<int> &bin)
+{
+	for (int n=0; n < (int) bin.size(); n++) {
+		Command &cmd = m_cmds[bin[n]];
+		int x1 = (cmd.x1 > tx1) ? cmd.x1 : tx1, x2 = (cmd.x2 < tx2) ? cmd.x2 : tx2;
+		int y1 = (cmd.y1 > ty1) ? cmd.y1 : ty1, y2 = (cmd.y2 < ty2) ? cmd.y2 : ty2;
+
+		switch (cmd.type) {
+		case CMD_CLEAR:
+			for (int y=y1; y < y2; y++) BlendFill32 (m_frame.GetRow (y) + x1, cmd.color, x2-x1);
+			break;
+		case CMD_IMAGE:	RasterImage (cmd, x1, y1, x2, y2);	break;
+		case CMD_LINE:	RasterLine (cmd, x1, y1, x2, y2);	break;
+		case CMD_TEXT:	RasterText (cmd, x1, y1, x2, y2);	break;
+		}
+	}
+}
+
+static void SoftSpan (XBYTE4 *dst, XBYTE4 *src, int count, int mode)
+{
+	switch (mode) {
+	case SOFT_OPAQUE:	memcpy (dst, src, count * 4);		break;
+	case SOFT_MASKED:	BlendMasked32 (dst, src, count);	break;
+	default:			BlendOver32 (dst, src, count);		break;
+	}
+}
+
+// Narrows [lo,hi) to the steps t where 0 <= f + k*t < limit
+static void SoftRange (float f, float k, float limit, float &lo, float &hi)
+{
+	if (k == 0.0f) {
+		if (f < 0.0f || f >= limit) hi = lo;
+		return;
+	}
+	float t0 = -f / k, t1 = (limit - f) / k;
+	if (k < 0.0f) { float t = t0; t0 = t1; t1 = t; }
+	if (t0 > lo) lo = t0;
+	if (t1 < hi) hi = t1;
+}
+
+void SoftRenderer::RasterImage (Command &cmd, int x1, int y1, int x2, int y2)
+{
+	SoftImage *img = cmd.img;
+	int w = img->GetWidth(), h = img->GetHeight();
+
+	if (cmd.fast) {
+		for (int y=y1; y < y2; y++) {
+			XBYTE4 *src = img->GetRow (y - cmd.oy) + (x1 - cmd.ox);
+			SoftSpan (m_frame.GetRow (y) + x1, src, x2-x1, cmd.mode);
+		}
+		return;
+	}
+
+	// Step through the source along each row, gathering nearest
+	// neighbors a chunk at a time for the span kernels
+	XBYTE4 row[BLEND_CHUNK];
+	float half_w = w / 2.0f, half_h = h / 2.0f;
+
+	for (int y=y1; y < y2; y++) {
+		float dx = x1 + 0.5f - cmd.cx, dy = y + 0.5f - cmd.cy;
+		float sx = half_w + dx * cmd.ux + dy * cmd.vx;
+		float sy = half_h + dx * cmd.uy + dy * cmd.vy;
+
+		// Only the part of the row that lands inside the source
+		float lo = 0.0f, hi = (float) (x2 - x1);
+		SoftRange (sx, cmd.ux, (float) w, lo, hi);
+		SoftRange (sy, cmd.uy, (float) h, lo, hi);
+		int start = (int) ceilf (lo), end = (int) ceilf (hi);
+		if (start < 0) start = 0;
+		if (end > x2 - x1) end = x2 - x1;
+
+		XBYTE4 *dst = m_frame.GetRow (y) + x1;
+		for (int x=start; x < end; x += BLEND_CHUNK) {
+			int count = (end - x < BLEND_CHUNK) ? end - x : BLEND_CHUNK;
+			for (int n=0; n < count; n++) {
+				int ix = (int) (sx + (x+n) * cmd.ux);
+				int iy = (int) (sy + (x+n) * cmd.uy);
+				if (ix < 0) ix = 0; else if (ix >= w) ix = w-1;		// Rounding at the span ends
+				if (iy < 0) iy = 0; else if (iy >= h) iy = h-1;
+				row[n] = img->GetRow (iy)[ix];
+			}
+			SoftSpan (dst + x, row, count, cmd.mode);
+		}
+	}
+}
+
+void SoftRenderer::RasterLine (Command &cmd, int x1, int y1, int x2, int y2)
+{
+	// Bresenham over the whole line, keeping the pixels in this tile so
+	// lines come out the same however the frame is tiled
+	int x = cmd.lx1, y = cmd.ly1;
+	int dx = (cmd.lx2 > x) ? cmd.lx2 - x : x - cmd.lx2;
+	int dy = (cmd.ly2 > y) ? y - cmd.ly2 : cmd.ly2 - y;
+	int sx = (cmd.lx2 > x) ? 1 : -1, sy = (cmd.ly2 > y) ? 1 : -1;
+	int err = dx + dy;
+
+	for (;;) {
+		if (x >= x1 && x < x2 && y >= y1 && y < y2) m_frame.GetRow (y)[x] = cmd.color;
+		if (x == cmd.lx2 && y == cmd.ly2) break;
+		int e2 = 2 * err;
+		if (e2 >= dy) { err += dy; x += sx; }
+		if (e2 <= dx) { err += dx; y += sy; }
+	}
+}
+
+void SoftRenderer::RasterText (Command &cmd, int x1, int y1, int x2, int y2)
+{
+	const char *msg = &m_text[cmd.text];
+	for (int n=0; msg[n] != '\0'; n++) {
+		int gx = cmd.ox + n * SOFT_FONT_WIDTH;
+		if (gx + 5 <= x1 || gx >= x2) continue;
+
+		int ch = (unsigned char) msg[n];
+		if (ch < 32 || ch > 126) ch = '?';
+		const unsigned char *glyph = soft_font[ch - 32];
+
+		for (int row=0; row < 7; row++) {
+			int y = cmd.oy + row;
+			if (y < y1 || y >= y2) continue;
+			XBYTE4 *dst = m_frame.GetRow (y);
+			for (int col=0; col < 5; col++) {
+				int x = gx + col;
+				if (x >= x1 && x < x2 && (glyph[row] & (0x10 >> col))) dst[x] = cmd.color;
+			}
+		}
+	}
+}
+
+//-------------------------------------------------------- SoftRotationCache
+
+SoftRotationCache::SoftRotationCache (int steps, int budget)
+{
+	m_steps = (steps > 0) ? steps : 1;
+	m_budget = budget;
+	m_bytes = 0;
+	m_frame = 0;
+	m_hits = m_misses = 0;
+}
+
+SoftRotationCache::~SoftRotationCache ()
+{
+	Clear ();
+}
+
+bool SoftRotationCache::Key::operator< (const Key &k) const
+{
+	if (img != k.img) return img < k.img;
+	if (bucket != k.bucket) return bucket < k.bucket;
+	return scale < k.scale;
+}
+
+SoftImage *SoftRotationCache::Get (SoftImage *img, float angle, float scale)
+{
+	if (img == NULL || img->GetPixels() == NULL || scale <= 0.0f) return NULL;
+
+	Key key;
+	key.img = img;
+	key.bucket = (int) floorf (angle * m_steps / 360.0f + 0.5f) % m_steps;
+	if (key.bucket < 0) key.bucket += m_steps;
+	key.scale = scale;
+
+	EntryMap::iterator it = m_entries.find (key);
+	if (it != m_entries.end()) {
+		m_lru.splice (m_lru.begin(), m_lru, it->second.lru);
+		it->second.frame = m_frame;
+		m_hits++;
+		return it->second.copy;
+	}
+	m_misses++;
+
+	float ux, uy, vx, vy, ex, ey;
+	SoftRotation (img, key.bucket * 360.0f / m_steps, scale, ux, uy, vx, vy, ex, ey);
+	int w = 2 * (int) ceilf (ex), h = 2 * (int) ceilf (ey);
+	int bytes = w * h * 4;
+	if (w == 0 || h == 0 || bytes > m_budget) return NULL;
+
+	// Nearest samples about the center, like RasterImage. Create
+	// clears the copy, so what falls outside the source stays empty
+	SoftImage *copy = new SoftImage;
+	copy->Create (w, h);
+	int sw = img->GetWidth(), sh = img->GetHeight();
+	for (int y=0; y < h; y++) {
+		XBYTE4 *dst = copy->GetRow (y);
+		float dy = y + 0.5f - h / 2.0f;
+		for (int x=0; x < w; x++) {
+			float dx = x + 0.5f - w / 2.0f;
+			float sx = sw / 2.0f + dx * ux + dy * vx;
+			float sy = sh / 2.0f + dx * uy + dy * vy;
+			if (sx >= 0.0f && sx < sw && sy >= 0.0f && sy < sh)
+				dst[x] = img->GetRow ((int) sy)[(int) sx];
+		}
+	}
+
+	m_lru.push_front (key);
+	Entry &entry = m_entries[key];
+	entry.copy = copy;
+	entry.bytes = bytes;
+	entry.frame = m_frame;
+	entry.lru = m_lru.begin ();
+	m_bytes += bytes;
+
+	Evict ();
+	return copy;
+}
+
+// Drops least recently used copies down to the budget. Copies drawn this
+// frame sit at the front of the list, so stop at the first one
+void SoftRotationCache::Evict (void)
+{
+	while (m_bytes > m_budget && !m_lru.empty()) {
+		EntryMap::iterator it = m_entries.find (m_lru.back());
+		if (it->second.frame == m_frame) break;
+		m_bytes -= it->second.bytes;
+		delete it->second.copy;
+		m_entries.erase (it);
+		m_lru.pop_back ();
+	}
+}
+
+void SoftRotationCache::NextFrame (void)
+{
+	m_frame++;
+	Evict ();
+}
+
+void SoftRotationCache::Invalidate (SoftImage *img)
+{
+	EntryMap::iterator it = m_entries.begin ();
+	while (it != m_entries.end()) {
+		if (it->first.img == img) {
+			m_bytes -= it->second.bytes;
+			delete it->second.copy;
+			m_lru.erase (it->second.lru);
+			m_entries.erase (it++);
+		} else
+			++it;
+	}
+}
+
+void SoftRotationCache::Clear (void)
+{
+	for (EntryMap::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+		delete it->second.copy;
+	m_entries.clear ();
+	m_lru.clear ();
+	m_bytes = 0;
+}
+
+void SoftRotationCache::SetSteps (int steps)
+{
+	Clear ();
+	m_steps = (steps > 0) ? steps : 1;
+}
+
+void SoftRotationCache::SetBudget (int bytes)
+{
+	m_budget = bytes;
+	Evict ();
+}
+
+#ifdef SOFT_TESTER
+
+	// Draws a busy frame with one thread and with the pool, checks the
+	// two match, reports speed and dumps the frame. Builds off Windows:
+	//   g++ -O2 -DSOFT_TESTER gamex-soft.cpp gamex-blend.cpp gamex-thread.cpp -lpthread
+
+	#include <stdlib.h>
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <sys/time.h>
+	#endif
+
+	static double Seconds (void)
+	{
+		#ifdef _WIN32
+			LARGE_INTEGER freq, now;
+			QueryPerformanceFrequency (&freq);
+			QueryPerformanceCounter (&now);
+			return (double) now.QuadPart / (double) freq.QuadPart;
+		#else
+			struct timeval tv;
+			gettimeofday (&tv, NULL);
+			return tv.tv_sec + tv.tv_usec / 1e6;
+		#endif
+	}
+
+	static void DrawScene (SoftRenderer &r, SoftImage &background, SoftImage &sprite, int count)
+	{
+		r.ClearScreen (0, 0, 64);
+		r.DrawImage (&background, 0, 0, SOFT_OPAQUE);
+		srand (99);
+		for (int n=0; n < count; n++) {
+			int x = rand () % 1056 - 32, y = rand () % 800 - 32;
+			float angle = (n % 4 == 0) ? 0.0f : (float) (rand () % 360);
+			float scale = (n % 4 == 0) ? 1.0f : 0.5f + (rand () % 100) / 100.0f;
+			r.DrawImage (&sprite, x, y, angle, scale, (n & 1) ? SOFT_ALPHA : SOFT_MASKED);
+		}
+		for (int n=0; n < 64; n++)
+			r.DrawLine (255, 0, 0, rand () % 1100 - 40, rand () % 800 - 16, rand () % 1100 - 40, rand () % 800 - 16);
+		r.DrawText (5, 5, (char *) "Fatal Inflation - software renderer 0123456789 !?", 255, 255, 0);
+		r.DrawText (-7, 762, (char *) "clipped text at the edges", 255, 255, 255);
+	}
+
+	int main (void)
+	{
+		const int kWidth = 1024, kHeight = 768, kFrames = 10;
+
+		// A soft edged ball, the background a gradient
+		SoftImage sprite, background;
+		sprite.Create (32, 32);
+		for (int y=0; y < 32; y++) {
+			for (int x=0; x < 32; x++) {
+				float d = sqrtf ((x-15.5f)*(x-15.5f) + (y-15.5f)*(y-15.5f)) / 16.0f;
+				int a = (d >= 1.0f) ? 0 : (int) (255 * (1.0f - d*d));
+				sprite.GetRow (y)[x] = (a == 0) ? 0 : (a << 24) | ((200 + x) << 16) | ((y * 6) << 8) | 40;	// Black outside, for SOFT_MASKED
+			}
+		}
+		background.Create (kWidth, kHeight);
+		for (int y=0; y < kHeight; y++)
+			for (int x=0; x < kWidth; x++)
+				background.GetRow (y)[x] = 0xFF000000 | ((x / 8) << 8) | (y / 6);
+
+		// Use a few threads even on one processor, the tiles must still match
+		SoftRenderer single (kWidth, kHeight, 1), pool (kWidth, kHeight, (ThreadPool::GetNumProcessors() > 1) ? 0 : 4);
+
+		DrawScene (single, background, sprite, 2000);
+		single.Flush ();
+		DrawScene (pool, background, sprite, 2000);
+		pool.Flush ();
+		bool same = memcmp (single.GetFrame()->GetPixels(), pool.GetFrame()->GetPixels(), kWidth * kHeight * 4) == 0;
+		printf ("1 thread vs %d threads: %s\n", pool.GetNumThreads(), same ? "identical" : "DIFFERENT");
+
+		pool.GetFrame()->SaveTGA ((char *) "soft_frame.tga");
+		pool.GetFrame()->SavePNG ((char *) "soft_frame.png");
+
+		int counts[3] = { 100, 1000, 10000 };
+		for (int c=0; c < 3; c++) {
+			for (int p=0; p < 2; p++) {
+				SoftRenderer &r = (p == 0) ? single : pool;
+				double start = Seconds ();
+				for (int f=0; f < kFrames; f++) {
+					DrawScene (r, background, sprite, counts[c]);
+					r.Flush ();
+				}
+				double ms = (Seconds () - start) * 1000.0 / kFrames;
+				printf ("%5d sprites, %2d threads: %7.2f ms/frame, %6.1f MP/s filled\n", counts[c], r.GetNumThreads(),
+						ms, kWidth * kHeight / ms / 1000.0);
+			}
+		}
+
+		// Per-sprite cost of rotated draws, resampled every time vs from
+		// the rotation cache. Arrows keep the angle they spawn with, so
+		// each sprite has a fixed angle here
+		const int kSprites = 10000;
+		SoftRotationCache cache;
+		float angles[kSprites];
+		srand (7);
+		for (int n=0; n < kSprites; n++) angles[n] = (float) (rand () % 3600) / 10.0f;
+
+		for (int p=0; p < 2; p++) {
+			single.SetRotationCache ((p == 0) ? NULL : &cache);
+			double start = Seconds ();
+			for (int f=0; f < kFrames; f++) {
+				single.ClearScreen ();
+				srand (11);
+				for (int n=0; n < kSprites; n++)
+					single.DrawImage (&sprite, rand () % kWidth - 16, rand () % kHeight - 16, angles[n], 1.0f, SOFT_ALPHA);
+				single.Flush ();
+			}
+			double ns = (Seconds () - start) * 1e9 / (kFrames * kSprites);
+			printf ("rotated %-9s %7.1f ns/sprite", (p == 0) ? "resample" : "cached", ns);
+			if (p == 1)
+				printf (" (%d steps, %d copies, %d KB, %d hits, %d misses)", cache.GetSteps(), cache.GetNumCopies(),
+						cache.GetBytes() / 1024, cache.GetHits(), cache.GetMisses());
+			printf ("\n");
+		}
+
+		// A small budget has to evict, but never below what a frame draws
+		cache.SetBudget (64 * 1024);
+		single.ClearScreen ();
+		for (int n=0; n < 200; n++) single.DrawImage (&sprite, n * 5, 300, n * 1.8f, 1.0f, SOFT_ALPHA);
+		single.Flush ();
+		single.ClearScreen ();
+		single.Flush ();
+		printf ("64 KB budget: %d copies, %d KB after an empty frame\n", cache.GetNumCopies(), cache.GetBytes() / 1024);
+		single.SetRotationCache (NULL);
+
+		return same ? 0 : 1;
+	}
+
+#endif
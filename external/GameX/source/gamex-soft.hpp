@@ -0,0 +1,169 @@
+//
+// GameX - Software Renderer Header
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#ifndef SOFT_DEF
+	#define SOFT_DEF
+
+	// #define SOFT_TESTER
+
+	// A CPU renderer for the 2D subset of the GameX drawing calls. It
+	// draws into a 32-bit ARGB frame in memory, so frames can be drawn,
+	// dumped and compared without DirectX (or Windows). Draw calls are
+	// queued and rasterized on Flush by a thread pool, one screen tile
+	// per job, with the spans going through the gamex-blend kernels.
+
+	#include "gamex-blend.hpp"
+	#include "gamex-thread.hpp"
+
+	#include <vector>
+	#include <list>
+	#include <map>
+
+	#define SOFT_TILE			64			// Tile size in pixels
+
+	#define SOFT_OPAQUE			0			// Copy every pixel
+	#define SOFT_MASKED			1			// Skip black pixels, like DRAW_PLAIN
+	#define SOFT_ALPHA			2			// Blend by the source alpha
+
+	#define SOFT_FONT_WIDTH		6			// Built-in 5x7 font, with spacing
+	#define SOFT_FONT_HEIGHT	8
+
+	#define SOFT_ROT_STEPS		64			// Rotation cache defaults
+	#define SOFT_ROT_BUDGET		(4*1024*1024)
+
+	// A 32-bit ARGB (0xAARRGGBB) pixel buffer
+	class SoftImage {
+	public:
+		SoftImage (void);
+		~SoftImage ();
+
+		void Create (int xres, int yres);						// Allocate (owned) pixels
+		void Wrap (XBYTE4 *pixels, int xres, int yres, int pitch);	// Use someone else's pixels
+		void Destroy (void);
+
+		inline int GetWidth (void)		{ return m_xres; }
+		inline int GetHeight (void)		{ return m_yres; }
+		inline int GetPitch (void)		{ return m_pitch; }		// In pixels
+		inline XBYTE4 *GetPixels (void)	{ return m_data; }
+		inline XBYTE4 *GetRow (int y)	{ return m_data + y * m_pitch; }
+
+		bool SaveTGA (char *filename);							// 32-bit uncompressed
+		bool SavePNG (char *filename);							// 24-bit, stored (no compression)
+
+	private:
+		XBYTE4 *m_data;
+		int m_xres, m_yres, m_pitch;
+		bool m_owned;
+	};
+
+	// Pre-rotated copies of images, so a rotated draw becomes a straight
+	// blit. Angles snap to one of 'steps' buckets. Once the copies pass
+	// the byte budget the least recently used go, but never one drawn
+	// since the last NextFrame (its draw may still be queued).
+	class SoftRotationCache {
+	public:
+		SoftRotationCache (int steps = SOFT_ROT_STEPS, int budget = SOFT_ROT_BUDGET);
+		~SoftRotationCache ();
+
+		SoftImage *Get (SoftImage *img, float angle, float scale);	// NULL if it can't be cached
+		void NextFrame (void);									// Called by SoftRenderer::Flush
+		void Invalidate (SoftImage *img);						// After changing img's pixels
+		void Clear (void);
+
+		void SetSteps (int steps);								// Clears the cache
+		void SetBudget (int bytes);
+
+		inline int GetSteps (void)		{ return m_steps; }
+		inline int GetBudget (void)		{ return m_budget; }
+		inline int GetBytes (void)		{ return m_bytes; }
+		inline int GetNumCopies (void)	{ return (int) m_entries.size(); }
+		inline int GetHits (void)		{ return m_hits; }
+		inline int GetMisses (void)		{ return m_misses; }
+
+	private:
+		struct Key {
+			SoftImage *img;
+			int bucket;
+			float scale;
+			bool operator< (const Key &k) const;
+		};
+		struct Entry {
+			SoftImage *copy;
+			int bytes;
+			int frame;											// Last frame it was drawn in
+			std::list<Key>::iterator lru;
+		};
+		typedef std::map<Key, Entry> EntryMap;
+
+		void Evict (void);
+
+		EntryMap m_entries;
+		std::list<Key> m_lru;									// Most recently used first
+		int m_steps, m_budget, m_bytes;
+		int m_frame;
+		int m_hits, m_misses;
+	};
+
+	class SoftRenderer {
+	public:
+		SoftRenderer (int xres, int yres, int threads = 0);	// threads = 0 for one per processor
+		~SoftRenderer ();
+
+		// Drawing (queued until Flush)
+		void ClearScreen (int r=0, int g=0, int b=0);
+		void DrawImage (SoftImage *img, int x, int y, int mode=SOFT_ALPHA);
+		void DrawImage (SoftImage *img, int x, int y, float angle, float scale, int mode=SOFT_ALPHA); // angle in degrees counter-clockwise, about the center
+		void DrawLine (int r, int g, int b, int x1, int y1, int x2, int y2);
+		void DrawText (int x, int y, char *msg, int r=255, int g=255, int b=255);
+
+		void Flush (void);										// Rasterize everything queued
+		void SetRotationCache (SoftRotationCache *cache);		// Masked and alpha rotated draws use it, NULL for none
+		SoftImage *GetFrame (void);								// The frame, after a Flush
+
+		inline int GetNumQueued (void)	{ return (int) m_cmds.size(); }
+		inline int GetNumThreads (void)	{ return m_pool.GetNumThreads(); }
+
+	private:
+		class TileJob;
+		friend class TileJob;
+
+		enum { CMD_CLEAR, CMD_IMAGE, CMD_LINE, CMD_TEXT };
+
+		struct Command {
+			int type, mode;
+			int ox, oy;											// Unclipped top-left
+			bool fast;											// Unrotated, unscaled image
+			int x1, y1, x2, y2;									// Bounds, clipped to the frame (exclusive)
+			XBYTE4 color;
+			SoftImage *img;
+			float cx, cy;										// Center of a rotated image
+			float ux, uy, vx, vy;								// Screen to source steps
+			int lx1, ly1, lx2, ly2;								// Line end points
+			int text;											// Offset into m_text
+		};
+
+		void Queue (Command &cmd);
+		void RasterTile (int tx1, int ty1, int tx2, int ty2, std::vector<int> &bin);
+		void RasterImage (Command &cmd, int tx1, int ty1, int tx2, int ty2);
+		void RasterLine (Command &cmd, int tx1, int ty1, int tx2, int ty2);
+		void RasterText (Command &cmd, int tx1, int ty1, int tx2, int ty2);
+
+		SoftImage m_frame;
+		ThreadPool m_pool;
+		std::vector<Command> m_cmds;
+		std::vector<char> m_text;
+		int m_tilesx, m_tilesy;
+		std::vector< std::vector<int> > m_bins;					// Commands touching each tile
+		std::vector<TileJob*> m_jobs;
+		SoftRotationCache *m_rotcache;
+	};
+
+#endif
@@ -11,6 +11,7 @@
 //
 
 #include "gamex-sound.hpp"
+#include "gamex-wav.hpp"
 
 SoundX::SoundX()
 {
@@ -63,88 +64,27 @@ bool SoundX::ReadSize (File& wav, Buffer &code, unsigned int &size)
 
 bool SoundX::LoadWav (char *filename)
 {
-	XBYTE2 twobytes;
-	XBYTE4 fourbytes;
-	XBYTE2 format;
-	unsigned int size;
-	int source_bps;
-	char buf[100];
-	ZeroMemory(buf,100);
-	int n;
-
-	File wav;
-	Buffer code;
-
-	if (wav.Open (filename, FILE_READ | FILE_RANDOM) != FILE_EXIST_NO) {
-		code.SetOrder (BUFFER_ORDER_LBF);
-		
-		if (ReadName(wav, code, "RIFF")==false) {InvalidWav(); return false;}
-		if (ReadSize(wav, code, size)==false)	{InvalidWav(); return false;}
-		if (ReadName(wav, code, "WAVE")==false)	{InvalidWav(); return false;}
-		if (ReadName(wav, code, "fmt ")==false)	{InvalidWav(); return false;}
-		if (ReadSize(wav, code, size)==false)	{InvalidWav(); return false;}
-		// Read WAV Format Header (THIS READS 16 BYTES)
-		wav.Read2 (twobytes); format = code.ReadI (twobytes);				// WAV Format Tag (1 = PCM) (2 = MS ADPCM)
-		switch(format) {
-		case 1: {
-			wav.Read2 (twobytes); num_channels = code.ReadI (twobytes);			// WAV Number of Channels
-			wav.Read4 (fourbytes); samples_per_sec = code.ReadL (fourbytes);	// WAV Samples per Second
-			wav.Read4 (fourbytes);												// WAV Avergae Bytes per Second (IGNORED)
-			wav.Read2 (twobytes); int block_align = code.ReadI (twobytes);		// WAV Block Align (IGNORED)
-			wav.Read2 (twobytes); bits_per_sample = code.ReadI (twobytes);		// WAV Bits Per Sample			
-			source_bps = bits_per_sample;
-			bits_per_sample = min(16,source_bps);
-			wav.ReadC (size-16, buf);
-			while(wav.EndOfFile()==0) {
-				int stat = wav.ReadC (1, buf);
-				if(stat == FILE_STATUS_EOF) break;
-				if(buf[0] == 'd')
-					wav.ReadC (3, buf+1);
-				else if(buf[0] == 'f')
-					wav.ReadC (3, buf+1);
-				else continue;
-				if (strncmp (buf, "data", 4)==0) {
-					if (ReadSize(wav, code, size)==false)	{InvalidWav(); return false;}
-					// Read WAV Data
-					num_bytes = size;								// Load number of bytes in data (from file)				
-					num_samples = num_bytes / ((bits_per_sample/8) * num_channels);	// Calculate number of samples
-					length = (float) num_samples / (float) samples_per_sec;		// Calculate length of sound (in seconds)
-					if (data!=NULL) {delete [] data; data = NULL;}
-					data = new char[num_bytes];
-					ZeroMemory(data, num_bytes ) ;
-	//				for (n = 0; n < num_bytes; n++) 
-	//					*(data + n) = 0;
-
-					int source_byte_ps = source_bps/8;
-					int dest_byte_ps = bits_per_sample/8;
-					int skip_channels = (source_byte_ps-dest_byte_ps);
-					int read_channels = dest_byte_ps;
-
-					for (n = 0; n < num_bytes; n+=dest_byte_ps) {
-						if(skip_channels) {
-							char skip [8];
-							wav.ReadC (skip_channels, skip);
-						}
-						wav.ReadC (read_channels, data + n);
-					}
-				} else if (strncmp (buf, "fact", 4)==0) {
-					wav.Read4 (fourbytes);
-					wav.Read4 (fourbytes);
-				}
-			}
-		}	break;
-		default:
-			char errstr [128];
-			sprintf(errstr, "The WAV \"%s\" was not saved in PCM format. Please re-save it in any standard PCM format so GameX can load it.", filename);
-			debug.Output("Error loading sound:",errstr);
-			GameX.ErrorDialog(errstr);
-			wav.Close();
-			return false;
+	FileMapped wav;
+
+	if (wav.Open (filename) != FILE_EXIST_NO) {
+		// The whole file mapped (or, if it can't be, read in one go);
+		// LoadWav on the stream finds the chunks in it and narrows the
+		// samples straight out of it
+		long size = wav.GetSize ();
+		if (size <= 0) {wav.Close(); InvalidWav(); return false;}
+
+		XBYTE *stream = (XBYTE *) wav.GetData ();
+		int stat = FILE_STATUS_OK;
+		if (stream == NULL) {
+			stream = new XBYTE[size];
+			stat = wav.Read ((int) size, stream);
 		}
-				
-//		dx_index = -1; // fixes bug that can make playing any sound fail if a different sound has been loaded already
-		dx_refresh = true;
+		bool loaded = false;
+		if (stat == FILE_STATUS_OK)	loaded = LoadWav (stream, size, filename);
+		else						InvalidWav();
+		if (wav.GetData () == NULL) delete [] stream;
 		wav.Close ();
+		return loaded;
 	} else {
 		char disp[500];
 		sprintf (disp, ".WAV File Not Found: %s\n\nMake sure paths and names of WAV files are correct. If you started the game outside of Visual C++, make sure the executable is in the correct location to find sounds.", filename); 
@@ -154,8 +94,41 @@ bool SoundX::LoadWav (char *filename)
 #endif
 		return false;
 	}
+}
+
+bool SoundX::LoadWav (XBYTE *stream, int size, char *filename)
+{
+	WavInfo info;
+
+	if (WavReadHeader (info, stream, size)==false) {InvalidWav(); return false;}
+	if (info.format != WAV_PCM) {
+		char errstr [128];
+		sprintf(errstr, "The WAV \"%s\" was not saved in PCM format. Please re-save it in any standard PCM format so GameX can load it.", filename);
+		debug.Output("Error loading sound:",errstr);
+		GameX.ErrorDialog(errstr);
+		return false;
+	}
+	if ((info.bits != 8 && info.bits != 16 && info.bits != 24 && info.bits != 32) || info.channels <= 0) {InvalidWav(); return false;}
+
+	num_channels = info.channels;
+	samples_per_sec = info.samples_per_sec;
+	bits_per_sample = min(16,info.bits);
+
+	// Sizes are of the narrowed samples. (Loading 24 and 32-bit sounds
+	// used to size them from the file's bytes and read past the data.)
+	int source_byte_ps = info.bits/8;
+	int dest_byte_ps = bits_per_sample/8;
+	num_samples = info.data_size / (source_byte_ps * num_channels);		// Calculate number of samples
+	num_bytes = num_samples * num_channels * dest_byte_ps;
+	length = (float) num_samples / (float) samples_per_sec;				// Calculate length of sound (in seconds)
+	if (data!=NULL) {delete [] data; data = NULL;}
+	data = new char[num_bytes];
+	WavNarrow ((XBYTE *) data, stream + info.data_offset, num_samples * num_channels, source_byte_ps);
+
+//	dx_index = -1; // fixes bug that can make playing any sound fail if a different sound has been loaded already
+	dx_refresh = true;
 
-	sprintf(m_filename, filename);
+	sprintf(m_filename, "%s", filename);
 
 	#ifdef WINDX_DEBUG
 		int z;
@@ -26,6 +26,7 @@
 		SoundX ();
 		~SoundX ();
 		bool LoadWav (char *filename);
+		bool LoadWav (XBYTE *stream, int size, char *filename);	// From a WAV in memory (filename is only for messages)
 		inline bool Load (char *filename) {return LoadWav(filename);}
 		void InvalidWav (void);
 		bool ReadName (File& wav, Buffer &code, char *match_name);
@@ -0,0 +1,404 @@
+//
+// GameX - Music Stream Code
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#include "gamex-stream.hpp"
+
+#include <string.h>
+
+static inline XBYTE4 StreamRead4 (const XBYTE *p)	{ return p[0] | (p[1] << 8) | (p[2] << 16) | ((XBYTE4) p[3] << 24); }
+
+MusicStream::MusicStream (int ring_frames, int chunk_frames)
+{
+	m_chunk_frames = (chunk_frames > 0) ? chunk_frames : STREAM_CHUNK;
+	m_ring_frames = (ring_frames > m_chunk_frames) ? ring_frames : m_chunk_frames;
+	m_ring = new short[m_ring_frames * 2];
+	m_chunk = new XBYTE[m_chunk_frames * 2 * 4];			// room for 32-bit stereo
+	m_fp = NULL;
+	m_data = 0;
+	m_frames = m_next = 0;
+	m_channels = m_rate = m_bytes = 0;
+	m_loop = false;
+	m_read = m_count = 0;
+}
+
+MusicStream::~MusicStream ()
+{
+	Close ();
+	delete [] m_ring;
+	delete [] m_chunk;
+}
+
+bool MusicStream::Open (const char *filename, long offset, long size)
+{
+	Close ();
+	m_fp = fopen (filename, "rb");
+	if (m_fp == NULL) return false;
+
+	if (size <= 0) {
+		fseek (m_fp, 0, SEEK_END);
+		size = ftell (m_fp) - offset;
+	}
+
+	// The chunks before the samples are small, so one read finds them
+	XBYTE head[STREAM_HEADER];
+	int got = 0;
+	if (size > 0 && fseek (m_fp, offset, SEEK_SET) == 0)
+		got = (int) fread (head, 1, (size < STREAM_HEADER) ? size : STREAM_HEADER, m_fp);
+
+	WavInfo info;
+	if (!WavReadHeader (info, head, got) || info.format != WAV_PCM ||
+		(info.channels != 1 && info.channels != 2) || (info.bits != 16 && info.bits != 24 && info.bits != 32)) {
+		Close ();
+		return false;
+	}
+
+	// The header only saw its own bytes, so the data chunk's size is
+	// taken as written, cut to what the track holds
+	long bytes = (long) StreamRead4 (head + info.data_offset - 4);
+	if (bytes > size - info.data_offset) bytes = size - info.data_offset;
+
+	m_channels = info.channels;
+	m_rate = info.samples_per_sec;
+	m_bytes = info.bits / 8;
+	m_frames = (int) (bytes / (m_channels * m_bytes));
+	m_data = offset + info.data_offset;
+	Rewind ();
+	return true;
+}
+
+void MusicStream::Close (void)
+{
+	if (m_fp != NULL) fclose (m_fp);
+	m_fp = NULL;
+	m_frames = m_next = 0;
+	m_read = m_count = 0;
+}
+
+void MusicStream::Rewind (void)
+{
+	if (m_fp == NULL) return;
+	fseek (m_fp, m_data, SEEK_SET);
+	m_next = 0;
+	m_read = m_count = 0;
+	Fill ();
+}
+
+int MusicStream::Fill (void)
+{
+	if (m_fp == NULL) return 0;
+
+	int frame_bytes = m_channels * m_bytes, total = 0;
+	while (m_ring_frames - m_count >= m_chunk_frames) {
+		if (m_next >= m_frames) {
+			if (!m_loop || m_frames == 0) break;
+			fseek (m_fp, m_data, SEEK_SET);
+			m_next = 0;
+		}
+		int frames = (m_chunk_frames < m_frames - m_next) ? m_chunk_frames : m_frames - m_next;
+		int got = (int) fread (m_chunk, frame_bytes, frames, m_fp);
+
+		// Narrowed straight into the ring, in two if it wraps round
+		int write = (m_read + m_count) % m_ring_frames;
+		int first = (got < m_ring_frames - write) ? got : m_ring_frames - write;
+		WavNarrow ((XBYTE *) (m_ring + write*m_channels), m_chunk, first * m_channels, m_bytes);
+		WavNarrow ((XBYTE *) m_ring, m_chunk + first*frame_bytes, (got - first) * m_channels, m_bytes);
+		m_count += got;
+		m_next += got;
+		total += got;
+
+		if (got < frames) {									// the file's shorter than it said
+			m_frames = m_next;
+			if (got == 0) break;
+		}
+	}
+	return total;
+}
+
+int MusicStream::Read (short *dst, int frames)
+{
+	if (m_fp == NULL) return -1;
+	if (m_count == 0) return (m_next >= m_frames && !m_loop) ? -1 : 0;
+
+	if (frames > m_count) frames = m_count;
+	int first = (frames < m_ring_frames - m_read) ? frames : m_ring_frames - m_read;
+	memcpy (dst, m_ring + m_read*m_channels, first * m_channels * sizeof (short));
+	memcpy (dst + first*m_channels, m_ring, (frames - first) * m_channels * sizeof (short));
+	m_read = (m_read + frames) % m_ring_frames;
+	m_count -= frames;
+	return frames;
+}
+
+int MusicStream::GetMemory (void)
+{
+	return m_ring_frames * 2 * sizeof (short) + m_chunk_frames * 2 * 4;
+}
+
+#ifdef STREAM_TESTER
+
+	// Checks streamed samples against the track they came from (packed
+	// among others, 16, 24 and 32-bit, looped, cut short, through the
+	// mixer), then packs 30 tracks and compares loading them all with
+	// indexing them and streaming one. Builds off Windows:
+	//   g++ -O2 -DSTREAM_TESTER gamex-stream.cpp gamex-mixer.cpp gamex-wav.cpp gamex-blend.cpp
+
+	#include <stdlib.h>
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <sys/time.h>
+	#endif
+
+	static double Seconds (void)
+	{
+		#ifdef _WIN32
+			LARGE_INTEGER freq, now;
+			QueryPerformanceFrequency (&freq);
+			QueryPerformanceCounter (&now);
+			return (double) now.QuadPart / (double) freq.QuadPart;
+		#else
+			struct timeval tv;
+			gettimeofday (&tv, NULL);
+			return tv.tv_sec + tv.tv_usec / 1e6;
+		#endif
+	}
+
+	static int Rand (int lo, int hi)	{ return lo + rand () % (hi - lo + 1); }
+
+	static int Check (bool ok, const char *what)
+	{
+		if (!ok) printf ("  %s\n", what);
+		return ok ? 0 : 1;
+	}
+
+	static void Put4 (XBYTE *p, XBYTE4 v)	{ p[0] = (XBYTE) v; p[1] = (XBYTE) (v >> 8); p[2] = (XBYTE) (v >> 16); p[3] = (XBYTE) (v >> 24); }
+	static void Put2 (XBYTE *p, int v)		{ p[0] = (XBYTE) v; p[1] = (XBYTE) (v >> 8); }
+
+	// Writes a .wav of 'frames' frames whose samples' top 16 bits are
+	// 'top', with a LIST chunk ahead of the data if 'list'. Returns its size
+	static long WriteWav (FILE *fp, const short *top, int frames, int channels, int bits, bool list)
+	{
+		int bytes = bits / 8, data = frames * channels * bytes;
+		XBYTE head[44 + 20];
+		int len = 0;
+		memcpy (head, "RIFF", 4);
+		memcpy (head + 8, "WAVEfmt ", 8);
+		Put4 (head + 16, 16);
+		Put2 (head + 20, WAV_PCM);
+		Put2 (head + 22, channels);
+		Put4 (head + 24, MIXER_RATE);
+		Put4 (head + 28, MIXER_RATE * channels * bytes);
+		Put2 (head + 32, channels * bytes);
+		Put2 (head + 34, bits);
+		len = 36;
+		if (list) {
+			memcpy (head + len, "LIST", 4);
+			Put4 (head + len + 4, 12);
+			memcpy (head + len + 8, "INFOjunkjunk", 12);
+			len += 20;
+		}
+		memcpy (head + len, "data", 4);
+		Put4 (head + len + 4, data);
+		len += 8;
+		Put4 (head + 4, len - 8 + data);
+		fwrite (head, len, 1, fp);
+
+		XBYTE *samples = new XBYTE[data];
+		for (int n=0; n < frames * channels; n++) {
+			XBYTE *s = samples + n*bytes;
+			if (bytes == 1) { s[0] = (XBYTE) (top[n] >> 8); continue; }
+			for (int b=0; b < bytes - 2; b++) s[b] = (XBYTE) Rand (0, 255);
+			Put2 (s + bytes - 2, top[n]);
+		}
+		fwrite (samples, data, 1, fp);
+		delete [] samples;
+		return len + data;
+	}
+
+	static void Junk (FILE *fp, int count)
+	{
+		for (int n=0; n < count; n++) fputc (Rand (0, 255), fp);
+	}
+
+	// Reads the whole track out in odd sized pieces, filling between
+	static bool ReadsBack (MusicStream &stream, const short *top, int frames, int channels)
+	{
+		short buf[2*1000];
+		int pos = 0;
+		bool ok = true;
+		for (;;) {
+			stream.Fill ();
+			int got = stream.Read (buf, Rand (1, 1000));
+			if (got < 0) break;
+			if (pos + got > frames) return false;
+			ok = ok && memcmp (buf, top + pos*channels, got * channels * sizeof (short)) == 0;
+			pos += got;
+		}
+		return ok && pos == frames;
+	}
+
+	static int TestStream (void)
+	{
+		const int kFrames = 30011;
+		const char *name = "stream_test.pak";
+		short *top = new short[kFrames*2], *out = new short[kFrames*2], *ref = new short[kFrames*2];
+		int fails = 0, n;
+		for (n=0; n < kFrames*2; n++) top[n] = (short) Rand (-32768, 32767);
+
+		// Tracks packed between other data, as they are in a game's pack
+		FILE *fp = fopen (name, "wb");
+		long at[4], size[4];
+		const int bits[4] = { 16, 24, 32, 8 }, channels[4] = { 2, 1, 2, 1 };
+		for (int t=0; t < 4; t++) {
+			Junk (fp, Rand (1, 100));
+			at[t] = ftell (fp);
+			size[t] = WriteWav (fp, top, kFrames, channels[t], bits[t], t == 1);
+		}
+		Junk (fp, 100);
+		fclose (fp);
+
+		MusicStream stream (1000, 300);
+		char what[64];
+		for (int t=0; t < 3; t++) {
+			sprintf (what, "%d-bit track %d doesn't read back", bits[t], t);
+			bool ok = stream.Open (name, at[t], size[t]) && stream.GetFrames () == kFrames &&
+					  stream.GetChannels () == channels[t] && stream.GetRate () == MIXER_RATE;
+			fails += Check (ok && ReadsBack (stream, top, kFrames, channels[t]), what);
+		}
+		fails += Check (!stream.Open (name, at[3], size[3]), "8-bit opened");
+		fails += Check (!stream.Open (name, at[0] + 1, size[0]), "opened off the start of a track");
+		fails += Check (!stream.Open ("no such file", 0, 0), "opened a missing file");
+
+		// Cut short: the pack says less than the .wav does
+		stream.Open (name, at[0], size[0] - 4 * 1000 - 2);
+		fails += Check (stream.GetFrames () == kFrames - 1001 && ReadsBack (stream, top, kFrames - 1001, 2), "short track doesn't read back");
+
+		// Looped, it comes round again and again
+		stream.Open (name, at[1], size[1]);
+		stream.SetLoop (true);
+		bool ok = true;
+		int pos = 0;
+		while (pos < kFrames * 3) {
+			stream.Fill ();
+			int got = stream.Read (out, Rand (1, 1000));
+			for (n=0; n < got; n++) ok = ok && out[n] == top[(pos + n) % kFrames];
+			pos += got;
+		}
+		fails += Check (ok, "looped track doesn't come round");
+		stream.Rewind ();
+		stream.Read (out, 10);
+		fails += Check (memcmp (out, top, 10 * sizeof (short)) == 0, "rewind doesn't go back to the start");
+
+		// Through the mixer it's the same as playing the track from
+		// memory, and its voice ends with it
+		Mixer mixer (4), from_memory (4);
+		stream.Open (name, at[2], size[2]);
+		stream.SetLoop (false);
+		int v = mixer.Stream (&stream, &stream, 2, 10);
+		from_memory.Play (top, top, kFrames, 2, MIXER_RATE);
+		for (pos=0; pos < kFrames; pos += 500) {
+			int count = (kFrames - pos < 500) ? kFrames - pos : 500;
+			stream.Fill ();
+			mixer.Mix (out + pos*2, count);
+			from_memory.Mix (ref + pos*2, count);
+		}
+		fails += Check (memcmp (out, ref, kFrames * 2 * sizeof (short)) == 0, "mixed stream isn't the track");
+		mixer.Mix (ref, 1);
+		fails += Check (!mixer.IsPlaying (v), "stream's voice outlived it");
+
+		// Run dry, it leaves a gap and carries on from where it was
+		stream.Rewind ();
+		int ahead = stream.GetAvail ();
+		v = mixer.Stream (&stream, &stream, 2, 10);
+		mixer.Mix (out, 2000);
+		ok = memcmp (out, top, ahead * 2 * sizeof (short)) == 0;
+		for (n=ahead*2; n < 2000*2; n++) ok = ok && out[n] == 0;
+		stream.Fill ();
+		mixer.Mix (out, 10);
+		ok = ok && memcmp (out, top + ahead*2, 10 * 2 * sizeof (short)) == 0;
+		fails += Check (ok && mixer.IsPlaying (v), "dry stream didn't pick up again");
+
+		remove (name);
+		delete [] top;
+		delete [] out;
+		delete [] ref;
+		return fails;
+	}
+
+	// 30 tracks of 16-bit stereo: each loaded whole, as the pack did,
+	// against reading the index and starting one
+	static void BenchTracks (void)
+	{
+		const int kTracks = 30, kSeconds = 30, kFrames = MIXER_RATE * kSeconds;
+		const char *name = "stream_bench.pak";
+		short *top = new short[kFrames*2];
+		for (int n=0; n < kFrames*2; n++) top[n] = (short) Rand (-20000, 20000);
+
+		FILE *fp = fopen (name, "wb");
+		long at[kTracks], size[kTracks];
+		for (int t=0; t < kTracks; t++) {
+			at[t] = ftell (fp);
+			size[t] = WriteWav (fp, top, kFrames, 2, 16, false);
+		}
+		fclose (fp);
+		delete [] top;
+
+		double start = Seconds ();
+		XBYTE *tracks[kTracks];
+		long held = 0;
+		fp = fopen (name, "rb");
+		for (int t=0; t < kTracks; t++) {
+			tracks[t] = new XBYTE[size[t]];
+			fseek (fp, at[t], SEEK_SET);
+			fread (tracks[t], size[t], 1, fp);
+			held += size[t];
+		}
+		fclose (fp);
+		double load_all = Seconds () - start;
+		for (int t=0; t < kTracks; t++) delete [] tracks[t];
+
+		start = Seconds ();
+		MusicStream stream;
+		stream.Open (name, at[kTracks/2], size[kTracks/2]);
+		double open_one = Seconds () - start;
+
+		// Playing it through, a game frame at a time
+		Mixer mixer (32);
+		short out[2 * (MIXER_RATE/60)];
+		mixer.Stream (&stream, &stream, 2, 10);
+		start = Seconds ();
+		for (int frame=0; frame < kSeconds * 60; frame++) {
+			stream.Fill ();
+			mixer.Mix (out, MIXER_RATE/60);
+		}
+		double play = Seconds () - start;
+
+		printf ("%d tracks of %d s, 16-bit stereo (%.1f MB packed)\n", kTracks, kSeconds, held / 1048576.0);
+		printf ("load every track   %8.1f ms   %8.1f MB held\n", load_all * 1000.0, held / 1048576.0);
+		printf ("stream one track   %8.1f ms   %8.1f KB held\n", open_one * 1000.0, stream.GetMemory () / 1024.0);
+		printf ("streaming it all   %8.1f ms of fills and mixing for %d s of music\n", play * 1000.0, kSeconds);
+		remove (name);
+	}
+
+	int main (void)
+	{
+		int best = BlendGetLevel (), fails = 0;
+		srand (1234);
+		if (best >= BLEND_SSE2) fails += TestStream ();
+		BlendSetLevel (BLEND_SCALAR);
+		fails += TestStream ();
+		printf ("%s: %d mismatches\n", fails ? "FAILED" : "OK", fails);
+
+		BlendSetLevel (best);
+		BenchTracks ();
+		return fails ? 1 : 0;
+	}
+
+#endif
@@ -0,0 +1,75 @@
+//
+// GameX - Music Stream Header
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#ifndef STREAM_DEF
+	#define STREAM_DEF
+
+	// #define STREAM_TESTER
+
+	// Plays a long .wav, such as a music track, without holding it in
+	// memory. Its samples are read off disk a chunk at a time, narrowed
+	// to 16 bits and kept in a small ring just ahead of where the mixer
+	// is taking them. The .wav can start anywhere in the file, so tracks
+	// packed together play from where they lie. Like the blend kernels
+	// this has no DirectX or Windows in it.
+
+	#include "gamex-mixer.hpp"
+	#include "gamex-wav.hpp"
+
+	#include <stdio.h>
+
+	#define STREAM_RING			MIXER_RATE	// Default ring: a second at the mixer's rate
+	#define STREAM_CHUNK		4096		// Default frames read at a time
+	#define STREAM_HEADER		4096		// Most bytes looked through for the .wav's chunks
+
+	class MusicStream : public MixerSource {
+	public:
+		MusicStream (int ring_frames = STREAM_RING, int chunk_frames = STREAM_CHUNK);
+		~MusicStream ();
+
+		// Opens the .wav 'offset' bytes into a file, 'size' bytes long (0
+		// for the rest of the file), and fills the ring. Only 16, 24 and
+		// 32-bit mono or stereo PCM is streamed; false for anything else
+		bool Open (const char *filename, long offset = 0, long size = 0);
+		void Close (void);
+
+		// Reads whole chunks while the ring has room for one; returns the
+		// frames read. Call it often enough that the ring never runs dry
+		int Fill (void);
+
+		// Takes up to 'frames' frames out of the ring; -1 once the track
+		// has ended and they've all been taken
+		int Read (short *dst, int frames);
+
+		void SetLoop (bool loop)			{ m_loop = loop; }
+		void Rewind (void);						// Back to the start, dropping what's in the ring
+
+		inline bool IsOpen (void)			{ return m_fp != NULL; }
+		inline int GetChannels (void)		{ return m_channels; }
+		inline int GetRate (void)			{ return m_rate; }
+		inline int GetFrames (void)			{ return m_frames; }			// In the whole track
+		inline int GetAvail (void)			{ return m_count; }				// Read ahead, waiting in the ring
+		int GetMemory (void);												// Bytes held for the ring and chunk
+
+	private:
+		FILE *m_fp;
+		long m_data;							// Where the samples start in the file
+		int m_frames, m_next;					// Frames in the track, and the next one to read off disk
+		int m_channels, m_rate, m_bytes;		// m_bytes per sample in the file
+		bool m_loop;
+
+		short *m_ring;
+		int m_ring_frames, m_read, m_count;
+		XBYTE *m_chunk;							// A chunk as it is on disk
+		int m_chunk_frames;
+	};
+
+#endif
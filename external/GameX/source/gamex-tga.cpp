@@ -0,0 +1,403 @@
+//
+// GameX - Targa Decoder Code
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#include "gamex-tga.hpp"
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define TGA_HAS_SSE2
+	#include <emmintrin.h>
+#endif
+
+#ifdef __GNUC__
+	#define TGA_SSE2_FUNC	__attribute__ ((target ("sse2")))
+#else
+	#define TGA_SSE2_FUNC
+#endif
+
+bool TGAReadHeader (TGAInfo &info, const XBYTE *stream, int size)
+{
+	if (stream == NULL || size < TGA_HEADER_SIZE) return false;
+	if (stream[2] != TGA_TRUECOLOR && stream[2] != TGA_TRUECOLOR_RLE) return false;
+
+	info.xres = stream[12] | (stream[13] << 8);
+	info.yres = stream[14] | (stream[15] << 8);
+	info.bpp = stream[16];
+	info.rle = (stream[2] == TGA_TRUECOLOR_RLE);
+	info.top_down = (stream[17] & 0x20) != 0;
+
+	// The pixels come after the id field and, though a true color image
+	// doesn't use one, any color map
+	info.offset = TGA_HEADER_SIZE + stream[0];
+	if (stream[1] != 0) info.offset += (stream[5] | (stream[6] << 8)) * ((stream[7] + 7) / 8);
+
+	if (info.xres <= 0 || info.yres <= 0 || (info.bpp != 24 && info.bpp != 32)) return false;
+	return info.offset <= size;
+}
+
+void TGAExpand24Ref (XBYTE4 *dst, const XBYTE *src, int count)
+{
+	for (int n=0; n < count; n++, src += 3)
+		dst[n] = 0xFF000000 | (src[2] << 16) | (src[1] << 8) | src[0];
+}
+
+#ifdef TGA_HAS_SSE2
+
+// Four pixels from the first 12 of 16 loaded bytes: pixel k's three
+// bytes are shifted up k bytes into lane k, and the alpha ORed in. Stops
+// 6 pixels short of the end so the load never reads past the row
+TGA_SSE2_FUNC static int TGAExpand24SSE2 (XBYTE4 *dst, const XBYTE *src, int count)
+{
+	__m128i lane = _mm_set1_epi32 (0x00FFFFFF), alpha = _mm_set1_epi32 ((int) 0xFF000000);
+	__m128i m0 = _mm_setr_epi32 (0x00FFFFFF, 0, 0, 0), m1 = _mm_setr_epi32 (0, 0x00FFFFFF, 0, 0);
+	__m128i m2 = _mm_setr_epi32 (0, 0, 0x00FFFFFF, 0), m3 = _mm_setr_epi32 (0, 0, 0, 0x00FFFFFF);
+	int n = 0;
+	for (; n + 6 <= count; n += 4) {
+		__m128i v = _mm_loadu_si128 ((__m128i *) (src + n*3));
+		__m128i p = _mm_or_si128 (_mm_or_si128 (_mm_and_si128 (v, m0), _mm_and_si128 (_mm_slli_si128 (v, 1), m1)),
+								  _mm_or_si128 (_mm_and_si128 (_mm_slli_si128 (v, 2), m2), _mm_and_si128 (_mm_slli_si128 (v, 3), m3)));
+		_mm_storeu_si128 ((__m128i *) (dst + n), _mm_or_si128 (_mm_and_si128 (p, lane), alpha));
+	}
+	return n;
+}
+
+#endif
+
+void TGAExpand24 (XBYTE4 *dst, const XBYTE *src, int count)
+{
+	int n = 0;
+	#ifdef TGA_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) n = TGAExpand24SSE2 (dst, src, count);
+	#endif
+	TGAExpand24Ref (dst + n, src + n*3, count - n);
+}
+
+// 'count' stored pixels to ARGB
+static inline void TGAPixels (XBYTE4 *dst, const XBYTE *src, int count, int bytes)
+{
+	if (bytes == 4) memcpy (dst, src, count*4);
+	else TGAExpand24 (dst, src, count);
+}
+
+static inline XBYTE4 TGAPixel (const XBYTE *src, int bytes)
+{
+	if (bytes == 4) return src[0] | (src[1] << 8) | (src[2] << 16) | ((XBYTE4) src[3] << 24);
+	return 0xFF000000 | (src[2] << 16) | (src[1] << 8) | src[0];
+}
+
+bool TGADecode (const TGAInfo &info, const XBYTE *stream, int size, XBYTE4 *dst, int pitch)
+{
+	int bytes = info.bpp / 8;
+	const XBYTE *p = stream + info.offset, *end = stream + size;
+
+	// n counts rows in the order they're stored
+	#define TGA_ROW(n)		(dst + ((info.top_down) ? (n) : info.yres-1-(n)) * pitch)
+
+	if (!info.rle) {
+		for (int n=0; n < info.yres; n++) {
+			if (end - p < info.xres * bytes) return false;
+			TGAPixels (TGA_ROW(n), p, info.xres, bytes);
+			p += info.xres * bytes;
+		}
+		return true;
+	}
+
+	// Packets are a count byte and one pixel to repeat (high bit set)
+	// or that many pixels, and may run on into the next row
+	int n = 0, x = 0;
+	XBYTE4 *row = TGA_ROW(0);
+	while (n < info.yres) {
+		if (p >= end) return false;
+		int head = *p++, count = (head & 0x7F) + 1;
+		XBYTE4 v = 0;
+		if (head & 0x80) {
+			if (end - p < bytes) return false;
+			v = TGAPixel (p, bytes);
+			p += bytes;
+		} else if (end - p < count * bytes) {
+			return false;
+		}
+		while (count > 0 && n < info.yres) {
+			int run = (count < info.xres - x) ? count : info.xres - x;
+			if (head & 0x80) {
+				for (int i=0; i < run; i++) row[x+i] = v;
+			} else {
+				TGAPixels (row + x, p, run, bytes);
+				p += run * bytes;
+			}
+			x += run;
+			count -= run;
+			if (x == info.xres) {
+				x = 0;
+				if (++n < info.yres) row = TGA_ROW(n);
+			}
+		}
+	}
+	return true;
+
+	#undef TGA_ROW
+}
+
+#ifdef TGA_TESTER
+
+	// Checks SSE2 against the reference, decodes random images written
+	// plain and run length encoded, and makes sure cut off or garbled
+	// files fail without writing outside the image. Given .tga files,
+	// times the old loader's loops against TGADecode on them. Builds off
+	// Windows:
+	//   g++ -O2 -DTGA_TESTER gamex-tga.cpp gamex-blend.cpp
+	//   ./a.out build/textures/*.tga
+
+	#include <stdio.h>
+	#include <stdlib.h>
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <sys/time.h>
+	#endif
+
+	static double Seconds (void)
+	{
+		#ifdef _WIN32
+			LARGE_INTEGER freq, now;
+			QueryPerformanceFrequency (&freq);
+			QueryPerformanceCounter (&now);
+			return (double) now.QuadPart / (double) freq.QuadPart;
+		#else
+			struct timeval tv;
+			gettimeofday (&tv, NULL);
+			return tv.tv_sec + tv.tv_usec / 1e6;
+		#endif
+	}
+
+	static int Rand (int lo, int hi)	{ return lo + rand () % (hi - lo + 1); }
+
+	#define GUARD		0xDEADBEEF
+
+	// Writes a targa of 'pixels' (ARGB, stored order) into out, returning
+	// its size. Packets ignore rows, as TGA 2.0 allows
+	static int Encode (XBYTE *out, const XBYTE4 *pixels, int xres, int yres, int bpp, bool rle, bool top_down)
+	{
+		int bytes = bpp / 8, size = xres * yres, len = 0;
+		memset (out, 0, TGA_HEADER_SIZE);
+		out[2] = rle ? TGA_TRUECOLOR_RLE : TGA_TRUECOLOR;
+		out[12] = xres & 0xFF; out[13] = xres >> 8;
+		out[14] = yres & 0xFF; out[15] = yres >> 8;
+		out[16] = bpp;
+		out[17] = top_down ? 0x20 : 0;
+		len = TGA_HEADER_SIZE;
+
+		for (int n=0; n < size; ) {
+			int count = 1;
+			if (rle) {
+				while (n + count < size && count < 128 && pixels[n+count] == pixels[n]) count++;
+				if (count > 1) {
+					out[len++] = 0x80 | (count-1);
+				} else {
+					while (n + count < size && count < 128 && pixels[n+count] != pixels[n+count-1]) count++;
+					out[len++] = count-1;
+				}
+			}
+			int repeat = rle && (out[len-1] & 0x80);
+			for (int i=0; i < (repeat ? 1 : count); i++)
+				for (int b=0; b < bytes; b++) out[len++] = (XBYTE) (pixels[n+i] >> (b*8));
+			n += count;
+		}
+		return len;
+	}
+
+	// Random pixels with runs in them, as the decoder would give them back
+	static void FillRuns (XBYTE4 *p, int size, int bpp)
+	{
+		for (int n=0; n < size; ) {
+			XBYTE4 v = (XBYTE4) rand () ^ ((XBYTE4) rand () << 16);
+			if (bpp == 24) v |= 0xFF000000;
+			int run = (rand () % 3 == 0) ? Rand (1, 300) : 1;
+			for (; run > 0 && n < size; run--) p[n++] = v;
+		}
+	}
+
+	static int Test (void)
+	{
+		const int kMax = 70, kPitch = kMax + 4;
+		XBYTE4 *pixels = new XBYTE4[kMax*kMax], *img = new XBYTE4[kPitch*(kMax+1)];
+		XBYTE *file = new XBYTE[TGA_HEADER_SIZE + kMax*kMax*5 + 16];
+		int fails = 0;
+
+		for (int t=0; t < 20000; t++) {
+			int count = Rand (0, 200), at = Rand (0, 3);
+			XBYTE src[600+3];
+			XBYTE4 out[200], ref[200];
+			for (int n=0; n < (int) sizeof (src); n++) src[n] = (XBYTE) rand ();
+			TGAExpand24 (out, src + at, count);
+			TGAExpand24Ref (ref, src + at, count);
+			if (memcmp (out, ref, count*4) != 0) {
+				if (fails++ < 5) printf ("  expand of %d differs\n", count);
+			}
+		}
+
+		for (int t=0; t < 5000; t++) {
+			int xres = Rand (1, kMax), yres = Rand (1, kMax), bpp = (t & 1) ? 32 : 24;
+			bool rle = (t & 2) != 0, top_down = (t & 4) != 0;
+			TGAInfo info;
+			FillRuns (pixels, xres*yres, bpp);
+			int len = Encode (file, pixels, xres, yres, bpp, rle, top_down);
+
+			for (int n=0; n < kPitch*(kMax+1); n++) img[n] = GUARD;
+			if (!TGAReadHeader (info, file, len) || !TGADecode (info, file, len, img, kPitch)) {
+				if (fails++ < 5) printf ("  %dx%d %d bit%s didn't decode\n", xres, yres, bpp, rle ? " rle" : "");
+				continue;
+			}
+			for (int y=0; y < yres; y++) {
+				int stored = top_down ? y : yres-1-y;
+				if (memcmp (img + y*kPitch, pixels + stored*xres, xres*4) != 0) {
+					if (fails++ < 5) printf ("  %dx%d %d bit%s row %d differs\n", xres, yres, bpp, rle ? " rle" : "", y);
+					break;
+				}
+			}
+
+			// Cut off or garbled: never a write outside the image
+			int cut = Rand (0, len-1);
+			if (t & 8) for (int n=TGA_HEADER_SIZE; n < len; n++) if (rand () % 8 == 0) file[n] = (XBYTE) rand ();
+			for (int n=0; n < kPitch*(kMax+1); n++) img[n] = GUARD;
+			bool ok = TGAReadHeader (info, file, cut) && TGADecode (info, file, cut, img, kPitch);
+			if (ok && !(t & 8)) {
+				if (fails++ < 5) printf ("  %dx%d cut to %d of %d bytes still decoded\n", xres, yres, cut, len);
+			}
+			for (int y=0; y <= kMax; y++)
+				for (int x=0; x < kPitch; x++)
+					if ((x >= xres || y >= yres) && img[y*kPitch + x] != GUARD) {
+						if (fails++ < 5) printf ("  %dx%d cut to %d wrote outside at %d,%d\n", xres, yres, cut, x, y);
+						x = kPitch; y = kMax;
+					}
+		}
+		delete [] pixels; delete [] img; delete [] file;
+		return fails;
+	}
+
+	// The old loader: copy the pixels out, swap red and blue, then one
+	// DrawPixel each (a function pointer, as GameX's is)
+	static XBYTE4 *old_dest;
+	static int old_pitch;
+
+	static void OldDrawPixel (int x, int y, int r, int g, int b, int a)
+	{
+		old_dest[y*old_pitch + x] = (a << 24) + (r << 16) + (g << 8) + b;
+	}
+
+	static void (*DrawPixel) (int x, int y, int r, int g, int b, int a) = OldDrawPixel;
+
+	static void DecodeOld (const XBYTE *stream, XBYTE4 *dst, int pitch)
+	{
+		int width = stream[12] + stream[13] * 256, height = stream[14] + stream[15] * 256;
+		int channels = stream[16] / 8, imageSize = width*height*channels;
+		XBYTE *imageData = new XBYTE[imageSize];
+		memcpy (imageData, stream + TGA_HEADER_SIZE, imageSize);
+		for (int i=0; i < imageSize; i += channels) {
+			XBYTE temp = imageData[i];
+			imageData[i] = imageData[i + 2];
+			imageData[i + 2] = temp;
+		}
+		old_dest = dst; old_pitch = pitch;
+		XBYTE *pixel = imageData;
+		for (int i=0; i < height; ++i)
+			for (int j=0; j < width; ++j) {
+				DrawPixel (j, height-1-i, pixel[0], pixel[1], pixel[2], channels == 4 ? pixel[3] : 255);
+				pixel += channels;
+			}
+		delete [] imageData;
+	}
+
+	static void Bench (int argc, char **argv, int best)
+	{
+		const int kPasses = 20;
+		const char *names[4] = { "old", "scalar", "sse2", "sse2 rle" };
+		XBYTE *files[64], *rle[64];
+		int lens[64], rle_lens[64], count = 0, most = 0;
+		double bytes = 0.0, packed = 0.0;
+
+		for (int f=1; f < argc && count < 64; f++) {
+			FILE *fp = fopen (argv[f], "rb");
+			if (fp == NULL) continue;
+			fseek (fp, 0, SEEK_END);
+			int len = (int) ftell (fp);
+			fseek (fp, 0, SEEK_SET);
+			XBYTE *data = new XBYTE[len];
+			TGAInfo info;
+			if ((int) fread (data, 1, len, fp) != len || !TGAReadHeader (info, data, len) || info.rle || info.offset != TGA_HEADER_SIZE) {
+				delete [] data;
+				fclose (fp);
+				continue;
+			}
+			fclose (fp);
+
+			// The same image run length encoded
+			XBYTE4 *pixels = new XBYTE4[info.xres*info.yres];
+			TGADecode (info, data, len, pixels, info.xres);
+			rle[count] = new XBYTE[TGA_HEADER_SIZE + info.xres*info.yres*5];
+			for (int y=0; y < info.yres/2; y++)			// back to stored order
+				for (int x=0; x < info.xres; x++) {
+					XBYTE4 t = pixels[y*info.xres + x];
+					pixels[y*info.xres + x] = pixels[(info.yres-1-y)*info.xres + x];
+					pixels[(info.yres-1-y)*info.xres + x] = t;
+				}
+			rle_lens[count] = Encode (rle[count], pixels, info.xres, info.yres, info.bpp, true, false);
+			delete [] pixels;
+
+			files[count] = data;
+			lens[count] = len;
+			if (info.xres * info.yres > most) most = info.xres * info.yres;
+			bytes += len;
+			packed += rle_lens[count];
+			count++;
+		}
+		if (count == 0) {
+			printf ("pass the texture pack's .tga files to time decoding it\n");
+			return;
+		}
+
+		XBYTE4 *img = new XBYTE4[most];
+		printf ("pack of %d, %.2f MB (%.2f MB run length encoded)\n", count, bytes / 1e6, packed / 1e6);
+		for (int way=0; way < 4; way++) {
+			if (way >= 2 && best < BLEND_SSE2) continue;
+			BlendSetLevel ((way >= 2) ? BLEND_SSE2 : BLEND_SCALAR);
+			double start = Seconds ();
+			for (int pass=0; pass < kPasses; pass++)
+				for (int f=0; f < count; f++) {
+					TGAInfo info;
+					XBYTE *data = (way == 3) ? rle[f] : files[f];
+					int len = (way == 3) ? rle_lens[f] : lens[f];
+					TGAReadHeader (info, data, len);
+					if (way == 0) DecodeOld (data, img, info.xres);
+					else TGADecode (info, data, len, img, info.xres);
+				}
+			double secs = (Seconds () - start) / kPasses;
+			printf ("%-10s %7.2f ms  %8.1f MB/s\n", names[way], secs * 1000.0, bytes / secs / 1e6);
+		}
+		for (int f=0; f < count; f++) { delete [] files[f]; delete [] rle[f]; }
+		delete [] img;
+	}
+
+	int main (int argc, char **argv)
+	{
+		int best = BlendGetLevel (), fails = 0;
+		srand (1234);
+		BlendSetLevel (best);
+		if (best >= BLEND_SSE2) fails += Test ();
+		BlendSetLevel (BLEND_SCALAR);
+		fails += Test ();
+		printf ("%s: %d mismatches\n", fails ? "FAILED" : "OK", fails);
+		Bench (argc, argv, best);
+		return fails ? 1 : 0;
+	}
+
+#endif
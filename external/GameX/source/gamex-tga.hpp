@@ -0,0 +1,52 @@
+//
+// GameX - Targa Decoder Header
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#ifndef TGA_DEF
+	#define TGA_DEF
+
+	// #define TGA_TESTER
+
+	// Decodes 24 and 32-bit true color .tga files, plain or run length
+	// encoded, from memory straight into rows of 32-bit ARGB pixels, such
+	// as an ImageX's surface. A 32-bit targa's pixels are already ARGB
+	// and are copied as they are; 24-bit ones get an alpha of 255, with
+	// SSE2 doing 4 pixels at a time. Like the blend kernels this has no
+	// DirectX or Windows in it.
+
+	#include "gamex-blend.hpp"
+
+	#define TGA_HEADER_SIZE		18
+
+	#define TGA_TRUECOLOR		2			// Image types handled
+	#define TGA_TRUECOLOR_RLE	10
+
+	class TGAInfo {
+	public:
+		int xres, yres;
+		int bpp;								// 24 or 32
+		bool rle;
+		bool top_down;							// Rows stored top row first (most are bottom first)
+		int offset;								// Where the pixels start
+	};
+
+	// Reads the header; false if it isn't a targa this decodes
+	bool TGAReadHeader (TGAInfo &info, const XBYTE *stream, int size);
+
+	// Decodes the image into dst, top row first, rows 'pitch' pixels
+	// apart. False if the stream runs out first, in which case the
+	// rest of dst is left alone
+	bool TGADecode (const TGAInfo &info, const XBYTE *stream, int size, XBYTE4 *dst, int pitch);
+
+	// b,g,r bytes to 0xFFrrggbb pixels
+	void TGAExpand24 (XBYTE4 *dst, const XBYTE *src, int count);
+	void TGAExpand24Ref (XBYTE4 *dst, const XBYTE *src, int count);
+
+#endif
@@ -0,0 +1,236 @@
+//
+// GameX - Thread Pool Class Code
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#include "gamex-thread.hpp"
+
+#ifndef _WIN32
+	#include <unistd.h>
+#endif
+
+ThreadPool::ThreadPool (int num)
+{
+	if (num <= 0) num = GetNumProcessors ();
+	pending = 0;
+	quit = false;
+
+	#ifdef _WIN32
+		InitializeCriticalSection (&lock);
+		work_sem = CreateSemaphore (NULL, 0, 0x7FFFFFFF, NULL);
+		idle_event = CreateEvent (NULL, TRUE, TRUE, NULL);		// Manual reset, starts idle
+		done_event = CreateEvent (NULL, FALSE, FALSE, NULL);	// Auto reset
+		for (int n=0; n < num; n++) {
+			HANDLE h = CreateThread (NULL, 0, WorkerProc, this, 0, NULL);
+			if (h != NULL) threads.push_back (h);
+		}
+	#else
+		pthread_mutex_init (&lock, NULL);
+		pthread_cond_init (&work_cond, NULL);
+		pthread_cond_init (&done_cond, NULL);
+		for (int n=0; n < num; n++) {
+			pthread_t t;
+			if (pthread_create (&t, NULL, WorkerProc, this) == 0) threads.push_back (t);
+		}
+	#endif
+}
+
+ThreadPool::~ThreadPool ()
+{
+	Wait ();
+
+	Lock ();
+	quit = true;
+	Unlock ();
+
+	#ifdef _WIN32
+		ReleaseSemaphore (work_sem, (LONG) threads.size(), NULL);
+		for (int n=0; n < (int) threads.size(); n++) {
+			WaitForSingleObject (threads[n], INFINITE);
+			CloseHandle (threads[n]);
+		}
+		CloseHandle (work_sem);
+		CloseHandle (idle_event);
+		CloseHandle (done_event);
+		DeleteCriticalSection (&lock);
+	#else
+		pthread_mutex_lock (&lock);
+		pthread_cond_broadcast (&work_cond);
+		pthread_mutex_unlock (&lock);
+		for (int n=0; n < (int) threads.size(); n++)
+			pthread_join (threads[n], NULL);
+		pthread_cond_destroy (&work_cond);
+		pthread_cond_destroy (&done_cond);
+		pthread_mutex_destroy (&lock);
+	#endif
+}
+
+int ThreadPool::GetNumProcessors (void)
+{
+	#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo (&info);
+		return (info.dwNumberOfProcessors > 0) ? (int) info.dwNumberOfProcessors : 1;
+	#else
+		long n = sysconf (_SC_NPROCESSORS_ONLN);
+		return (n > 0) ? (int) n : 1;
+	#endif
+}
+
+void ThreadPool::Lock (void)
+{
+	#ifdef _WIN32
+		EnterCriticalSection (&lock);
+	#else
+		pthread_mutex_lock (&lock);
+	#endif
+}
+
+void ThreadPool::Unlock (void)
+{
+	#ifdef _WIN32
+		LeaveCriticalSection (&lock);
+	#else
+		pthread_mutex_unlock (&lock);
+	#endif
+}
+
+void ThreadPool::AddJob (ThreadJob *job)
+{
+	job->job_done = 0;
+
+	// Without threads the caller does the work
+	if (threads.size() == 0) {
+		job->Run ();
+		job->job_done = 1;
+		return;
+	}
+
+	Lock ();
+	queue.push_back (job);
+	#ifdef _WIN32
+		if (pending++ == 0) ResetEvent (idle_event);
+		Unlock ();
+		ReleaseSemaphore (work_sem, 1, NULL);
+	#else
+		pending++;
+		pthread_cond_signal (&work_cond);
+		Unlock ();
+	#endif
+}
+
+void ThreadPool::WaitJob (ThreadJob *job)
+{
+	#ifdef _WIN32
+		// done_event stays set if it fires between the test and the wait
+		while (!job->IsDone ())
+			WaitForSingleObject (done_event, INFINITE);
+	#else
+		Lock ();
+		while (!job->IsDone ())
+			pthread_cond_wait (&done_cond, &lock);
+		Unlock ();
+	#endif
+}
+
+void ThreadPool::Wait (void)
+{
+	#ifdef _WIN32
+		WaitForSingleObject (idle_event, INFINITE);
+	#else
+		Lock ();
+		while (pending > 0)
+			pthread_cond_wait (&done_cond, &lock);
+		Unlock ();
+	#endif
+}
+
+void ThreadPool::WorkerLoop (void)
+{
+	for (;;) {
+		#ifdef _WIN32
+			WaitForSingleObject (work_sem, INFINITE);
+			Lock ();
+		#else
+			Lock ();
+			while (!quit && queue.empty())
+				pthread_cond_wait (&work_cond, &lock);
+		#endif
+
+		if (queue.empty()) {							// Only woken empty to quit
+			Unlock ();
+			return;
+		}
+		ThreadJob *job = queue.front ();
+		queue.pop_front ();
+		Unlock ();
+
+		job->Run ();
+
+		Lock ();
+		job->job_done = 1;
+		pending--;
+		#ifdef _WIN32
+			if (pending == 0) SetEvent (idle_event);
+			Unlock ();
+			SetEvent (done_event);
+		#else
+			pthread_cond_broadcast (&done_cond);
+			Unlock ();
+		#endif
+	}
+}
+
+#ifdef _WIN32
+	DWORD WINAPI ThreadPool::WorkerProc (LPVOID param)
+	{
+		((ThreadPool*) param)->WorkerLoop ();
+		return 0;
+	}
+#else
+	void *ThreadPool::WorkerProc (void *param)
+	{
+		((ThreadPool*) param)->WorkerLoop ();
+		return NULL;
+	}
+#endif
+
+#ifdef THREAD_TESTER
+
+	#include <stdio.h>
+
+	class SumJob : public ThreadJob {
+	public:
+		int from, to;
+		double sum;
+		void Run (void)		{ sum = 0; for (int n=from; n < to; n++) sum += n; }
+	};
+
+	int main (void)
+	{
+		ThreadPool pool;
+		SumJob jobs[64];
+		double total = 0;
+
+		for (int n=0; n < 64; n++) {
+			jobs[n].from = n * 100000;
+			jobs[n].to = (n+1) * 100000;
+			pool.AddJob (&jobs[n]);
+		}
+		pool.WaitJob (&jobs[0]);
+		pool.Wait ();
+		for (int n=0; n < 64; n++) total += jobs[n].sum;
+
+		double expected = 6400000.0 * 6399999.0 / 2.0;
+		printf ("%d threads, sum %.0f (expected %.0f)\n", pool.GetNumThreads(), total, expected);
+		printf ("%s\n", total == expected ? "OK" : "FAILED");
+		return total == expected ? 0 : 1;
+	}
+
+#endif
@@ -0,0 +1,83 @@
+//
+// GameX - Thread Pool Class Header
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#ifndef THREAD_DEF
+	#define THREAD_DEF
+
+	// #define THREAD_TESTER
+
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <pthread.h>
+	#endif
+
+	#include <deque>
+	#include <vector>
+
+	// A unit of work for the pool. The pool does not own jobs,
+	// the caller keeps them alive until they are done.
+	class ThreadJob {
+	public:
+		ThreadJob (void)			{ job_done = 0; }
+		virtual ~ThreadJob ()		{}
+
+		virtual void Run (void) = 0;						// Do the work (on a pool thread)
+
+		bool IsDone (void)			{ return job_done != 0; }
+
+	private:
+		friend class ThreadPool;
+		volatile long job_done;
+	};
+
+	class ThreadPool {
+	public:
+		ThreadPool (int num = 0);							// Start 'num' threads, 0 = one per processor
+		~ThreadPool ();										// Finish queued jobs and stop threads
+
+		void AddJob (ThreadJob *job);						// Queue a job
+		void WaitJob (ThreadJob *job);						// Block until one job is done
+		void Wait (void);									// Block until every queued job is done
+
+		int GetNumThreads (void)	{ return (int) threads.size(); }
+		static int GetNumProcessors (void);
+
+	private:
+		void Lock (void);
+		void Unlock (void);
+		void WorkerLoop (void);
+
+		#ifdef _WIN32
+			static DWORD WINAPI WorkerProc (LPVOID param);
+		#else
+			static void *WorkerProc (void *param);
+		#endif
+
+		std::deque<ThreadJob*> queue;						// Jobs not yet started
+		int pending;										// Jobs queued or running
+		bool quit;
+
+		#ifdef _WIN32
+			CRITICAL_SECTION lock;
+			HANDLE work_sem;								// One count per queued job
+			HANDLE idle_event;								// Set while nothing is pending
+			HANDLE done_event;								// Pulsed as each job finishes
+			std::vector<HANDLE> threads;
+		#else
+			pthread_mutex_t lock;
+			pthread_cond_t work_cond;
+			pthread_cond_t done_cond;
+			std::vector<pthread_t> threads;
+		#endif
+	};
+
+#endif
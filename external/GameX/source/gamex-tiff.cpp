@@ -0,0 +1,813 @@
+//
+// GameX - TIFF Decoder Code
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#include "gamex-tiff.hpp"
+#include "gamex-thread.hpp"
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define TIFF_HAS_SSE2
+	#include <emmintrin.h>
+#endif
+
+#ifdef __GNUC__
+	#define TIFF_SSE2_FUNC	__attribute__ ((target ("sse2")))
+#else
+	#define TIFF_SSE2_FUNC
+#endif
+
+//---------------------------------------------------------------- Header
+
+static inline XBYTE4 TIFFGet (const XBYTE *p, int bytes, bool big)
+{
+	if (bytes == 2) return big ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+	if (big) return ((XBYTE4) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((XBYTE4) p[3] << 24);
+}
+
+// A directory entry's values: in its last 4 bytes if they fit there,
+// or wherever those point. False for types that aren't numbers
+static bool TIFFReadValues (FileReader &file, const XBYTE *entry, bool big, std::vector<XBYTE4> &values)
+{
+	int type = TIFFGet (entry + 2, 2, big);
+	XBYTE4 count = TIFFGet (entry + 4, 4, big);
+	int size = (type == TIFF_TYPE_BYTE) ? 1 : (type == TIFF_TYPE_SHORT) ? 2 : (type == TIFF_TYPE_LONG) ? 4 : 0;
+	if (size == 0 || count == 0 || count > (1 << 24)) return false;
+
+	std::vector<XBYTE> raw (count * size);
+	if (count * size <= 4) memcpy (&raw[0], entry + 8, count * size);
+	else {
+		file.SetPosition ((long) TIFFGet (entry + 8, 4, big));
+		if (file.Read (count * size, &raw[0]) != FILE_STATUS_OK) return false;
+	}
+
+	values.resize (count);
+	for (XBYTE4 n=0; n < count; n++) values[n] = (size == 1) ? raw[n] : TIFFGet (&raw[n*size], size, big);
+	return true;
+}
+
+bool TIFFReadHeader (TIFFInfo &info, FileReader &file)
+{
+	info.xres = info.yres = 0;
+	info.channels = 0;
+	info.bits = 1;
+	info.compression = TIFF_COMPRESS_NONE;
+	info.photometric = -1;
+	info.big_endian = false;
+	info.alpha = false;
+	info.rows_per_strip = 0;
+	info.offsets.clear ();
+	info.counts.clear ();
+
+	XBYTE head[8];
+	file.SetPosition (FILE_POS_BEGIN);
+	if (file.Read (8, head) != FILE_STATUS_OK) return false;
+	if (head[0] == 'M' && head[1] == 'M') info.big_endian = true;
+	else if (head[0] != 'I' || head[1] != 'I') return false;
+	bool big = info.big_endian;
+	if (TIFFGet (head + 2, 2, big) != TIFF_MAGIC) return false;
+
+	XBYTE two[2];
+	file.SetPosition ((long) TIFFGet (head + 4, 4, big));
+	if (file.Read (2, two) != FILE_STATUS_OK) return false;
+	int num = TIFFGet (two, 2, big);
+	if (num == 0) return false;
+	std::vector<XBYTE> entries (num * 12);
+	if (file.Read (num * 12, &entries[0]) != FILE_STATUS_OK) return false;
+
+	std::vector<XBYTE4> values, bits;
+	int samples = 0, planar = 1;
+	for (int n=0; n < num; n++) {
+		const XBYTE *e = &entries[n*12];
+		if (!TIFFReadValues (file, e, big, values)) continue;		// names, resolutions, ...
+		switch (TIFFGet (e, 2, big)) {
+		case TIFF_TAG_IMAGEWIDTH:		info.xres = (int) values[0]; break;
+		case TIFF_TAG_IMAGEHEIGHT:		info.yres = (int) values[0]; break;
+		case TIFF_TAG_BITSPERSAMPLE:	bits = values; break;
+		case TIFF_TAG_COMPRESSION:		info.compression = (int) values[0]; break;
+		case TIFF_TAG_PHOTOMETRIC:		info.photometric = (int) values[0]; break;
+		case TIFF_TAG_STRIPOFFSETS:		info.offsets = values; break;
+		case TIFF_TAG_SAMPLESPERPIXEL:	samples = (int) values[0]; break;
+		case TIFF_TAG_ROWSPERSTRIP:		info.rows_per_strip = (int) values[0]; break;
+		case TIFF_TAG_STRIPBYTECOUNTS:	info.counts = values; break;
+		case TIFF_TAG_PLANARCONFIG:		planar = (int) values[0]; break;
+		}
+	}
+
+	// Every channel has to be the same size
+	info.channels = (samples > 0) ? samples : (int) bits.size ();
+	if (!bits.empty ()) info.bits = (int) bits[0];
+	for (size_t n=1; n < bits.size (); n++)
+		if ((int) bits[n] != info.bits) return false;
+
+	info.alpha = (info.channels == 2 || info.channels == 4);
+	if (info.photometric < 0) info.photometric = (info.channels >= 3) ? TIFF_PHOTO_RGB : TIFF_PHOTO_BLACKZERO;
+	if (info.rows_per_strip <= 0 || info.rows_per_strip > info.yres) info.rows_per_strip = info.yres;
+
+	if (info.xres <= 0 || info.yres <= 0 || (XBYTE8) info.xres * info.yres > (1 << 28)) return false;
+	if (info.compression != TIFF_COMPRESS_NONE || planar != 1) return false;
+	if (info.photometric == TIFF_PHOTO_RGB) {
+		if (info.channels != 3 && info.channels != 4) return false;
+	} else if (info.photometric == TIFF_PHOTO_WHITEZERO || info.photometric == TIFF_PHOTO_BLACKZERO) {
+		if (info.channels != 1 && info.channels != 2) return false;
+	} else return false;
+	if (info.bits != 8 && info.bits != 16 && info.bits != 32 && !(info.bits == 1 && info.channels == 1)) return false;
+
+	size_t strips = (info.yres + info.rows_per_strip - 1) / info.rows_per_strip;
+	return info.offsets.size () >= strips && info.counts.size () >= strips;
+}
+
+//---------------------------------------------------------------- Kernels
+
+void TIFFGrayToRGBRef (XBYTE *dst, const XBYTE *src, int count)
+{
+	for (int n=0; n < count; n++, dst += 3)
+		dst[0] = dst[1] = dst[2] = src[n];
+}
+
+void TIFFSplitAlphaRef (XBYTE *rgb, XBYTE *alpha, const XBYTE *src, int count)
+{
+	for (int n=0; n < count; n++, src += 4, rgb += 3) {
+		rgb[0] = src[0];
+		rgb[1] = src[1];
+		rgb[2] = src[2];
+		alpha[n] = src[3];
+	}
+}
+
+void TIFFNarrowRef (XBYTE *dst, const XBYTE *src, int count, int src_bytes, bool big_endian)
+{
+	const XBYTE *top = big_endian ? src : src + src_bytes - 1;
+	for (int n=0; n < count; n++) dst[n] = top[n * src_bytes];
+}
+
+#ifdef TIFF_HAS_SSE2
+
+// The low 3 bytes of each lane, packed into the low 12: lane k is
+// shifted down k bytes. The top 4 bytes are left zero, for the next
+// store to write over, so callers stop 2 pixels short of the end
+TIFF_SSE2_FUNC static inline __m128i TIFFPack24 (__m128i v)
+{
+	__m128i m0 = _mm_setr_epi32 (0x00FFFFFF, 0, 0, 0), m1 = _mm_setr_epi32 (0, 0x00FFFFFF, 0, 0);
+	__m128i m2 = _mm_setr_epi32 (0, 0, 0x00FFFFFF, 0), m3 = _mm_setr_epi32 (0, 0, 0, 0x00FFFFFF);
+	return _mm_or_si128 (_mm_or_si128 (_mm_and_si128 (v, m0), _mm_srli_si128 (_mm_and_si128 (v, m1), 1)),
+						 _mm_or_si128 (_mm_srli_si128 (_mm_and_si128 (v, m2), 2), _mm_srli_si128 (_mm_and_si128 (v, m3), 3)));
+}
+
+// 16 gray bytes a pass, widened to a lane each and copied into its
+// green and blue bytes
+TIFF_SSE2_FUNC static int TIFFGrayToRGBSSE2 (XBYTE *dst, const XBYTE *src, int count)
+{
+	__m128i zero = _mm_setzero_si128 ();
+	int n = 0;
+	for (; n + 18 <= count; n += 16) {
+		__m128i g = _mm_loadu_si128 ((__m128i *) (src + n));
+		__m128i lo = _mm_unpacklo_epi8 (g, zero), hi = _mm_unpackhi_epi8 (g, zero);
+		__m128i q[4];
+		q[0] = _mm_unpacklo_epi16 (lo, zero);
+		q[1] = _mm_unpackhi_epi16 (lo, zero);
+		q[2] = _mm_unpacklo_epi16 (hi, zero);
+		q[3] = _mm_unpackhi_epi16 (hi, zero);
+		for (int k=0; k < 4; k++) {
+			__m128i v = _mm_or_si128 (q[k], _mm_or_si128 (_mm_slli_epi32 (q[k], 8), _mm_slli_epi32 (q[k], 16)));
+			_mm_storeu_si128 ((__m128i *) (dst + n*3 + k*12), TIFFPack24 (v));
+		}
+	}
+	return n;
+}
+
+// 16 pixels a pass: the alphas are the lanes' top bytes, packed down
+TIFF_SSE2_FUNC static int TIFFSplitAlphaSSE2 (XBYTE *rgb, XBYTE *alpha, const XBYTE *src, int count)
+{
+	int n = 0;
+	for (; n + 18 <= count; n += 16) {
+		__m128i p[4];
+		for (int k=0; k < 4; k++) {
+			p[k] = _mm_loadu_si128 ((__m128i *) (src + n*4 + k*16));
+			_mm_storeu_si128 ((__m128i *) (rgb + n*3 + k*12), TIFFPack24 (p[k]));
+		}
+		__m128i lo = _mm_packs_epi32 (_mm_srli_epi32 (p[0], 24), _mm_srli_epi32 (p[1], 24));
+		__m128i hi = _mm_packs_epi32 (_mm_srli_epi32 (p[2], 24), _mm_srli_epi32 (p[3], 24));
+		_mm_storeu_si128 ((__m128i *) (alpha + n), _mm_packus_epi16 (lo, hi));
+	}
+	return n;
+}
+
+// 16 samples a pass, each cut to its top byte and packed down
+TIFF_SSE2_FUNC static int TIFFNarrow16SSE2 (XBYTE *dst, const XBYTE *src, int count, bool big_endian)
+{
+	__m128i low = _mm_set1_epi16 (0x00FF);
+	int n = 0;
+	for (; n + 16 <= count; n += 16) {
+		__m128i a = _mm_loadu_si128 ((__m128i *) (src + n*2)), b = _mm_loadu_si128 ((__m128i *) (src + n*2 + 16));
+		if (big_endian) a = _mm_and_si128 (a, low), b = _mm_and_si128 (b, low);
+		else a = _mm_srli_epi16 (a, 8), b = _mm_srli_epi16 (b, 8);
+		_mm_storeu_si128 ((__m128i *) (dst + n), _mm_packus_epi16 (a, b));
+	}
+	return n;
+}
+
+TIFF_SSE2_FUNC static int TIFFNarrow32SSE2 (XBYTE *dst, const XBYTE *src, int count, bool big_endian)
+{
+	__m128i low = _mm_set1_epi32 (0x000000FF);
+	int n = 0;
+	for (; n + 16 <= count; n += 16) {
+		__m128i v[4];
+		for (int k=0; k < 4; k++) {
+			v[k] = _mm_loadu_si128 ((__m128i *) (src + n*4 + k*16));
+			v[k] = big_endian ? _mm_and_si128 (v[k], low) : _mm_srli_epi32 (v[k], 24);
+		}
+		_mm_storeu_si128 ((__m128i *) (dst + n), _mm_packus_epi16 (_mm_packs_epi32 (v[0], v[1]), _mm_packs_epi32 (v[2], v[3])));
+	}
+	return n;
+}
+
+#endif
+
+void TIFFGrayToRGB (XBYTE *dst, const XBYTE *src, int count)
+{
+	int n = 0;
+	#ifdef TIFF_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) n = TIFFGrayToRGBSSE2 (dst, src, count);
+	#endif
+	TIFFGrayToRGBRef (dst + n*3, src + n, count - n);
+}
+
+void TIFFSplitAlpha (XBYTE *rgb, XBYTE *alpha, const XBYTE *src, int count)
+{
+	int n = 0;
+	#ifdef TIFF_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) n = TIFFSplitAlphaSSE2 (rgb, alpha, src, count);
+	#endif
+	TIFFSplitAlphaRef (rgb + n*3, alpha + n, src + n*4, count - n);
+}
+
+void TIFFNarrow (XBYTE *dst, const XBYTE *src, int count, int src_bytes, bool big_endian)
+{
+	int n = 0;
+	#ifdef TIFF_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) {
+			if (src_bytes == 2) n = TIFFNarrow16SSE2 (dst, src, count, big_endian);
+			else if (src_bytes == 4) n = TIFFNarrow32SSE2 (dst, src, count, big_endian);
+		}
+	#endif
+	TIFFNarrowRef (dst + n, src + n*src_bytes, count - n, src_bytes, big_endian);
+}
+
+//---------------------------------------------------------------- Strips
+
+static inline int TIFFRowBytes (const TIFFInfo &info)
+{
+	return (int) (((XBYTE8) info.xres * info.channels * info.bits + 7) / 8);
+}
+
+void TIFFDecodeStrip (const TIFFInfo &info, const XBYTE *src, int size, int row, XBYTE *rgb, XBYTE *alpha)
+{
+	int xres = info.xres, channels = info.channels, samples = xres * channels;
+	int bpr = TIFFRowBytes (info);
+	int rows = info.rows_per_strip;
+	if (rows > info.yres - row) rows = info.yres - row;
+	if (rows > size / bpr) rows = size / bpr;
+	if (rows <= 0) return;
+
+	// Rows that aren't 8-bit already, or are inverted, are put right in
+	// tmp first; alpha with nowhere to go lands in drop
+	bool invert = (info.photometric == TIFF_PHOTO_WHITEZERO);
+	XBYTE *tmp = (info.bits != 8 || invert) ? new XBYTE[samples] : NULL;
+	XBYTE *drop = (info.alpha && alpha == NULL) ? new XBYTE[xres] : NULL;
+
+	for (int y=0; y < rows; y++) {
+		const XBYTE *in = src + y * bpr;
+		XBYTE *out = rgb + (size_t) (row + y) * xres * 3;
+		XBYTE *out_alpha = (alpha != NULL) ? alpha + (size_t) (row + y) * xres : drop;
+
+		const XBYTE *s = in;
+		if (info.bits == 1) {
+			for (int x=0; x < xres; x++) tmp[x] = ((in[x >> 3] >> (7 - (x & 7))) & 1) ? 255 : 0;
+			s = tmp;
+		} else if (info.bits != 8) {
+			TIFFNarrow (tmp, in, samples, info.bits / 8, info.big_endian);
+			s = tmp;
+		}
+		if (invert) {
+			if (s != tmp) memcpy (tmp, s, samples);
+			for (int n=0; n < samples; n += channels) tmp[n] = 255 - tmp[n];		// gray only, not alpha
+			s = tmp;
+		}
+
+		switch (channels) {
+		case 1: TIFFGrayToRGB (out, s, xres); break;
+		case 2:
+			for (int x=0; x < xres; x++) {
+				out[x*3] = out[x*3+1] = out[x*3+2] = s[x*2];
+				out_alpha[x] = s[x*2+1];
+			}
+			break;
+		case 3: memcpy (out, s, xres * 3); break;
+		case 4: TIFFSplitAlpha (out, out_alpha, s, xres); break;
+		}
+	}
+
+	delete [] tmp;
+	delete [] drop;
+}
+
+class TIFFStripJob : public ThreadJob {
+public:
+	const TIFFInfo *info;
+	const XBYTE *src;
+	int size, row;
+	XBYTE *rgb, *alpha;
+	void Run (void)		{ TIFFDecodeStrip (*info, src, size, row, rgb, alpha); }
+};
+
+// Started the first time an image is big enough to split, and stopped
+// with the program. Images load on the main thread, so creating it
+// needs no lock
+static ThreadPool *tiff_pool = NULL;
+
+static class TIFFPoolOwner {
+public:
+	~TIFFPoolOwner ()	{ delete tiff_pool; tiff_pool = NULL; }
+} tiff_pool_owner;
+
+// Each job decodes its strip where it lies in the mapped file
+static bool TIFFDecodeMapped (const TIFFInfo &info, FileReader &file, XBYTE *rgb, XBYTE *alpha, int strips, bool split)
+{
+	const XBYTE *data = file.GetData ();
+	XBYTE4 size = (XBYTE4) file.GetSize ();
+	TIFFStripJob *jobs = new TIFFStripJob[strips];
+	bool ok = true;
+
+	for (int s=0; s < strips; s++) {
+		XBYTE4 offset = info.offsets[s], count = info.counts[s];
+		if (offset > size) offset = size;
+		if (count > size - offset) count = size - offset, ok = false;
+		jobs[s].info = &info;
+		jobs[s].src = data + offset;
+		jobs[s].size = (int) count;
+		jobs[s].row = s * info.rows_per_strip;
+		jobs[s].rgb = rgb;
+		jobs[s].alpha = alpha;
+		if (split) tiff_pool->AddJob (&jobs[s]);
+		else jobs[s].Run ();
+	}
+
+	if (split) tiff_pool->Wait ();
+	delete [] jobs;
+	return ok;
+}
+
+bool TIFFDecode (const TIFFInfo &info, FileReader &file, XBYTE *rgb, XBYTE *alpha, bool threads)
+{
+	int strips = (info.yres + info.rows_per_strip - 1) / info.rows_per_strip;
+	bool split = threads && strips > 1 && info.xres * info.yres >= TIFF_SPLIT && ThreadPool::GetNumProcessors () >= 2;
+	if (split && tiff_pool == NULL) tiff_pool = new ThreadPool;
+	if (file.GetData () != NULL) return TIFFDecodeMapped (info, file, rgb, alpha, strips, split);
+
+	// Two batches: one being decoded while the other is read
+	std::vector<XBYTE> buf[2];
+	TIFFStripJob *jobs[2] = { NULL, NULL };
+	int cur = 0, strip = 0;
+	bool ok = true;
+
+	while (strip < strips) {
+		int first = strip;
+		XBYTE8 bytes = 0;
+		while (strip < strips && (strip == first || bytes + info.counts[strip] <= TIFF_BATCH)) bytes += info.counts[strip++];
+		buf[cur].resize ((size_t) bytes + 1);
+
+		delete [] jobs[cur];
+		jobs[cur] = new TIFFStripJob[strip - first];
+
+		// Strips that follow each other in the file are read together
+		size_t at = 0;
+		for (int s=first; s < strip; ) {
+			int end = s + 1;
+			size_t run = info.counts[s];
+			while (end < strip && info.offsets[end] == info.offsets[end-1] + info.counts[end-1]) run += info.counts[end++];
+
+			size_t got = 0;
+			if (run > 0) {
+				file.SetPosition ((long) info.offsets[s]);
+				if (file.Read ((int) run, &buf[cur][at]) != FILE_STATUS_OK) ok = false;
+				got = (file.GetPosition () > (long) info.offsets[s]) ? file.GetPosition () - info.offsets[s] : 0;
+			}
+
+			for (; s < end; s++) {
+				TIFFStripJob &job = jobs[cur][s - first];
+				job.info = &info;
+				job.src = &buf[cur][at];
+				job.size = (int) ((got < info.counts[s]) ? got : info.counts[s]);
+				job.row = s * info.rows_per_strip;
+				job.rgb = rgb;
+				job.alpha = alpha;
+				got = (got > info.counts[s]) ? got - info.counts[s] : 0;
+				at += info.counts[s];
+			}
+		}
+
+		// The batch before has to be done with its buffer before it's reused
+		if (split) tiff_pool->Wait ();
+		for (int n=0; n < strip - first; n++) {
+			if (split) tiff_pool->AddJob (&jobs[cur][n]);
+			else jobs[cur][n].Run ();
+		}
+		cur ^= 1;
+	}
+
+	if (split) tiff_pool->Wait ();
+	delete [] jobs[0];
+	delete [] jobs[1];
+	return ok;
+}
+
+#ifdef TIFF_TESTER
+
+	// Checks SSE2 against the reference, decodes random tiffs of every
+	// kind handled (both byte orders, strip tables of shorts or longs,
+	// strips out of order) read or mapped, on one thread and on the
+	// pool, and makes sure cut off files fail. Then times the old
+	// loader's way (a read per row, a byte at a time) against
+	// TIFFDecode on large multi-strip images, counting the reads made of
+	// the OS (from /proc/self/io where there is one). Builds off Windows:
+	//   g++ -O2 -DTIFF_TESTER gamex-tiff.cpp gamex-file.cpp gamex-debug.cpp gamex-thread.cpp gamex-blend.cpp -lpthread
+
+	#include <stdlib.h>
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <sys/time.h>
+	#endif
+
+	static double Seconds (void)
+	{
+		#ifdef _WIN32
+			LARGE_INTEGER freq, now;
+			QueryPerformanceFrequency (&freq);
+			QueryPerformanceCounter (&now);
+			return (double) now.QuadPart / (double) freq.QuadPart;
+		#else
+			struct timeval tv;
+			gettimeofday (&tv, NULL);
+			return tv.tv_sec + tv.tv_usec / 1e6;
+		#endif
+	}
+
+	static int Rand (int lo, int hi)	{ return lo + rand () % (hi - lo + 1); }
+
+	// Reads the OS has done for this process so far, or -1
+	static long SysReads (void)
+	{
+		FILE *fp = fopen ("/proc/self/io", "r");
+		if (fp == NULL) return -1;
+		char line[128];
+		long reads = -1;
+		while (fgets (line, sizeof (line), fp) != NULL)
+			if (strncmp (line, "syscr:", 6) == 0) reads = atol (line + 6);
+		fclose (fp);
+		return reads;
+	}
+
+	static int Check (bool ok, const char *what)
+	{
+		if (!ok) printf ("  %s\n", what);
+		return ok ? 0 : 1;
+	}
+
+	#define GUARD		0xA5
+
+	static int TestKernels (void)
+	{
+		XBYTE src[4*300], out[4*300 + 16], ref[4*300 + 16], a_out[300 + 16], a_ref[300 + 16];
+		int fails = 0;
+
+		for (int t=0; t < 20000; t++) {
+			int count = Rand (0, 300), bytes = Rand (0, 1) ? 2 : 4;
+			bool big = Rand (0, 1) != 0;
+			for (int n=0; n < 4*300; n++) src[n] = (XBYTE) Rand (0, 255);
+
+			memset (out, GUARD, sizeof (out)); memset (ref, GUARD, sizeof (ref));
+			TIFFGrayToRGB (out, src, count);
+			TIFFGrayToRGBRef (ref, src, count);
+			if (memcmp (out, ref, sizeof (out)) != 0 && fails++ < 5) printf ("  gray to rgb of %d differs\n", count);
+
+			memset (out, GUARD, sizeof (out)); memset (ref, GUARD, sizeof (ref));
+			memset (a_out, GUARD, sizeof (a_out)); memset (a_ref, GUARD, sizeof (a_ref));
+			TIFFSplitAlpha (out, a_out, src, count);
+			TIFFSplitAlphaRef (ref, a_ref, src, count);
+			if ((memcmp (out, ref, sizeof (out)) != 0 || memcmp (a_out, a_ref, sizeof (a_out)) != 0) && fails++ < 5)
+				printf ("  split alpha of %d differs\n", count);
+
+			memset (out, GUARD, sizeof (out)); memset (ref, GUARD, sizeof (ref));
+			TIFFNarrow (out, src, count, bytes, big);
+			TIFFNarrowRef (ref, src, count, bytes, big);
+			if (memcmp (out, ref, sizeof (out)) != 0 && fails++ < 5) printf ("  narrow of %d x %d differs\n", count, bytes);
+		}
+		return fails;
+	}
+
+	static void Put (XBYTE *p, XBYTE4 v, int bytes, bool big)
+	{
+		for (int b=0; b < bytes; b++) p[big ? bytes - 1 - b : b] = (XBYTE) (v >> (b * 8));
+	}
+
+	class TestImage {
+	public:
+		int xres, yres, channels, bits, rps, photometric;
+		bool big, long_tables, shuffle;
+		std::vector<XBYTE> rows;				// As they are in the file, top row first
+	};
+
+	static int RowBytes (const TestImage &img)	{ return (img.xres * img.channels * img.bits + 7) / 8; }
+
+	// Writes the image as a tiff: header, strips (in shuffled order if
+	// asked), the tables, then the directory. Returns its size
+	static long WriteTIFF (const char *name, const TestImage &img)
+	{
+		int bpr = RowBytes (img), strips = (img.yres + img.rps - 1) / img.rps;
+		bool big = img.big;
+		std::vector<XBYTE> file (8);
+		file[0] = file[1] = big ? 'M' : 'I';
+		Put (&file[2], TIFF_MAGIC, 2, big);
+
+		std::vector<int> order (strips);
+		for (int s=0; s < strips; s++) order[s] = s;
+		if (img.shuffle) for (int s=strips-1; s > 0; s--) { int o = Rand (0, s), t = order[s]; order[s] = order[o]; order[o] = t; }
+
+		std::vector<XBYTE4> offsets (strips), counts (strips);
+		for (int i=0; i < strips; i++) {
+			int s = order[i], y = s * img.rps, rows = (img.yres - y < img.rps) ? img.yres - y : img.rps;
+			offsets[s] = (XBYTE4) file.size ();
+			counts[s] = rows * bpr;
+			file.insert (file.end (), img.rows.begin () + y * bpr, img.rows.begin () + (y + rows) * bpr);
+			if (Rand (0, 3) == 0) file.push_back (0);						// a gap now and then
+		}
+
+		// Arrays that don't fit in an entry
+		int table = img.long_tables ? 4 : 2;
+		XBYTE4 at_bits = (XBYTE4) file.size ();
+		for (int c=0; c < img.channels; c++) { file.resize (file.size () + 2); Put (&file[file.size () - 2], img.bits, 2, big); }
+		XBYTE4 at_offsets = (XBYTE4) file.size ();
+		for (int s=0; s < strips; s++) { file.resize (file.size () + table); Put (&file[file.size () - table], offsets[s], table, big); }
+		XBYTE4 at_counts = (XBYTE4) file.size ();
+		for (int s=0; s < strips; s++) { file.resize (file.size () + table); Put (&file[file.size () - table], counts[s], table, big); }
+
+		XBYTE4 ifd = (XBYTE4) file.size ();
+		Put (&file[4], ifd, 4, big);
+		XBYTE e[10][12];
+		int num = 0;
+		struct { int tag, type; XBYTE4 count, value; } entries[10] = {
+			{ TIFF_TAG_IMAGEWIDTH, TIFF_TYPE_LONG, 1, (XBYTE4) img.xres },
+			{ TIFF_TAG_IMAGEHEIGHT, TIFF_TYPE_SHORT, 1, (XBYTE4) img.yres },
+			{ TIFF_TAG_BITSPERSAMPLE, TIFF_TYPE_SHORT, (XBYTE4) img.channels, img.channels <= 2 ? (XBYTE4) img.bits : at_bits },
+			{ TIFF_TAG_COMPRESSION, TIFF_TYPE_SHORT, 1, TIFF_COMPRESS_NONE },
+			{ TIFF_TAG_PHOTOMETRIC, TIFF_TYPE_SHORT, 1, (XBYTE4) img.photometric },
+			{ TIFF_TAG_STRIPOFFSETS, table == 4 ? TIFF_TYPE_LONG : TIFF_TYPE_SHORT, (XBYTE4) strips, strips * table <= 4 ? offsets[0] : at_offsets },
+			{ TIFF_TAG_SAMPLESPERPIXEL, TIFF_TYPE_SHORT, 1, (XBYTE4) img.channels },
+			{ TIFF_TAG_ROWSPERSTRIP, TIFF_TYPE_LONG, 1, (XBYTE4) img.rps },
+			{ TIFF_TAG_STRIPBYTECOUNTS, table == 4 ? TIFF_TYPE_LONG : TIFF_TYPE_SHORT, (XBYTE4) strips, strips * table <= 4 ? counts[0] : at_counts },
+			{ TIFF_TAG_XRES, TIFF_TYPE_RATIONAL, 1, 0 } };
+		for (num=0; num < 10; num++) {
+			Put (e[num], entries[num].tag, 2, big);
+			Put (e[num] + 2, entries[num].type, 2, big);
+			Put (e[num] + 4, entries[num].count, 4, big);
+			int size = (entries[num].type == TIFF_TYPE_SHORT) ? 2 : 4;
+			memset (e[num] + 8, 0, 4);
+			if (entries[num].count == 2 && size == 2) {						// two shorts in place
+				const XBYTE4 *v = (entries[num].tag == TIFF_TAG_STRIPOFFSETS) ? &offsets[0] :
+								  (entries[num].tag == TIFF_TAG_STRIPBYTECOUNTS) ? &counts[0] : NULL;
+				Put (e[num] + 8, v ? v[0] : img.bits, 2, big);
+				Put (e[num] + 10, v ? v[1] : img.bits, 2, big);
+			} else if (entries[num].count == 1 && size == 2) Put (e[num] + 8, entries[num].value, 2, big);
+			else Put (e[num] + 8, entries[num].value, 4, big);
+		}
+		file.resize (file.size () + 2);
+		Put (&file[file.size () - 2], num, 2, big);
+		for (int n=0; n < num; n++) file.insert (file.end (), e[n], e[n] + 12);
+		file.insert (file.end (), 4, 0);
+
+		FILE *fp = fopen (name, "wb");
+		fwrite (&file[0], 1, file.size (), fp);
+		fclose (fp);
+		return (long) file.size ();
+	}
+
+	// What a pixel of the test image should decode to, worked out the
+	// plain way
+	static void Expect (const TestImage &img, int x, int y, XBYTE rgb[3], XBYTE &alpha)
+	{
+		const XBYTE *row = &img.rows[y * RowBytes (img)];
+		XBYTE s[4] = { 0, 0, 0, 0 };
+		int bytes = img.bits / 8;
+		for (int c=0; c < img.channels; c++) {
+			if (img.bits == 1) s[c] = ((row[x >> 3] >> (7 - (x & 7))) & 1) ? 255 : 0;
+			else s[c] = row[(x * img.channels + c) * bytes + (img.big ? 0 : bytes - 1)];
+		}
+		if (img.photometric == TIFF_PHOTO_WHITEZERO) s[0] = 255 - s[0];
+		if (img.channels <= 2) rgb[0] = rgb[1] = rgb[2] = s[0];
+		else rgb[0] = s[0], rgb[1] = s[1], rgb[2] = s[2];
+		alpha = (img.channels == 2) ? s[1] : (img.channels == 4) ? s[3] : 0;
+	}
+
+	static int TestDecode (void)
+	{
+		const char *name = "tiff_test.tif";
+		int fails = 0;
+		for (int t=0; t < 300; t++) {
+			TestImage img;
+			img.channels = Rand (1, 4);
+			img.bits = (img.channels == 1 && Rand (0, 3) == 0) ? 1 : 8 << Rand (0, 2);
+			img.xres = Rand (1, 200);
+			img.yres = Rand (1, 200);
+			img.rps = Rand (1, img.yres + 5);
+			img.photometric = (img.channels >= 3) ? TIFF_PHOTO_RGB : Rand (0, 1) ? TIFF_PHOTO_BLACKZERO : TIFF_PHOTO_WHITEZERO;
+			img.big = Rand (0, 1) != 0;
+			img.long_tables = Rand (0, 1) != 0 || RowBytes (img) * img.yres > 60000;	// shorts can't point past 64K
+			img.shuffle = Rand (0, 1) != 0;
+			img.rows.resize (RowBytes (img) * img.yres);
+			for (size_t n=0; n < img.rows.size (); n++) img.rows[n] = (XBYTE) Rand (0, 255);
+			long size = WriteTIFF (name, img);
+
+			char what[128];
+			sprintf (what, "%dx%d, %d x %d bits, %d rows a strip, %s: ", img.xres, img.yres, img.channels, img.bits, img.rps, img.big ? "MM" : "II");
+			// Through small blocks, so fields and strips cross them, and
+			// mapped; each on one thread and on the pool
+			FileReader reader;
+			FileMapped mapped;
+			reader.Open ((char *) name, Rand (1, 5000));
+			mapped.Open ((char *) name);
+			TIFFInfo info, info_mapped;
+			bool ok = TIFFReadHeader (info, reader) && TIFFReadHeader (info_mapped, mapped) && mapped.GetData () != NULL &&
+					  info.xres == img.xres && info.yres == img.yres && info.channels == img.channels && info.bits == img.bits &&
+					  info.alpha == (img.channels % 2 == 0) && info.offsets == info_mapped.offsets && info.counts == info_mapped.counts;
+			if (!ok) {
+				fails += Check (false, strcat (what, "header"));
+				continue;
+			}
+
+			int pixels = img.xres * img.yres;
+			std::vector<XBYTE> rgb[4], alpha[4];
+			for (int way=0; way < 4; way++) {
+				rgb[way].assign (pixels * 3 + 1, GUARD);
+				alpha[way].assign (pixels + 1, GUARD);
+				ok = ok && TIFFDecode (info, (way < 2) ? (FileReader &) reader : mapped, &rgb[way][0], info.alpha ? &alpha[way][0] : NULL, (way & 1) != 0);
+			}
+			for (int way=1; way < 4; way++) ok = ok && rgb[0] == rgb[way] && alpha[0] == alpha[way];
+			for (int y=0; y < img.yres && ok; y++) {
+				for (int x=0; x < img.xres; x++) {
+					XBYTE e[3], a;
+					Expect (img, x, y, e, a);
+					int p = y * img.xres + x;
+					ok = ok && memcmp (&rgb[0][p*3], e, 3) == 0 && (!info.alpha || alpha[0][p] == a);
+				}
+			}
+			ok = ok && rgb[0][pixels*3] == GUARD && alpha[0][pixels] == GUARD;
+			fails += Check (ok, strcat (what, "pixels"));
+			reader.Close ();
+			mapped.Close ();
+
+			// Cut off in its strips, going by the directory read before
+			// the cut: fails, and writes nothing outside the image
+			if (t % 10 == 0) {
+				std::vector<XBYTE> file (size);
+				FILE *fp = fopen (name, "rb");
+				fread (&file[0], 1, size, fp);
+				fclose (fp);
+				fp = fopen (name, "wb");
+				fwrite (&file[0], 1, 8 + (size - 8) / 3, fp);
+				fclose (fp);
+				for (int way=0; way < 2; way++) {
+					if (way == 0) reader.Open ((char *) name, Rand (1, 5000));
+					else mapped.Open ((char *) name);
+					rgb[0].assign (pixels * 3 + 1, GUARD);
+					bool cut = !TIFFDecode (info, (way == 0) ? (FileReader &) reader : mapped, &rgb[0][0], NULL);
+					fails += Check (cut && rgb[0][pixels*3] == GUARD, "cut off tiff didn't fail cleanly");
+				}
+				reader.Close ();
+				mapped.Close ();
+			}
+		}
+		remove (name);
+		return fails;
+	}
+
+	// As LoadTiffData did it: a read per row into a fixed buffer, then
+	// the channels copied a byte at a time
+	static bool OldLoad (const TIFFInfo &info, FILE *fp, XBYTE *rgb, XBYTE *alpha)
+	{
+		static XBYTE in[200000];
+		int bpr = info.xres * info.channels * info.bits / 8;
+		if (bpr > (int) sizeof (in)) return false;
+		XBYTE *pData = rgb, *pAlpha = alpha;
+		for (size_t s=0; s < info.offsets.size (); s++) {
+			fseek (fp, (long) info.offsets[s], SEEK_SET);
+			int last = (int) s * info.rows_per_strip + info.rows_per_strip;
+			if (last > info.yres) last = info.yres;
+			for (int y = (int) s * info.rows_per_strip; y < last; y++) {
+				fread (in, 1, bpr, fp);
+				if (info.channels == 1 && info.bits == 8) {
+					XBYTE *pIn = in;
+					for (int x=0; x < info.xres; x++) {
+						*pData++ = *pIn;
+						*pData++ = *pIn;
+						*pData++ = *pIn++;
+					}
+				} else if (info.channels == 4 && info.bits == 16) {
+					XBYTE2 *pIn = (XBYTE2 *) in;
+					for (int x=0; x < info.xres; x++) {
+						*pData++ = (XBYTE) (*pIn++ >> 8);
+						*pData++ = (XBYTE) (*pIn++ >> 8);
+						*pData++ = (XBYTE) (*pIn++ >> 8);
+						*pAlpha++ = (XBYTE) (*pIn++ >> 8);
+					}
+				} else {
+					XBYTE *pIn = in;
+					for (int x=0; x < info.xres; x++) {
+						*pData++ = *pIn++;
+						*pData++ = *pIn++;
+						*pData++ = *pIn++;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	static void Bench (int channels, int bits, int rps)
+	{
+		const char *name = "tiff_bench.tif";
+		TestImage img;
+		img.xres = img.yres = 4096;
+		img.channels = channels;
+		img.bits = bits;
+		img.rps = rps;
+		img.photometric = (channels >= 3) ? TIFF_PHOTO_RGB : TIFF_PHOTO_BLACKZERO;
+		img.big = false;
+		img.long_tables = true;
+		img.shuffle = false;
+		img.rows.resize ((size_t) RowBytes (img) * img.yres);
+		for (size_t n=0; n < img.rows.size (); n++) img.rows[n] = (XBYTE) (n * 7 + (n >> 11));
+		long size = WriteTIFF (name, img);
+		img.rows.clear ();
+
+		XBYTE *rgb = new XBYTE[4096 * 4096 * 3], *alpha = new XBYTE[4096 * 4096];
+		double secs[4];
+		long reads[4];
+		for (int way=0; way < 4; way++) {
+			int level = BlendGetLevel ();
+			if (way == 1) BlendSetLevel (BLEND_SCALAR);
+			reads[way] = SysReads ();
+			double start = Seconds ();
+			TIFFInfo info;
+			FileReader reader;
+			FileMapped mapped;
+			FileReader &file = (way == 3) ? mapped : reader;
+			if (way == 3) mapped.Open ((char *) name);
+			else reader.Open ((char *) name);
+			TIFFReadHeader (info, file);
+			if (way == 0) {
+				FILE *fp = fopen (name, "rb");
+				OldLoad (info, fp, rgb, alpha);
+				fclose (fp);
+			} else TIFFDecode (info, file, rgb, info.alpha ? alpha : NULL);
+			file.Close ();
+			secs[way] = Seconds () - start;
+			reads[way] = (reads[way] < 0) ? -1 : SysReads () - reads[way] - 1;
+			BlendSetLevel (level);
+		}
+		printf ("%d x %-2d bits, %4d rows a strip (%5.1f MB)  %7.1f  %7.1f  %7.1f  %7.1f   %6ld %6ld %6ld\n", channels, bits, rps,
+				size / 1048576.0, secs[0] * 1000.0, secs[1] * 1000.0, secs[2] * 1000.0, secs[3] * 1000.0, reads[0], reads[2], reads[3]);
+		remove (name);
+		delete [] rgb;
+		delete [] alpha;
+	}
+
+	int main (void)
+	{
+		int best = BlendGetLevel (), fails = 0;
+		srand (1234);
+		if (best >= BLEND_SSE2) fails += TestKernels () + TestDecode ();
+		BlendSetLevel (BLEND_SCALAR);
+		fails += TestKernels () + TestDecode ();
+		printf ("%s: %d mismatches, %d processors\n", fails ? "FAILED" : "OK", fails, ThreadPool::GetNumProcessors ());
+
+		BlendSetLevel (best);
+		printf ("4096x4096 from a cached file      ms:     old   scalar     sse2   mapped   OS reads: old   sse2 mapped\n");
+		Bench (1, 8, 16);
+		Bench (3, 8, 16);
+		Bench (4, 16, 8);
+		Bench (3, 8, 4096);
+		return fails ? 1 : 0;
+	}
+
+#endif
@@ -0,0 +1,112 @@
+//
+// GameX - TIFF Decoder Header
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#ifndef TIFF_DEF
+	#define TIFF_DEF
+
+	// #define TIFF_TESTER
+
+	// Decodes uncompressed .tif files into rows of 8-bit RGB and a
+	// separate alpha plane, as an ImageX holds them. The strip table is
+	// read up front; strips are then decoded on a thread pool, a strip
+	// per job, straight out of the file if it's mapped, or else read a
+	// batch at a time with the next batch read while one is decoded.
+	// Widening gray to RGB, cutting 16 and 32-bit samples to 8 and
+	// splitting off alpha use SSE2. Like the blend kernels this has no
+	// DirectX or Windows in it.
+
+	#include "gamex-blend.hpp"
+	#include "gamex-file.hpp"
+
+	#include <vector>
+
+	#define TIFF_BYTEORDER				0x4949
+	#define TIFF_MAGIC					42
+
+	#define TIFF_TAG_NEWSUBTYPE			254
+	#define TIFF_TAG_SUBTYPE			255
+	#define TIFF_TAG_IMAGEWIDTH			256
+	#define TIFF_TAG_IMAGEHEIGHT		257
+	#define TIFF_TAG_BITSPERSAMPLE		258
+	#define TIFF_TAG_COMPRESSION		259
+		#define TIFF_COMPRESS_NONE		1
+		#define TIFF_COMPRESS_LZW		5
+		#define TIFF_COMPRESS_PACKBITS	32773
+	#define TIFF_TAG_PHOTOMETRIC		262
+		#define TIFF_PHOTO_WHITEZERO	0
+		#define TIFF_PHOTO_BLACKZERO	1
+		#define TIFF_PHOTO_RGB			2
+		#define TIFF_PHOTO_RGBPAL		3
+		#define TIFF_PHOTO_TRANS		4
+		#define TIFF_PHOTO_CMYK			5
+	#define TIFF_TAG_THRESHOLDING		263
+	#define TIFF_TAG_DOCNAME			269
+	#define TIFF_TAG_STRIPOFFSETS		273
+	#define TIFF_TAG_ORIENTATION		274
+	#define TIFF_TAG_SAMPLESPERPIXEL	277
+	#define TIFF_TAG_ROWSPERSTRIP		278
+	#define TIFF_TAG_STRIPBYTECOUNTS	279
+	#define TIFF_TAG_XRES				282
+	#define TIFF_TAG_YRES				283
+	#define TIFF_TAG_PLANARCONFIG		284
+	#define TIFF_TAG_RESUNIT			296
+	#define TIFF_TAG_COLORMAP			320
+	#define TIFF_TAG_EXTRASAMPLES		338
+
+	#define TIFF_TYPE_BYTE				1
+	#define TIFF_TYPE_ASCII				2
+	#define TIFF_TYPE_SHORT				3
+	#define TIFF_TYPE_LONG				4
+	#define TIFF_TYPE_RATIONAL			5
+
+	#define TIFF_BATCH					(4 << 20)	// Bytes of strips read at a time
+	#define TIFF_SPLIT					(256*256)	// Smaller images decode on one thread
+
+	class TIFFInfo {
+	public:
+		int xres, yres;
+		int channels;							// 1 gray, 2 gray and alpha, 3 RGB, 4 RGB and alpha
+		int bits;								// Per channel: 1 (black and white only), 8, 16 or 32
+		int compression, photometric;
+		bool big_endian;
+		bool alpha;
+		int rows_per_strip;
+		std::vector<XBYTE4> offsets, counts;	// Each strip's place in the file
+	};
+
+	// Reads the first directory and the strip table. False if it isn't
+	// an uncompressed gray or RGB tiff this decodes, though what was
+	// read (compression, say) is left in info
+	bool TIFFReadHeader (TIFFInfo &info, FileReader &file);
+
+	// Decodes every strip into rgb (3 bytes a pixel) and alpha (1 byte,
+	// or NULL to leave it), both top row first. Strips are decoded on a
+	// pool if 'threads' and the image is big enough. False if a strip
+	// couldn't be read; the rows it would have filled are left alone
+	bool TIFFDecode (const TIFFInfo &info, FileReader &file, XBYTE *rgb, XBYTE *alpha, bool threads = true);
+
+	// Decodes one strip of 'size' bytes whose first row is 'row'. Rows
+	// it's too short for are left alone
+	void TIFFDecodeStrip (const TIFFInfo &info, const XBYTE *src, int size, int row, XBYTE *rgb, XBYTE *alpha);
+
+	// Gray bytes to r,g,b triples
+	void TIFFGrayToRGB (XBYTE *dst, const XBYTE *src, int count);
+	void TIFFGrayToRGBRef (XBYTE *dst, const XBYTE *src, int count);
+
+	// r,g,b,a quads to r,g,b triples and a bytes
+	void TIFFSplitAlpha (XBYTE *rgb, XBYTE *alpha, const XBYTE *src, int count);
+	void TIFFSplitAlphaRef (XBYTE *rgb, XBYTE *alpha, const XBYTE *src, int count);
+
+	// 'count' samples of src_bytes (2 or 4) each to their top 8 bits
+	void TIFFNarrow (XBYTE *dst, const XBYTE *src, int count, int src_bytes, bool big_endian);
+	void TIFFNarrowRef (XBYTE *dst, const XBYTE *src, int count, int src_bytes, bool big_endian);
+
+#endif
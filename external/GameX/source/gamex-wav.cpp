@@ -0,0 +1,363 @@
+//
+// GameX - WAV Reader Code
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#include "gamex-wav.hpp"
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define WAV_HAS_SSE2
+	#include <emmintrin.h>
+#endif
+
+#ifdef __GNUC__
+	#define WAV_SSE2_FUNC	__attribute__ ((target ("sse2")))
+#else
+	#define WAV_SSE2_FUNC
+#endif
+
+static inline XBYTE4 WavRead4 (const XBYTE *p)	{ return p[0] | (p[1] << 8) | (p[2] << 16) | ((XBYTE4) p[3] << 24); }
+static inline int WavRead2 (const XBYTE *p)		{ return p[0] | (p[1] << 8); }
+
+bool WavReadHeader (WavInfo &info, const XBYTE *stream, int size)
+{
+	bool fmt = false, data = false;
+
+	if (stream == NULL || size < 12) return false;
+	if (memcmp (stream, "RIFF", 4) != 0 || memcmp (stream + 8, "WAVE", 4) != 0) return false;
+
+	// Each chunk is an id, a size and that many bytes, padded to even
+	int pos = 12;
+	while (pos <= size - 8 && !(fmt && data)) {
+		const XBYTE *chunk = stream + pos;
+		XBYTE4 len = WavRead4 (chunk + 4);
+		int left = size - pos - 8;
+
+		if (memcmp (chunk, "fmt ", 4) == 0) {
+			if (len < 16 || (XBYTE4) left < 16) return false;
+			info.format = WavRead2 (chunk + 8);
+			info.channels = WavRead2 (chunk + 10);
+			info.samples_per_sec = (int) WavRead4 (chunk + 12);
+			info.bits = WavRead2 (chunk + 22);
+			fmt = true;
+		} else if (memcmp (chunk, "data", 4) == 0) {
+			info.data_offset = pos + 8;
+			info.data_size = (len > (XBYTE4) left) ? left : (int) len;
+			data = true;
+		}
+
+		if (len > (XBYTE4) left) break;					// runs off the end, nothing after it
+		pos += 8 + (int) len + (int) (len & 1);
+	}
+	return fmt && data;
+}
+
+void WavNarrowRef (XBYTE *dst, const XBYTE *src, int count, int src_bytes)
+{
+	if (src_bytes <= 2) {
+		memcpy (dst, src, count * src_bytes);
+		return;
+	}
+	for (int n=0; n < count; n++, src += src_bytes) {
+		dst[n*2] = src[src_bytes-2];
+		dst[n*2+1] = src[src_bytes-1];
+	}
+}
+
+#ifdef WAV_HAS_SSE2
+
+// 4-byte samples: the top half of each, sign extended, packs exactly
+WAV_SSE2_FUNC static int WavNarrow32SSE2 (XBYTE *dst, const XBYTE *src, int count)
+{
+	int n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m128i lo = _mm_srai_epi32 (_mm_loadu_si128 ((__m128i *) (src + n*4)), 16);
+		__m128i hi = _mm_srai_epi32 (_mm_loadu_si128 ((__m128i *) (src + n*4 + 16)), 16);
+		_mm_storeu_si128 ((__m128i *) (dst + n*2), _mm_packs_epi32 (lo, hi));
+	}
+	return n;
+}
+
+// 3-byte samples: sample k of 4 is shifted up k bytes into lane k, then
+// up one more byte and back down two, leaving its top 16 bits sign
+// extended. Each 16-byte load uses 12, so this stops short of the end
+WAV_SSE2_FUNC static inline __m128i WavLanes24SSE2 (__m128i v)
+{
+	__m128i m0 = _mm_setr_epi32 (0x00FFFFFF, 0, 0, 0), m1 = _mm_setr_epi32 (0, 0x00FFFFFF, 0, 0);
+	__m128i m2 = _mm_setr_epi32 (0, 0, 0x00FFFFFF, 0), m3 = _mm_setr_epi32 (0, 0, 0, 0x00FFFFFF);
+	__m128i p = _mm_or_si128 (_mm_or_si128 (_mm_and_si128 (v, m0), _mm_and_si128 (_mm_slli_si128 (v, 1), m1)),
+							  _mm_or_si128 (_mm_and_si128 (_mm_slli_si128 (v, 2), m2), _mm_and_si128 (_mm_slli_si128 (v, 3), m3)));
+	return _mm_srai_epi32 (_mm_slli_epi32 (p, 8), 16);
+}
+
+WAV_SSE2_FUNC static int WavNarrow24SSE2 (XBYTE *dst, const XBYTE *src, int count)
+{
+	int n = 0;
+	for (; n + 10 <= count; n += 8) {
+		__m128i lo = WavLanes24SSE2 (_mm_loadu_si128 ((__m128i *) (src + n*3)));
+		__m128i hi = WavLanes24SSE2 (_mm_loadu_si128 ((__m128i *) (src + n*3 + 12)));
+		_mm_storeu_si128 ((__m128i *) (dst + n*2), _mm_packs_epi32 (lo, hi));
+	}
+	return n;
+}
+
+#endif
+
+void WavNarrow (XBYTE *dst, const XBYTE *src, int count, int src_bytes)
+{
+	int n = 0;
+	#ifdef WAV_HAS_SSE2
+		if (BlendGetLevel () >= BLEND_SSE2) {
+			if (src_bytes == 4) n = WavNarrow32SSE2 (dst, src, count);
+			else if (src_bytes == 3) n = WavNarrow24SSE2 (dst, src, count);
+		}
+	#endif
+	WavNarrowRef (dst + n*2, src + n*src_bytes, count - n, src_bytes);
+}
+
+#ifdef WAV_TESTER
+
+	// Checks SSE2 against the reference and the chunk walk against odd
+	// layouts and cut off files, then times loading 10 minutes of 24-bit
+	// stereo the old way (a read per sample) and the new (one read, then
+	// WavNarrow). Builds off Windows:
+	//   g++ -O2 -DWAV_TESTER gamex-wav.cpp gamex-blend.cpp
+
+	#include <stdio.h>
+	#include <stdlib.h>
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <sys/time.h>
+	#endif
+
+	static double Seconds (void)
+	{
+		#ifdef _WIN32
+			LARGE_INTEGER freq, now;
+			QueryPerformanceFrequency (&freq);
+			QueryPerformanceCounter (&now);
+			return (double) now.QuadPart / (double) freq.QuadPart;
+		#else
+			struct timeval tv;
+			gettimeofday (&tv, NULL);
+			return tv.tv_sec + tv.tv_usec / 1e6;
+		#endif
+	}
+
+	static int Rand (int lo, int hi)	{ return lo + rand () % (hi - lo + 1); }
+
+	static int Put4 (XBYTE *p, XBYTE4 v)	{ p[0] = (XBYTE) v; p[1] = (XBYTE) (v >> 8); p[2] = (XBYTE) (v >> 16); p[3] = (XBYTE) (v >> 24); return 4; }
+	static int Put2 (XBYTE *p, int v)		{ p[0] = (XBYTE) v; p[1] = (XBYTE) (v >> 8); return 2; }
+
+	static int Chunk (XBYTE *p, const char *id, int len)
+	{
+		memcpy (p, id, 4);
+		Put4 (p + 4, len);
+		for (int n=0; n < len; n++) p[8+n] = (XBYTE) rand ();
+		if (len & 1) p[8+len] = 0;
+		return 8 + len + (len & 1);
+	}
+
+	// A WAV with the chunks in the given order: 'f'mt, 'd'ata, 'l'ist
+	// or 'x' (fact), the list and data of odd sizes now and then
+	static int Write (XBYTE *out, const char *order, int bits, int channels, int samples, int &data_offset)
+	{
+		int len = 12;
+		memcpy (out, "RIFF", 4);
+		memcpy (out + 8, "WAVE", 4);
+		for (const char *c=order; *c; c++) {
+			if (*c == 'f') {
+				int extra = (rand () % 2) ? 0 : 2;
+				memcpy (out + len, "fmt ", 4);
+				Put4 (out + len + 4, 16 + extra);
+				Put2 (out + len + 8, WAV_PCM);
+				Put2 (out + len + 10, channels);
+				Put4 (out + len + 12, 44100);
+				Put4 (out + len + 16, 44100 * channels * bits / 8);
+				Put2 (out + len + 20, channels * bits / 8);
+				Put2 (out + len + 22, bits);
+				if (extra) Put2 (out + len + 24, 0);
+				len += 24 + extra;
+			} else if (*c == 'd') {
+				data_offset = len + 8;
+				len += Chunk (out + len, "data", samples * channels * bits / 8);
+			} else if (*c == 'l') {
+				len += Chunk (out + len, "LIST", Rand (0, 41));
+			} else {
+				len += Chunk (out + len, "fact", 4);
+			}
+		}
+		Put4 (out + 4, len - 8);
+		return len;
+	}
+
+	static int Test (void)
+	{
+		const char *orders[5] = { "fd", "lfd", "fxld", "flxdl", "dlf" };
+		XBYTE *file = new XBYTE[20000], src[4*300+16], out[2*300], ref[2*300];
+		int fails = 0;
+
+		for (int t=0; t < 20000; t++) {
+			int count = Rand (0, 300), bytes = Rand (1, 4);
+			for (int n=0; n < (int) sizeof (src); n++) src[n] = (XBYTE) rand ();
+			memset (out, 0, sizeof (out)); memset (ref, 0, sizeof (ref));
+			WavNarrow (out, src, count, bytes);
+			WavNarrowRef (ref, src, count, bytes);
+			if (memcmp (out, ref, sizeof (out)) != 0) {
+				if (fails++ < 5) printf ("  narrow of %d %d-byte samples differs\n", count, bytes);
+			}
+		}
+
+		for (int t=0; t < 5000; t++) {
+			int bits = Rand (1, 4) * 8, channels = Rand (1, 2), samples = Rand (0, 1000), data_offset = -1;
+			const char *order = orders[t % 5];
+			int len = Write (file, order, bits, channels, samples, data_offset);
+			WavInfo info;
+			if (!WavReadHeader (info, file, len) || info.bits != bits || info.channels != channels ||
+				info.data_offset != data_offset || info.data_size != samples * channels * bits / 8) {
+				if (fails++ < 5) printf ("  chunks %s, %d bits didn't read back\n", order, bits);
+				continue;
+			}
+
+			// Cut off: data runs to the end of what's there, anything
+			// else missing is a failure, never a read past the end
+			int cut = Rand (0, len);
+			bool ok = WavReadHeader (info, file, cut);
+			bool want = cut >= data_offset;					// with "fmt " ahead of the data
+			if (ok && (info.data_offset + info.data_size > cut)) {
+				if (fails++ < 5) printf ("  chunks %s cut to %d reads past it\n", order, cut);
+			}
+			if (ok != want && strcmp (order, "dlf") != 0) {
+				if (fails++ < 5) printf ("  chunks %s cut to %d of %d: %s\n", order, cut, len, ok ? "read" : "failed");
+			}
+
+			// Garbled sizes: no crash, nothing past the end
+			for (int n=0; n < 6; n++) file[Rand (4, len-1)] = (XBYTE) rand ();
+			if (WavReadHeader (info, file, len) && info.data_offset + info.data_size > len) {
+				if (fails++ < 5) printf ("  garbled chunks %s read past the end\n", order);
+			}
+		}
+		delete [] file;
+		return fails;
+	}
+
+	// SoundX::LoadWav before: ReadC one byte at a time to find "data",
+	// then two reads per sample (skip the low byte, read the top two)
+	static int LoadOld (const char *name, char *&data)
+	{
+		FILE *fp = fopen (name, "rb");
+		char buf[100], skip[8];
+		int num_bytes = 0;
+		fread (buf, 12, 1, fp);
+		fread (buf, 8, 1, fp);
+		fread (buf, 16, 1, fp);
+		while (feof (fp) == 0) {
+			if (fread (buf, 1, 1, fp) < 1) break;
+			if (buf[0] == 'd') fread (buf+1, 3, 1, fp);
+			else continue;
+			if (strncmp (buf, "data", 4) == 0) {
+				XBYTE4 size;
+				fread (&size, 4, 1, fp);
+				num_bytes = (int) size / 3 * 2;
+				data = new char[num_bytes];
+				for (int n = 0; n < num_bytes; n += 2) {
+					fread (skip, 1, 1, fp);
+					fread (data + n, 2, 1, fp);
+				}
+				break;
+			}
+		}
+		fclose (fp);
+		return num_bytes;
+	}
+
+	static int LoadNew (const char *name, char *&data)
+	{
+		FILE *fp = fopen (name, "rb");
+		fseek (fp, 0, SEEK_END);
+		int size = (int) ftell (fp);
+		fseek (fp, 0, SEEK_SET);
+		XBYTE *stream = new XBYTE[size];
+		fread (stream, size, 1, fp);
+		fclose (fp);
+
+		WavInfo info;
+		int num_bytes = 0;
+		if (WavReadHeader (info, stream, size)) {
+			int count = info.data_size / (info.bits / 8);
+			num_bytes = count * 2;
+			data = new char[num_bytes];
+			WavNarrow ((XBYTE *) data, stream + info.data_offset, count, info.bits / 8);
+		}
+		delete [] stream;
+		return num_bytes;
+	}
+
+	static void Bench (int best)
+	{
+		const int kSamples = 44100 * 60 * 10, kChannels = 2;
+		const char *name = "wavtest.wav";
+		int data_offset, bytes = kSamples * kChannels * 3;
+		XBYTE *file = new XBYTE[bytes + 64];
+		int len = Write (file, "lfd", 24, kChannels, kSamples, data_offset);
+		FILE *fp = fopen (name, "wb");
+		if (fp == NULL) { delete [] file; return; }
+		fwrite (file, len, 1, fp);
+		fclose (fp);
+
+		printf ("10 minutes, 24-bit stereo (%.1f MB)\n", len / 1e6);
+		char *ref = NULL;
+		int ref_bytes = 0;
+		for (int way=0; way < 4; way++) {
+			if (way >= 2 && best < BLEND_SSE2) continue;
+			char *data = NULL;
+			int num_bytes;
+			BlendSetLevel ((way >= 2) ? BLEND_SSE2 : BLEND_SCALAR);
+			double start = Seconds ();
+			if (way == 0) num_bytes = LoadOld (name, data);
+			else if (way < 3) num_bytes = LoadNew (name, data);
+			else {
+				WavInfo info;										// already in memory, as from the pack
+				WavReadHeader (info, file, len);
+				num_bytes = info.data_size / 3 * 2;
+				data = new char[num_bytes];
+				WavNarrow ((XBYTE *) data, file + info.data_offset, info.data_size / 3, 3);
+			}
+			double secs = Seconds () - start;
+			const char *names[4] = { "old", "scalar", "sse2", "sse2 memory" };
+			printf ("%-12s %8.1f ms", names[way], secs * 1000.0);
+			if (way == 0) {
+				ref = data; ref_bytes = num_bytes;
+				printf ("\n");
+			} else {
+				printf ("   %s\n", (num_bytes == ref_bytes && memcmp (data, ref, num_bytes) == 0) ? "same samples" : "DIFFERENT samples");
+				delete [] data;
+			}
+		}
+		delete [] ref;
+		delete [] file;
+		remove (name);
+	}
+
+	int main (void)
+	{
+		int best = BlendGetLevel (), fails = 0;
+		srand (1234);
+		if (best >= BLEND_SSE2) fails += Test ();
+		BlendSetLevel (BLEND_SCALAR);
+		fails += Test ();
+		printf ("%s: %d mismatches\n", fails ? "FAILED" : "OK", fails);
+		Bench (best);
+		return fails ? 1 : 0;
+	}
+
+#endif
@@ -0,0 +1,45 @@
+//
+// GameX - WAV Reader Header
+//
+// Copyright (C) 2002 Rama C. Hoetzlein
+//
+// This software is released under the GameX GNU GPL
+// Open Source License. See the GameX documentation included
+// with this source code for terms of modification,
+// distribution and re-release.
+//
+
+#ifndef WAV_DEF
+	#define WAV_DEF
+
+	// #define WAV_TESTER
+
+	// Finds the format and sample data of a .wav file in memory by
+	// walking its RIFF chunks, and narrows 24 and 32-bit samples to the
+	// 16 bits SoundX plays, SSE2 doing 8 samples at a time. Like the
+	// blend kernels this has no DirectX or Windows in it.
+
+	#include "gamex-blend.hpp"
+
+	#define WAV_PCM				1			// Format tag of plain PCM
+
+	class WavInfo {
+	public:
+		int format;								// Format tag (WAV_PCM, ...)
+		int channels, samples_per_sec;
+		int bits;								// Bits per sample in the file
+		int data_offset, data_size;				// The sample data; size is cut to what the stream holds
+	};
+
+	// Indexes the chunks; false if there's no RIFF WAVE with both a
+	// "fmt " and a "data" chunk. Chunks may come in any order, and
+	// unknown ones (LIST, fact, cue, ...) are skipped
+	bool WavReadHeader (WavInfo &info, const XBYTE *stream, int size);
+
+	// Copies 'count' little endian samples of src_bytes each into dst,
+	// keeping the top 16 bits of 3 and 4-byte ones. 1 and 2-byte
+	// samples are copied as they are
+	void WavNarrow (XBYTE *dst, const XBYTE *src, int count, int src_bytes);
+	void WavNarrowRef (XBYTE *dst, const XBYTE *src, int count, int src_bytes);
+
+#endif
@@ -49,6 +49,11 @@ WindowsDX::WindowsDX (void)
 	max_sounds = 0;
 	sound_list = NULL;
 	sound_support = false;
+	ds_mixer = NULL;
+	ds_mix_buffer = NULL;
+	ds_mix_bytes = 0;
+	ds_mix_pos = 0;
+	ds_stream = NULL;
 	drawLocked = false;
 	win_warning_on_draw = false;
 	strcpy(win_name, "GameX");
@@ -58,6 +63,12 @@ WindowsDX::WindowsDX (void)
 	draw_state->cam = new CameraX();
 	draw_state->dst = VIEWPORT;
 	ResetDrawStates();
+	quad_batch_on = false;
+	quad_batch_count = 0;
+	quad_batch_verts = NULL;
+	quad_batch_indices = NULL;
+	stat_quads = stat_calls = stat_textures = 0;
+	stat_last_quads = stat_last_calls = stat_last_textures = 0;
 	for(int i=0 ; i<GAMEX_TOTAL_STATUS_NUMBER ; i++)
 		win_status_problem_ignore[i] = false;
 }
@@ -411,6 +422,7 @@ int WINAPI WinMain (HINSTANCE hThisInst, HINSTANCE hPrevInst, LPSTR lpszArgs, in
 			TranslateMessage(&msg) ;
 			DispatchMessage(&msg) ;
 		}
+		GameX.UpdateMixer(); // keep mixed sound ahead of what's playing, paused or not
 		if(!GameX.win_active && GameX.CanAutoPause()) { // if the window isn't active, and we can pause,
 			Sleep(10) ; // sleep so we don't max out the cpu in the background
 			cycleTime = GetClock(); // set the timers to the current time
@@ -707,6 +719,11 @@ bool WindowsDX::Initialize (char * name, GameXInitFlags options, int xres, int y
 	else
 		win_request_no_sound = false;
 
+	if(options & AUDIO_MIXER)
+		win_request_mixer = true;
+	else
+		win_request_mixer = false;
+
 	if(options & RUN_USEESCAPEKEY)
 		win_request_use_escape = true;
 	else
@@ -1986,6 +2003,53 @@ bool WindowsDX::InitDirectSound (void)
 	master_music_tempo = master_music_volume = 1.0f;
 
 	sound_support = true;
+	if(win_request_mixer) InitMixer(); // if this fails, sounds just get their own buffers as usual
+	return true;
+}
+
+// The mixer's buffer holds half a second and is kept a fifteenth of a
+// second ahead of the play cursor. The rest of it is kept silent, so
+// a stall (a long load, say) goes quiet rather than replaying old sound
+#define WINDX_MIX_FRAMES	(MIXER_RATE/2)
+#define WINDX_MIX_LEAD		(MIXER_RATE/15)
+#define WINDX_STREAM_PRIORITY	1000	// above every sound, so music is never taken over
+
+bool WindowsDX::InitMixer (void)
+{
+	WAVEFORMATEX format;
+	ZeroMemory(&format,sizeof(format)) ;
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = 2;
+	format.nSamplesPerSec = MIXER_RATE;
+	format.wBitsPerSample = 16;
+	format.nBlockAlign = 4;
+	format.nAvgBytesPerSec = MIXER_RATE * 4;
+
+	DSBUFFERDESC bufferDesc;
+	ZeroMemory(&bufferDesc,sizeof(bufferDesc)) ;
+	bufferDesc.dwSize = sizeof(bufferDesc) ;
+	bufferDesc.dwFlags = DSBCAPS_GETCURRENTPOSITION2;
+	bufferDesc.dwBufferBytes = WINDX_MIX_FRAMES * 4;
+	bufferDesc.lpwfxFormat = &format;
+
+	if(FAILED(ds_main->CreateSoundBuffer(&bufferDesc, &ds_mix_buffer, NULL))) {
+		debug.Output("WinDX: Failed to create the mixer's buffer, sounds will get their own");
+		ds_mix_buffer = NULL;
+		return false;
+	}
+	ds_mix_bytes = WINDX_MIX_FRAMES * 4;
+	ds_mix_pos = 0;
+
+	void *buf_a, *buf_b;
+	DWORD bytes_a, bytes_b;
+	if(SUCCEEDED(ds_mix_buffer->Lock(0, ds_mix_bytes, &buf_a, &bytes_a, &buf_b, &bytes_b, 0))) {
+		ZeroMemory(buf_a, bytes_a);
+		ds_mix_buffer->Unlock(buf_a, bytes_a, buf_b, bytes_b);
+	}
+	ds_mix_buffer->Play(0, 0, DSBPLAY_LOOPING);
+	MemoryRecordChange(ds_mix_bytes/1024);
+
+	ds_mixer = new Mixer(MIXER_VOICES, MIXER_RATE);
 	return true;
 }
 
@@ -2434,6 +2498,9 @@ bool WindowsDX::DirectXCleanUp (void)
 	if (dm_loader)		dm_loader->Release(),		 dm_loader = NULL;
 	
 	// DirectSound
+	ds_stream = NULL;
+	if (ds_mixer)		delete ds_mixer,				ds_mixer = NULL;
+	if (ds_mix_buffer)	ds_mix_buffer->Stop(),		ds_mix_buffer->Release(),	ds_mix_buffer = NULL;
 	if (ds_main)		ds_main->Release(), 		ds_main = NULL;
 
 	// DirectInput
@@ -2450,6 +2517,10 @@ bool WindowsDX::DirectXCleanUp (void)
 	if (dd_front_buf)	dd_front_buf->Release(),	dd_front_buf = NULL;	
 	if (dd_main)		dd_main->Release(), 		dd_main = NULL;
 
+	// Quad batching
+	delete [] quad_batch_verts;		quad_batch_verts = NULL;
+	delete [] quad_batch_indices;	quad_batch_indices = NULL;
+
 	CoUninitialize();
 	return true;
 }
@@ -2479,6 +2550,11 @@ int WindowsDX::UpdateView (void)
 	if(draw_render_batch_open)
 		EndRenderBatch();
 
+	stat_last_quads = stat_quads;
+	stat_last_calls = stat_calls;
+	stat_last_textures = stat_textures;
+	stat_quads = stat_calls = stat_textures = 0;
+
 	// DirectX 8.1
 	//dd_device->Present (NULL, NULL, win_hwnd, NULL) ;
 
@@ -4172,6 +4248,22 @@ void WindowsDX::InternalDrawMaster(ImageX * source)
 	if(!(draw_state->flags & DRAWMODESMASK))
 		draw_state->flags |= DRAW_PLAIN; // assume no drawing mode means plain drawing mode
 
+	if(source != NULL && source != VIEWPORT && source->m_view_page != NULL && draw_3D_depth_sort != 2) {
+		// a view draws its part of the page, so move the source rect onto the page
+		RECT part = draw_state->src_rect;
+		bool keep = (draw_state->flags & DRAWOP_KEEPSTATES) != 0;
+		RECT & r = draw_state->src_rect;
+		if(r.right == DEFAULT) {
+			r.left = 0; r.top = 0;
+			r.right = source->m_xres; r.bottom = source->m_yres;
+		}
+		r.left += source->m_view_x; r.right += source->m_view_x;
+		r.top += source->m_view_y; r.bottom += source->m_view_y;
+		InternalDrawMaster(source->m_view_page);
+		if(keep) draw_state->src_rect = part; // or the next draw would move it again
+		return;
+	}
+
 	if(draw_state->dst != VIEWPORT && !(draw_state->dst->m_usage & LOAD_TARGETABLE))
 		draw_state->dst->ConvertUsageTo(draw_state->dst->m_usage | LOAD_TARGETABLE); // auto-convert to targetable if needed
 
@@ -4345,6 +4437,8 @@ void WindowsDX::InternalDrawMaster(ImageX * source)
 			ok = InternalDrawImageD3D(p_dst_device, NULL, FULLRECT, FULLRECT, x, y, z, win_width, win_height, alphatype);
 	}
 	if(!ok) {
+		FlushQuadBatch(); // DirectDraw can't draw in between queued quads
+
 ///		bool can_2D_accelerate = (sourceHasSurface && destHasSurface && p_src_surface != NULL && (draw_state->flags & DRAW_PLAIN) && alphatype != 2 && draw_state->angle==0.0f && !draw_state->colors.HasShading() && (draw_state->vertices_3D==0||draw_state->vertices_3D==2||draw_state->vertices_3D==3));
 		bool can_2D_accelerate = destHasSurface ? true : false;
 
@@ -4484,7 +4578,20 @@ int WindowsDX::InternalDrawImageD3D(LPDIRECT3DDEVICE7 device, LPDIRECTDRAWSURFAC
 		UnlockBackBuffer(); // must be "closed" (actually called unlocked) to draw with D3D (or DD for that matter)
 	}
 
-	if(d3d_device != NULL) {
+	// a draw that matches the open batch only has to add its vertices,
+	// everything else draws the batch first
+	bool batch_quad = quad_batch_on && InternalCanBatchD3D(alphatype);
+	bool batch_join = false;
+	if(quad_batch_count) {
+		if(batch_quad && device == quad_batch_device && image == quad_batch_image && alphatype == quad_batch_alphatype
+		&& draw_state->flags == quad_batch_flags && draw_state->color_effect == quad_batch_effect
+		&& draw_state->colors.HasTransparency() == quad_batch_transparent && EqualRect(&draw_state->dst_bounds, &quad_batch_bounds))
+			batch_join = true;
+		else
+			FlushQuadBatch();
+	}
+
+	if(d3d_device != NULL && !batch_join) {
 		D3DVIEWPORT7 view;
 		view.dwX = draw_state->dst_bounds.left;
 		view.dwY = draw_state->dst_bounds.top;
@@ -4559,6 +4666,14 @@ int WindowsDX::InternalDrawImageD3D(LPDIRECT3DDEVICE7 device, LPDIRECTDRAWSURFAC
 		rightMap = 1.0f; bottomMap = 1.0f;
 	}
 
+	if(batch_join) {
+		InternalMakeQuadD3D(quad_batch_verts + quad_batch_count*4, x, y, z, leftMap, topMap, rightMap, bottomMap);
+		stat_quads++;
+		if(++quad_batch_count == WINDX_BATCHSIZE)
+			FlushQuadBatch();
+		return 1;
+	}
+
 	int color_shift = 0; // amount to left-shift brightness
 
 	if(draw_state->flags & DRAWOP_BRIGHT)
@@ -4776,6 +4891,7 @@ int WindowsDX::InternalDrawImageD3D(LPDIRECT3DDEVICE7 device, LPDIRECTDRAWSURFAC
 	if(new_batch || image != last_texture_surface) { // note: image NULL means blank/untextured poly
 		last_texture_surface = image;
 		status = device->SetTexture(0,image); // set the texture image (or nothing if NULL) to draw
+		stat_textures++;
 	}
 
 	if(draw_render_batch_open == false) {
@@ -4786,31 +4902,28 @@ int WindowsDX::InternalDrawImageD3D(LPDIRECT3DDEVICE7 device, LPDIRECTDRAWSURFAC
 		}
 	}
 
+	if(SUCCEEDED(status) && batch_quad) {
+		// open a batch in these states, FlushQuadBatch draws it and resets them
+		InternalMakeQuadD3D(quad_batch_verts, x, y, z, leftMap, topMap, rightMap, bottomMap);
+		quad_batch_count = 1;
+		quad_batch_device = device;
+		quad_batch_image = image;
+		quad_batch_flags = draw_state->flags;
+		quad_batch_effect = draw_state->color_effect;
+		quad_batch_transparent = draw_state->colors.HasTransparency();
+		quad_batch_alphatype = alphatype;
+		quad_batch_bounds = draw_state->dst_bounds;
+		stat_quads++;
+		return 1;
+	}
+
 	if(SUCCEEDED(status)) {
 		D3DTLVERTEX quad[4];
-		float near_plane = draw_state->cam->GetNear();
-		float far_plane = draw_state->cam->GetFar();
-		float plane_sep = far_plane - near_plane;
-		for(int i = 0 ; i < 4 ; i++) {
-			quad[i].sx = x[i] - 0.5f;
-			quad[i].sy = y[i] - 0.5f;
-
-			if(draw_sort_mode & SCENESORTS)
-				if(win_alternator)
-					quad[i].sz = 1.0f - (z[i]-near_plane)/(plane_sep)/2.0f; // for signed z-buffer
-				else
-					quad[i].sz = (z[i]-near_plane)/(plane_sep)/2.0f; // for signed z-buffer
-			else
-				quad[i].sz = (z[i]-near_plane)/(plane_sep); // for normal z-buffer
-
-			quad[i].rhw = (draw_state->warp_mode!=0) ? draw_state->warp[i] : 1.0f;
-			quad[i].color = RGBA_MAKE(draw_state->colors.c[i][0], draw_state->colors.c[i][1], draw_state->colors.c[i][2], draw_state->colors.c[i][3]);
-			quad[i].specular = 0;
-			quad[i].tu = (i==0 || i==2) ? (leftMap) : (rightMap);
-			quad[i].tv = (i==0 || i==1) ? (topMap) : (bottomMap);
-		}
+		InternalMakeQuadD3D(quad, x, y, z, leftMap, topMap, rightMap, bottomMap);
 
 		status = device->DrawPrimitive(D3DPT_TRIANGLESTRIP, D3DFVF_TLVERTEX,quad,4,0);
+		stat_quads++;
+		stat_calls++;
 
 		// rest of DRAW_BURN workaround is implemented here, unless DRAW_SUBTRACT workaround also needed:
 		if(work_burn && win_subtract_workaround != 2 && (win_subtract_workaround != 1 || alphatype == 2)) {
@@ -4821,47 +4934,126 @@ int WindowsDX::InternalDrawImageD3D(LPDIRECT3DDEVICE7 device, LPDIRECTDRAWSURFAC
 	}
 
 	// reset DirectX renderstates for next time:
+	InternalResetStatesD3D(device, draw_state->flags, alphatype);
 
-	if(draw_state->flags & DRAWOP_NOBLENDALPHA && draw_state->flags & DRAW_PLAIN)
+	// rest of DRAW_BURN workaround is implemented here if the DRAW_SUBTRACT workaround is also needed:
+	if(work_burn && !(win_subtract_workaround != 2 && (win_subtract_workaround != 1 || alphatype == 2))) {
+		draw_state->flags ^= DRAW_SUBTRACT | DRAW_INVERT; // switch from inversion to subtraction
+		draw_state->colors /= 2.0f;
+		InternalDrawImageD3D(device, image, src_rect, src_bounds, x, y, z, surf_width, surf_height, alphatype);
+		draw_state->colors *= 2.0f;
+	}
+
+	if(work_inten) draw_state->colors *= 2.0f; // reverse color change from DRAW_INTENSIFY workaround
+
+	// report our success or failure to do the actual drawing:
+
+	if(FAILED(status)) {
+		Direct3DError(status);
+		DirectDrawError(status);
+		return 0;
+	} else {
+		return 1;
+	}
+}
+
+// fills in the 4 triangle strip vertices of a quad (see the diagram in InternalDrawImageD3D)
+void WindowsDX::InternalMakeQuadD3D(D3DTLVERTEX * quad, float * x, float * y, float * z, float leftMap, float topMap, float rightMap, float bottomMap)
+{
+	float near_plane = draw_state->cam->GetNear();
+	float far_plane = draw_state->cam->GetFar();
+	float plane_sep = far_plane - near_plane;
+	for(int i = 0 ; i < 4 ; i++) {
+		quad[i].sx = x[i] - 0.5f;
+		quad[i].sy = y[i] - 0.5f;
+
+		if(draw_sort_mode & SCENESORTS)
+			if(win_alternator)
+				quad[i].sz = 1.0f - (z[i]-near_plane)/(plane_sep)/2.0f; // for signed z-buffer
+			else
+				quad[i].sz = (z[i]-near_plane)/(plane_sep)/2.0f; // for signed z-buffer
+		else
+			quad[i].sz = (z[i]-near_plane)/(plane_sep); // for normal z-buffer
+
+		quad[i].rhw = (draw_state->warp_mode!=0) ? draw_state->warp[i] : 1.0f;
+		quad[i].color = RGBA_MAKE(draw_state->colors.c[i][0], draw_state->colors.c[i][1], draw_state->colors.c[i][2], draw_state->colors.c[i][3]);
+		quad[i].specular = 0;
+		quad[i].tu = (i==0 || i==2) ? (leftMap) : (rightMap);
+		quad[i].tv = (i==0 || i==1) ? (topMap) : (bottomMap);
+	}
+}
+
+// undoes the renderstates InternalDrawImageD3D set up for a draw
+void WindowsDX::InternalResetStatesD3D(LPDIRECT3DDEVICE7 device, DrawFlags flags, int alphatype)
+{
+	if(flags & DRAWOP_NOBLENDALPHA && flags & DRAW_PLAIN)
 		device->SetRenderState(D3DRENDERSTATE_ALPHABLENDENABLE, TRUE);
 
-	if(draw_state->flags & DRAWOP_NOFILTER) {
+	if(flags & DRAWOP_NOFILTER) {
 		device->SetTextureStageState(0,D3DTSS_MAGFILTER,D3DTFG_LINEAR);
 		device->SetTextureStageState(0,D3DTSS_MINFILTER,D3DTFG_LINEAR);
 	}
 
-	if(draw_state->flags & DRAWOP_NODITHER)
+	if(flags & DRAWOP_NODITHER)
 		device->SetRenderState(D3DRENDERSTATE_DITHERENABLE, TRUE);
 
 	if(alphatype == 1) { // if masked
 		device->SetRenderState(D3DRENDERSTATE_COLORKEYENABLE,FALSE);
 	}
 
-	if(draw_state->flags & DRAWOP_INVERTED) {
+	if(flags & DRAWOP_INVERTED) {
 		device->SetTextureStageState(0,D3DTSS_COLORARG1, D3DTA_TEXTURE);
 	}
 
-	if(draw_state->flags & DRAWOP_NOCULL)
+	if(flags & DRAWOP_NOCULL)
 		d3d_device->SetRenderState(D3DRENDERSTATE_CULLMODE, D3DCULL_CCW);
+}
 
-	// rest of DRAW_BURN workaround is implemented here if the DRAW_SUBTRACT workaround is also needed:
-	if(work_burn && !(win_subtract_workaround != 2 && (win_subtract_workaround != 1 || alphatype == 2))) {
-		draw_state->flags ^= DRAW_SUBTRACT | DRAW_INVERT; // switch from inversion to subtraction
-		draw_state->colors /= 2.0f;
-		InternalDrawImageD3D(device, image, src_rect, src_bounds, x, y, z, surf_width, surf_height, alphatype);
-		draw_state->colors *= 2.0f;
+// only plain and additive draws batch -- the other modes may switch
+// textures or draw twice to work around old video cards
+bool WindowsDX::InternalCanBatchD3D(int alphatype)
+{
+	DrawFlags mode = draw_state->flags & DRAWMODESMASK;
+	if(mode != DRAW_PLAIN && mode != DRAW_ADD)
+		return false;
+	if(win_alpha_blend_workaround == 1 && mode == DRAW_PLAIN && alphatype != 2 && draw_state->colors.HasTransparency())
+		return false;
+	return true;
+}
+
+void WindowsDX::BeginBatch (void)
+{
+	if(quad_batch_verts == NULL) {
+		quad_batch_verts = new D3DTLVERTEX[WINDX_BATCHSIZE*4];
+		quad_batch_indices = new WORD[WINDX_BATCHSIZE*6];
+		for(int i = 0 ; i < WINDX_BATCHSIZE ; i++) { // two triangles wound the same way as the strip's
+			WORD v = (WORD)(i*4);
+			quad_batch_indices[i*6+0] = v;	 quad_batch_indices[i*6+1] = v+1; quad_batch_indices[i*6+2] = v+2;
+			quad_batch_indices[i*6+3] = v+2; quad_batch_indices[i*6+4] = v+1; quad_batch_indices[i*6+5] = v+3;
+		}
 	}
+	quad_batch_on = true;
+}
 
-	if(work_inten) draw_state->colors *= 2.0f; // reverse color change from DRAW_INTENSIFY workaround
+void WindowsDX::EndBatch (void)
+{
+	FlushQuadBatch();
+	quad_batch_on = false;
+}
 
-	// report our success or failure to do the actual drawing:
+void WindowsDX::FlushQuadBatch (void)
+{
+	if(quad_batch_count == 0) return;
+
+	HRESULT status = quad_batch_device->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, D3DFVF_TLVERTEX, quad_batch_verts, quad_batch_count*4, quad_batch_indices, quad_batch_count*6, 0);
+	stat_calls++;
+	quad_batch_count = 0;
+
+	InternalResetStatesD3D(quad_batch_device, quad_batch_flags, quad_batch_alphatype);
 
 	if(FAILED(status)) {
 		Direct3DError(status);
 		DirectDrawError(status);
-		return 0;
-	} else {
-		return 1;
 	}
 }
 
@@ -4900,73 +5092,40 @@ int WindowsDX::InternalDrawPlain (XBYTE * source_pix, XBYTE * dest_pix, RECT & s
 
 	if(drawType == 0) return 1; // image is entirely out of bounds, so just return
 
-	XBYTE2 *img_start;
-	XBYTE2 *view_start;
-	int img_xs = dst_rect.right-dst_rect.left;
-	int img_ys = dst_rect.bottom-dst_rect.top;
-
 	int img_offset = src_rect.top * src_pitch + src_rect.left;
 	int view_offset = dst_rect.top * dst_pitch + dst_rect.left;
+	int img_xs = dst_rect.right-dst_rect.left;
+	int img_ys = dst_rect.bottom-dst_rect.top;
 
+	XBYTE2 *img_start = (XBYTE2 *) source_pix + img_offset;
+	XBYTE2 *view_start = (XBYTE2 *) dest_pix + view_offset;
 
 	if(drawType == 1) {
-		// if source and destination rectangles are exactly the same size,
-		// use this optimized code that assumes no scaling:
-
-		if(nomask) {
-			
-			// even slightly more optimized code that assumes no mask
-
-			img_start = (XBYTE2 *) source_pix + img_offset;
-			view_start = (XBYTE2 *) dest_pix + view_offset;
-			for (int y=img_ys; y--;) {			
-				memcpy (view_start, img_start, img_xs<<1) ; // the	<< 1  is 16-bit specific
-				view_start += dst_pitch;
-				img_start += src_pitch;
-			} 
-		} else {
-
-			XBYTE2 *img_now;
-			XBYTE2 *view_pix;
-
-			int src_height = src_rect.bottom-src_rect.top;
-			int src_width = src_rect.right-src_rect.left;
-
-			img_start = (XBYTE2 *) source_pix + img_offset;
-			view_start = (XBYTE2 *) dest_pix + view_offset;
-			for (int y=0 ; y < img_ys; y++) {
+		// if source and destination rectangles are exactly the same size:
+		// (each row goes straight through the blend kernels, see gamex-blend)
 
-				view_pix = view_start;
-				img_now = img_start;
-				for (int x=0 ; x < img_xs; x++) {
-					if (* img_now) * view_pix = * img_now;
-					view_pix++; img_now++;
-				}
-				view_start += dst_pitch;
-				img_start += src_pitch;
-			}
+		for (int y=0 ; y < img_ys; y++) {
+			BlendPlain (view_start, img_start, img_xs, nomask);
+			view_start += dst_pitch;
+			img_start += src_pitch;
 		}
+
 	} else {
-		// if drawType == 2, that means we have to stretch or shrink the image accordingly:
+		// if ClipRects() returned 2, that means we have to stretch or shrink the image accordingly:
 		// (using nearest-neighbor technique, since it's the easiest to implement)
+		// the source pixels are gathered a chunk at a time for the same kernels
 
-		XBYTE2 *img_rowstart;
-		XBYTE2 *img_now;
-		XBYTE2 *view_pix;
+		XBYTE2 row[BLEND_CHUNK];
 
 		int src_height = src_rect.bottom-src_rect.top;
 		int src_width = src_rect.right-src_rect.left;
 
-		img_start = (XBYTE2 *) source_pix + img_offset;
-		view_start = (XBYTE2 *) dest_pix + view_offset;
 		for (int y=0 ; y < img_ys; y++) {
-
-			img_rowstart = img_start + y*src_height/img_ys*src_pitch;
-			view_pix = view_start;
-			for (int x=0 ; x < img_xs; x++) {
-				img_now = img_rowstart + x*src_width/img_xs;
-				if(nomask || *img_now) * view_pix = * img_now;
-				view_pix++;
+			XBYTE2 *img_rowstart = img_start + y*src_height/img_ys*src_pitch;
+			for (int x=0 ; x < img_xs; x += BLEND_CHUNK) {
+				int count = min(BLEND_CHUNK, img_xs-x);
+				BlendGather16 (row, img_rowstart, x, count, src_width, img_xs);
+				BlendPlain (view_start + x, row, count, nomask);
 			}
 			view_start += dst_pitch;
 		}
@@ -5092,105 +5251,49 @@ int WindowsDX::InternalDrawAlphaMerged (XBYTE * source_pix, XBYTE * dest_pix, RE
 	// Unfortunately, DirectDraw doesn't support alpha blending (and never will).
 	// Fortunately, Direct3D does support alpha blending, but this function is for in case we can't use D3D
 
+	BlendFormat fmt (win_maskr, win_maskg, win_maskb, win_shiftr, win_shiftg, win_shiftb);
+
 	int drawType = ClipRects(src_rect, dst_rect, src_bounds, dst_bounds);
 
 	if(drawType == 0) return 1; // image is entirely out of bounds, so just return
 
-	if(drawType == 1) {
-		// if source and destination rectangles are exactly the same size:
-
-		XBYTE4 *img_start;
-		XBYTE4 *img_now;
-
-		XBYTE2 *view_start;
-		XBYTE2 *view_pix;
-
-		int img_offset = src_rect.top * src_pitch + src_rect.left;
-		int view_offset = dst_rect.top * dst_pitch + dst_rect.left;
-		int img_xs = dst_rect.right-dst_rect.left;
-		int img_ys = dst_rect.bottom-dst_rect.top;
-		int src_height = src_rect.bottom-src_rect.top;
-		int src_width = src_rect.right-src_rect.left;
+	int img_offset = src_rect.top * src_pitch + src_rect.left;
+	int view_offset = dst_rect.top * dst_pitch + dst_rect.left;
+	int img_xs = dst_rect.right-dst_rect.left;
+	int img_ys = dst_rect.bottom-dst_rect.top;
 
-		img_start = (XBYTE4 *) source_pix + img_offset;
-		view_start = (XBYTE2 *) dest_pix + view_offset;
+	XBYTE4 *img_start = (XBYTE4 *) source_pix + img_offset;
+	XBYTE2 *view_start = (XBYTE2 *) dest_pix + view_offset;
 
-		XBYTE2 *temp = new XBYTE2[img_xs];
+	if(drawType == 1) {
+		// if source and destination rectangles are exactly the same size:
+		// (each row goes straight through the blend kernels, see gamex-blend)
 
 		for (int y=0 ; y < img_ys; y++) {
-			memcpy (temp, view_start, img_xs<<1) ; // copy a source-length line of the destination -- the slowest part by far, but there doesn't seem to be a way to optimize it any more...
-			view_pix = view_start;
-			img_now = img_start;
-			for (int x=0 ; x < img_xs; x++) {
-				int i = *img_now;
-				int a = ((i & 0xFF000000) >> 24);
-				if (a) {
-					int r = ((i & 0x00FF0000) >> 16);
-					int g = ((i & 0x0000FF00) >> 8);
-					int b = ((i & 0x000000FF) >> 0);
-					i = ((r >> 3) << win_shiftr) | ((g >> 2) << win_shiftg) | ((b >> 3) << win_shiftb);
-					int v = temp[view_pix-view_start] ; // speedy alternative to: v = *view_pix
-					*view_pix = (((((v & win_maskb) * (255-a)) >> 8) & win_maskb) + ((((i & win_maskb) * a) >> 8) & win_maskb))
-							  | (((((v & win_maskg) * (255-a)) >> 8) & win_maskg) + ((((i & win_maskg) * a) >> 8) & win_maskg))
-							  | (((((v & win_maskr) * (255-a)) >> 8) & win_maskr) + ((((i & win_maskr) * a) >> 8) & win_maskr));
-				}
-				view_pix++; img_now++;
-			}
+			BlendAlphaMerged (view_start, img_start, img_xs, fmt);
 			view_start += dst_pitch;
 			img_start += src_pitch;
 		}
-		delete [] temp;
 
 	} else {
 		// if ClipRects() returned 2, that means we have to stretch or shrink the image accordingly:
 		// (using nearest-neighbor technique, since it's the easiest to implement)
+		// the source pixels are gathered a chunk at a time for the same kernels
 
-		XBYTE4 *img_start;
-		XBYTE4 *img_rowstart;
-		XBYTE4 *img_now;
-
-		XBYTE2 *view_start;
-		XBYTE2 *view_pix;
+		XBYTE4 row[BLEND_CHUNK];
 
-		int img_offset = src_rect.top * src_pitch + src_rect.left;
-		int view_offset = dst_rect.top * dst_pitch + dst_rect.left;
-		int img_xs = dst_rect.right-dst_rect.left;
-		int img_ys = dst_rect.bottom-dst_rect.top;
 		int src_height = src_rect.bottom-src_rect.top;
 		int src_width = src_rect.right-src_rect.left;
 
-		img_start = (XBYTE4 *) source_pix + img_offset;
-		view_start = (XBYTE2 *) dest_pix + view_offset;
-
-		XBYTE2 *temp = new XBYTE2[img_xs];
-
 		for (int y=0 ; y < img_ys; y++) {
-			memcpy (temp, view_start, img_xs<<1) ; // copy a source-length line of the destination -- the slowest part by far, but there doesn't seem to be a way to optimize it any more...
-
-			int yOffset = y*src_height/img_ys*src_pitch;
-			img_rowstart = img_start + yOffset;
-			view_pix = view_start;
-			for (int x=0 ; x < img_xs; x++) {
-				int xOffset = x*src_width/img_xs;
-				img_now = img_rowstart + xOffset;
-
-				int i = *img_now;
-				int a = ((i & 0xFF000000) >> 24);
-				if (a) {
-					int r = ((i & 0x00FF0000) >> 16);
-					int g = ((i & 0x0000FF00) >> 8);
-					int b = ((i & 0x000000FF) >> 0);
-					i = ((r >> 3) << win_shiftr) | ((g >> 2) << win_shiftg) | ((b >> 3) << win_shiftb);
-					int v = temp[view_pix-view_start] ; // speedy alternative to: v = *view_pix
-					*view_pix = (((((v & win_maskb) * (255-a)) >> 8) & win_maskb) + ((((i & win_maskb) * a) >> 8) & win_maskb))
-							  | (((((v & win_maskg) * (255-a)) >> 8) & win_maskg) + ((((i & win_maskg) * a) >> 8) & win_maskg))
-							  | (((((v & win_maskr) * (255-a)) >> 8) & win_maskr) + ((((i & win_maskr) * a) >> 8) & win_maskr));
-				}
-				view_pix++;
+			XBYTE4 *img_rowstart = img_start + y*src_height/img_ys*src_pitch;
+			for (int x=0 ; x < img_xs; x += BLEND_CHUNK) {
+				int count = min(BLEND_CHUNK, img_xs-x);
+				BlendGather32 (row, img_rowstart, x, count, src_width, img_xs);
+				BlendAlphaMerged (view_start + x, row, count, fmt);
 			}
 			view_start += dst_pitch;
 		}
-		delete [] temp;
 	}
 	return 1;
 }
@@ -5205,120 +5308,49 @@ int WindowsDX::InternalDrawAdded (XBYTE * source_pix, XBYTE * dest_pix, RECT & s
 {
 	if(!(ri>0||gi>0||bi>0)) return 1; // if no intensity at all, return to save processor time
 
+	BlendFormat fmt (win_maskr, win_maskg, win_maskb, win_shiftr, win_shiftg, win_shiftb);
+
 	int drawType = ClipRects(src_rect, dst_rect, src_bounds, dst_bounds);
 
 	if(drawType == 0) return 1; // image is entirely out of bounds, so just return
 
-	if(drawType == 1) {
-		// if source and destination rectangles are exactly the same size:
-
-		XBYTE2 *img_start;
-		XBYTE2 *img_now;
-
-		XBYTE2 *view_start;
-		XBYTE2 *view_pix;
-
-		int img_offset = src_rect.top * src_pitch + src_rect.left;
-		int view_offset = dst_rect.top * dst_pitch + dst_rect.left;
-		int img_xs = dst_rect.right-dst_rect.left;
-		int img_ys = dst_rect.bottom-dst_rect.top;
-		int src_height = src_rect.bottom-src_rect.top;
-		int src_width = src_rect.right-src_rect.left;
+	int img_offset = src_rect.top * src_pitch + src_rect.left;
+	int view_offset = dst_rect.top * dst_pitch + dst_rect.left;
+	int img_xs = dst_rect.right-dst_rect.left;
+	int img_ys = dst_rect.bottom-dst_rect.top;
 
-		img_start = (XBYTE2 *) source_pix + img_offset;
-		view_start = (XBYTE2 *) dest_pix + view_offset;
+	XBYTE2 *img_start = (XBYTE2 *) source_pix + img_offset;
+	XBYTE2 *view_start = (XBYTE2 *) dest_pix + view_offset;
 
-		XBYTE2 *temp = new XBYTE2[img_xs];
+	if(drawType == 1) {
+		// if source and destination rectangles are exactly the same size:
+		// (each row goes straight through the blend kernels, see gamex-blend)
 
-		if(ri==255 && gi==255 && bi==255) { // slightly faster code in fully additive case (which r,g,b default to)
-			for (int y=0 ; y < img_ys; y++) {
-				memcpy (temp, view_start, img_xs<<1) ; // copy a source-length line of the destination -- the slowest part by far, but there doesn't seem to be a way to optimize it any more...
-				view_pix = view_start;
-				img_now = img_start;
-				for (int x=0 ; x < img_xs; x++) {
-					int i, v;
-					if ((i = *img_now) && ((v = temp[view_pix-view_start]) != 65535)) { // if destination pixel isn't white and source pixel isn't black
-						*view_pix = min(((v & win_maskb) + (i & win_maskb)), win_maskb)
-								  | min(((v & win_maskg) + (i & win_maskg)), win_maskg)
-								  | min(((v & win_maskr) + (i & win_maskr)), win_maskr) ;
-					}
-					view_pix++; img_now++;
-				}
-				view_start += dst_pitch;
-				img_start += src_pitch;
-			}
-		}
-		else {
-			for (int y=0 ; y < img_ys; y++) {
-				memcpy (temp, view_start, img_xs<<1) ; // copy a source-length line of the destination -- the slowest part by far, but there doesn't seem to be a way to optimize it any more...
-				view_pix = view_start;
-				img_now = img_start;
-				for (int x=0 ; x < img_xs; x++) {
-					int i, v;
-					if ((i = *img_now)) { // if source pixel isn't black
-						v = temp[view_pix-view_start] ; // speedy alternative to: v = *view_pix
-						int blue  = ((v & win_maskb) + (((((i & win_maskb) >> win_shiftb) * bi) >> 8) << win_shiftb)) ;
-						int green = ((v & win_maskg) + (((((i & win_maskg) >> win_shiftg) * gi) >> 8) << win_shiftg)) ;
-						int red   = ((v & win_maskr) + (((((i & win_maskr) >> win_shiftr) * ri) >> 8) << win_shiftr)) ;
-						*view_pix = ((bi < 0) ? max(0,blue)  : min(win_maskb, blue))
-								  | ((gi < 0) ? max(0,green) : min(win_maskg, green))
-								  | ((ri < 0) ? max(0,red)	 : min(win_maskr, red)) ;
-					}
-					view_pix++; img_now++;
-				}
-				view_start += dst_pitch;
-				img_start += src_pitch;
-			}
+		for (int y=0 ; y < img_ys; y++) {
+			BlendAdded (view_start, img_start, img_xs, ri, gi, bi, fmt);
+			view_start += dst_pitch;
+			img_start += src_pitch;
 		}
-		delete [] temp;
 
 	} else {
 		// if ClipRects() returned 2, that means we have to stretch or shrink the image accordingly:
 		// (using nearest-neighbor technique, since it's the easiest to implement)
+		// the source pixels are gathered a chunk at a time for the same kernels
 
-		XBYTE2 *img_start;
-		XBYTE2 *img_rowstart;
-		XBYTE2 *img_now;
-
-		XBYTE2 *view_start;
-		XBYTE2 *view_pix;
+		XBYTE2 row[BLEND_CHUNK];
 
-		int img_offset = src_rect.top * src_pitch + src_rect.left;
-		int view_offset = dst_rect.top * dst_pitch + dst_rect.left;
-		int img_xs = dst_rect.right-dst_rect.left;
-		int img_ys = dst_rect.bottom-dst_rect.top;
 		int src_height = src_rect.bottom-src_rect.top;
 		int src_width = src_rect.right-src_rect.left;
 
-		img_start = (XBYTE2 *) source_pix + img_offset;
-		view_start = (XBYTE2 *) dest_pix + view_offset;
-
-		XBYTE2 *temp = new XBYTE2[img_xs];
-
 		for (int y=0 ; y < img_ys; y++) {
-			memcpy (temp, view_start, img_xs<<1) ; // copy a source-length line of the destination -- the slowest part by far, but there doesn't seem to be a way to optimize it any more...
-			img_rowstart = img_start + y*src_height/img_ys*src_pitch;
-			view_pix = view_start;
-			for (int x=0 ; x < img_xs; x++) {
-				img_now = img_rowstart + x*src_width/img_xs;
-
-				// assignment, not equality... and v = temp[view_pix] is the speedy alternative to: v = *view_pix
-				int i, v;
-				if ((i = *img_now)) { // if source pixel isn't black
-					v = temp[view_pix-view_start] ; // speedy alternative to: v = *view_pix
-					int blue  = ((v & win_maskb) + (((((i & win_maskb) >> win_shiftb) * bi) >> 8) << win_shiftb)) ;
-					int green = ((v & win_maskg) + (((((i & win_maskg) >> win_shiftg) * gi) >> 8) << win_shiftg)) ;
-					int red   = ((v & win_maskr) + (((((i & win_maskr) >> win_shiftr) * ri) >> 8) << win_shiftr)) ;
-					*view_pix = ((bi < 0) ? max(0,blue)  : min(win_maskb, blue))
-							  | ((gi < 0) ? max(0,green) : min(win_maskg, green))
-							  | ((ri < 0) ? max(0,red)	 : min(win_maskr, red)) ;
-				}
-
-				view_pix++;
+			XBYTE2 *img_rowstart = img_start + y*src_height/img_ys*src_pitch;
+			for (int x=0 ; x < img_xs; x += BLEND_CHUNK) {
+				int count = min(BLEND_CHUNK, img_xs-x);
+				BlendGather16 (row, img_rowstart, x, count, src_width, img_xs);
+				BlendAdded (view_start + x, row, count, ri, gi, bi, fmt);
 			}
 			view_start += dst_pitch;
 		}
-		delete [] temp;
 	}
 	return 1;
 }
@@ -5467,90 +5499,49 @@ int WindowsDX::InternalDrawBlended (XBYTE * source_pix, XBYTE * dest_pix, RECT &
 {
 	if(a<=0) return 1; // if no opacity at all, return to save processor time
 
+	BlendFormat fmt (win_maskr, win_maskg, win_maskb, win_shiftr, win_shiftg, win_shiftb);
+
 	int drawType = ClipRects(src_rect, dst_rect, src_bounds, dst_bounds);
 
 	if(drawType == 0) return 1; // image is entirely out of bounds, so just return
 
-	XBYTE2 *img_start;
-	XBYTE2 *img_now;
-	XBYTE2 *view_start;
-	XBYTE2 *view_pix;
 	int img_offset = src_rect.top * src_pitch + src_rect.left;
 	int view_offset = dst_rect.top * dst_pitch + dst_rect.left;
 	int img_xs = dst_rect.right-dst_rect.left;
 	int img_ys = dst_rect.bottom-dst_rect.top;
 
+	XBYTE2 *img_start = (XBYTE2 *) source_pix + img_offset;
+	XBYTE2 *view_start = (XBYTE2 *) dest_pix + view_offset;
+
 	if(drawType == 1) {
 		// if source and destination rectangles are exactly the same size:
-
-
-		img_start = (XBYTE2 *) source_pix + img_offset;
-		view_start = (XBYTE2 *) dest_pix + view_offset;
-
-		XBYTE2 *temp = new XBYTE2[img_xs];
+		// (each row goes straight through the blend kernels, see gamex-blend)
 
 		for (int y=0 ; y < img_ys; y++) {
-			memcpy (temp, view_start, img_xs<<1) ; // copy a source-length line of the destination -- the slowest part by far, but there doesn't seem to be a way to optimize it any more...
-			view_pix = view_start;
-			img_now = img_start;
-			for (int x=0 ; x < img_xs; x++) {
-				int i, v;
-				if ((i = *img_now) || nomask) { // if source pixel isn't black
-					v = temp[view_pix-view_start] ; // speedy alternative to: v = *view_pix
-					*view_pix =
-						  ((((((v & win_maskb) >> win_shiftb) *   (255-a)) >> 8) << win_shiftb)
-						 + (((((i & win_maskb) >> win_shiftb) * (b*a/255)) >> 8) << win_shiftb))
-						| ((((((v & win_maskg) >> win_shiftg) *   (255-a)) >> 8) << win_shiftg)
-						 + (((((i & win_maskg) >> win_shiftg) * (g*a/255)) >> 8) << win_shiftg))
-						| ((((((v & win_maskr) >> win_shiftr) *   (255-a)) >> 8) << win_shiftr)
-						 + (((((i & win_maskr) >> win_shiftr) * (r*a/255)) >> 8) << win_shiftr)) ;
-				}
-				view_pix++; img_now++;
-			}
+			BlendBlended (view_start, img_start, img_xs, r, g, b, a, nomask, fmt);
 			view_start += dst_pitch;
 			img_start += src_pitch;
 		}
-		delete [] temp;
 
 	} else {
 		// if ClipRects() returned 2, that means we have to stretch or shrink the image accordingly:
 		// (using nearest-neighbor technique, since it's the easiest to implement)
+		// the source pixels are gathered a chunk at a time for the same kernels
 
-		XBYTE2 *img_rowstart;
+		XBYTE2 row[BLEND_CHUNK];
 
 		int src_height = src_rect.bottom-src_rect.top;
 		int src_width = src_rect.right-src_rect.left;
 
-		img_start = (XBYTE2 *) source_pix + img_offset;
-		view_start = (XBYTE2 *) dest_pix + view_offset;
-
-		XBYTE2 *temp = new XBYTE2[img_xs];
-
 		for (int y=0 ; y < img_ys; y++) {
-			memcpy (temp, view_start, img_xs<<1) ; // copy a source-length line of the destination -- the slowest part by far, but there doesn't seem to be a way to optimize it any more...
-			img_rowstart = img_start + y*src_height/img_ys*src_pitch;
-			view_pix = view_start;
-			for (int x=0 ; x < img_xs; x++) {
-				img_now = img_rowstart + x*src_width/img_xs;
-
-				// assignment, not equality... and v = temp[view_pix] is the speedy alternative to: v = *view_pix
-				int i, v;
-				if ((i = *img_now) || nomask) { // if source pixel isn't black
-					v = temp[view_pix-view_start] ; // speedy alternative to: v = *view_pix
-					*view_pix =
-						  ((((((v & win_maskb) >> win_shiftb) *   (255-a)) >> 8) << win_shiftb)
-						 + (((((i & win_maskb) >> win_shiftb) * (b*a/255)) >> 8) << win_shiftb))
-						| ((((((v & win_maskg) >> win_shiftg) *   (255-a)) >> 8) << win_shiftg)
-						 + (((((i & win_maskg) >> win_shiftg) * (g*a/255)) >> 8) << win_shiftg))
-						| ((((((v & win_maskr) >> win_shiftr) *   (255-a)) >> 8) << win_shiftr)
-						 + (((((i & win_maskr) >> win_shiftr) * (r*a/255)) >> 8) << win_shiftr)) ;
-				}
-
-				view_pix++;
+			XBYTE2 *img_rowstart = img_start + y*src_height/img_ys*src_pitch;
+			for (int x=0 ; x < img_xs; x += BLEND_CHUNK) {
+				int count = min(BLEND_CHUNK, img_xs-x);
+				BlendGather16 (row, img_rowstart, x, count, src_width, img_xs);
+				BlendBlended (view_start + x, row, count, r, g, b, a, nomask, fmt);
 			}
 			view_start += dst_pitch;
 		}
-		delete [] temp;
 	}
 	return 1;
 }
@@ -5870,9 +5861,6 @@ void WindowsDX::ReportProblem (void)
 void WindowsDX::PlaySound (SoundX * snd, SoundPlayMode mode, float vol, float pan, float freq)
 {
 	if(sound_support) {
-		if(snd->NeedUpdate()==true) UpdateSound((SoundXPtr)snd) ;	
-		LPDIRECTSOUNDBUFFER buffer = snd->GetDSBuffer();
-		if(buffer == NULL) return;
 		if(pan > 1.0f) {
 			vol *= max(0.0f, 1.0f - (pan-1.0f));
 			pan = 1.0f;
@@ -5882,6 +5870,13 @@ void WindowsDX::PlaySound (SoundX * snd, SoundPlayMode mode, float vol, float pa
 		}
 		if(vol > 1.0f) vol = 1.0f; // DirectSound does not support sound amplification (volume > 100%)
 		if(vol < 0.0f) vol = 0.0f;
+		if(IsMixed(snd)) {
+			PlayMixed(snd, mode, vol, pan, freq);
+			return;
+		}
+		if(snd->NeedUpdate()==true) UpdateSound((SoundXPtr)snd) ;	
+		LPDIRECTSOUNDBUFFER buffer = snd->GetDSBuffer();
+		if(buffer == NULL) return;
 		if(mode & PLAY_NOTIFLESSVOL) {
 			DWORD status;
 			buffer->GetStatus(&status);
@@ -5901,6 +5896,158 @@ void WindowsDX::PlaySound (SoundX * snd, SoundPlayMode mode, float vol, float pa
 	}
 }
 
+bool WindowsDX::IsMixed (SoundX * snd)
+{
+	return ds_mixer != NULL && snd->GetBPS() == 16;
+}
+
+// DirectSound takes volume and pan as attenuations in hundredths of a
+// decibel; the mixer gets the gains those come to, to sound the same.
+// vol and pan are as PlaySound leaves them, clamped to 0..1 and -1..1
+void WindowsDX::ToMixerGains (float vol, float pan, float& left, float& right)
+{
+	long attenuation = ToAttenuation(vol);
+	float gain = (attenuation <= -10000) ? 0.0f : powf(10.0f, attenuation / 2000.0f);
+	left = right = gain;
+	if(pan > 0.0f) left *= powf(10.0f, -pan * 2048.0f / 2000.0f);
+	if(pan < 0.0f) right *= powf(10.0f, pan * 2048.0f / 2000.0f);
+}
+
+// PlaySound through the mixer (vol and pan already clamped)
+void WindowsDX::PlayMixed (SoundX * snd, SoundPlayMode mode, float vol, float pan, float freq)
+{
+	// a reloaded sound may have new data, so nothing may go on playing the old
+	if(snd->NeedUpdate()==true) {
+		StopSound(snd);
+		snd->SetRefresh(false);
+	}
+
+	float left, right;
+	ToMixerGains(vol, pan, left, right);
+
+	int voice = ds_mixer->Find(snd);
+	if(voice >= 0 && (mode & PLAY_NOTIFLESSVOL) && max(left, right) < ds_mixer->GetGain(voice))
+		return;
+	if(voice < 0)
+		voice = ds_mixer->Play(snd, (short*) snd->GetData(), snd->GetNumSamples(), snd->GetNumChannels(), snd->GetSamplesPerSec());
+	else if(mode & PLAY_REWIND)
+		ds_mixer->Rewind(voice);
+	if(voice < 0) return; // every voice is busy with something more important
+
+	ds_mixer->Set(voice, left, right, freq);
+	ds_mixer->SetLoop(voice, (mode & PLAY_LOOP) != 0);
+}
+
+void WindowsDX::TriggerSound (SoundX * snd, float vol, float pan, float freq)
+{
+	if(!sound_support) return;
+	if(!IsMixed(snd)) {
+		PlaySound(snd, PLAY_CONTINUE, vol, pan, freq);
+		return;
+	}
+
+	if(snd->NeedUpdate()==true) {
+		StopSound(snd);
+		snd->SetRefresh(false);
+	}
+
+	// the same clamping as PlaySound
+	if(pan > 1.0f) {
+		vol *= max(0.0f, 1.0f - (pan-1.0f));
+		pan = 1.0f;
+	} else if(pan < -1.0f) {
+		vol *= max(0.0f, 1.0f - (-pan-1.0f));
+		pan = -1.0f;
+	}
+	if(vol > 1.0f) vol = 1.0f;
+	if(vol < 0.0f) vol = 0.0f;
+
+	float left, right;
+	ToMixerGains(vol, pan, left, right);
+	ds_mixer->Trigger(snd, (short*) snd->GetData(), snd->GetNumSamples(), snd->GetNumChannels(), snd->GetSamplesPerSec(), left, right, freq);
+}
+
+void WindowsDX::SetSoundThrottle (float window_seconds, int max_copies)
+{
+	if(ds_mixer != NULL)
+		ds_mixer->SetThrottle((int) (window_seconds * MIXER_RATE), max_copies);
+}
+
+void WindowsDX::GetSoundStats (int& voices, int& merged, int& dropped)
+{
+	voices = merged = dropped = 0;
+	if(ds_mixer != NULL) {
+		voices = ds_mixer->GetNumPlaying();
+		merged = ds_mixer->GetMerged();
+		dropped = ds_mixer->GetDropped();
+	}
+}
+
+void WindowsDX::UpdateMixer (void)
+{
+	if(ds_mixer == NULL) return;
+	if(ds_stream != NULL) ds_stream->Fill(); // read the music ahead of mixing it
+
+	DWORD play, write;
+	if(FAILED(ds_mix_buffer->GetCurrentPosition(&play, &write))) return;
+
+	// bytes already mixed ahead of the play cursor -- more than the lead
+	// means the cursor went all the way round past them, during a stall
+	int lead = WINDX_MIX_LEAD * 4;
+	int ahead = (ds_mix_pos - (int) play + ds_mix_bytes) % ds_mix_bytes;
+	int safe = ((int) write - (int) play + ds_mix_bytes) % ds_mix_bytes;
+	if(ahead < safe || ahead > lead) {
+		ds_mix_pos = (int) write;
+		ahead = safe;
+	}
+	int frames = (lead - ahead) / 4;
+	if(frames < MIXER_BLOCK) return; // mix a block at a time
+
+	// lock all the way round to the play cursor: mix the lead, silence the rest
+	void *buf_a, *buf_b;
+	DWORD bytes_a, bytes_b;
+	HRESULT result = ds_mix_buffer->Lock(ds_mix_pos, ds_mix_bytes - ahead, &buf_a, &bytes_a, &buf_b, &bytes_b, 0);
+	if(result == DSERR_BUFFERLOST) {
+		ds_mix_buffer->Restore();
+		result = ds_mix_buffer->Lock(ds_mix_pos, ds_mix_bytes - ahead, &buf_a, &bytes_a, &buf_b, &bytes_b, 0);
+	}
+	if(FAILED(result)) return;
+
+	int frames_a = min(frames, (int) bytes_a / 4);
+	ds_mixer->Mix((short*) buf_a, frames_a);
+	ZeroMemory((char*) buf_a + frames_a*4, bytes_a - frames_a*4);
+	if(buf_b != NULL) {
+		ds_mixer->Mix((short*) buf_b, frames - frames_a);
+		ZeroMemory((char*) buf_b + (frames - frames_a)*4, bytes_b - (frames - frames_a)*4);
+	}
+	ds_mix_buffer->Unlock(buf_a, bytes_a, buf_b, bytes_b);
+	ds_mix_pos = (ds_mix_pos + frames*4) % ds_mix_bytes;
+}
+
+bool WindowsDX::PlayStream (MusicStream* stream, float volume, bool loop)
+{
+	StopStream();
+	if(ds_mixer == NULL || stream == NULL || !stream->IsOpen()) return false;
+	if(stream->GetRate() != ds_mixer->GetRate()) {
+		debug.Output("WinDX: Can't stream music that isn't at the mixer's rate");
+		return false;
+	}
+	stream->SetLoop(loop);
+	int voice = ds_mixer->Stream(stream, stream, stream->GetChannels(), WINDX_STREAM_PRIORITY);
+	if(voice < 0) return false;
+	ds_mixer->Set(voice, volume, volume, 1.0f);
+	ds_stream = stream;
+	return true;
+}
+
+void WindowsDX::StopStream (void)
+{
+	if(ds_stream == NULL) return;
+	int voice = ds_mixer->Find(ds_stream); // gone already if the stream ended
+	if(voice >= 0) ds_mixer->Stop(voice);
+	ds_stream = NULL;
+}
+
 
 // Plays a MusicX object, and immediately stops playing any other music that may be playing
 // times of 0 means infinite loop, 1 means play once, 2 means play twice, etc.
@@ -6059,6 +6206,7 @@ bool WindowsDX::IsMusicPlaying(MusicX * music)
 
 bool WindowsDX::IsSoundPlaying(SoundX * snd)
 {
+	if(IsMixed(snd)) return ds_mixer->Find(snd) >= 0;
 	if(snd->NeedUpdate()==true) UpdateSound(snd) ;	
 	LPDIRECTSOUNDBUFFER buffer = snd->GetDSBuffer();
 	if(buffer == NULL) return false;
@@ -6074,6 +6222,10 @@ bool WindowsDX::IsSoundPlaying(SoundX * snd)
 void WindowsDX::RewindSound (SoundX * snd)
 {
 	if (sound_support) {
+		if (IsMixed(snd)) {
+			ds_mixer->Rewind(ds_mixer->Find(snd));
+			return;
+		}
 		if (snd->NeedUpdate()==true) UpdateSound (snd) ;	
 		snd->GetDSBuffer()->SetCurrentPosition(0) ;
 	}
@@ -6083,6 +6235,11 @@ void WindowsDX::RewindSound (SoundX * snd)
 void WindowsDX::StopSound (SoundX * snd)
 {
 	if (sound_support) {
+		if (IsMixed(snd)) { // every copy of it
+			int voice;
+			while ((voice = ds_mixer->Find(snd)) >= 0) ds_mixer->Stop(voice);
+			return;
+		}
 		snd->GetDSBuffer()->Stop() ;
 	}
 }
@@ -57,7 +57,10 @@
 	// headers of other components of GameX we need:
 	#include "gamex-debug.hpp" // allows calling of debug.Output("something") to output to the "debug.txt" file
 	#include "gamex-image.hpp" // support for loading and converting graphics
+	#include "gamex-blend.hpp" // pixel blending kernels for the software blitters
 	#include "gamex-sound.hpp" // support for loading sounds and music
+	#include "gamex-mixer.hpp" // software mixing of sounds, for AUDIO_MIXER
+	#include "gamex-stream.hpp" // music read off disk as it plays, through the mixer
 	#include "gamex-camera.hpp" // 3D camera support
 	#include "gamex-vector.hpp" // vector support
 	#include "gamex-matrix.hpp" // matrix support
@@ -229,6 +232,14 @@
 		inline void SetDrawWarp 		 (float w0, float w1, float w2, float w3) {draw_state->warp_mode = 1; draw_state->warp[0] = w0; draw_state->warp[1] = w1; draw_state->warp[2] = w2; draw_state->warp[3] = w3;}
 		inline void SetDrawDestination	 (ImageX* dest) {draw_state->dst = dest;}
 		inline void SetDrawDepth   (float depth) {draw_state->depth2D = depth + draw_state->cam->GetNear();} // only affects 2D drawing into 3D scenes! -- is the distance in world units from the screen, 0.0 means as close as possible, 10.0f means further away, etc.
+		// Quad batching: between BeginBatch and EndBatch, back-to-back 2D draws that share an image and drawing
+		// states go to the card as one triangle list instead of one call each. Drawing order is kept, so sort
+		// draws by image first to get long batches. Anything that isn't a batched draw ends the batch early.
+		void BeginBatch (void);
+		void EndBatch (void);
+		inline void GetDrawStats (int& quads, int& calls) /* for the last frame shown: quads drawn and D3D draw calls used */ {quads = stat_last_quads; calls = stat_last_calls;}
+		inline void GetDrawStats (int& quads, int& calls, int& textures) /* the same, and how many times the texture was switched */ {quads = stat_last_quads; calls = stat_last_calls; textures = stat_last_textures;}
+
 		inline void ResetDrawStates (void) {draw_state->flags = DRAW_PLAIN; SetDrawPart(0,0,DEFAULT,DEFAULT); draw_state->angle = 0.0f; draw_state->scalex = draw_state->scaley = 1.0f; draw_state->transx = draw_state->transy = 0.0f; draw_state->colors = ColorX(); SetDrawShadingEffect(DRAW_MULTIPLY); draw_state->warp_mode = 0; draw_state->dst = VIEWPORT;}
 
 
@@ -300,6 +311,25 @@
 		// Returns true if the given sound is still playing, looping, or paused, false otherwise
 		bool IsSoundPlaying (SoundX* snd);
 
+		// Plays a sound that may be started many times at once, such as one for each of a crowd of objects.
+		// With AUDIO_MIXER, triggers close together merge into one and a sound only plays a few copies
+		// at a time (see SetSoundThrottle); otherwise it's the same as PlaySound with PLAY_CONTINUE
+		void TriggerSound (SoundX* snd, float vol=1.0f, float pan=0.0f, float freq=1.0f);
+
+		// Triggers of a sound less than window_seconds apart merge, and no more than max_copies play at once
+		void SetSoundThrottle (float window_seconds, int max_copies);
+
+		// Sounds the mixer is playing, and triggers merged and dropped so far (all 0 without AUDIO_MIXER)
+		void GetSoundStats (int& voices, int& merged, int& dropped);
+
+		// With AUDIO_MIXER, mixes sound ahead of what's playing -- called by GameX every time around its loop
+		void UpdateMixer (void);
+
+		// With AUDIO_MIXER, plays an open MusicStream at the mixer's rate and keeps it read ahead, stopping
+		// any stream already playing. The stream must stay open until StopStream. False if it can't play
+		bool PlayStream (MusicStream* stream, float volume = 1.0f, bool loop = true);
+		void StopStream (void);
+
 
 		//**** Music Functions:
 		// (must load a MusicX object with music.Load(music_filename); before using the following)
@@ -555,6 +585,12 @@
 		// Draw an image using Direct3D (hopefully 3D-accelerated)
 		int InternalDrawImageD3D(LPDIRECT3DDEVICE7 device, LPDIRECTDRAWSURFACE7 image, RECT& src_rect, RECT& src_bounds, float* x, float* y, float* z, int surf_width, int surf_height, int alphatype);
 
+		// Quad batching helpers
+		bool InternalCanBatchD3D (int alphatype); // true if a draw in the current state can go in a batch
+		void InternalMakeQuadD3D (D3DTLVERTEX* quad, float* x, float* y, float* z, float leftMap, float topMap, float rightMap, float bottomMap);
+		void InternalResetStatesD3D (LPDIRECT3DDEVICE7 device, DrawFlags flags, int alphatype); // undoes the states a draw set up
+		void FlushQuadBatch (void); // draws the open batch, if any
+
 		// Draw an image using DirectDraw (hopefully 2D-accelerated)
 		int InternalDrawImageDD(LPDIRECTDRAWSURFACE7 p_src_surface, LPDIRECTDRAWSURFACE7 p_dst_surface, RECT& src_rect, RECT& dst_rect, int nomask);
 		void InternalDrawRectDD(int red, int green, int blue, int xLeft, int yTop, int xRight, int yBottom); // fast but cannot use any advanced features like transparency or rotation
@@ -580,7 +616,7 @@
 		// helper function for functions that want to convert 4 sets of (r,g,b,a) to (r,g,b)
 		void ScaleByAlpha (ColorX& colors);
 
-		inline HRESULT EndRenderBatch(void) {draw_render_batch_open = false; return draw_render_batch_device->EndScene();}
+		inline HRESULT EndRenderBatch(void) {FlushQuadBatch(); draw_render_batch_open = false; return draw_render_batch_device->EndScene();}
 		
 		// Dispatched Drawing Functions
 		void (*FuncDrawPixel) (int x, int y, int r, int g, int b, int a);
@@ -610,6 +646,7 @@
 		bool InitDirect3D (void);
 		bool InitDirectInput (void);
 		bool InitDirectSound (void);
+		bool InitMixer (void);
 		bool InitDirectMusic (void);
 		bool TestDirectShow (void);
 		void InitVSync (void);
@@ -622,6 +659,9 @@
 		// Sound Functions
 		void UpdateSound (SoundX* snd);
 		int AddSound (SoundX* snd);
+		void PlayMixed (SoundX* snd, SoundPlayMode mode, float vol, float pan, float freq);
+		void ToMixerGains (float vol, float pan, float& left, float& right);
+		bool IsMixed (SoundX* snd); // whether the sound goes through the mixer
 
 		HINSTANCE				win_hinst;	
 		int 					win_hmode;
@@ -633,6 +673,7 @@
 		int 					win_request_full; // 0 if VIDEO_WINDOWED flag on, 1 if VIDEO_FULLSCREEN flag on, 2 if neither is on, temporarily
 		int 					win_request_vsync; // 0 unless VIDEO_ALLOWREFRESHSYNC flag on
 		bool					win_request_no_sound; // false unless AUDIO_DISABLE flag on
+		bool					win_request_mixer; // false unless AUDIO_MIXER flag on
 		bool					win_request_antialias; // false unless VIDEO_ALLOWANTIALIAS flag on
 		bool					win_request_can_resize; // true unless VIDEO_NORESIZE flag on
 		bool					win_request_use_escape; // false unless RUN_USEESCAPEKEY flag on
@@ -676,6 +717,21 @@
 		bool					draw_render_batch_open;
 		LPDIRECT3DDEVICE7		draw_render_batch_device;
 
+		bool					quad_batch_on; // true between BeginBatch and EndBatch
+		int 					quad_batch_count; // quads waiting in the open batch
+		D3DTLVERTEX*			quad_batch_verts; // 4 per quad
+		WORD*					quad_batch_indices; // 6 per quad, two triangles
+		LPDIRECT3DDEVICE7		quad_batch_device; // the states the open batch was set up with:
+		LPDIRECTDRAWSURFACE7	quad_batch_image;
+		DrawFlags				quad_batch_flags;
+		D3DTEXTUREOP			quad_batch_effect;
+		bool					quad_batch_transparent;
+		int 					quad_batch_alphatype;
+		RECT					quad_batch_bounds;
+
+		int 					stat_quads, stat_calls, stat_textures; // this frame's quads, D3D draw calls and SetTexture calls
+		int 					stat_last_quads, stat_last_calls, stat_last_textures; // the same for the last frame shown
+
 		int 					draw_3D_depth_sort; // 1 if sorting a 3D scene, 2 if actually drawing it, 0 if done or not doing either
 		SceneSortMode			draw_sort_mode;
 		GameXDrawState*			draw_state; // current draw state
@@ -743,6 +799,11 @@
 		int 					max_sounds;
 		int 					num_playing;
 		SoundXPtr*				sound_list;
+		Mixer*					ds_mixer; // NULL unless AUDIO_MIXER is on and its buffer was made
+		LPDIRECTSOUNDBUFFER 	ds_mix_buffer; // looping buffer the mixer writes into
+		int 					ds_mix_bytes; // size of ds_mix_buffer
+		int 					ds_mix_pos; // where in it the mixed sound so far ends
+		MusicStream*			ds_stream; // the stream the mixer is playing, if any
 
 		// DirectShow (see in MusicX)
 		bool					mp3_support;
@@ -15,9 +15,9 @@ namespace Game
 		GameX.Quit();
 	}
 
-	StateChangeAction::StateChangeAction( std::string newState )
+	StateChangeAction::StateChangeAction( const char* newState )
 	{
-		mNewState = newState;
+		mNewState = SMachine.GetStateID( newState );
 	}
 
 	ToggleVisible::ToggleVisible( GuiElement* elem ) : mElem(elem)
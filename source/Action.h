@@ -10,6 +10,7 @@
 
 #include "Types.h"
 #include "Gui.h"
+#include "StateMachine.h"
 
 namespace Game
 {	
@@ -30,11 +31,13 @@ namespace Game
 	{
 	public:
 
-		StateChangeAction( std::string newState );
+		// the state is looked up once here, so build these after
+		// the states are registered
+		StateChangeAction( const char* newState );
 		void Act();
 
 	private:
-		std::string mNewState;
+		StateMachine::StateID mNewState;
 	};
 
 	class ToggleVisible : public Action
@@ -180,6 +180,32 @@ bool FileExists( char* szPath )
 	return false;		
 }
 
+// Get file size and last write time from the directory entry
+bool GetFileStats( const char* szFile, uint32_t& size, uint32_t& timeLow, uint32_t& timeHigh )
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if( !GetFileAttributesEx( szFile, GetFileExInfoStandard, &data ) )
+		return false;
+
+	size	 = (uint32_t)data.nFileSizeLow;
+	timeLow  = (uint32_t)data.ftLastWriteTime.dwLowDateTime;
+	timeHigh = (uint32_t)data.ftLastWriteTime.dwHighDateTime;
+	return true;
+}
+
+// FNV-1a over a buffer
+uint32_t HashBuffer( const uint8_t* buffer, uint32_t size )
+{
+	uint32_t hash = 2166136261u;
+	for( uint32_t i = 0; i < size; ++i )
+	{
+		hash ^= buffer[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
 
 }; //end Algorithm
 
@@ -122,6 +122,18 @@ uint32_t ReadFileIntoBuffer( const char* szFile, uint8_t*& buffer );
 //-----------------------------------------------------------
 bool FileExists( char* szPath );
 
+//-----------------------------------------------------------
+// Name: GetFileStats
+// Desc:  gets size and last write time without opening the file
+//-----------------------------------------------------------
+bool GetFileStats( const char* szFile, uint32_t& size, uint32_t& timeLow, uint32_t& timeHigh );
+
+//-----------------------------------------------------------
+// Name: HashBuffer
+// Desc:  FNV-1a hash of a block of memory
+//-----------------------------------------------------------
+uint32_t HashBuffer( const uint8_t* buffer, uint32_t size );
+
 
 }; //end Algorithm
 
@@ -12,6 +12,7 @@
 
 #include "FileIO.h"
 #include "ResourceCache.h"
+#include "SpriteBatch.h"
 
 #include <math.h>
 #include <string>
@@ -56,12 +57,10 @@ namespace Game
 
 				case kArrowProp_GenSound:
 					{
-						if( mpGenSound = GetSound( (char*)itr->mData ) )						
-						{
-							// for some reason the arrow sound needs to play once
-							// or the data does not get initialized...							
-							GameX.PlaySound( mpGenSound, PLAY_REWIND, 0.0f, 0, 1.0f );
-						}						
+						// LoadWAV readies the sound when the pack is cached. playing
+						// it at volume 0 here too rewound and silenced whatever copy
+						// was already going, every time an arrow spawned
+						mpGenSound = GetSound( (char*)itr->mData );
 					}
 
 				case kArrowProp_Rotation:
@@ -130,7 +129,7 @@ namespace Game
 	{
 		if( mBaseImage )
 		{	
-			GameX.DrawImage( mBaseImage, mPos[0], mPos[1], mBBox.mRotation, 1.0f );
+			SSpriteBatch.Draw( mBaseImage, mPos[0], mPos[1], mBBox.mRotation, 1.0f );
 		}
 	}
 
@@ -210,12 +209,14 @@ namespace Game
 
 	//-----------------------------------------------------------
 	// Name: PlayGenSound
-	// Desc:  plays a generation sound if we have one
+	// Desc:  plays a generation sound if we have one. a wave
+	//		  of arrows triggers it together, so it goes through
+	//		  GameX's throttle rather than PlaySound
 	//-----------------------------------------------------------
 	void Arrow::PlayGenSound()
 	{
 		if( mpGenSound )
-			GameX.PlaySound( mpGenSound );
+			GameX.TriggerSound( mpGenSound );
 	}		
 
 	//-----------------------------------------------------------
@@ -0,0 +1,167 @@
+//---------------------------------------------------
+// Name: Game : AtlasPacker
+// Desc:  packs rectangles onto atlas pages
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#include "AtlasPacker.h"
+
+namespace Game
+{
+	//-----------------------------------------------------------
+	// Name: AtlasPacker
+	// Desc:  constructor
+	//-----------------------------------------------------------
+	AtlasPacker::AtlasPacker( uint32_t width, uint32_t height, uint32_t padding ) :  mWidth(width)
+																				  , mHeight(height)
+																				  , mPadding(padding)
+	{
+		Reset();
+	}
+
+	//-----------------------------------------------------------
+	// Name: Reset
+	// Desc:  empties the page
+	//-----------------------------------------------------------
+	void AtlasPacker::Reset()
+	{
+		Segment floor;
+		floor.mX	 = 0;
+		floor.mY	 = 0;
+		floor.mWidth = mWidth;
+
+		mSkyline.clear();
+		mSkyline.push_back( floor );
+		mUsedArea = 0;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Insert
+	// Desc:  bottom-left placement: the lowest resting spot,
+	//		  leftmost on ties
+	//-----------------------------------------------------------
+	bool AtlasPacker::Insert( uint32_t width, uint32_t height, uint32_t& x, uint32_t& y )
+	{
+		if( width == 0 || height == 0 )
+			return false;
+
+		uint32_t paddedWidth  = width + mPadding;
+		uint32_t paddedHeight = height + mPadding;
+
+		uint32_t best	   = (uint32_t)-1;
+		uint32_t bestTop   = (uint32_t)-1;
+		uint32_t bestY	   = 0;
+
+		for( uint32_t i = 0; i < mSkyline.size(); ++i )
+		{
+			uint32_t fitY;
+			if( !Fit( i, paddedWidth, paddedHeight, fitY ) )
+				continue;
+
+			uint32_t top = fitY + paddedHeight;
+			if( top < bestTop )
+			{
+				best	= i;
+				bestTop = top;
+				bestY	= fitY;
+			}
+		}
+
+		if( best == (uint32_t)-1 )
+			return false;
+
+		x = mSkyline[best].mX;
+		y = bestY;
+
+		Place( best, x, y, paddedWidth, paddedHeight );
+		mUsedArea += width * height;
+		return true;
+	}
+
+	uint32_t AtlasPacker::GetWidth() const
+	{
+		return mWidth;
+	}
+
+	uint32_t AtlasPacker::GetHeight() const
+	{
+		return mHeight;
+	}
+
+	F32 AtlasPacker::GetOccupancy() const
+	{
+		return (F32)mUsedArea / (F32)( mWidth * mHeight );
+	}
+
+	//-----------------------------------------------------------
+	// Name: Fit
+	// Desc:  a rect starting at segment i rests on the highest
+	//		  segment under it
+	//-----------------------------------------------------------
+	bool AtlasPacker::Fit( uint32_t i, uint32_t width, uint32_t height, uint32_t& y ) const
+	{
+		uint32_t x = mSkyline[i].mX;
+		if( x + width > mWidth )
+			return false;
+
+		y = 0;
+		uint32_t covered = 0;
+		for( ; i < mSkyline.size() && covered < width; ++i )
+		{
+			if( mSkyline[i].mY > y )
+				y = mSkyline[i].mY;
+
+			covered += mSkyline[i].mWidth;
+		}
+
+		return y + height <= mHeight;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Place
+	// Desc:  raises the skyline over the new rect
+	//-----------------------------------------------------------
+	void AtlasPacker::Place( uint32_t i, uint32_t x, uint32_t y, uint32_t width, uint32_t height )
+	{
+		Segment top;
+		top.mX	   = x;
+		top.mY	   = y + height;
+		top.mWidth = width;
+
+		mSkyline.insert( mSkyline.begin() + i, top );
+
+		// trim or drop the segments now under the new one
+		uint32_t right = x + width;
+		uint32_t j = i + 1;
+		while( j < mSkyline.size() && mSkyline[j].mX < right )
+		{
+			uint32_t segRight = mSkyline[j].mX + mSkyline[j].mWidth;
+			if( segRight <= right )
+			{
+				mSkyline.erase( mSkyline.begin() + j );
+			}
+			else
+			{
+				mSkyline[j].mWidth = segRight - right;
+				mSkyline[j].mX	   = right;
+				break;
+			}
+		}
+
+		// merge runs at the same height
+		for( j = 1; j < mSkyline.size(); )
+		{
+			if( mSkyline[j-1].mY == mSkyline[j].mY )
+			{
+				mSkyline[j-1].mWidth += mSkyline[j].mWidth;
+				mSkyline.erase( mSkyline.begin() + j );
+			}
+			else
+			{
+				++j;
+			}
+		}
+	}
+
+}; //end Game
@@ -0,0 +1,64 @@
+//---------------------------------------------------
+// Name: Game : AtlasPacker
+// Desc:  packs rectangles onto atlas pages
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#ifndef _GAME_ATLAS_PACKER_H_
+#define _GAME_ATLAS_PACKER_H_
+
+#include "Types.h"
+
+#include <vector>
+
+namespace Game
+{
+	//-----------------------------------------------------------
+	// Name: AtlasPacker
+	// Desc:  skyline bin packer for one page. the skyline is the
+	//		  top edge of everything placed so far; a rect goes at
+	//		  the lowest spot it fits, leftmost on ties, and the
+	//		  space under it is given up. rects are padded on the
+	//		  right and bottom so filtering doesn't pick up their
+	//		  neighbours. insert tall rects first for tight pages
+	//-----------------------------------------------------------
+	class AtlasPacker
+	{
+	public:
+
+		AtlasPacker( uint32_t width, uint32_t height, uint32_t padding = 0 );
+
+		// finds a place for a width x height rect, false if full
+		bool		Insert( uint32_t width, uint32_t height, uint32_t& x, uint32_t& y );
+
+		void		Reset();
+
+		uint32_t	GetWidth() const;
+		uint32_t	GetHeight() const;
+		F32			GetOccupancy() const;		// fraction of the page used
+
+	private:
+
+		// a run of the skyline at height y
+		struct Segment
+		{
+			uint32_t	mX, mY, mWidth;
+		};
+
+		// where a rect starting at segment i would sit, false if it won't fit
+		bool		Fit( uint32_t i, uint32_t width, uint32_t height, uint32_t& y ) const;
+		void		Place( uint32_t i, uint32_t x, uint32_t y, uint32_t width, uint32_t height );
+
+	private:
+
+		std::vector<Segment>	mSkyline;
+		uint32_t				mWidth;
+		uint32_t				mHeight;
+		uint32_t				mPadding;
+		uint32_t				mUsedArea;
+	};
+
+}; //end Game
+
+#endif // end _GAME_ATLAS_PACKER_H_
@@ -7,14 +7,14 @@
 
 #include "Ball.h"
 #include "GameConstants.h"
+#include "SpriteBatch.h"
 #include <assert.h>
 
 namespace Game
 {	
 	Ball::Ball( EntityDesc* desc ) : Entity(desc)
 	{
-		srand( (uint32_t)time(NULL) );
-
+		// rand() is seeded once per level by State_Game so replays match
 		int32_t randNum = rand();
 
 		mStartRotation = 0.0f;
@@ -68,7 +68,7 @@ namespace Game
 	{
 		if( mBaseImage )
 		{
-			GameX.DrawImage( mBaseImage, mPos[0], mPos[1], mRotation, 1.0f );
+			SSpriteBatch.Draw( mBaseImage, mPos[0], mPos[1], mRotation, 1.0f );
 		}
 	}
 
@@ -7,6 +7,7 @@
 
 #include "Beam.h"
 #include "GameConstants.h"
+#include "SpriteBatch.h"
 #include <assert.h>
 
 namespace Game
@@ -63,10 +64,10 @@ namespace Game
 		if( mBaseImage && mFiring )
 		{
 			uint32_t width = mBaseImage->GetWidth();
-			uint32_t drawCount = kWindowWidth / width;
 
+			// the tiles all share an image, so they batch into one draw
 			for( uint32_t x = 0; x < kWindowWidth; x += width )
-				GameX.DrawImage( mBaseImage, x, mStartPos[1] );
+				SSpriteBatch.Draw( mBaseImage, x, mStartPos[1] );
 		}		
 	}
 
@@ -107,6 +107,11 @@ namespace Game
 			if( !dy ) dy += 2;
 			MoveByDelta( 0, dy );
 		}
+		else if( mState == kState_Popped && mDieFadeAlpha <= 0 )
+		{
+			// done in update so headless replays reach the same state
+			mState = kState_Dead;
+		}
 	}
 	
 	void Character::Draw()
@@ -123,11 +128,7 @@ namespace Game
 
 		if( mState == kState_Popped )
 		{
-			if( mDieFadeAlpha <= 0 )
-			{
-				mState = kState_Dead;			
-			}
-			else if( mDieFadeImg )
+			if( mDieFadeAlpha > 0 && mDieFadeImg )
 			{	
 				GameX.DrawImage( mDieFadeImg, mPos[0] - mDieFadeImg->GetWidth()/2,
 											  mPos[1] - mDieFadeImg->GetHeight()/2 );				
@@ -14,6 +14,7 @@
 #include "ResourceCache.h"
 #include "Ball.h"
 #include "Beam.h"
+#include "Util/Tokenizer.h"
 
 namespace Game
 {	
@@ -57,13 +58,15 @@ namespace Game
 			return val;
 		}
 
+		// a string too long for the buffer is cut short, but the
+		// stream still moves past all of it
 		void ReadString( char* buffer, uint32_t bufferSize, uint8_t*& stream )
 		{
 			uint32_t size = Read<uint32_t>( stream );
-			uint32_t read_size = bufferSize < size ? bufferSize : size;
+			uint32_t read_size = bufferSize - 1 < size ? bufferSize - 1 : size;
 			memcpy( buffer, stream, read_size );
 			buffer[read_size] = '\0';
-			stream += read_size;			
+			stream += size;			
 		}
 
 		void ReadString( std::string& str, uint8_t*& stream )
@@ -73,6 +76,35 @@ namespace Game
 			str = std::string(buffer);			
 		}
 
+		// reads for untrusted files. they fail instead of passing end,
+		// and leave the stream where it was when they do
+		template <typename T>
+		bool Read( T& val, uint8_t*& stream, const uint8_t* end )
+		{
+			if( (uint32_t)( end - stream ) < sizeof(T) )
+				return false;
+
+			memcpy( &val, stream, sizeof(T) );
+			stream += sizeof(T);
+			return true;
+		}
+
+		bool ReadString( std::string& str, uint8_t*& stream, const uint8_t* end )
+		{
+			uint8_t* start = stream;
+
+			uint32_t size;
+			if( !Read( size, stream, end ) || (uint32_t)( end - stream ) < size )
+			{
+				stream = start;
+				return false;
+			}
+
+			str.assign( (const char*)stream, size );
+			stream += size;
+			return true;
+		}
+
 		bool GetNextLine( std::string& line, FILE*& file )
 		{
 			if( !file || feof(file) )
@@ -88,36 +120,6 @@ namespace Game
 			return true;
 		}
 
-		std::string GetWordFromString( uint32_t wordNum, char* str, char delim )
-		{
-			U32 idx = 0;
-			U32 k   = 0;
-			char res[256];
-			strcpy( res, "" );
-
-			while( idx < wordNum )
-			{
-				while( k < strlen(str) && str[k] != delim)	++k;
-				if( k == strlen(str)) break;
-				++idx;
-				++k;
-			}
-
-			idx = 0;
-			while( k < strlen(str) && str[k] != delim )
-			{
-				res[idx] = str[k];
-				++idx;
-				++k;
-			}
-
-			//cut off the crap
-			if( res[idx-1] == 10 )	res[idx-1] = '\0';
-			else					res[idx] = '\0';
-			
-			return std::string(res);
-		}
-
 
 	}; // end FileUtils
 
@@ -142,30 +144,31 @@ namespace Game
 			uint32_t		mAssocFlag;		// flag associated with this parse
 		};
 
-		bool Parse( ParsePacket* pp, uint32_t packetCount, std::string parseStr, EntityProperty& prop )
+		// tokens are expected as: Name = value0 value1 ...
+		bool Parse( ParsePacket* pp, uint32_t packetCount, const Tokenizer& tokens, EntityProperty& prop )
 		{
 			uint8_t buffer[1024];
 
-			std::string propType = FileUtils::GetWordFromString( 0, (char*)parseStr.c_str(), ' ' );
+			const StringRef& propType = tokens.GetToken(0);
 
 			// look through all of our parse packets for the token
 			for( uint32_t i = 0; i < packetCount; ++i )
 			{
-				if( propType == pp[i].mParseToken )
+				if( propType.Equals( pp[i].mParseToken.c_str() ) )
 				{
 					uint32_t dataSize = 0;				
 					uint8_t* dataStream = (uint8_t*)buffer;
 
 					for( uint32_t j = 0; j < pp[i].mDataAmt; ++j )
 					{
-						std::string data = FileUtils::GetWordFromString( j+2, (char*)parseStr.c_str(), ' ' );
+						const StringRef& data = tokens.GetToken( j+2 );
 
 						switch( pp[i].mDataTypeFlag )
 						{
 
 						case kDT_int32:
 							{
-								int32_t val = (int32_t)atoi( data.c_str() );
+								int32_t val = data.ToInt();
 								memcpy( dataStream, &val, sizeof(int32_t) );
 								dataStream += sizeof(int32_t);
 								dataSize += sizeof(int32_t);
@@ -174,7 +177,7 @@ namespace Game
 
 						case kDT_float:
 							{
-								F32 val = (F32)atof( data.c_str() );
+								F32 val = data.ToFloat();
 								memcpy( dataStream, &val, sizeof(F32) );
 								dataStream += sizeof(F32);
 								dataSize += sizeof(F32);
@@ -183,8 +186,8 @@ namespace Game
 
 						case kDT_string:
 							{
-								uint32_t len = (uint32_t)data.size();
-								memcpy( dataStream, data.c_str(), len );
+								uint32_t len = data.mLength;
+								memcpy( dataStream, data.mStr, len );
 								dataStream[len] = '\0';
 								dataStream += len+1;
 								dataSize += len+1;
@@ -476,7 +479,7 @@ namespace Game
 			return true;
 		}
 
-		bool ParseProperty( EntityProperty& prop, std::string propString )
+		bool ParseProperty( EntityProperty& prop, const Tokenizer& tokens )
 		{
 			//parsing setup
 			static ParseUtils::ParsePacket parsePackets [] = 
@@ -494,13 +497,14 @@ namespace Game
 
 			static uint32_t parsePacketCount = sizeof(parsePackets) / sizeof(ParseUtils::ParsePacket);
 
-			return ParseUtils::Parse( parsePackets, parsePacketCount, propString, prop );
+			return ParseUtils::Parse( parsePackets, parsePacketCount, tokens, prop );
 		}
 
 		bool Parse( const char* szFile, EntityDescMap* descMap )
 		{
-			FILE* file = fopen( szFile, "r+t" );
-			if( !file )
+			uint8_t* buffer = NULL;
+			uint32_t size = jbsCommon::Algorithm::ReadFileIntoBuffer( szFile, buffer );
+			if( !buffer )
 				return false;
 
 			std::string arrowName;
@@ -509,33 +513,39 @@ namespace Game
 			EntityDesc      arrowDesc;
 			EntityProperty  arrowProp;
 
-			while( true  )
+			LineReader reader( (const char*)buffer, size );
+			Tokenizer  tokens;
+			StringRef  line;
+
+			while( reader.NextLine( line ) )
 			{
-				std::string line;
-				if( !FileUtils::GetNextLine(line, file) )
-					break;
+				if( !tokens.Tokenize( line ) )
+					continue;
+
+				const StringRef& first = tokens.GetToken(0);
 				
-				if( line.find("#Begin") != std::string::npos )
+				if( first.StartsWith("#Begin") )
 				{
 					arrowDesc.clear();
 					parsingEntity = true;
-					arrowName = FileUtils::GetWordFromString( 1, (char*)line.c_str(), ' ' );
+					arrowName = tokens.GetToken(1).ToString();
 				}
 				else if( parsingEntity )
 				{
-					if( line.find("#End") != std::string::npos )
+					if( first.StartsWith("#End") )
 					{						
 						parsingEntity = false;
 						(*descMap)[arrowName] = arrowDesc;						
 					}
 					else
 					{
-						if( ParseProperty( arrowProp, line ) )
+						if( ParseProperty( arrowProp, tokens ) )
 							arrowDesc.push_back( arrowProp );
 					}
 				}
 			}
 
+			delete [] buffer;
 			return true;
 		}
 	};
@@ -615,58 +625,63 @@ namespace Game
 
 		bool Parse( const char* szFile, LevelEntry& entry )
 		{		
-			FILE* file = fopen( szFile, "r+t" );			
-			if( !file )
+			uint8_t* buffer = NULL;
+			uint32_t size = jbsCommon::Algorithm::ReadFileIntoBuffer( szFile, buffer );
+			if( !buffer )
 				return false;			
 
 			bool parsingLevel = false;
 
-			while( true  )
+			LineReader reader( (const char*)buffer, size );
+			Tokenizer  tokens;
+			StringRef  line;
+
+			while( reader.NextLine( line ) )
 			{
-				std::string line;
-				if( !FileUtils::GetNextLine(line, file) )
-					break;
+				if( !tokens.Tokenize( line ) )
+					continue;
+
+				const StringRef& propType = tokens.GetToken(0);
 				
-				if( line.find("#Begin") != std::string::npos )
+				if( propType.StartsWith("#Begin") )
 				{
-					entry.mName = FileUtils::GetWordFromString( 1, (char*)line.c_str(), ' ' );
+					entry.mName = tokens.GetToken(1).ToString();
 					parsingLevel = true;					
 				}
 				else if( parsingLevel )
 				{
-					if( line.find("#End") != std::string::npos )
+					if( propType.StartsWith("#End") )
 					{				
 						//Currently we only parse 1 level per file
 						parsingLevel = false;
-						return true;
+						break;
 					}
 					else
 					{
-						std::string propType = FileUtils::GetWordFromString( 0, (char*)line.c_str(), ' ' );						
-
-						if( !strcmp( propType.c_str(), "Background" ) )
+						if( propType.Equals( "Background" ) )
 						{
-							entry.mBackground = FileUtils::GetWordFromString( 2, (char*)line.c_str(), ' ' );							
+							entry.mBackground = tokens.GetToken(2).ToString();							
 						}						
 
-						else if( !strcmp( propType.c_str(), "Music" ) )
+						else if( propType.Equals( "Music" ) )
 						{
-							entry.mMusic = FileUtils::GetWordFromString( 2, (char*)line.c_str(), ' ' );
+							entry.mMusic = tokens.GetToken(2).ToString();
 						}
 
-						else if( !strcmp( propType.c_str(), "ArrowSet" ) )
+						else if( propType.Equals( "ArrowSet" ) )
 						{
-							entry.mEntitySet = FileUtils::GetWordFromString( 2, (char*)line.c_str(), ' ' );
+							entry.mEntitySet = tokens.GetToken(2).ToString();
 						}						
 
-						else if( !strcmp( propType.c_str(), "TimeLength" ) )
+						else if( propType.Equals( "TimeLength" ) )
 						{							
-							entry.mTimeLength = (F32)atof( FileUtils::GetWordFromString( 2, (char*)line.c_str(), ' ' ).c_str() ); 							
+							entry.mTimeLength = tokens.GetToken(2).ToFloat(); 							
 						}						
 					}
 				}
 			}
 
+			delete [] buffer;
 			return true;
 		}
 
@@ -695,15 +710,17 @@ namespace Game
 			uint32_t		   mFlags;			
 		};
 
-		// export information into a packed file
-		bool Export( const char* szFile, PackElementList& list )
+		// export information into a packed file. the source sizes
+		// give every offset up front, so the element headers go out
+		// first and the data is streamed in behind them
+		bool Export( const char* szFile, const PackSourceList& sources, PackWriter& writer )
 		{
 			FILE* file = fopen( szFile, "w+b" );
 			if( !file )
 				return false;
 
 			uint32_t version = 1;
-			uint32_t numElements = (uint32_t)list.size();
+			uint32_t numElements = (uint32_t)sources.size();
 			uint32_t flags = 0;
 
 			// write the pack header
@@ -714,27 +731,24 @@ namespace Game
 			uint32_t offset = sizeof(uint32_t)*3 + sizeof(PackElementHeader) * numElements;
 
 			// write the pack element headers
-			PackElementList::iterator itr;
-			for( itr = list.begin(); itr != list.end(); ++itr )
+			PackSourceList::const_iterator itr;
+			for( itr = sources.begin(); itr != sources.end(); ++itr )
 			{
 				PackElementHeader peh;
 				peh.mOffset			= offset;
 				peh.mSignature		= itr->mSignature;
 				peh.mSize			= itr->mSize;
-				peh.mVersion		= itr->mVersion;
+				peh.mVersion		= 1;
 				fwrite( &peh, sizeof(PackElementHeader), 1, file );
 
 				offset += itr->mSize;
 			}
 
 			//write the pack data
-			for( itr = list.begin(); itr != list.end(); ++itr )
-			{
-				fwrite( itr->mData, itr->mSize, 1, file );
-			}
+			bool written = writer.Write( file, sources );
 
 			fclose(file);
-			return true;
+			return written;
 		}
 
 		// Import packed information from a file
@@ -760,6 +774,36 @@ namespace Game
 			return import;
 		}
 
+		// Import the element table alone
+		bool ImportIndex( const char* szFile, PackSourceList& index )
+		{
+			if( !szFile )
+				return false;
+
+			FILE* file = fopen( szFile, "rb" );
+			if( !file )
+				return false;
+
+			PackHeader header;
+			if( fread( &header, sizeof(PackHeader), 1, file ) != 1 )
+			{
+				fclose( file );
+				return false;
+			}
+
+			PackElementHeader peh;
+			for( uint32_t i = 0; i < header.mNumElements; ++i )
+			{
+				if( fread( &peh, sizeof(PackElementHeader), 1, file ) != 1 )
+					break;
+
+				index.push_back( PackSource( peh.mSignature, szFile, peh.mSize, peh.mOffset ) );
+			}
+
+			fclose( file );
+			return index.size() == header.mNumElements;
+		}
+
 		// Import packed information from a memory stream
 		bool Import( uint8_t* stream, uint32_t streamSize, PackElementList& list )
 		{
@@ -789,9 +833,55 @@ namespace Game
 			return true;
 		}
 
+		// reads the elements one at a time rather than the whole file
+		// and then copies of it, skipping the streamed ones
 		bool PackFileManager::Import( const char* szFile )
 		{
-			return PackFile::Import( szFile, mPackList );
+			if( !szFile )
+				return false;
+
+			FILE* file = fopen( szFile, "rb" );
+			if( !file )
+				return false;
+
+			PackHeader header;
+			if( fread( &header, sizeof(PackHeader), 1, file ) != 1 )
+			{
+				fclose( file );
+				return false;
+			}
+
+			std::vector< PackElementHeader > elements( header.mNumElements );
+			bool ok = elements.empty() ||
+					  fread( &elements[0], sizeof(PackElementHeader), elements.size(), file ) == elements.size();
+
+			for( uint32_t i = 0; ok && i < elements.size(); ++i )
+			{
+				const PackElementHeader& peh = elements[i];
+
+				if( IsStreamed( peh.mSignature ) )
+				{
+					mStreamList.push_back( PackSource( peh.mSignature, szFile, peh.mSize, peh.mOffset ) );
+					continue;
+				}
+
+				PackElement packElem;
+				packElem.mSignature = peh.mSignature;
+				packElem.mVersion   = peh.mVersion;
+				packElem.mSize      = peh.mSize;
+				packElem.mData      = new uint8_t[ packElem.mSize ];
+
+				ok = fseek( file, peh.mOffset, SEEK_SET ) == 0 &&
+					 ( packElem.mSize == 0 || fread( packElem.mData, packElem.mSize, 1, file ) == 1 );
+
+				if( ok )
+					mPackList.push_back( packElem );
+				else
+					delete [] (uint8_t*)packElem.mData;
+			}
+
+			fclose( file );
+			return ok;
 		}
 
 		bool PackFileManager::GetPackElement( const char* signature, PackElement& elem )
@@ -813,6 +903,39 @@ namespace Game
 			return false;
 		}
 
+		void PackFileManager::SetStreamed( const char* signature )
+		{
+			uint32_t sigHash = ResourceCache::DJBHash( signature );
+			if( !IsStreamed( sigHash ) )
+				mStreamed.push_back( sigHash );
+		}
+
+		bool PackFileManager::IsStreamed( uint32_t sigHash )
+		{
+			for( uint32_t i = 0; i < mStreamed.size(); ++i )
+			{
+				if( mStreamed[i] == sigHash )
+					return true;
+			}
+
+			return false;
+		}
+
+		bool PackFileManager::GetPackSource( const char* signature, PackSource& src )
+		{
+			uint32_t sigHash = ResourceCache::DJBHash( signature );
+			for( uint32_t i = 0; i < mStreamList.size(); ++i )
+			{
+				if( mStreamList[i].mSignature == sigHash )
+				{
+					src = mStreamList[i];
+					return true;
+				}
+			}
+
+			return false;
+		}
+
 		void PackFileManager::HardClearData()
 		{
 			PackElementList::iterator itr;
@@ -825,6 +948,7 @@ namespace Game
 			}
 
 			mPackList.clear();
+			mStreamList.clear();
 		}
 
 		PackFileManager* PackFileManager::GetPFM()
@@ -851,9 +975,11 @@ namespace Game
 			uint32_t	mFlags;
 		};
 
-		bool Export( const char* szFile, ImageEntryList& list )
+		// an empty list still writes a header, so an empty directory
+		// packs as an empty index rather than a missing one
+		bool Export( const char* szFile, const PackSourceList& sources, PackWriter& writer )
 		{
-			if( !szFile || list.size() <= 0 ) 
+			if( !szFile ) 
 				return false;
 
 			FILE* file = fopen( szFile, "w+b" );
@@ -861,40 +987,65 @@ namespace Game
 				return false;
 
 			ImageFileHeader header;
-			header.mNumEntries = (uint32_t)list.size();
+			header.mNumEntries = (uint32_t)sources.size();
 			header.mFlags      = 0;
 
-			fwrite( &header, sizeof(ImageFileHeader), 1, file );
-
-			std::vector< ImageFileEntry > imageFileEntries;
+			bool written = fwrite( &header, sizeof(ImageFileHeader), 1, file ) == 1;
 
-			int32_t offset = (int32_t)(sizeof(ImageFileHeader) + sizeof(ImageFileEntry) * list.size());
+			int32_t offset = (int32_t)(sizeof(ImageFileHeader) + sizeof(ImageFileEntry) * sources.size());
 
 			// write ImageFileEntries
-			ImageEntryList::iterator entryItr;
-			for( entryItr = list.begin(); entryItr != list.end(); ++entryItr )
+			PackSourceList::const_iterator entryItr;
+			for( entryItr = sources.begin(); entryItr != sources.end(); ++entryItr )
 			{
 				ImageFileEntry e;
-				//e.mImageName = entryItr->mImageName;
-				e.mNameHash  = entryItr->mImgNameHash;
+				e.mNameHash  = entryItr->mSignature;
 				e.mSize      = entryItr->mSize;
 				e.mOffset    = offset;
 				
 				offset += entryItr->mSize;
 
-				fwrite( &e, sizeof(ImageFileEntry), 1, file );
+				written = fwrite( &e, sizeof(ImageFileEntry), 1, file ) == 1 && written;
 			}
 
 			// write ImageFile Data
-			for( entryItr = list.begin(); entryItr != list.end(); ++entryItr )
-			{
-				fwrite( entryItr->mpData, entryItr->mSize, 1, file );
-			}
+			written = writer.Write( file, sources ) && written;
 
 			fclose(file);
-			return true;
+			return written;
 		}	
 
+		bool ImportIndex( const char* szFile, uint32_t offset, PackSourceList& index )
+		{
+			if( !szFile )
+				return false;
+
+			FILE* file = fopen( szFile, "rb" );
+			if( !file )
+				return false;
+
+			ImageFileHeader header;
+			if( fseek( file, offset, SEEK_SET ) != 0 ||
+				fread( &header, sizeof(ImageFileHeader), 1, file ) != 1 )
+			{
+				fclose( file );
+				return false;
+			}
+
+			// entry offsets are from the start of the image file
+			ImageFileEntry e;
+			for( uint32_t i = 0; i < header.mNumEntries; ++i )
+			{
+				if( fread( &e, sizeof(ImageFileEntry), 1, file ) != 1 )
+					break;
+
+				index.push_back( PackSource( e.mNameHash, szFile, e.mSize, offset + e.mOffset ) );
+			}
+
+			fclose( file );
+			return index.size() == header.mNumEntries;
+		}
+
 		bool Import( uint8_t* stream, uint32_t streamSize, ImageEntryList& list )
 		{
 			if( !stream || !streamSize )
@@ -924,6 +1075,63 @@ namespace Game
 
 	}; // end ImageFile
 
+	namespace AtlasFile
+	{
+		struct AtlasFileHeader
+		{
+			uint32_t	mNumEntries;
+			uint32_t	mNumPages;
+			uint32_t	mPageWidth;
+			uint32_t	mPageHeight;
+		};
+
+		bool Export( const char* szFile, const AtlasLayout& layout )
+		{
+			if( !szFile )
+				return false;
+
+			FILE* file = fopen( szFile, "w+b" );
+			if( !file )
+				return false;
+
+			AtlasFileHeader header;
+			header.mNumEntries = (uint32_t)layout.mEntries.size();
+			header.mNumPages   = layout.mNumPages;
+			header.mPageWidth  = layout.mPageWidth;
+			header.mPageHeight = layout.mPageHeight;
+
+			bool written = fwrite( &header, sizeof(AtlasFileHeader), 1, file ) == 1;
+
+			if( !layout.mEntries.empty() )
+				written = fwrite( &layout.mEntries[0], sizeof(AtlasEntry), layout.mEntries.size(), file ) == layout.mEntries.size() && written;
+
+			fclose(file);
+			return written;
+		}
+
+		bool Import( uint8_t* stream, uint32_t streamSize, AtlasLayout& layout )
+		{
+			if( !stream || streamSize < sizeof(AtlasFileHeader) )
+				return false;
+
+			AtlasFileHeader* header = (AtlasFileHeader*)stream;
+			stream += sizeof(AtlasFileHeader);
+
+			if( streamSize < sizeof(AtlasFileHeader) + header->mNumEntries * sizeof(AtlasEntry) )
+				return false;
+
+			layout.mNumPages   = header->mNumPages;
+			layout.mPageWidth  = header->mPageWidth;
+			layout.mPageHeight = header->mPageHeight;
+
+			AtlasEntry* entries = (AtlasEntry*)stream;
+			layout.mEntries.assign( entries, entries + header->mNumEntries );
+
+			return true;
+		}
+
+	}; // end AtlasFile
+
 	namespace GameSaveFile
 	{
 		struct Header
@@ -979,5 +1187,216 @@ namespace Game
 		}
 
 	}; //end GameSaveFile
+
+//------------------------------------------------------------------------------
+// ManifestFile
+//------------------------------------------------------------------------------
+	namespace ManifestFile
+	{
+		struct Header
+		{
+			float		mVersion;
+			uint32_t	mFlags;
+			uint32_t	mReserved1;
+			uint32_t	mReserved2;
+		};
+
+		const float kManifestVersion = 1.0f;
+
+		bool Export( const char* szFile, const ManifestMap& manifest )
+		{
+			FILE* file = fopen(szFile, "w+b" );
+			if( !file )
+				return false;
+
+			Header h;
+			h.mVersion = kManifestVersion;
+			h.mFlags   = 0;
+			h.mReserved1 = 0;
+			h.mReserved2 = 0;
+
+			fwrite( &h, sizeof(Header), 1, file );
+
+			uint32_t numEntries = (uint32_t)manifest.size();
+			fwrite( &numEntries, sizeof(uint32_t), 1, file );
+
+			ManifestMap::const_iterator itr;
+			for( itr = manifest.begin(); itr != manifest.end(); ++itr )
+			{
+				FileUtils::WriteString( itr->first, file );
+				fwrite( &itr->second, sizeof(ManifestEntry), 1, file );
+			}
+
+			fclose(file);
+			return true;
+		}
+
+		bool Import( const char* szFile, ManifestMap& manifest )
+		{
+			uint32_t size;
+			uint8_t* buffer = NULL;
+			size = jbsCommon::Algorithm::ReadFileIntoBuffer( szFile, buffer );
+			if( !buffer )
+				return false;
+
+			bool import = Import( buffer, size, manifest );
+			delete [] buffer;
+			return import;
+		}
+
+		bool Import( uint8_t* stream, uint32_t streamSize, ManifestMap& manifest )
+		{
+			manifest.clear();
+
+			if( !stream )
+				return false;
+
+			// a manifest that can't be read whole is no manifest,
+			// and everything is rebuilt
+			const uint8_t* end = stream + streamSize;
+
+			Header header;
+			uint32_t numEntries;
+			if( !FileUtils::Read( header, stream, end ) || header.mVersion != kManifestVersion ||
+				!FileUtils::Read( numEntries, stream, end ) )
+				return false;
+
+			for( uint32_t i = 0; i < numEntries; ++i )
+			{
+				std::string name;
+				ManifestEntry entry;
+				if( !FileUtils::ReadString( name, stream, end ) ||
+					!FileUtils::Read( entry, stream, end ) )
+				{
+					manifest.clear();
+					return false;
+				}
+
+				manifest[name] = entry;
+			}
+
+			return true;
+		}
+
+	}; //end ManifestFile
+
+//------------------------------------------------------------------------------
+// ReplayFile
+//------------------------------------------------------------------------------
+	namespace ReplayFile
+	{
+		struct Header
+		{
+			float		mVersion;
+			uint32_t	mFlags;
+			uint32_t	mReserved1;
+			uint32_t	mReserved2;
+		};
+
+		const float kReplayVersion = 1.0f;
+
+		bool Export( const char* szFile, const ReplayLog& log )
+		{
+			FILE* file = fopen(szFile, "w+b" );
+			if( !file )
+				return false;
+
+			Header h;
+			h.mVersion = kReplayVersion;
+			h.mFlags   = 0;
+			h.mReserved1 = 0;
+			h.mReserved2 = 0;
+
+			fwrite( &h, sizeof(Header), 1, file );
+			fwrite( &log.mLevel, sizeof(uint32_t), 1, file );
+			fwrite( &log.mSeed, sizeof(uint32_t), 1, file );
+			fwrite( &log.mStartTime, sizeof(F32), 1, file );
+
+			uint32_t numTuners = (uint32_t)log.mTuners.size();
+			fwrite( &numTuners, sizeof(uint32_t), 1, file );
+
+			Tuner::VariableMap::const_iterator itr;
+			for( itr = log.mTuners.begin(); itr != log.mTuners.end(); ++itr )
+			{
+				FileUtils::WriteString( itr->first, file );
+				FileUtils::WriteString( itr->second, file );
+			}
+
+			uint32_t numTicks = (uint32_t)log.mTicks.size();
+			fwrite( &numTicks, sizeof(uint32_t), 1, file );
+
+			for( uint32_t i = 0; i < numTicks; ++i )
+			{
+				fwrite( &log.mTicks[i].mInput, sizeof(uint8_t), 1, file );
+				fwrite( &log.mTicks[i].mTime, sizeof(F32), 1, file );
+			}
+
+			fclose(file);
+			return true;
+		}
+
+		bool Import( const char* szFile, ReplayLog& log )
+		{
+			uint32_t size;
+			uint8_t* buffer = NULL;
+			size = jbsCommon::Algorithm::ReadFileIntoBuffer( szFile, buffer );
+			if( !buffer )
+				return false;
+
+			bool import = Import( buffer, size, log );
+			delete [] buffer;
+			return import;
+		}
+
+		bool Import( uint8_t* stream, uint32_t streamSize, ReplayLog& log )
+		{
+			if( !stream || streamSize < sizeof(Header) )
+				return false;
+
+			// replays come off disk, so every read is checked
+			// against the end of the file
+			const uint8_t* end = stream + streamSize;
+
+			Header header;
+			if( !FileUtils::Read( header, stream, end ) || header.mVersion != kReplayVersion )
+				return false;
+
+			uint32_t numTuners;
+			if( !FileUtils::Read( log.mLevel, stream, end ) ||
+				!FileUtils::Read( log.mSeed, stream, end ) ||
+				!FileUtils::Read( log.mStartTime, stream, end ) ||
+				!FileUtils::Read( numTuners, stream, end ) )
+				return false;
+
+			log.mTuners.clear();
+			for( uint32_t i = 0; i < numTuners; ++i )
+			{
+				std::string name, value;
+				if( !FileUtils::ReadString( name, stream, end ) ||
+					!FileUtils::ReadString( value, stream, end ) )
+					return false;
+
+				log.mTuners[name] = value;
+			}
+
+			// each tick is its input byte then its time
+			const uint32_t kTickSize = sizeof(uint8_t) + sizeof(F32);
+
+			uint32_t numTicks;
+			if( !FileUtils::Read( numTicks, stream, end ) ||
+				numTicks > (uint32_t)( end - stream ) / kTickSize )
+				return false;
+
+			log.mTicks.resize( numTicks );
+			for( uint32_t i = 0; i < numTicks; ++i )
+			{
+				FileUtils::Read( log.mTicks[i].mInput, stream, end );
+				FileUtils::Read( log.mTicks[i].mTime, stream, end );
+			}
+
+			return true;
+		}
+
+	}; //end ReplayFile
 	
 }; //end Game
@@ -15,6 +15,8 @@
 #include <map>
 
 #include "Arrow.h"
+#include "PackWriter.h"
+#include "Util/Tuner.h"
 
 namespace Game
 {	
@@ -91,10 +93,14 @@ namespace Game
 
 		typedef std::vector<PackElement> PackElementList;
 
-		bool Export( const char* szFile, PackElementList& list );
+		// streams the sources into a pack, one element each
+		bool Export( const char* szFile, const PackSourceList& sources, PackWriter& writer );
 		bool Import( const char* szFile, PackElementList& list );
 		bool Import( uint8_t* stream, uint32_t streamSize, PackElementList& list );
 
+		// reads only the element table, as sources pointing into the file
+		bool ImportIndex( const char* szFile, PackSourceList& index );
+
 		class PackFileManager
 		{
 		public:
@@ -104,13 +110,22 @@ namespace Game
 			bool GetPackElement( const char* signature, PackElement& elem );
 			bool GetPackElement( uint32_t sigHash, PackElement& elem );
 
+			// streamed elements are left on disk by Import, only where
+			// they lie is kept so they can be read a piece at a time
+			void SetStreamed( const char* signature );
+			bool GetPackSource( const char* signature, PackSource& src );
+
 			void HardClearData();
 
 			static PackFileManager* GetPFM();
 
 		private:
 
+			bool IsStreamed( uint32_t sigHash );
+
 			PackElementList			mPackList;
+			PackSourceList			mStreamList;	// streamed elements, still in the file
+			std::vector< uint32_t >	mStreamed;		// signatures to leave on disk
 		};
 	};	
 
@@ -129,8 +144,37 @@ namespace Game
 
 		typedef std::vector< ImageEntry > ImageEntryList;
 
-		bool Export( const char* szFile, ImageEntryList& list );
+		bool Export( const char* szFile, const PackSourceList& sources, PackWriter& writer );
 		bool Import( uint8_t* stream, uint32_t streamSize, ImageEntryList& list );
+
+		// reads the entry table of an image file stored at offset
+		// in szFile, as sources pointing into szFile
+		bool ImportIndex( const char* szFile, uint32_t offset, PackSourceList& index );
+	};
+
+	// where the images of the image pack sit on shared atlas pages
+	namespace AtlasFile
+	{
+		struct AtlasEntry
+		{
+			uint32_t	mImgNameHash;
+			uint32_t	mPage;
+			uint32_t	mX, mY;			// top-left on the page
+			uint32_t	mWidth, mHeight;
+		};
+
+		typedef std::vector< AtlasEntry > AtlasEntryList;
+
+		struct AtlasLayout
+		{
+			uint32_t		mPageWidth;
+			uint32_t		mPageHeight;
+			uint32_t		mNumPages;
+			AtlasEntryList	mEntries;
+		};
+
+		bool Export( const char* szFile, const AtlasLayout& layout );
+		bool Import( uint8_t* stream, uint32_t streamSize, AtlasLayout& layout );
 	};
 
 	namespace GameSaveFile
@@ -145,6 +189,50 @@ namespace Game
 		bool Import( const char* szFile, SaveFile& saveFile );
 		bool Import( uint8_t* stream, uint32_t streamSize, SaveFile& saveFile );
 	};
+
+	// the state of every build input when the pack was last built
+	namespace ManifestFile
+	{
+		struct ManifestEntry
+		{
+			uint32_t	mSize;
+			uint32_t	mTimeLow;	// last write time
+			uint32_t	mTimeHigh;
+			uint32_t	mHash;		// content hash
+		};
+
+		typedef std::map< std::string, ManifestEntry > ManifestMap;
+
+		bool Export( const char* szFile, const ManifestMap& manifest );
+		bool Import( const char* szFile, ManifestMap& manifest );
+		bool Import( uint8_t* stream, uint32_t streamSize, ManifestMap& manifest );
+	};
+
+	// a recorded play session: the seed, tuners and per-tick input needed to
+	// reproduce a run of State_Game exactly
+	namespace ReplayFile
+	{
+		struct ReplayTick
+		{
+			uint8_t		mInput;		// kInput_* bits held this tick
+			F32			mTime;		// latched clock for the tick
+		};
+
+		typedef std::vector< ReplayTick > ReplayTickList;
+
+		struct ReplayLog
+		{
+			uint32_t			mLevel;		// level index the run started on
+			uint32_t			mSeed;		// rand() seed
+			F32					mStartTime;	// clock when the level began
+			Tuner::VariableMap	mTuners;	// tuner snapshot at record time
+			ReplayTickList		mTicks;
+		};
+
+		bool Export( const char* szFile, const ReplayLog& log );
+		bool Import( const char* szFile, ReplayLog& log );
+		bool Import( uint8_t* stream, uint32_t streamSize, ReplayLog& log );
+	};
 	
 }; //end Game
 
@@ -14,6 +14,10 @@ namespace Game
 	const char*				kWindowName    = "Balloon Game";
 	const char*		        kGamePackFile  = "gameData.pack";
 	const char*             kSaveFile      = "playerSave.sav";
+	const char*				kManifestFile  = "gameData.manifest";
+	const uint32_t			kAtlasPageSize = 512;		// square atlas pages
+	const uint32_t			kAtlasMaxImageSize = 256;	// bigger textures get their own
+	const uint32_t			kAtlasPadding  = 2;			// blank pixels right and below each
 	const bool				kFullscreen    = false;
 	const bool				kUseVSync	   = true;
 	const bool				kResizeable	   = true;
@@ -17,6 +17,10 @@ namespace Game
 	extern const char*				kWindowName  ;
 	extern const char*				kGamePackFile;
 	extern const char*              kSaveFile;
+	extern const char*				kManifestFile;
+	extern const uint32_t			kAtlasPageSize;
+	extern const uint32_t			kAtlasMaxImageSize;
+	extern const uint32_t			kAtlasPadding;
 	extern const bool				kFullscreen  ;
 	extern const bool				kUseVSync	 ;
 	extern const bool				kResizeable  ;
@@ -9,85 +9,44 @@
 #include "Algorithms.h"
 #include "ResourceCache.h"
 #include "FileIO.h"
+#include "Util/Profiler.h"
+#include "Util/Tuner.h"
 
 #include "GameXExt.h"
+#include "gamex-tga.hpp"
+
+#include <map>
 
 namespace Game
 {
 	//----------------------------------------------------
-	// Name: LoadTGAData
-	// Desc:  loads image data from a targa file
+	// Name: DecodeTGA
+	// Desc:  decodes a targa straight into the part of an
+	//		  ImageX at x,y. no copy in between when the image
+	//		  has a 32-bit surface
 	//----------------------------------------------------
-	bool LoadTGAData( uint8_t* inStream, uint32_t inStreamSize, uint8_t*& outStream, uint32_t& width, uint32_t& height, uint32_t& channels )
+	static bool DecodeTGA( ImageX* image, uint32_t x, uint32_t y, const TGAInfo& info, 
+						   uint8_t* stream, uint32_t streamSize )
 	{
-		//code adapted from http://nehe.gamedev.net/data/lessons/lesson.asp?lesson=24
-		uint8_t TGAheader[12]={0,0,2,0,0,0,0,0,0,0,0,0};	// Uncompressed TGA Header
-		uint8_t TGAcompare[12];							// Used To Compare TGA Header
-		uint8_t header[6];									// First 6 Useful Bytes From The Header
-		uint8_t temp;										// Temporary byte variable
-		U32 bytesPerPixel;								// Holds Number Of Bytes Per Pixel Used In The TGA File
-		U32 imageSize;									// Used To Store The Image Size When Setting Aside Ram	
-		U32 bpp;
-		uint8_t *imageData = NULL;
-
-		if( !inStream || !inStreamSize )
-			return false;
+		PROFILE_ZONE( "DecodeTGA" );
 
-		memcpy( TGAcompare, inStream, sizeof(TGAcompare) ); 		
-		inStream += sizeof(TGAcompare);		
+		image->SetFilterRect( x, y, x + info.xres, y + info.yres );
 
-		memcpy( TGAheader, TGAcompare, sizeof(TGAheader) );
+		int pitch;
+		XBYTE4* copy;
+		XBYTE4* pixels = image->BeginPixels32( pitch, copy, false );
+		bool decoded = false;
 
-		memcpy( header, inStream, sizeof(header) );		
-		inStream += sizeof(header);		
-		
-		//determine width, height, and bpp
-		width  = header[1] * 256 + header[0];			
-		height = header[3] * 256 + header[2];			
-		bpp	= header[4];								
-
- 		if(	width <=0 || height	<=0	|| (bpp!=24 && bpp!=32))						
-		{				
-			return false;									
+		if( pixels )
+		{
+			decoded = TGADecode( info, stream, streamSize, pixels, pitch );
+			image->EndPixels32( copy );
 		}
 
-		bytesPerPixel	= bpp/8;							// Divide By 8 To Get The Bytes Per Pixel
-		imageSize		= width*height*bytesPerPixel;		// Calculate The Memory Required For The TGA Data
-		channels		= bytesPerPixel;
-
-		//setup stream
-		outStream = new uint8_t[imageSize];
-		if( !outStream )
-			return false;
-		
-		imageData = (uint8_t*)outStream;	
-
-		memcpy( imageData, inStream, imageSize );		
-
-		//swap the 'r' and 'b' values
-		for(U32 i=0; i<imageSize; i+=bytesPerPixel)			
-		{													
-			temp=imageData[i];								
-			imageData[i] = imageData[i + 2];				
-			imageData[i + 2] = temp;						
-		}		
-
-		return true;	
+		image->ResetFilterRect();
+		return decoded;
 	}
 
-	//----------------------------------------------------
-	// Name: LoadTGAData
-	// Desc:  loads image data from a targa file
-	//----------------------------------------------------
-	bool LoadTGAData( const char* szFile, uint8_t*& stream, uint32_t& width, uint32_t& height, uint32_t& channels )
-	{
-		uint8_t* buffer;
-		uint32_t bufferSize = jbsCommon::Algorithm::ReadFileIntoBuffer( szFile, buffer );
-		bool import = LoadTGAData( buffer, bufferSize, stream, width, height, channels );	
-		delete [] buffer;
-		return import;		
-	}	
-
 	//----------------------------------------------------
 	// Name: LoadTGA
 	// Desc:  loads TGA data into an ImageX from file
@@ -97,28 +56,11 @@ namespace Game
 		if( !image || !szFile )
 			return false;		
 
-		uint8_t* stream;
-		uint32_t width, height, channels;
-
-		if( LoadTGAData( szFile, stream, width, height, channels ) )
-		{
-			image->Create( width, height, channels > 3 );
-
-			uint8_t* pixel = stream;			
-			for( uint32_t i = 0; i < height; ++i )
-			{
-				for( uint32_t j = 0; j < width; ++j )
-				{
-					image->SetPixel( j, height-i, pixel[0], pixel[1], pixel[2], channels == 4 ? pixel[3] : 255 );
-					pixel += channels;
-				}
-			}
-
-			delete [] stream;
-			return true;
-		}
-
-		return false;
+		uint8_t* buffer;
+		uint32_t bufferSize = jbsCommon::Algorithm::ReadFileIntoBuffer( szFile, buffer );
+		bool import = LoadTGA( image, buffer, bufferSize );
+		delete [] buffer;
+		return import;
 	}
 
 	//----------------------------------------------------
@@ -127,31 +69,34 @@ namespace Game
 	//----------------------------------------------------
 	bool LoadTGA( ImageX* image, uint8_t* stream, uint32_t streamSize )
 	{
-		if( !image || !stream || !streamSize )		
+		TGAInfo info;
+		if( !image || !TGAReadHeader( info, stream, streamSize ) )		
 			return false;
 
-		uint8_t* dataStream;
-		uint32_t width, height, channels;
+		image->Create( info.xres, info.yres, info.bpp == 32 );
+		return DecodeTGA( image, 0, 0, info, stream, streamSize );
+	}
 
-		if( LoadTGAData( stream, streamSize, dataStream, width, height, channels ) )		
-		{
-			image->Create( width, height, channels > 3 );
+	//----------------------------------------------------
+	// Name: LoadTGA
+	// Desc:  loads TGA data from stream into the width x
+	//		  height part of an ImageX at x,y (an atlas page).
+	//		  fails if the targa isn't that size
+	//----------------------------------------------------
+	bool LoadTGA( ImageX* image, uint32_t x, uint32_t y, uint32_t width, uint32_t height, 
+				  uint8_t* stream, uint32_t streamSize )
+	{
+		TGAInfo info;
+		if( !image || !TGAReadHeader( info, stream, streamSize ) )		
+			return false;
 
-			uint8_t* pixel = dataStream;			
-			for( uint32_t i = 0; i < height; ++i )
-			{
-				for( uint32_t j = 0; j < width; ++j )
-				{
-					image->SetPixel( j, height-i, pixel[0], pixel[1], pixel[2], channels == 4 ? pixel[3] : 255 );
-					pixel += channels;
-				}
-			}
+		if( (uint32_t)info.xres != width || (uint32_t)info.yres != height )
+			return false;
 
-			delete [] dataStream;
-			return true;
-		}		
+		if( x + width > (uint32_t)image->GetWidth() || y + height > (uint32_t)image->GetHeight() )
+			return false;
 
-		return false;
+		return DecodeTGA( image, x, y, info, stream, streamSize );
 	}
 
 	//----------------------------------------------------
@@ -160,6 +105,8 @@ namespace Game
 	//----------------------------------------------------
 	bool Load_MP3( MusicX* music, uint8_t* stream, uint32_t streamSize )
 	{
+		PROFILE_ZONE( "DecodeMP3" );
+
 		// write data to file...
 		char filename[256];
 		//sprintf( filename, "t45063.mp3" );
@@ -189,27 +136,15 @@ namespace Game
 	//----------------------------------------------------
 	bool LoadWAV( SoundX* sound, uint8_t* stream, uint32_t streamSize )
 	{
-		// write data to file...
-		char filename[256];
-		sprintf( filename, "t45064.wav" );
+		PROFILE_ZONE( "DecodeWAV" );
 
-		FILE* file = fopen( filename, "w+b" );
-		if( !file )
-			return false;
-
-		fwrite( stream, streamSize, 1, file );
-		fclose(file);
-
-		//load from file
-		if( !sound->Load( filename ) )
+		// straight from the pack, no temp file
+		if( !sound->LoadWav( stream, streamSize, "packed sound" ) )
 			return false;
 
 		// for some reason the arrow sound needs to play once
 		// or the data does not get initialized...							
 		GameX.PlaySound( sound, PLAY_REWIND, 0.0f, 0, 1.0f );
-
-		//delete file
-		DeleteFile( filename );
 		return true;
 	}
 	
@@ -267,45 +202,55 @@ namespace Game
 		return (MusicX*)GetResource( fileName, kResType_Music );
 	}
 
+	// where each streamed track lies in the pack
+	static PackSourceList sMusicIndex;
+
+	//----------------------------------------------------
+	// Name: OpenMusic
+	// Desc:  opens a track from the stream pack where it
+	//		  lies; it's read in pieces as it plays
+	//----------------------------------------------------
+	MusicStream* OpenMusic( const char* fileName )
+	{
+		char cleaned[512];
+		jbsCommon::Algorithm::CleanFilePath( cleaned, (char*)fileName );
+		uint32_t hash = ResCache.DJBHash( cleaned );
+
+		for( uint32_t i = 0; i < sMusicIndex.size(); ++i )
+		{
+			const PackSource& src = sMusicIndex[i];
+			if( src.mSignature != hash )
+				continue;
+
+			MusicStream* stream = new MusicStream();
+			if( stream->Open( src.mFile.c_str(), src.mOffset, src.mSize ) )
+				return stream;
+
+			delete stream;
+			break;
+		}
+
+		return NULL;
+	}
+
 	//----------------------------------------------------
 	// Name: AddAudioPackToCache
 	// Desc:  add all of our audio to the cache
 	//----------------------------------------------------
 	void AddAudioPackToCache()
 	{
+		PROFILE_ZONE( "AddAudioPackToCache" );
+
 		PackFile::PackElement packFile;
 
-		// import mp3s
-		if( SPackFile.GetPackElement( "MusicPackFile", packFile ) )
-		{
-			ImageFile::ImageEntryList list;
-			if( ImageFile::Import( (uint8_t*)packFile.mData, packFile.mSize, list ) )
-			{
-				// add each image to the cache
-				ImageFile::ImageEntryList::iterator itr;
-				for( itr = list.begin(); itr != list.end(); ++itr )
-				{		
-					/*
-					// generate our music structure	
-					MusicX music;
+		// index the music. tracks stay in the pack and only the
+		// level's is read, a piece at a time as it plays
+		sMusicIndex.clear();
 
-					// attempt to load the mp3 music file
-					if( Load_MP3( &music, (uint8_t*)itr->mpData, itr->mSize ) )
-					{
-						ResCache.AddRes( new TypedResource<MusicX>( kResType_Music,
-																	itr->mImgNameHash,
-																	&music ) );						
-					}
-					else
-					{
-						//delete music;
-					}						
-*/
-					// delete imported memory
-					if( itr->mpData )
-						delete [] itr->mpData;
-				}				
-			}
+		PackSource musicPack;
+		if( SPackFile.GetPackSource( "StreamPackFile", musicPack ) )
+		{
+			ImageFile::ImportIndex( musicPack.mFile.c_str(), musicPack.mOffset, sMusicIndex );
 		}
 
 		// import wavs
@@ -341,10 +286,45 @@ namespace Game
 
 	//-----------------------------------------------------------
 	// Name: AddPackedImagesToCache
-	// Desc:  add arrow images to cache based on arrow name
+	// Desc:  add arrow images to cache based on arrow name.
+	//		  images the atlas layout has a place for are decoded
+	//		  onto its pages and cached as views of them, so they
+	//		  all draw from a few textures
 	//-----------------------------------------------------------
 	void AddPackedImagesToCache()
 	{
+		PROFILE_ZONE( "AddPackedImagesToCache" );
+
+		AtlasFile::AtlasLayout layout;
+		std::vector< ImageX* > pages;
+		std::map< uint32_t, uint32_t > atlasIndex;		// image hash -> layout entry
+
+		PackFile::PackElement packAtlasFile;
+		if( gTuner.GetUint( "kTextureAtlas" ) &&
+			SPackFile.GetPackElement( "AtlasPackFile", packAtlasFile ) &&
+			AtlasFile::Import( (uint8_t*)packAtlasFile.mData, packAtlasFile.mSize, layout ) )
+		{
+			for( uint32_t i = 0; i < layout.mNumPages; ++i )
+			{
+				ImageX* page = new ImageX;
+				page->Create( layout.mPageWidth, layout.mPageHeight, true );
+				pages.push_back( page );
+
+				// the cache owns the pages like any other image
+				char pageName[64];
+				sprintf( pageName, "AtlasPage%u", i );
+				ResCache.AddRes( new TypedResource< ImageX >( kResType_Image,
+															  ResCache.MakeHandle( pageName ),
+															  page ) );
+			}
+
+			for( uint32_t i = 0; i < layout.mEntries.size(); ++i )
+			{
+				if( layout.mEntries[i].mPage < pages.size() )
+					atlasIndex[ layout.mEntries[i].mImgNameHash ] = i;
+			}
+		}
+
 		PackFile::PackElement packImageFile;
 		if( SPackFile.GetPackElement( "ImagePackFile", packImageFile ) )
 		{
@@ -356,8 +336,27 @@ namespace Game
 				for( itr = list.begin(); itr != list.end(); ++itr )
 				{
 					ImageX* image = new ImageX;					
+					bool loaded = false;
+
+					std::map< uint32_t, uint32_t >::iterator atlasItr = atlasIndex.find( itr->mImgNameHash );
+					if( atlasItr != atlasIndex.end() )
+					{
+						const AtlasFile::AtlasEntry& entry = layout.mEntries[ atlasItr->second ];
+						ImageX* page = pages[ entry.mPage ];
+
+						if( LoadTGA( page, entry.mX, entry.mY, entry.mWidth, entry.mHeight, 
+									 (uint8_t*)itr->mpData, itr->mSize ) )
+						{
+							image->CreateView( page, entry.mX, entry.mY, entry.mWidth, entry.mHeight );
+							loaded = true;
+						}
+					}
+
+					// not in the atlas, or the layout is out of date
+					if( !loaded )
+						loaded = LoadTGA( image, (uint8_t*)itr->mpData, itr->mSize );
 					
-					if( LoadTGA( image, (uint8_t*)itr->mpData, itr->mSize ) )
+					if( loaded )
 					{
 						ResCache.AddRes( new TypedResource< ImageX >( kResType_Image,
 																      itr->mImgNameHash,
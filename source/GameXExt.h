@@ -19,6 +19,8 @@ namespace Game
 	//-----------------------------------------------------------
 	bool LoadTGA( ImageX* image, char* szFile );
 	bool LoadTGA( ImageX* image, uint8_t* stream, uint32_t streamSize );
+	bool LoadTGA( ImageX* image, uint32_t x, uint32_t y, uint32_t width, uint32_t height, 
+				  uint8_t* stream, uint32_t streamSize );
 	bool Load_MP3( MusicX* music, uint8_t* stream, uint32_t streamSize );
 	bool LoadWAV( SoundX* sound, uint8_t* stream, uint32_t streamSize );
 
@@ -30,6 +32,9 @@ namespace Game
 	SoundX* GetSound( const char* fileName );
 	MusicX* GetMusic( const char* fileName );		
 
+	// opens a packed music track to stream, NULL if it isn't one
+	MusicStream* OpenMusic( const char* fileName );
+
 	//-----------------------------------------------------------
 	// Name: AddAudioPackToCache
 	// Desc:  adds all audio to cache
@@ -7,9 +7,11 @@
 
 #include "Gui.h"
 #include "gamex.hpp"
+#include "gamex-blend.hpp"
 #include "GameConstants.h"
 
 #include <assert.h>
+#include <algorithm>
 
 namespace Game
 {
@@ -18,34 +20,92 @@ namespace Game
 	GuiElement::GuiElement() : mpParent(NULL)						     
 							 , mVisible(false)
 							 , mState( kState_Normal )							 
+							 , mpLayer(NULL)
+							 , mDirty(false)
+							 , mIndexed(false)
+							 , mpLayerImage(NULL)
+							 , mOrder(0)
+							 , mStamp(0)
 	{
 		mAlign.x = kAlign_RelativeLeft;
 		mAlign.y = kAlign_RelativeTop;
 	}	
+
+	GuiElement::~GuiElement()
+	{
+		if( mpLayer )
+			mpLayer->Detach( this );
+	}
 	
 	void GuiElement::SetParent( GuiElement* elem )
 	{
 		mpParent = elem;
 	}
 
+	GuiElement* GuiElement::GetParent()
+	{
+		return mpParent;
+	}
+
 	void GuiElement::SetPosition( const jbsCommon::Vec2i& pos )
 	{
 		mPosition = pos;
+		MarkDirty();
 	}
 
 	void GuiElement::SetExtent( const jbsCommon::Vec2i& extent )
 	{
 		mExtent = extent;		
+		MarkDirty();
 	}
 
 	void GuiElement::SetAlignment( const jbsCommon::Vec2<Alignment>& align )
 	{
 		mAlign = align;		
+		MarkDirty();
 	}
 
 	void GuiElement::SetVisible( bool visible )
 	{
-		mVisible = visible;
+		if( mVisible != visible )
+		{
+			mVisible = visible;
+			MarkDirty();
+		}
+	}
+
+	// a state only changes how the element itself looks
+	void GuiElement::SetState( State state )
+	{
+		if( mState != state )
+		{
+			mState = state;
+			if( mpLayer )
+				mpLayer->Invalidate( this );
+		}
+	}
+
+	void GuiElement::MarkDirty()
+	{
+		if( !mpLayer )
+			return;
+
+		mpLayer->Invalidate( this );
+
+		// children are placed from their parent
+		GuiContainer* container = GetContainer();
+		for( uint32_t i = 0; container && i < container->GetNumChildren(); ++i )
+			container->GetChild(i)->MarkDirty();
+	}
+
+	GuiContainer* GuiElement::GetContainer()
+	{
+		return NULL;
+	}
+
+	GuiLayer* GuiElement::GetLayer()
+	{
+		return mpLayer;
 	}
 
 	bool GuiElement::Draw()
@@ -70,6 +130,11 @@ namespace Game
 		return true;
 	}
 
+	ImageX* GuiElement::GetDrawImage()
+	{
+		return NULL;
+	}
+
 	GuiElement::State GuiElement::GetState()
 	{
 		return mState;
@@ -143,9 +208,20 @@ namespace Game
 		return mVisible;
 	}
 
+	bool GuiElement::IsShown()
+	{
+		for( GuiElement* elem = this; elem; elem = elem->mpParent )
+		{
+			if( !elem->mVisible )
+				return false;
+		}
+
+		return true;
+	}
+
 	void GuiElement::OnMouseOver( const jbsCommon::Vec2i& pos )
 	{
-		mState = kState_MouseOver;
+		SetState( kState_MouseOver );
 	}
 /*
 	bool GuiElement::CheckMouse( int32_t x, int32_t y, bool lClick, bool rClick )
@@ -195,12 +271,12 @@ namespace Game
 
 	void GuiElement::OnMouseOut( const jbsCommon::Vec2i& pos )
 	{
-		mState = kState_Normal;
+		SetState( kState_Normal );
 	}
 
 	void GuiElement::OnClick( const jbsCommon::Vec2i& pos )
 	{
-		mState = kState_Depressed;
+		SetState( kState_Depressed );
 	}
 
 	void GuiElement::OnClickRelease( const jbsCommon::Vec2i& pos )
@@ -299,6 +375,9 @@ namespace Game
 		{
 			child->SetParent(this);
 			mChildren.push_back(child);
+
+			if( GetLayer() )
+				GetLayer()->Attach( child );
 		}
 	}
 
@@ -311,11 +390,35 @@ namespace Game
 			if( (*itr) == child )
 			{
 				mChildren.erase( itr );
+				ReleaseChild( child );
 				break;
 			}
 		}
 	}
 
+	void GuiContainer::ReleaseChild( GuiElement* child )
+	{
+		if( GetLayer() )
+			GetLayer()->Detach( child );
+
+		child->SetParent(NULL);
+	}
+
+	GuiContainer* GuiContainer::GetContainer()
+	{
+		return this;
+	}
+
+	uint32_t GuiContainer::GetNumChildren()
+	{
+		return (uint32_t)mChildren.size();
+	}
+
+	GuiElement* GuiContainer::GetChild( uint32_t i )
+	{
+		return mChildren[i];
+	}
+
 	void GuiContainer::OnMouseOver( const jbsCommon::Vec2i& pos )
 	{
 		GuiElement::OnMouseOver(pos);
@@ -431,6 +534,7 @@ namespace Game
 		if(found)
 		{
 			mChildren.erase(itrFound);
+			ReleaseChild(child);
 		}
 	}
     
@@ -451,14 +555,23 @@ namespace Game
 
 	bool GuiImageControl::Draw()
 	{
+		if( !IsVisible() || !mpImage )
+			return true;
+
 		jbsCommon::Vec2i pos = GetPosition();
 		GameX.DrawImage( mpImage, pos.x, pos.y );
 		return true;
 	}
 
+	ImageX* GuiImageControl::GetDrawImage()
+	{
+		return mpImage;
+	}
+
 	void GuiImageControl::SetImage( ImageX* img )
 	{
 		mpImage = img;
+		MarkDirty();
 	}
 
 	void GuiImageControl::SetExtentFromImages()
@@ -484,14 +597,10 @@ namespace Game
 
 	bool GuiButtonControl::Draw()
 	{
-		ImageX* curImage = NULL;
-		switch( GetState() )
-		{
-		case GuiElement::kState_Normal:    curImage = mpNormalImage; break;
-		case GuiElement::kState_Depressed: curImage = mpDepressedImage; break;
-		case GuiElement::kState_MouseOver: curImage = mpOverImage; break;
-		}
+		if( !IsVisible() )
+			return true;
 
+		ImageX* curImage = GetDrawImage();
 		if( curImage )
 		{
 			jbsCommon::Vec2i pos = GetPosition();
@@ -500,11 +609,24 @@ namespace Game
 		return true;
 	}
 
+	ImageX* GuiButtonControl::GetDrawImage()
+	{
+		switch( GetState() )
+		{
+		case GuiElement::kState_Normal:    return mpNormalImage;
+		case GuiElement::kState_Depressed: return mpDepressedImage;
+		case GuiElement::kState_MouseOver: return mpOverImage;
+		}
+
+		return NULL;
+	}
+
 	void GuiButtonControl::SetImages( ImageX* normal, ImageX* depressed, ImageX* mouseOver )
 	{
 		mpNormalImage = normal;
 		mpDepressedImage = depressed;
 		mpOverImage = mouseOver;
+		MarkDirty();
 	}
 
 	void GuiButtonControl::SetExtentFromImages()
@@ -516,4 +638,559 @@ namespace Game
 		}
 	}
 	
+///////////////////////////////////////////////////////////////////////////////
+
+	GuiLayer::GuiLayer() : mpRoot(NULL)
+						 , mpLayer(NULL)
+						 , mWidth( (int32_t)kWindowWidth )
+						 , mHeight( (int32_t)kWindowHeight )
+						 , mNumElements(0)
+						 , mStamp(0)
+						 , mDirtyPixels(0)
+						 , mRenumber(false)
+	{
+		mCellsX = ( mWidth  + kCellSize - 1 ) / kCellSize;
+		mCellsY = ( mHeight + kCellSize - 1 ) / kCellSize;
+		mCells.resize( mCellsX * mCellsY );
+	}
+
+	GuiLayer::~GuiLayer()
+	{
+		SetRoot( NULL );
+
+		if( mpLayer )
+			delete mpLayer;
+	}
+
+	void GuiLayer::SetRoot( GuiElement* root )
+	{
+		if( mpRoot )
+			Detach( mpRoot );
+
+		mHovered.clear();
+
+		if( root )
+		{
+			Attach( root );
+			mpRoot = root;
+		}
+
+		InvalidateAll();
+	}
+
+	GuiElement* GuiLayer::GetRoot()
+	{
+		return mpRoot;
+	}
+
+	void GuiLayer::InvalidateAll()
+	{
+		Rect all = { 0, 0, mWidth, mHeight };
+
+		mPixels.clear();
+		mDirtyRects.clear();
+		mDirtyRects.push_back( all );
+	}
+
+	//-----------------------------------------------------------
+	// Name: Draw
+	// Desc:  the dirty rects are cleared and everything that
+	//		  overlaps them drawn again in order, then the whole
+	//		  layer goes out in one draw. black is left out of
+	//		  both, as DrawImage leaves it out of each image
+	//-----------------------------------------------------------
+	void GuiLayer::Draw()
+	{
+		if( !mpRoot )
+			return;
+
+		if( !mpLayer )
+		{
+			mpLayer = new ImageX;
+			mpLayer->Create( mWidth, mHeight, false );
+			InvalidateAll();
+		}
+
+		Update();
+
+		mDirtyPixels = 0;
+		for( uint32_t i = 0; i < mDirtyRects.size(); ++i )
+		{
+			const Rect& rect = mDirtyRects[i];
+			mDirtyPixels += ( rect.x2 - rect.x1 ) * ( rect.y2 - rect.y1 );
+			Redraw( rect );
+		}
+		mDirtyRects.clear();
+
+		GameX.DrawImage( mpLayer, 0, 0 );
+	}
+
+	void GuiLayer::OnMouseMove( const jbsCommon::Vec2i& pos )
+	{
+		if( !mpRoot )
+			return;
+
+		Update();
+
+		ElementList over;
+		over.push_back( mpRoot );
+		FindHits( pos, over );
+
+		// out before over, so an element never has two at once
+		for( uint32_t i = 0; i < mHovered.size(); ++i )
+		{
+			if( std::find( over.begin(), over.end(), mHovered[i] ) == over.end() )
+				Send( mHovered[i], kEvent_MouseOut, pos );
+		}
+
+		for( uint32_t i = 0; i < over.size(); ++i )
+		{
+			if( std::find( mHovered.begin(), mHovered.end(), over[i] ) == mHovered.end() )
+				Send( over[i], kEvent_MouseOver, pos );
+		}
+
+		mHovered.swap( over );
+	}
+
+	void GuiLayer::OnClick( const jbsCommon::Vec2i& pos )
+	{
+		SendAll( kEvent_Click, pos );
+	}
+
+	void GuiLayer::OnClickRelease( const jbsCommon::Vec2i& pos )
+	{
+		SendAll( kEvent_ClickRelease, pos );
+	}
+
+	GuiElement* GuiLayer::HitTest( const jbsCommon::Vec2i& pos )
+	{
+		if( !mpRoot )
+			return NULL;
+
+		Update();
+
+		ElementList hits;
+		FindHits( pos, hits );
+
+		// the last drawn is on top
+		return hits.empty() ? NULL : hits.back();
+	}
+
+	uint32_t GuiLayer::GetNumElements()
+	{
+		return mNumElements;
+	}
+
+	uint32_t GuiLayer::GetDirtyPixels()
+	{
+		return mDirtyPixels;
+	}
+
+	void GuiLayer::Attach( GuiElement* elem )
+	{
+		elem->mpLayer		= this;
+		elem->mDirty		= false;
+		elem->mIndexed		= false;
+		elem->mpLayerImage	= NULL;
+		++mNumElements;
+		mRenumber = true;
+
+		Invalidate( elem );
+
+		GuiContainer* container = elem->GetContainer();
+		for( uint32_t i = 0; container && i < container->GetNumChildren(); ++i )
+			Attach( container->GetChild(i) );
+	}
+
+	// also called as elements are deleted, when they are no
+	// longer containers, so their children have gone already
+	void GuiLayer::Detach( GuiElement* elem )
+	{
+		GuiContainer* container = elem->GetContainer();
+		for( uint32_t i = 0; container && i < container->GetNumChildren(); ++i )
+			Detach( container->GetChild(i) );
+
+		if( elem->mpLayerImage )
+			AddDirty( elem->mLayerBounds );
+
+		if( elem->mIndexed )
+			Index( elem, false );
+
+		if( elem->mDirty )
+			mDirtyElems.erase( std::remove( mDirtyElems.begin(), mDirtyElems.end(), elem ), mDirtyElems.end() );
+
+		mHovered.erase( std::remove( mHovered.begin(), mHovered.end(), elem ), mHovered.end() );
+
+		elem->mpLayer		= NULL;
+		elem->mDirty		= false;
+		elem->mIndexed		= false;
+		elem->mpLayerImage	= NULL;
+		--mNumElements;
+		mRenumber = true;
+
+		if( elem == mpRoot )
+			mpRoot = NULL;
+	}
+
+	void GuiLayer::Invalidate( GuiElement* elem )
+	{
+		if( !elem->mDirty )
+		{
+			elem->mDirty = true;
+			mDirtyElems.push_back( elem );
+		}
+	}
+
+	//-----------------------------------------------------------
+	// Name: Update
+	// Desc:  catches the grid and dirty rects up with the
+	//		  elements that changed. an element only dirties the
+	//		  screen if it moved or its image changed
+	//-----------------------------------------------------------
+	void GuiLayer::Update()
+	{
+		if( mRenumber )
+		{
+			uint32_t order = 0;
+			if( mpRoot )
+				Number( mpRoot, order );
+
+			mRenumber = false;
+		}
+
+		for( uint32_t i = 0; i < mDirtyElems.size(); ++i )
+		{
+			GuiElement* elem = mDirtyElems[i];
+			elem->mDirty = false;
+
+			BoundingBoxi bounds = elem->GetBounds();
+			bool moved = !elem->mIndexed ||
+						 bounds.mX != elem->mLayerBounds.mX || bounds.mY != elem->mLayerBounds.mY ||
+						 bounds.mWidth != elem->mLayerBounds.mWidth || bounds.mHeight != elem->mLayerBounds.mHeight;
+
+			ImageX* img = elem->IsShown() ? elem->GetDrawImage() : NULL;
+			if( moved || img != elem->mpLayerImage )
+			{
+				if( elem->mpLayerImage )
+					AddDirty( elem->mLayerBounds );
+
+				if( img )
+					AddDirty( bounds );
+
+				elem->mpLayerImage = img;
+			}
+
+			if( moved )
+			{
+				if( elem->mIndexed )
+					Index( elem, false );
+
+				elem->mLayerBounds = bounds;
+				Index( elem, true );
+			}
+		}
+
+		mDirtyElems.clear();
+	}
+
+	void GuiLayer::Number( GuiElement* elem, uint32_t& order )
+	{
+		elem->mOrder = order++;
+
+		GuiContainer* container = elem->GetContainer();
+		for( uint32_t i = 0; container && i < container->GetNumChildren(); ++i )
+			Number( container->GetChild(i), order );
+	}
+
+	// Collide takes points on the right and bottom edges too
+	GuiLayer::Rect GuiLayer::ToRect( BoundingBoxi& bounds )
+	{
+		Rect rect = { bounds.mX, bounds.mY, bounds.mX + bounds.mWidth + 1, bounds.mY + bounds.mHeight + 1 };
+		return rect;
+	}
+
+	// the cells a rect covers, inclusive. false if it's off the layer
+	bool GuiLayer::ToCells( const Rect& rect, int32_t& cx1, int32_t& cy1, int32_t& cx2, int32_t& cy2 )
+	{
+		if( rect.x2 <= 0 || rect.y2 <= 0 || rect.x1 >= mWidth || rect.y1 >= mHeight ||
+			rect.x1 >= rect.x2 || rect.y1 >= rect.y2 )
+			return false;
+
+		cx1 = std::max( rect.x1, 0 ) / kCellSize;
+		cy1 = std::max( rect.y1, 0 ) / kCellSize;
+		cx2 = ( std::min( rect.x2, mWidth )  - 1 ) / kCellSize;
+		cy2 = ( std::min( rect.y2, mHeight ) - 1 ) / kCellSize;
+		return true;
+	}
+
+	void GuiLayer::Index( GuiElement* elem, bool add )
+	{
+		elem->mIndexed = add;
+
+		int32_t cx1, cy1, cx2, cy2;
+		if( !ToCells( ToRect( elem->mLayerBounds ), cx1, cy1, cx2, cy2 ) )
+			return;
+
+		for( int32_t cy = cy1; cy <= cy2; ++cy )
+		{
+			for( int32_t cx = cx1; cx <= cx2; ++cx )
+			{
+				ElementList& cell = mCells[ cy * mCellsX + cx ];
+				if( add )
+				{
+					cell.push_back( elem );
+				}
+				else
+				{
+					ElementList::iterator itr = std::find( cell.begin(), cell.end(), elem );
+					if( itr != cell.end() )
+					{
+						*itr = cell.back();
+						cell.pop_back();
+					}
+				}
+			}
+		}
+	}
+
+	// everything indexed in the cells under rect, in drawing order
+	void GuiLayer::Query( const Rect& rect, std::vector<GuiElement*>& found )
+	{
+		found.clear();
+
+		int32_t cx1, cy1, cx2, cy2;
+		if( !ToCells( rect, cx1, cy1, cx2, cy2 ) )
+			return;
+
+		++mStamp;
+		for( int32_t cy = cy1; cy <= cy2; ++cy )
+		{
+			for( int32_t cx = cx1; cx <= cx2; ++cx )
+			{
+				ElementList& cell = mCells[ cy * mCellsX + cx ];
+				for( uint32_t i = 0; i < cell.size(); ++i )
+				{
+					if( cell[i]->mStamp != mStamp )
+					{
+						cell[i]->mStamp = mStamp;
+						found.push_back( cell[i] );
+					}
+				}
+			}
+		}
+
+		std::sort( found.begin(), found.end(), OrderLess );
+	}
+
+	void GuiLayer::AddDirty( BoundingBoxi& bounds )
+	{
+		AddDirty( ToRect( bounds ) );
+	}
+
+	// overlapping rects are merged, so no pixel is drawn twice
+	void GuiLayer::AddDirty( Rect rect )
+	{
+		rect.x1 = std::max( rect.x1, 0 );
+		rect.y1 = std::max( rect.y1, 0 );
+		rect.x2 = std::min( rect.x2, mWidth );
+		rect.y2 = std::min( rect.y2, mHeight );
+		if( rect.x1 >= rect.x2 || rect.y1 >= rect.y2 )
+			return;
+
+		for( uint32_t i = 0; i < mDirtyRects.size(); )
+		{
+			const Rect& other = mDirtyRects[i];
+			if( rect.x1 <= other.x2 && other.x1 <= rect.x2 && rect.y1 <= other.y2 && other.y1 <= rect.y2 )
+			{
+				rect.x1 = std::min( rect.x1, other.x1 );
+				rect.y1 = std::min( rect.y1, other.y1 );
+				rect.x2 = std::max( rect.x2, other.x2 );
+				rect.y2 = std::max( rect.y2, other.y2 );
+
+				// the grown rect may reach ones already passed
+				mDirtyRects.erase( mDirtyRects.begin() + i );
+				i = 0;
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		mDirtyRects.push_back( rect );
+
+		if( mDirtyRects.size() > kMaxDirtyRects )
+		{
+			Rect all = mDirtyRects[0];
+			for( uint32_t i = 1; i < mDirtyRects.size(); ++i )
+			{
+				all.x1 = std::min( all.x1, mDirtyRects[i].x1 );
+				all.y1 = std::min( all.y1, mDirtyRects[i].y1 );
+				all.x2 = std::max( all.x2, mDirtyRects[i].x2 );
+				all.y2 = std::max( all.y2, mDirtyRects[i].y2 );
+			}
+
+			mDirtyRects.clear();
+			mDirtyRects.push_back( all );
+		}
+	}
+
+	void GuiLayer::Redraw( const Rect& rect )
+	{
+		Query( rect, mFound );
+
+		// images are read before the layer is opened, GameX only
+		// has one image's pixels open at a time
+		for( uint32_t i = 0; i < mFound.size(); ++i )
+		{
+			if( mFound[i]->mpLayerImage )
+				GetPixels( mFound[i]->mpLayerImage );
+		}
+
+		mpLayer->SetFilterRect( rect.x1, rect.y1, rect.x2, rect.y2 );
+
+		int pitch;
+		XBYTE4* copy;
+		XBYTE4* dst = mpLayer->BeginPixels32( pitch, copy, false );
+		if( dst )
+		{
+			const int32_t kWidth = rect.x2 - rect.x1;
+			for( int32_t y = rect.y1; y < rect.y2; ++y )
+				BlendFill32( dst + ( y - rect.y1 ) * pitch, 0, kWidth );
+
+			for( uint32_t i = 0; i < mFound.size(); ++i )
+			{
+				GuiElement* elem = mFound[i];
+				ImageX* img = elem->mpLayerImage;
+				XBYTE4* src = img ? GetPixels( img ) : NULL;
+				if( !src )
+					continue;
+
+				const BoundingBoxi& bounds = elem->mLayerBounds;
+				const int32_t kImgWidth = img->GetWidth();
+
+				int32_t x1 = std::max( rect.x1, bounds.mX );
+				int32_t y1 = std::max( rect.y1, bounds.mY );
+				int32_t x2 = std::min( rect.x2, bounds.mX + std::min( bounds.mWidth, kImgWidth ) );
+				int32_t y2 = std::min( rect.y2, bounds.mY + std::min( bounds.mHeight, (int32_t)img->GetHeight() ) );
+
+				for( int32_t y = y1; y < y2; ++y )
+				{
+					BlendMasked32( dst + ( y - rect.y1 ) * pitch + ( x1 - rect.x1 ),
+								   src + ( y - bounds.mY ) * kImgWidth + ( x1 - bounds.mX ), x2 - x1 );
+				}
+			}
+
+			mpLayer->EndPixels32( copy );
+		}
+
+		mpLayer->ResetFilterRect();
+	}
+
+	// an image's pixels as 32-bit ARGB, read on first use. a
+	// view is read out of its page
+	XBYTE4* GuiLayer::GetPixels( ImageX* img )
+	{
+		PixelMap::iterator itr = mPixels.find( img );
+		if( itr == mPixels.end() )
+		{
+			std::vector<XBYTE4>& pixels = mPixels[ img ];
+
+			ImageX* page = img->GetTexture();
+			const int32_t kX = img->IsView() ? img->m_view_x : 0;
+			const int32_t kY = img->IsView() ? img->m_view_y : 0;
+			const int32_t kWidth  = img->GetWidth();
+			const int32_t kHeight = img->GetHeight();
+
+			page->SetFilterRect( kX, kY, kX + kWidth, kY + kHeight );
+
+			int pitch;
+			XBYTE4* copy;
+			XBYTE4* src = page->BeginPixels32( pitch, copy );
+			if( src )
+			{
+				pixels.resize( kWidth * kHeight );
+				for( int32_t y = 0; y < kHeight; ++y )
+					memcpy( &pixels[ y * kWidth ], src + y * pitch, kWidth * sizeof(XBYTE4) );
+
+				page->EndPixels32( copy );
+			}
+
+			page->ResetFilterRect();
+			itr = mPixels.find( img );
+		}
+
+		return itr->second.empty() ? NULL : &itr->second[0];
+	}
+
+	// the shown elements under pos, below the root, in drawing order
+	void GuiLayer::FindHits( const jbsCommon::Vec2i& pos, std::vector<GuiElement*>& hits )
+	{
+		Rect rect = { pos.x, pos.y, pos.x + 1, pos.y + 1 };
+		Query( rect, mFound );
+
+		for( uint32_t i = 0; i < mFound.size(); ++i )
+		{
+			if( mFound[i] != mpRoot && Reaches( mFound[i], pos ) )
+				hits.push_back( mFound[i] );
+		}
+	}
+
+	// GuiContainer only passes events to visible children under
+	// pos, so every parent below the root has to be one
+	bool GuiLayer::Reaches( GuiElement* elem, const jbsCommon::Vec2i& pos )
+	{
+		for( ; elem && elem != mpRoot; elem = elem->mpParent )
+		{
+			if( !elem->mVisible || !elem->mLayerBounds.Collide( pos.x, pos.y ) )
+				return false;
+		}
+
+		return true;
+	}
+
+	void GuiLayer::Send( GuiElement* elem, Event evt, const jbsCommon::Vec2i& pos )
+	{
+		if( elem->GetContainer() )
+		{
+			switch( evt )
+			{
+			case kEvent_MouseOver:		elem->GuiElement::OnMouseOver( pos ); break;
+			case kEvent_MouseOut:		elem->GuiElement::OnMouseOut( pos ); break;
+			case kEvent_Click:			elem->GuiElement::OnClick( pos ); break;
+			case kEvent_ClickRelease:	elem->GuiElement::OnClickRelease( pos ); break;
+			}
+		}
+		else
+		{
+			switch( evt )
+			{
+			case kEvent_MouseOver:		elem->OnMouseOver( pos ); break;
+			case kEvent_MouseOut:		elem->OnMouseOut( pos ); break;
+			case kEvent_Click:			elem->OnClick( pos ); break;
+			case kEvent_ClickRelease:	elem->OnClickRelease( pos ); break;
+			}
+		}
+	}
+
+	void GuiLayer::SendAll( Event evt, const jbsCommon::Vec2i& pos )
+	{
+		if( !mpRoot )
+			return;
+
+		Update();
+
+		ElementList hits;
+		hits.push_back( mpRoot );
+		FindHits( pos, hits );
+
+		for( uint32_t i = 0; i < hits.size(); ++i )
+			Send( hits[i], evt, pos );
+	}
+
+	bool GuiLayer::OrderLess( GuiElement* a, GuiElement* b )
+	{
+		return a->mOrder < b->mOrder;
+	}
+	
 }; //end Game
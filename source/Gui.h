@@ -18,6 +18,9 @@ class ImageX;
 
 namespace Game
 {
+	class GuiContainer;
+	class GuiLayer;
+
 	// A Base element in the Gui system
 	class GuiElement
 	{
@@ -48,13 +51,14 @@ namespace Game
 
 	public:		
 		
-		virtual ~GuiElement() {}
+		virtual ~GuiElement();
 
 		// ctor
 		GuiElement();		
 
 		// set the parent of this element
 		void SetParent( GuiElement* elem );	
+		GuiElement* GetParent();
 
 		// set the position
 		void SetPosition( const jbsCommon::Vec2i& pos );
@@ -67,6 +71,10 @@ namespace Game
 		//render
 		virtual bool Draw();
 		virtual bool DrawBounds();
+
+		// the image drawn for the current state, NULL if none. a
+		// GuiLayer draws elements from this rather than Draw
+		virtual ImageX* GetDrawImage();
 		
 		State GetState();
 
@@ -77,6 +85,17 @@ namespace Game
 		virtual BoundingBoxi GetBounds();
 
 		bool IsVisible();
+		bool IsShown();		// visible, and so is every parent
+
+		// this element as a container, NULL if it isn't one
+		virtual GuiContainer* GetContainer();
+
+		// the layer drawing this element, NULL if none
+		GuiLayer* GetLayer();
+
+		// tells the layer this element and everything under it
+		// may look different. setters call it themselves
+		void MarkDirty();
 
 		// action
 		virtual void OnMouseOver( const jbsCommon::Vec2i& pos );
@@ -91,17 +110,30 @@ namespace Game
 
 	protected:		
 
+		void SetState( State state );
+
 		jbsCommon::Vec2i mPosition;
 		jbsCommon::Vec2i mExtent;
 
 	private:
 
+		friend class GuiLayer;
+
 		GuiElement* mpParent;
 		State		mState;
 		
 		jbsCommon::Vec2<Alignment> mAlign;		
 
 		bool		mVisible;		
+
+		// kept by the layer
+		GuiLayer*		mpLayer;
+		bool			mDirty;			// waiting in the layer's dirty list
+		bool			mIndexed;		// mLayerBounds is in the layer's grid
+		BoundingBoxi	mLayerBounds;	// as of the last update
+		ImageX*			mpLayerImage;	// in the layer now, NULL if nothing is
+		uint32_t		mOrder;			// depth first, parents before children
+		uint32_t		mStamp;			// last grid query that found it
 	};
 
 	class GuiContainer : public GuiElement
@@ -116,6 +148,11 @@ namespace Game
 		virtual void AddChild( GuiElement* child );	
 		virtual void RemoveChild( GuiElement* child );
 
+		virtual GuiContainer* GetContainer();
+
+		uint32_t	GetNumChildren();
+		GuiElement*	GetChild( uint32_t i );
+
 		virtual void OnMouseOver( const jbsCommon::Vec2i& pos );
 		virtual void OnMouseOut( const jbsCommon::Vec2i& pos );
 		virtual void OnClick( const jbsCommon::Vec2i& pos );
@@ -123,6 +160,9 @@ namespace Game
 
 	protected:
 
+		// lets go of a child taken out of mChildren
+		void ReleaseChild( GuiElement* child );
+
 		std::vector<GuiElement*>	mChildren;
 
 	};
@@ -156,6 +196,7 @@ namespace Game
 		virtual ~GuiImageControl() {}
 
 		virtual bool Draw();
+		virtual ImageX* GetDrawImage();
 
 		void SetExtentFromImages();
 		void SetImage( ImageX* img );		
@@ -174,6 +215,7 @@ namespace Game
 		GuiButtonControl();
 
 		virtual bool Draw();
+		virtual ImageX* GetDrawImage();
 
 		void SetImages( ImageX* normal, ImageX* depressed, ImageX* mouseOver );
 		void SetExtentFromImages();
@@ -185,6 +227,115 @@ namespace Game
 		ImageX*		mpOverImage;
 	};
 
+	//-----------------------------------------------------------
+	// Name: GuiLayer
+	// Desc:  retained drawing for a gui tree. elements report
+	//		  their changes as they happen, and only the parts of
+	//		  the screen those touched are redrawn into a cached
+	//		  layer, which goes to the screen as one image. events
+	//		  find what's under the mouse through a grid of element
+	//		  bounds instead of walking the tree.
+	//		  an element's image is clipped to its bounds, and the
+	//		  images' pixels are read once, so call InvalidateAll
+	//		  if they change
+	//-----------------------------------------------------------
+	class GuiLayer
+	{
+	public:
+
+		static const int32_t  kCellSize		 = 64;	// grid cell, in pixels
+		static const uint32_t kMaxDirtyRects = 16;	// past this they're merged into one
+
+		GuiLayer();
+		~GuiLayer();
+
+		// the tree to draw, NULL to let go of it. not owned
+		void			SetRoot( GuiElement* root );
+		GuiElement*		GetRoot();
+
+		// redraws everything on the next Draw
+		void			InvalidateAll();
+
+		// brings the layer up to date and draws it
+		void			Draw();
+
+		// events go to the root and to every shown element under
+		// pos, parents first as GuiContainer sends them. the layer
+		// sends to children itself, so containers only get the
+		// GuiElement handling. the mouse moving sends OnMouseOver
+		// and OnMouseOut as it comes and goes
+		void			OnMouseMove( const jbsCommon::Vec2i& pos );
+		void			OnClick( const jbsCommon::Vec2i& pos );
+		void			OnClickRelease( const jbsCommon::Vec2i& pos );
+
+		// the topmost shown element under pos, NULL if none
+		GuiElement*		HitTest( const jbsCommon::Vec2i& pos );
+
+		uint32_t		GetNumElements();
+		uint32_t		GetDirtyPixels();		// redrawn by the last Draw
+
+	private:
+
+		friend class GuiElement;
+		friend class GuiContainer;
+
+		enum Event
+		{
+			kEvent_MouseOver,
+			kEvent_MouseOut,
+			kEvent_Click,
+			kEvent_ClickRelease
+		};
+
+		// exclusive of x2, y2
+		struct Rect
+		{
+			int32_t x1, y1, x2, y2;
+		};
+
+		void	Attach( GuiElement* elem );		// elem and everything under it
+		void	Detach( GuiElement* elem );
+		void	Invalidate( GuiElement* elem );
+		void	Update();
+		void	Number( GuiElement* elem, uint32_t& order );
+
+		Rect	ToRect( BoundingBoxi& bounds );
+		bool	ToCells( const Rect& rect, int32_t& cx1, int32_t& cy1, int32_t& cx2, int32_t& cy2 );
+		void	Index( GuiElement* elem, bool add );
+		void	Query( const Rect& rect, std::vector<GuiElement*>& found );
+
+		void	AddDirty( BoundingBoxi& bounds );
+		void	AddDirty( Rect rect );
+		void	Redraw( const Rect& rect );
+		XBYTE4*	GetPixels( ImageX* img );
+
+		void	FindHits( const jbsCommon::Vec2i& pos, std::vector<GuiElement*>& hits );
+		bool	Reaches( GuiElement* elem, const jbsCommon::Vec2i& pos );
+		void	Send( GuiElement* elem, Event evt, const jbsCommon::Vec2i& pos );
+		void	SendAll( Event evt, const jbsCommon::Vec2i& pos );
+
+		static bool OrderLess( GuiElement* a, GuiElement* b );
+
+	private:
+
+		typedef std::vector< GuiElement* >					ElementList;
+		typedef std::map< ImageX*, std::vector<XBYTE4> >	PixelMap;
+
+		GuiElement*					mpRoot;
+		ImageX*						mpLayer;
+		int32_t						mWidth, mHeight;
+		int32_t						mCellsX, mCellsY;
+		std::vector< ElementList >	mCells;
+		ElementList					mDirtyElems;
+		std::vector< Rect >			mDirtyRects;
+		ElementList					mHovered;
+		ElementList					mFound;		// scratch for queries
+		PixelMap					mPixels;	// images' pixels, as 32-bit ARGB
+		uint32_t					mNumElements;
+		uint32_t					mStamp;
+		uint32_t					mDirtyPixels;
+		bool						mRenumber;
+	};
 	
 }; //end Game
 
@@ -0,0 +1,223 @@
+//---------------------------------------------------
+// Name: Game : LevelLoader
+// Desc:  reads and parses levels on a worker thread,
+//		  so the next one is ready before it is wanted
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#include "LevelLoader.h"
+
+#include "Algorithms.h"
+#include "GameXExt.h"
+#include "MasterFile.h"
+
+namespace Game
+{
+	LevelAssets::LevelAssets()
+		: mLoaded( false )
+		, mpMusicStream( NULL )
+	{
+		mLevel.mTimeLength = -1.0f;
+	}
+
+	LevelAssets::~LevelAssets()
+	{
+		DestroyEntityDescMap( &mEntityDescs );
+
+		if( mpMusicStream )
+			delete mpMusicStream;
+	}
+
+	//-----------------------------------------------------------
+	// Name: LoadJob
+	// Desc:  loads one level on the pool thread
+	//-----------------------------------------------------------
+	class LevelLoader::LoadJob : public ThreadJob
+	{
+	public:
+
+		LoadJob( const char* levelName, bool openMusic )
+			: mName( levelName )
+			, mOpenMusic( openMusic )
+		{
+			mAssets = new LevelAssets;
+		}
+
+		~LoadJob()
+		{
+			if( mAssets )
+				delete mAssets;
+		}
+
+		void Run()
+		{
+			Load( mName.c_str(), mOpenMusic, *mAssets );
+		}
+
+		std::string		mName;			// the assets' own is being written
+		bool			mOpenMusic;
+		LevelAssets*	mAssets;
+	};
+
+	// one thread is enough, a load is mostly waiting on the disk
+	LevelLoader::LevelLoader()
+		: mPool( 1 )
+	{
+	}
+
+	LevelLoader::~LevelLoader()
+	{
+		Clear();
+	}
+
+	void LevelLoader::Prefetch( const char* levelName, bool openMusic )
+	{
+		if( !levelName )
+			return;
+
+		for( uint32_t i = 0; i < mPending.size(); ++i )
+		{
+			if( mPending[i]->mName == levelName )
+				return;
+		}
+
+		for( uint32_t i = 0; i < mCompleted.size(); ++i )
+		{
+			if( mCompleted[i]->mName == levelName )
+				return;
+		}
+
+		LoadJob* job = new LoadJob( levelName, openMusic );
+		mPending.push_back( job );
+		mPool.AddJob( job );
+	}
+
+	//-----------------------------------------------------------
+	// Name: Poll
+	// Desc:  loads finish in the order they were asked for, so
+	//		  only the front of the pending queue needs a look
+	//-----------------------------------------------------------
+	void LevelLoader::Poll()
+	{
+		while( !mPending.empty() && mPending.front()->IsDone() )
+		{
+			LoadJob* job = mPending.front();
+			mPending.pop_front();
+
+			mCompleted.push_back( job->mAssets );
+			job->mAssets = NULL;
+			delete job;
+		}
+	}
+
+	LevelAssets* LevelLoader::Take( const char* levelName )
+	{
+		if( !levelName )
+			return NULL;
+
+		// a load still under way is waited out, it's nearer done
+		// than a load started now would be
+		for( uint32_t i = 0; i < mPending.size(); ++i )
+		{
+			if( mPending[i]->mName == levelName )
+			{
+				mPool.WaitJob( mPending[i] );
+				break;
+			}
+		}
+
+		Poll();
+
+		LevelAssets* taken = NULL;
+		while( !mCompleted.empty() )
+		{
+			LevelAssets* assets = mCompleted.front();
+			mCompleted.pop_front();
+
+			if( !taken && assets->mName == levelName )
+				taken = assets;
+			else
+				delete assets;
+		}
+
+		return taken;
+	}
+
+	void LevelLoader::Clear()
+	{
+		mPool.Wait();
+		Poll();
+
+		while( !mCompleted.empty() )
+		{
+			delete mCompleted.front();
+			mCompleted.pop_front();
+		}
+	}
+
+	uint32_t LevelLoader::GetNumPending() const
+	{
+		return (uint32_t)mPending.size();
+	}
+
+	uint32_t LevelLoader::GetNumCompleted() const
+	{
+		return (uint32_t)mCompleted.size();
+	}
+
+	//-----------------------------------------------------------
+	// Name: Load
+	// Desc:  the pack is all in memory and only read here, so a
+	//		  load is safe off the frame thread as long as the pack
+	//		  isn't cleared under it. music is the one part that
+	//		  touches the disk
+	//-----------------------------------------------------------
+	bool LevelLoader::Load( const char* levelName, bool openMusic, LevelAssets& assets )
+	{
+		char buffer[512];
+
+		assets.mName   = levelName;
+		assets.mLoaded = false;
+
+		// the entity descriptions, each level changes its own copy.
+		// the level still loads without them, it just spawns nothing
+		PackFile::PackElement packedEntityDesc;
+		bool haveDescs = SPackFile.GetPackElement( "EntityDescriptions", packedEntityDesc ) &&
+						 EntityDescFile::Import( (uint8_t*)packedEntityDesc.mData, packedEntityDesc.mSize, &assets.mEntityDescs );
+
+		// the level
+		PackFile::PackElement packedLevel;
+		if( !SPackFile.GetPackElement( levelName, packedLevel ) )
+			return false;
+
+		if( !LevelFile::Import( (uint8_t*)packedLevel.mData, packedLevel.mSize, assets.mLevel ) )
+			return false;
+
+#if PLAY_MUSIC
+		// a packed track is opened and its first second read in
+		if( openMusic && assets.mLevel.mMusic != "" )
+			assets.mpMusicStream = OpenMusic( assets.mLevel.mMusic.c_str() );
+#endif
+
+		// the arrow set, named without its extension in the pack
+		jbsCommon::Algorithm::RemoveFileExtension( buffer, (char*)assets.mLevel.mEntitySet.c_str() );
+
+		PackFile::PackElement packedEntitySet;
+		if( !SPackFile.GetPackElement( buffer, packedEntitySet ) )
+			return false;
+
+		if( !EntitySetFile::Import( (uint8_t*)packedEntitySet.mData, packedEntitySet.mSize, assets.mEntitySet ) )
+			return false;
+
+		assets.mLoaded = haveDescs;
+		return haveDescs;
+	}
+
+	LevelLoader* LevelLoader::GetLL()
+	{
+		static LevelLoader* pLL = new LevelLoader;
+		return pLL;
+	}
+
+}; //end Game
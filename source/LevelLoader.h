@@ -0,0 +1,91 @@
+//---------------------------------------------------
+// Name: Game : LevelLoader
+// Desc:  reads and parses levels on a worker thread,
+//		  so the next one is ready before it is wanted
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#ifndef _GAME_LEVEL_LOADER_H_
+#define _GAME_LEVEL_LOADER_H_
+
+#include "Types.h"
+#include "FileIO.h"
+#include "gamex.hpp"
+#include "gamex-thread.hpp"
+
+#include <deque>
+#include <string>
+
+namespace Game
+{
+	//-----------------------------------------------------------
+	// Name: LevelAssets
+	// Desc:  everything a level needs that can be had without
+	//		  the renderer or DirectShow. images come out of the
+	//		  resource cache and playing starts on the frame thread
+	//-----------------------------------------------------------
+	struct LevelAssets
+	{
+		LevelAssets();
+		~LevelAssets();					// frees whatever was not taken
+
+		std::string						mName;
+		bool							mLoaded;		// false if any part failed
+		LevelFile::LevelEntry			mLevel;
+		EntitySetFile::EntitySetList	mEntitySet;
+		EntityDescMap					mEntityDescs;
+		MusicStream*					mpMusicStream;	// opened and filled, not playing
+	};
+
+	//-----------------------------------------------------------
+	// Name: LevelLoader
+	// Desc:  a queue of level loads on a thread of their own.
+	//		  finished loads wait on a completion queue until the
+	//		  level is entered and takes them
+	//-----------------------------------------------------------
+	class LevelLoader
+	{
+	public:
+
+		LevelLoader();
+		~LevelLoader();
+
+		// starts loading a level in the background, unless it
+		// is already loading or loaded
+		void			Prefetch( const char* levelName, bool openMusic );
+
+		// moves finished loads to the completion queue
+		void			Poll();
+
+		// hands over a prefetched level, waiting if it's still
+		// loading. NULL if it was never asked for. anything else
+		// on the completion queue is thrown away
+		LevelAssets*	Take( const char* levelName );
+
+		// waits out every load and throws them all away, for
+		// before the pack they read from goes
+		void			Clear();
+
+		uint32_t		GetNumPending() const;
+		uint32_t		GetNumCompleted() const;
+
+		// loads a level on the calling thread
+		static bool		Load( const char* levelName, bool openMusic, LevelAssets& assets );
+
+		static LevelLoader* GetLL();
+
+	private:
+
+		class LoadJob;
+
+		ThreadPool					mPool;
+		std::deque< LoadJob* >		mPending;		// in the order asked for
+		std::deque< LevelAssets* >	mCompleted;
+	};
+
+#define SLevelLoader (*LevelLoader::GetLL())
+
+}; //end Game
+
+#endif // end _GAME_LEVEL_LOADER_H_
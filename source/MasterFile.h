@@ -19,6 +19,8 @@ extern const float kVersion;
 #define COMPILE_FILES 1		// set to zero to disable file compilation
 #define PLAY_MUSIC	  1		// set to zero to disable music
 #define ENABLE_EDIT   1		// set to zero to disable edit mode
+#define RECORD_REPLAYS 1	// set to zero to disable replay recording
+#define ENABLE_PROFILER 1	// set to zero to compile out profiling zones
 
 }; //end Game
 
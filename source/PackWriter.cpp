@@ -0,0 +1,314 @@
+//---------------------------------------------------
+// Name: Game : PackWriter
+// Desc:  streams pack contents to disk, reading the
+//		  inputs ahead on a thread pool
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#include "PackWriter.h"
+
+namespace Game
+{
+	PackSource::PackSource()
+		: mSignature( 0 )
+		, mOffset( 0 )
+		, mSize( 0 )
+	{
+	}
+
+	PackSource::PackSource( uint32_t signature, const std::string& file, uint32_t size, uint32_t offset )
+		: mSignature( signature )
+		, mFile( file )
+		, mOffset( offset )
+		, mSize( size )
+	{
+	}
+
+	//-----------------------------------------------------------
+	// Name: ReadJob
+	// Desc:  reads one source into memory on a pool thread
+	//-----------------------------------------------------------
+	class PackWriter::ReadJob : public ThreadJob
+	{
+	public:
+
+		ReadJob( const PackSource& source )
+			: mSource( source )
+			, mData( NULL )
+			, mRead( false )
+		{
+		}
+
+		~ReadJob()
+		{
+			if( mData )
+				delete [] mData;
+		}
+
+		void Run()
+		{
+			if( mSource.mSize == 0 )
+			{
+				mRead = true;
+				return;
+			}
+
+			FILE* file = fopen( mSource.mFile.c_str(), "rb" );
+			if( !file )
+				return;
+
+			mData = new uint8_t[ mSource.mSize ];
+
+			// a short read means the file changed after it was sized
+			mRead = fseek( file, mSource.mOffset, SEEK_SET ) == 0 &&
+					fread( mData, mSource.mSize, 1, file ) == 1;
+
+			fclose( file );
+		}
+
+		const PackSource&	mSource;
+		uint8_t*			mData;
+		bool				mRead;
+	};
+
+	PackWriter::PackWriter( uint32_t memoryBudget, int32_t numThreads )
+		: mPool( numThreads )
+		, mInFlight( 0 )
+		, mBudget( memoryBudget )
+		, mPeakMemory( 0 )
+		, mBytesWritten( 0 )
+	{
+		// enough read-ahead to keep every thread busy while the
+		// writer waits on the oldest job
+		mMaxJobs = 4 * ( mPool.GetNumThreads() > 0 ? mPool.GetNumThreads() : 1 );
+	}
+
+	//-----------------------------------------------------------
+	// Name: Write
+	// Desc:  sources are queued to the pool in order and written
+	//		  out oldest first, so the blobs land at the offsets
+	//		  the caller computed from the source sizes. returns
+	//		  false if any source could not be read
+	//-----------------------------------------------------------
+	bool PackWriter::Write( FILE* file, const PackSourceList& sources )
+	{
+		if( !file )
+			return false;
+
+		bool written = true;
+
+		PackSourceList::const_iterator itr;
+		for( itr = sources.begin(); itr != sources.end(); ++itr )
+		{
+			// hold off until the read fits the budget. a blob bigger
+			// than the budget is still read, just on its own
+			while( !mWindow.empty() &&
+				   ( mWindow.size() >= mMaxJobs || mInFlight + itr->mSize > mBudget ) )
+			{
+				written = Retire( file ) && written;
+			}
+
+			mInFlight += itr->mSize;
+			if( mInFlight > mPeakMemory )
+				mPeakMemory = mInFlight;
+
+			ReadJob* job = new ReadJob( *itr );
+			mWindow.push_back( job );
+			mPool.AddJob( job );
+		}
+
+		while( !mWindow.empty() )
+			written = Retire( file ) && written;
+
+		return written;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Retire
+	// Desc:  waits for the oldest read and writes it out
+	//-----------------------------------------------------------
+	bool PackWriter::Retire( FILE* file )
+	{
+		ReadJob* job = mWindow.front();
+		mWindow.pop_front();
+
+		mPool.WaitJob( job );
+
+		bool written = job->mRead;
+		if( written && job->mSource.mSize > 0 )
+		{
+			written = fwrite( job->mData, job->mSource.mSize, 1, file ) == 1;
+			mBytesWritten += job->mSource.mSize;
+		}
+
+		mInFlight -= job->mSource.mSize;
+		delete job;
+
+		return written;
+	}
+
+	uint32_t PackWriter::GetPeakMemory() const
+	{
+		return mPeakMemory;
+	}
+
+	uint32_t PackWriter::GetBytesWritten() const
+	{
+		return mBytesWritten;
+	}
+
+	int32_t PackWriter::GetNumThreads()
+	{
+		return mPool.GetNumThreads();
+	}
+
+}; //end Game
+
+#ifdef PACKWRITER_TESTER
+
+	// g++ -O2 -DPACKWRITER_TESTER -Isource -Iexternal/GameX/source -Iexternal/Common
+	//     source/PackWriter.cpp external/GameX/source/gamex-thread.cpp -lpthread
+
+	#include <string.h>
+	#include <time.h>
+
+	#ifdef _WIN32
+		#include <windows.h>
+		#include <direct.h>
+		#define MakeDir(dir)	_mkdir (dir)
+	#else
+		#include <sys/stat.h>
+		#include <sys/time.h>
+		#define MakeDir(dir)	mkdir (dir, 0777)
+	#endif
+
+	using namespace Game;
+
+	// wall clock, the pool's reads overlap so cpu time would mislead
+	static double Seconds()
+	{
+	#ifdef _WIN32
+		LARGE_INTEGER freq, now;
+		QueryPerformanceFrequency( &freq );
+		QueryPerformanceCounter( &now );
+		return (double)now.QuadPart / (double)freq.QuadPart;
+	#else
+		struct timeval tv;
+		gettimeofday( &tv, NULL );
+		return tv.tv_sec + tv.tv_usec / 1e6;
+	#endif
+	}
+
+	// true if both files hold the same bytes
+	static bool SameFile( const char* a, const char* b )
+	{
+		FILE* fa = fopen( a, "rb" );
+		FILE* fb = fopen( b, "rb" );
+		bool same = fa && fb;
+
+		static uint8_t bufA[ 64 * 1024 ], bufB[ 64 * 1024 ];
+		while( same )
+		{
+			size_t readA = fread( bufA, 1, sizeof(bufA), fa );
+			size_t readB = fread( bufB, 1, sizeof(bufB), fb );
+			same = readA == readB && memcmp( bufA, bufB, readA ) == 0;
+
+			if( readA == 0 )
+				break;
+		}
+
+		if( fa ) fclose( fa );
+		if( fb ) fclose( fb );
+		return same;
+	}
+
+	// packs 20k generated files both ways and reports the time and
+	// the most asset data held in memory at once
+	int main( void )
+	{
+		const uint32_t kNumFiles = 20000;
+
+		MakeDir( "packtest" );
+
+		PackSourceList sources;
+		uint32_t totalSize = 0;
+
+		char name[256];
+		uint8_t* data = new uint8_t[ 64 * 1024 ];
+		memset( data, 0xab, 64 * 1024 );
+
+		for( uint32_t i = 0; i < kNumFiles; ++i )
+		{
+			// 1k - 64k, roughly the spread of the textures and sounds
+			uint32_t size = 1024 + ( i * 7919 ) % ( 63 * 1024 );
+			data[0] = (uint8_t)i;
+
+			sprintf( name, "packtest/file%u.bin", i );
+			FILE* file = fopen( name, "wb" );
+			if( !file || fwrite( data, size, 1, file ) != 1 )
+			{
+				printf( "FAILED: couldn't write %s\n", name );
+				return 1;
+			}
+			fclose( file );
+
+			sources.push_back( PackSource( i, name, size ) );
+			totalSize += size;
+		}
+
+		delete [] data;
+		printf( "Generated %u files, %.1f MB\n", kNumFiles, totalSize / (1024.0f * 1024.0f) );
+
+		// the old way, everything read and then written in one go
+		double start = Seconds();
+		{
+			std::vector< uint8_t* > buffers;
+			PackSourceList::iterator itr;
+			for( itr = sources.begin(); itr != sources.end(); ++itr )
+			{
+				uint8_t* buffer = new uint8_t[ itr->mSize ];
+				FILE* file = fopen( itr->mFile.c_str(), "rb" );
+				fread( buffer, itr->mSize, 1, file );
+				fclose( file );
+				buffers.push_back( buffer );
+			}
+
+			FILE* pack = fopen( "packtest_old.pak", "wb" );
+			for( uint32_t i = 0; i < buffers.size(); ++i )
+			{
+				fwrite( buffers[i], sources[i].mSize, 1, pack );
+				delete [] buffers[i];
+			}
+			fclose( pack );
+		}
+		printf( "Load all:    %.3f s, peak %.1f MB\n",
+				Seconds() - start, totalSize / (1024.0f * 1024.0f) );
+
+		// streamed through the pool
+		bool written;
+		start = Seconds();
+		{
+			PackWriter writer;
+			FILE* pack = fopen( "packtest_new.pak", "wb" );
+			written = writer.Write( pack, sources );
+			fclose( pack );
+
+			printf( "PackWriter:  %.3f s, peak %.1f MB, %d threads\n",
+					Seconds() - start,
+					writer.GetPeakMemory() / (1024.0f * 1024.0f), writer.GetNumThreads() );
+		}
+
+		bool same = written && SameFile( "packtest_old.pak", "packtest_new.pak" );
+		printf( "%s\n", same ? "OK: packs match" : "FAILED: packs differ" );
+
+		for( uint32_t i = 0; i < kNumFiles; ++i )
+			remove( sources[i].mFile.c_str() );
+
+		remove( "packtest_old.pak" );
+		remove( "packtest_new.pak" );
+
+		return same ? 0 : 1;
+	}
+
+#endif
@@ -0,0 +1,82 @@
+//---------------------------------------------------
+// Name: Game : PackWriter
+// Desc:  streams pack contents to disk, reading the
+//		  inputs ahead on a thread pool
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#ifndef _GAME_PACK_WRITER_H_
+#define _GAME_PACK_WRITER_H_
+
+#include "Types.h"
+#include "gamex-thread.hpp"
+
+#include <stdio.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace Game
+{
+	//-----------------------------------------------------------
+	// Name: PackSource
+	// Desc:  where a packed blob comes from, a whole file or a
+	//		  byte range of one (an element of an older pack)
+	//-----------------------------------------------------------
+	struct PackSource
+	{
+		PackSource();
+		PackSource( uint32_t signature, const std::string& file, uint32_t size, uint32_t offset = 0 );
+
+		uint32_t		mSignature;
+		std::string		mFile;
+		uint32_t		mOffset;
+		uint32_t		mSize;
+	};
+
+	typedef std::vector< PackSource > PackSourceList;
+
+	//-----------------------------------------------------------
+	// Name: PackWriter
+	// Desc:  writes the blobs of a source list in order. the
+	//		  pool reads ahead of the writer but the bytes in
+	//		  flight stay under the memory budget, so packs never
+	//		  have to fit in memory
+	//-----------------------------------------------------------
+	class PackWriter
+	{
+	public:
+
+		static const uint32_t kDefaultBudget = 16 * 1024 * 1024;
+
+		PackWriter( uint32_t memoryBudget = kDefaultBudget, int32_t numThreads = 0 );
+
+		// writes every source at the current file position
+		bool		Write( FILE* file, const PackSourceList& sources );
+
+		uint32_t	GetPeakMemory() const;
+		uint32_t	GetBytesWritten() const;
+		int32_t		GetNumThreads();
+
+	private:
+
+		class ReadJob;
+
+		bool		Retire( FILE* file );
+
+	private:
+
+		ThreadPool				mPool;
+		std::deque< ReadJob* >	mWindow;		// in source order
+		uint32_t				mInFlight;		// bytes read or being read
+
+		uint32_t				mBudget;
+		uint32_t				mMaxJobs;
+		uint32_t				mPeakMemory;
+		uint32_t				mBytesWritten;
+	};
+
+}; //end Game
+
+#endif // end _GAME_PACK_WRITER_H_
@@ -0,0 +1,153 @@
+//---------------------------------------------------
+// Name: Game : Replay
+// Desc:  records and plays back game input
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#include "Replay.h"
+
+#include "Log.h"
+#include "Util/Tuner.h"
+
+namespace Game
+{	
+	//-----------------------------------------------------------
+	// Name: Replay
+	// Desc:  constructor
+	//-----------------------------------------------------------
+	Replay::Replay() :  mMode(kMode_Off)
+					  , mCurTick(0)
+	{}
+
+	//-----------------------------------------------------------
+	// Name: BeginRecord
+	// Desc:  starts a new recording, snapshotting the tuners
+	//-----------------------------------------------------------
+	void Replay::BeginRecord( const char* szFile, uint32_t level, uint32_t seed, F32 startTime )
+	{
+		if( mMode == kMode_Playback )
+			return;
+
+		mMode = kMode_Record;
+		mFile = std::string( szFile );
+
+		mLog.mLevel		= level;
+		mLog.mSeed		= seed;
+		mLog.mStartTime = startTime;
+		mLog.mTuners	= gTuner.GetVariables();
+		mLog.mTicks.clear();
+	}
+
+	//-----------------------------------------------------------
+	// Name: RecordTick
+	// Desc:  appends one tick of input
+	//-----------------------------------------------------------
+	void Replay::RecordTick( uint8_t input, F32 time )
+	{
+		if( mMode != kMode_Record )
+			return;
+
+		ReplayFile::ReplayTick tick;
+		tick.mInput = input;
+		tick.mTime  = time;
+		mLog.mTicks.push_back( tick );
+	}
+
+	//-----------------------------------------------------------
+	// Name: EndRecord
+	// Desc:  stops recording and writes the replay file
+	//-----------------------------------------------------------
+	bool Replay::EndRecord()
+	{
+		if( mMode != kMode_Record )
+			return false;
+
+		mMode = kMode_Off;
+
+		if( !ReplayFile::Export( mFile.c_str(), mLog ) )
+		{
+			SLog->Print( "Replay: failed to write replay file" );
+			return false;
+		}
+
+		return true;
+	}
+
+	//-----------------------------------------------------------
+	// Name: BeginPlayback
+	// Desc:  loads a replay file and pins the recorded tuners
+	//-----------------------------------------------------------
+	bool Replay::BeginPlayback( const char* szFile )
+	{
+		if( !ReplayFile::Import( szFile, mLog ) )
+		{
+			SLog->Print( "Replay: failed to read replay file" );
+			return false;
+		}
+
+		gTuner.SetVariables( mLog.mTuners );
+
+		mFile	 = std::string( szFile );
+		mMode	 = kMode_Playback;
+		mCurTick = 0;
+		return true;
+	}
+
+	//-----------------------------------------------------------
+	// Name: NextTick
+	// Desc:  fetches the next recorded tick. returns false once
+	//		  the replay is exhausted
+	//-----------------------------------------------------------
+	bool Replay::NextTick( uint8_t& input, F32& time )
+	{
+		if( mMode != kMode_Playback || mCurTick >= mLog.mTicks.size() )
+			return false;
+
+		input = mLog.mTicks[mCurTick].mInput;
+		time  = mLog.mTicks[mCurTick].mTime;
+		++mCurTick;
+		return true;
+	}
+
+	//-----------------------------------------------------------
+	// Name: EndPlayback
+	// Desc:  stops the playback
+	//-----------------------------------------------------------
+	void Replay::EndPlayback()
+	{
+		if( mMode == kMode_Playback )
+			mMode = kMode_Off;
+	}
+
+	bool Replay::IsRecording() const
+	{
+		return mMode == kMode_Record;
+	}
+
+	bool Replay::IsPlaying() const
+	{
+		return mMode == kMode_Playback;
+	}
+
+	const ReplayFile::ReplayLog& Replay::GetLog() const
+	{
+		return mLog;
+	}
+
+	const std::string& Replay::GetFile() const
+	{
+		return mFile;
+	}
+
+	//-----------------------------------------------------------
+	// Name: GetReplay
+	// Desc:  singleton pattern
+	//-----------------------------------------------------------
+	Replay* Replay::GetReplay()
+	{
+		static Replay* replay = new Replay();
+		return replay;
+	}
+	
+}; //end Game
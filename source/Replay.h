@@ -0,0 +1,84 @@
+//---------------------------------------------------
+// Name: Game : Replay
+// Desc:  records and plays back game input
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#ifndef _GAME_REPLAY_H_
+#define _GAME_REPLAY_H_
+
+#include "Types.h"
+#include "FileIO.h"
+
+#include <string>
+
+namespace Game
+{	
+	// input bits captured once per game tick
+	enum ReplayInput
+	{
+		kInput_Pause		= 1 << 0,
+		kInput_Back			= 1 << 1,
+		kInput_ReloadTuners = 1 << 2,
+		kInput_Up			= 1 << 3,
+		kInput_Down			= 1 << 4,
+		kInput_Left			= 1 << 5,
+		kInput_Right		= 1 << 6
+	};
+
+	//-----------------------------------------------------------
+	// Name: Replay
+	// Desc:  captures the per tick input and clock of a game
+	//		  session so it can be fed back in later. With the
+	//		  seed and tuners pinned, a playback walks the exact
+	//		  same states as the recorded run.
+	//-----------------------------------------------------------
+	class Replay
+	{
+	public:
+
+		enum Mode
+		{
+			kMode_Off,
+			kMode_Record,
+			kMode_Playback
+		};
+
+	private:
+
+		Replay();
+
+	public:
+
+		void BeginRecord( const char* szFile, uint32_t level, uint32_t seed, F32 startTime );
+		void RecordTick( uint8_t input, F32 time );
+		bool EndRecord();
+
+		bool BeginPlayback( const char* szFile );
+		bool NextTick( uint8_t& input, F32& time );
+		void EndPlayback();
+
+		bool IsRecording() const;
+		bool IsPlaying() const;
+
+		const ReplayFile::ReplayLog& GetLog() const;
+		const std::string&			 GetFile() const;
+
+		// singleton pattern
+		static Replay*	GetReplay();
+
+	private:
+
+		Mode						mMode;
+		std::string					mFile;		// file being recorded or played
+		ReplayFile::ReplayLog		mLog;
+		uint32_t					mCurTick;	// playback position
+	};
+
+#define SReplay (*Replay::GetReplay())
+	
+}; //end Game
+
+#endif // end _GAME_REPLAY_H_
+    
@@ -6,6 +6,7 @@
 //---------------------------------------------------
 
 #include "ResourceCache.h"
+#include "Util/Metrics.h"
 
 namespace Game
 {
@@ -136,8 +137,16 @@ namespace Game
 	//-----------------------------------------------------------
 	Resource* ResourceCache::GetResource( Resource::ResHandle handle )
 	{
+		static MetricCounter* sHits   = SMetrics.GetCounter( "CacheHits" );
+		static MetricCounter* sMisses = SMetrics.GetCounter( "CacheMisses" );
+
 		if( mHandleMap.find(handle) == mHandleMap.end() )
+		{
+			sMisses->Add();
 			return NULL;
+		}
+
+		sHits->Add();
 
 		uint32_t idx = mHandleMap[handle];
 		return mData[idx];
@@ -0,0 +1,223 @@
+//---------------------------------------------------
+// Name: Game : SpriteBatch
+// Desc:  sorts and batches a frame's sprite draws
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#include "SpriteBatch.h"
+
+#include <algorithm>
+
+namespace Game
+{	
+	//-----------------------------------------------------------
+	// Name: SpriteBatch
+	// Desc:  constructor
+	//-----------------------------------------------------------
+	SpriteBatch::SpriteBatch() :  mEnabled(true)
+								, mNumSprites(0)
+								, mNumRuns(0)
+	{
+		mSprites.reserve( 1024 );
+		mRuns.reserve( 256 );
+	}
+
+	//-----------------------------------------------------------
+	// Name: Draw
+	// Desc:  queues a sprite, or draws it now if disabled
+	//-----------------------------------------------------------
+	void SpriteBatch::Draw( ImageX* img, int32_t x, int32_t y, uint32_t layer, DrawFlags mode )
+	{
+		Draw( img, x, y, 0.0f, 1.0f, layer, mode );
+	}
+
+	void SpriteBatch::Draw( ImageX* img, int32_t x, int32_t y, F32 angle, F32 scale, 
+							uint32_t layer, DrawFlags mode )
+	{
+		if( !img )
+			return;
+
+		Sprite sprite;
+		sprite.mImage = img;
+		sprite.mMode  = mode;
+		sprite.mLayer = layer;
+		sprite.mRun	  = 0;
+		sprite.mX	  = x;
+		sprite.mY	  = y;
+		sprite.mAngle = angle;
+		sprite.mScale = scale;
+
+		if( mEnabled )
+			mSprites.push_back( sprite );
+		else
+			Submit( sprite );
+	}
+
+	//-----------------------------------------------------------
+	// Name: Flush
+	// Desc:  sorts the queue into runs and draws it in one GameX
+	//		  batch. the sorts are stable, so a run keeps the order
+	//		  its sprites were queued in
+	//-----------------------------------------------------------
+	void SpriteBatch::Flush()
+	{
+		mNumSprites = (uint32_t)mSprites.size();
+		mNumRuns	= 0;
+
+		if( mSprites.empty() )
+			return;
+
+		std::stable_sort( mSprites.begin(), mSprites.end(), SortLayer() );
+		AssignRuns();
+		std::stable_sort( mSprites.begin(), mSprites.end(), SortRun() );
+
+		GameX.BeginBatch();
+
+		const Sprite* prev = NULL;
+		std::vector<Sprite>::const_iterator itr;
+		for( itr = mSprites.begin(); itr != mSprites.end(); ++itr )
+		{
+			if( !prev || prev->mImage->GetTexture() != itr->mImage->GetTexture() || prev->mMode != itr->mMode )
+				++mNumRuns;
+
+			Submit( *itr );
+			prev = &(*itr);
+		}
+
+		GameX.EndBatch();
+
+		mSprites.clear();
+		mRuns.clear();
+	}
+
+	//-----------------------------------------------------------
+	// Name: AssignRuns
+	// Desc:  walks the sprites in queued order, layer by layer.
+	//		  the latest run over any cell a sprite touches is as
+	//		  early as it can be drawn, so it joins the last run of
+	//		  its texture and mode at or after that one, or starts
+	//		  a new run. the bounds are (width + height) * scale
+	//		  around the position, which holds a sprite turned to
+	//		  any angle about any point of it
+	//-----------------------------------------------------------
+	void SpriteBatch::AssignRuns()
+	{
+		int32_t layerStart = 0;
+
+		for( uint32_t i = 0; i < mSprites.size(); ++i )
+		{
+			Sprite& sprite = mSprites[i];
+
+			// runs don't cross layers, the layers are drawn in order
+			if( i == 0 || sprite.mLayer != mSprites[i-1].mLayer )
+			{
+				layerStart = (int32_t)mRuns.size();
+				for( uint32_t c = 0; c < kGridWidth * kGridHeight; ++c )
+					mGrid[c] = -1;
+			}
+
+			int32_t reach = (int32_t)( ( sprite.mImage->GetWidth() + sprite.mImage->GetHeight() ) * sprite.mScale ) + 1;
+
+			int32_t x0 = ( sprite.mX - reach ) / kCellSize;
+			int32_t y0 = ( sprite.mY - reach ) / kCellSize;
+			int32_t x1 = ( sprite.mX + reach ) / kCellSize;
+			int32_t y1 = ( sprite.mY + reach ) / kCellSize;
+
+			x0 = x0 < 0 ? 0 : ( x0 >= kGridWidth  ? kGridWidth  - 1 : x0 );
+			x1 = x1 < 0 ? 0 : ( x1 >= kGridWidth  ? kGridWidth  - 1 : x1 );
+			y0 = y0 < 0 ? 0 : ( y0 >= kGridHeight ? kGridHeight - 1 : y0 );
+			y1 = y1 < 0 ? 0 : ( y1 >= kGridHeight ? kGridHeight - 1 : y1 );
+
+			int32_t barrier = layerStart;
+			for( int32_t y = y0; y <= y1; ++y )
+				for( int32_t x = x0; x <= x1; ++x )
+					if( mGrid[ y * kGridWidth + x ] > barrier )
+						barrier = mGrid[ y * kGridWidth + x ];
+
+			ImageX* texture = sprite.mImage->GetTexture();
+
+			int32_t run = (int32_t)mRuns.size() - 1;
+			for( ; run >= barrier; --run )
+			{
+				if( mRuns[run].mTexture == texture && mRuns[run].mMode == sprite.mMode )
+					break;
+			}
+
+			if( run < barrier )
+			{
+				Run newRun;
+				newRun.mTexture = texture;
+				newRun.mMode	= sprite.mMode;
+
+				run = (int32_t)mRuns.size();
+				mRuns.push_back( newRun );
+			}
+
+			sprite.mRun = (uint32_t)run;
+
+			for( int32_t y = y0; y <= y1; ++y )
+				for( int32_t x = x0; x <= x1; ++x )
+					if( mGrid[ y * kGridWidth + x ] < run )
+						mGrid[ y * kGridWidth + x ] = run;
+		}
+	}
+
+	void SpriteBatch::SetEnabled( bool enabled )
+	{
+		// don't strand anything queued under the old setting
+		Flush();
+		mEnabled = enabled;
+	}
+
+	bool SpriteBatch::IsEnabled() const
+	{
+		return mEnabled;
+	}
+
+	uint32_t SpriteBatch::GetNumSprites() const
+	{
+		return mNumSprites;
+	}
+
+	uint32_t SpriteBatch::GetNumRuns() const
+	{
+		return mNumRuns;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Submit
+	// Desc:  issues the GameX draw for a sprite
+	//-----------------------------------------------------------
+	void SpriteBatch::Submit( const Sprite& sprite )
+	{
+		if( sprite.mMode != DRAW_PLAIN )
+			GameX.SetDrawMode( sprite.mMode );
+
+		if( sprite.mAngle != 0.0f || sprite.mScale != 1.0f )
+			GameX.DrawImage( sprite.mImage, sprite.mX, sprite.mY, sprite.mAngle, sprite.mScale );
+		else
+			GameX.DrawImage( sprite.mImage, sprite.mX, sprite.mY );
+	}
+
+	bool SpriteBatch::SortLayer::operator() ( const Sprite& a, const Sprite& b ) const
+	{
+		return a.mLayer < b.mLayer;
+	}
+
+	bool SpriteBatch::SortRun::operator() ( const Sprite& a, const Sprite& b ) const
+	{
+		return a.mRun < b.mRun;
+	}
+
+	//-----------------------------------------------------------
+	// Name: GetSpriteBatch
+	// Desc:  singleton pattern
+	//-----------------------------------------------------------
+	SpriteBatch* SpriteBatch::GetSpriteBatch()
+	{
+		static SpriteBatch* batch = new SpriteBatch();
+		return batch;
+	}
+	
+}; //end Game
@@ -0,0 +1,107 @@
+//---------------------------------------------------
+// Name: Game : SpriteBatch
+// Desc:  sorts and batches a frame's sprite draws
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#ifndef _GAME_SPRITE_BATCH_H_
+#define _GAME_SPRITE_BATCH_H_
+
+#include "Types.h"
+#include "gamex.hpp"
+
+#include <vector>
+
+namespace Game
+{	
+	//-----------------------------------------------------------
+	// Name: SpriteBatch
+	// Desc:  collects sprite draws until Flush, then hands them
+	//		  to GameX by layer inside a GameX batch. within a layer
+	//		  a sprite joins an earlier run of its texture and draw
+	//		  mode only if nothing it overlaps was queued after that
+	//		  run, so runs go to the card as one call but anything
+	//		  overlapping still draws in the order it was queued.
+	//		  atlas views of one page count as one texture.
+	//-----------------------------------------------------------
+	class SpriteBatch
+	{
+	private:
+
+		SpriteBatch();
+
+	public:
+
+		void Draw( ImageX* img, int32_t x, int32_t y, uint32_t layer = 0, DrawFlags mode = DRAW_PLAIN );
+		void Draw( ImageX* img, int32_t x, int32_t y, F32 angle, F32 scale, 
+				   uint32_t layer = 0, DrawFlags mode = DRAW_PLAIN );
+
+		// draws everything queued and empties the queue
+		void Flush();
+
+		// disabled, Draw goes straight to GameX as it used to
+		void SetEnabled( bool enabled );
+		bool IsEnabled() const;
+
+		uint32_t GetNumSprites() const;		// drawn by the last Flush
+		uint32_t GetNumRuns() const;		// texture/mode changes in the last Flush
+
+		// singleton pattern
+		static SpriteBatch* GetSpriteBatch();
+
+	private:
+
+		struct Sprite
+		{
+			ImageX*		mImage;
+			DrawFlags	mMode;
+			uint32_t	mLayer;
+			uint32_t	mRun;
+			int32_t		mX, mY;
+			F32			mAngle, mScale;
+		};
+
+		struct Run
+		{
+			ImageX*		mTexture;
+			DrawFlags	mMode;
+		};
+
+		// the grid that finds what a sprite overlaps. each cell holds
+		// the last run drawn over it. off the grid counts as its edge
+		enum
+		{
+			kCellSize	= 64,
+			kGridWidth	= 16,
+			kGridHeight = 16
+		};
+
+		struct SortLayer
+		{
+			bool operator() ( const Sprite& a, const Sprite& b ) const;
+		};
+
+		struct SortRun
+		{
+			bool operator() ( const Sprite& a, const Sprite& b ) const;
+		};
+
+		void AssignRuns();
+		void Submit( const Sprite& sprite );
+
+	private:
+
+		std::vector<Sprite>		mSprites;
+		std::vector<Run>		mRuns;
+		int32_t					mGrid[ kGridWidth * kGridHeight ];
+		bool					mEnabled;
+		uint32_t				mNumSprites;
+		uint32_t				mNumRuns;
+	};
+
+#define SSpriteBatch (*SpriteBatch::GetSpriteBatch())
+
+}; //end Game
+
+#endif // end _GAME_SPRITE_BATCH_H_
@@ -6,6 +6,10 @@
 //---------------------------------------------------
 
 #include "StateMachine.h"
+#include "ResourceCache.h"
+#include "Util/Profiler.h"
+
+#include <assert.h>
 
 namespace Game
 {
@@ -18,19 +22,17 @@ namespace Game
 
 	StateMachine::~StateMachine()
 	{
-		std::map< std::string, State*>::iterator itr;
-		for( itr = mStates.begin(); itr != mStates.end(); ++itr )
+		for( uint32_t i = 0; i < mStates.size(); ++i )
 		{
-			delete itr->second;
+			delete mStates[i];
 		}
 	}
 
-	bool StateMachine::RequestStateChange( std::string newState )
+	bool StateMachine::RequestStateChange( StateID newState )
 	{  
-		std::map< std::string, State*>::iterator itr;
-		if( ( itr = mStates.find(newState) ) != mStates.end() )
+		if( newState < mStates.size() )
 		{
-			mNextState = itr->second;
+			mNextState = mStates[newState];
 			mStateChange = true;
 		}
 		   
@@ -41,9 +43,16 @@ namespace Game
 		   
 		return mStateChange;
 	}
+
+	bool StateMachine::RequestStateChange( const char* newState )
+	{
+		return RequestStateChange( GetStateID( newState ) );
+	}
 	 
 	void StateMachine::Handle()
 	{
+		PROFILE_ZONE( "StateMachine::Handle" );
+
 		if( mStateChange )
 		{
 			if( mCurState )
@@ -68,15 +77,60 @@ namespace Game
 		}
 	}
 
-	void StateMachine::AddState( std::string name, State* addState )
+	StateMachine::StateID StateMachine::AddState( const char* name, State* addState )
 	{
-		std::map< std::string, State*>::iterator itr;
-		if( (itr = mStates.find(name)) != mStates.end() )
+		if( !name || !addState )
+			return kInvalidState;
+
+		uint32_t hash = ResourceCache::DJBHash( name );
+
+		StateIDMap::iterator itr;
+		if( (itr = mStateIDs.find(hash)) != mStateIDs.end() )
 		{         
-			delete itr->second;
+			StateID id = itr->second;
+
+			// two names hashing the same need one of them renamed
+			if( mNames[id] != name )
+			{
+				assert( false );
+				return kInvalidState;
+			}
+
+			if( mCurState == mStates[id] )
+				mCurState = addState;
+
+			if( mNextState == mStates[id] )
+				mNextState = addState;
+
+			delete mStates[id];
+			mStates[id] = addState;
+			return id;
 		}
 	     
-		mStates[name] = addState;
+		StateID id = (StateID)mStates.size();
+		mStateIDs[hash] = id;
+		mStates.push_back( addState );
+		mNames.push_back( name );
+		return id;
+	}
+
+	StateMachine::StateID StateMachine::GetStateID( const char* name )
+	{
+		if( !name )
+			return kInvalidState;
+
+		StateIDMap::iterator itr;
+		if( (itr = mStateIDs.find( ResourceCache::DJBHash( name ) )) == mStateIDs.end() ||
+			mNames[ itr->second ] != name )
+			return kInvalidState;
+
+		return itr->second;
+	}
+
+	void StateMachine::PreloadState( StateID state )
+	{
+		if( state < mStates.size() )
+			mStates[state]->Preload();
 	}
 
 	StateMachine* StateMachine::GetSM()
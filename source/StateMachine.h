@@ -8,8 +8,11 @@
 #ifndef _GAME_STATE_MACHINE_H_
 #define _GAME_STATE_MACHINE_H_
 
+#include "Types.h"
+
 #include <map>
 #include <string>
+#include <vector>
 
 namespace Game
 {
@@ -23,27 +26,52 @@ namespace Game
 		virtual void Enter() = 0;
 		virtual void Exit() = 0;
 		virtual void Handle() = 0;
+
+		// starts what Enter can do ahead of time, in the background.
+		// called through PreloadState, and may be called again or
+		// not at all before Enter
+		virtual void Preload() {}
 	};
 
 	class StateMachine
 	{
 	public:
+
+		// a registered state. handles index the states directly,
+		// so callers look one up once and change state by it
+		typedef uint32_t StateID;
+
+		static const StateID kInvalidState = 0xffffffff;
 	       
 		StateMachine();
 		~StateMachine();    
 		   
-		bool RequestStateChange( std::string newState );
+		// the change happens on the next Handle. by handle it's a
+		// bounds check and a pointer copy
+		bool RequestStateChange( StateID newState );
+		bool RequestStateChange( const char* newState );
 		void Handle();
 		   
-		void AddState( std::string name, State* addState );
+		// replacing a state keeps its handle
+		StateID AddState( const char* name, State* addState );
+
+		// kInvalidState if there's no state by that name
+		StateID GetStateID( const char* name );
+
+		// lets a state start loading before it's asked for
+		void PreloadState( StateID state );
 		   
 		static StateMachine* GetSM();
 		   
 	private:
 		        
+		typedef std::map< uint32_t, StateID > StateIDMap;
+
 		static StateMachine*       sStateMachine;
 		       
-		std::map< std::string, State* > mStates;
+		StateIDMap						mStateIDs;		// by name hash
+		std::vector< State* >			mStates;		// by handle
+		std::vector< std::string >		mNames;
 		State*                          mNextState;
 		State*                          mCurState;
 		bool                            mStateChange;
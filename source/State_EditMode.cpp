@@ -22,6 +22,7 @@
 #include "EntityFactory.h"
 
 #include "MasterFile.h"
+#include "SpriteBatch.h"
 
 #include <algorithm>
 
@@ -85,7 +86,7 @@ namespace Game
 		GameX.DrawImage( mEditBar, 0, 0 );
 		DrawEntityChooser();		
 
-		// draw entities
+		// draw entities, then their bboxes over the batched sprites
 		
 		EntitySetFile::EntitySetList::iterator entItr;
 		for( entItr = mEntities.begin(); entItr != mEntities.end(); ++entItr )
@@ -93,10 +94,15 @@ namespace Game
 			Entity* ent = entItr->mEntity;
 			ent->Update(mTime);
 			ent->Draw();			
+		}
+
+		SSpriteBatch.Flush();
 
-			if( mDrawBBox )
+		if( mDrawBBox )
+		{
+			for( entItr = mEntities.begin(); entItr != mEntities.end(); ++entItr )
 			{
-				BoundingBoxf* bbox = ent->GetBBox();
+				BoundingBoxf* bbox = entItr->mEntity->GetBBox();
 				if( bbox )
 					bbox->Draw();
 			}
@@ -15,6 +15,11 @@
 #include <string>
 
 #include "Util/Tuner.h"
+#include "Replay.h"
+#include "Util/Profiler.h"
+#include "SpriteBatch.h"
+
+#include <time.h>
 
 namespace Game
 {
@@ -27,22 +32,96 @@ namespace Game
 	State_Game::State_Game()
 	{
 		mCurLevel = 0;
+		mSaveFileLoaded = false;
+
+		mGameState		  = StateMachine::kInvalidState;
+		mStartScreenState = StateMachine::kInvalidState;
+
+		mSpawned	= SMetrics.GetCounter( "EntitiesSpawned" );
+		mRetired	= SMetrics.GetCounter( "EntitiesRetired" );
+		mNumActive	= SMetrics.GetGauge( "ActiveEntities" );
+		mDrawCalls	= SMetrics.GetGauge( "DrawCalls" );
+		mDrawQuads	= SMetrics.GetGauge( "DrawQuads" );
+		mSpriteRuns	= SMetrics.GetGauge( "SpriteRuns" );
+		mTextureSwitches = SMetrics.GetGauge( "TextureSwitches" );
+		mSoundVoices	= SMetrics.GetGauge( "SoundVoices" );
+		mSoundsMerged	= SMetrics.GetGauge( "SoundsMerged" );
+		mSoundsDropped	= SMetrics.GetGauge( "SoundsDropped" );
+
+#if _DEBUG
+		mShowMetrics = true;
+#else
+		mShowMetrics = false;
+#endif
+	}
+
+	// the level Enter will play. a playback plays the recorded one,
+	// and a run through every level starts again from the first
+	uint32_t State_Game::GetEnterLevel()
+	{
+		uint32_t level = SReplay.IsPlaying() ? SReplay.GetLog().mLevel : mCurLevel;
+		return level < kNumLevels ? level : 0;
+	}
+
+	// start reading the level while the state before this one finishes up
+	void State_Game::Preload()
+	{
+		SLevelLoader.Prefetch( kLevels[ GetEnterLevel() ], false );
 	}
 
 	void State_Game::Enter()
 	{
+		// the states this one moves on to, looked up once they're all registered
+		if( mGameState == StateMachine::kInvalidState )
+		{
+			mGameState		  = SMachine.GetStateID( "Game" );
+			mStartScreenState = SMachine.GetStateID( "StartScreen" );
+		}
+
 		mBackground = NULL;	
 		mpMusic		= NULL;
+		mpMusicStream = NULL;
 		mLevelEndTime = -1.0f;		
 
-		// load the save file
-		memset( &mSaveFile, 0, sizeof(GameSaveFile::SaveFile) );
-		GameSaveFile::Import( kSaveFile, mSaveFile );
+		// a playback pins the level, seed and clock to the recording
+		uint32_t seed;
+		F32		 startTime;
+
+		if( SReplay.IsPlaying() )
+		{
+			const ReplayFile::ReplayLog& log = SReplay.GetLog();
+			seed	  = log.mSeed;
+			startTime = log.mStartTime;
+			sTimer.LatchTime( startTime );
+		}
+		else
+		{
+			seed	  = (uint32_t)time(NULL);
+			startTime = sTimer.LatchTime();
+		}
+
+		srand( seed );
+		mCurLevel = GetEnterLevel();
 
-		// load our data
-		LoadEntityDesc();
+		// only this state writes the save file, so after the first
+		// read mSaveFile is what Exit last wrote
+		if( !mSaveFileLoaded )
+		{
+			memset( &mSaveFile, 0, sizeof(GameSaveFile::SaveFile) );
+			GameSaveFile::Import( kSaveFile, mSaveFile );
+			mSaveFileLoaded = true;
+		}
 
-		LoadLevel( kLevels[mCurLevel] );		
+		// a level read in ahead of time only needs swapping in
+		LevelAssets* assets = SLevelLoader.Take( kLevels[mCurLevel] );
+		if( !assets )
+		{
+			assets = new LevelAssets;
+			LevelLoader::Load( kLevels[mCurLevel], false, *assets );
+		}
+
+		LoadLevel( *assets );
+		delete assets;
 
 		// start the arrow generation
 		mEntityGen.StartGen();	
@@ -51,17 +130,49 @@ namespace Game
 		mPlayer.Init(pos);			
 
 		mTimerImg = GetImage( "textures/timer.tga" );  
+
+		SSpriteBatch.SetEnabled( gTuner.GetUint( "kSpriteBatching" ) != 0 );
+		GameX.SetSoundThrottle( gTuner.GetFloat( "kSoundMergeMs" ) / 1000.0f, gTuner.GetInt( "kSoundMaxCopies" ) );
 		sTimer.StartTimer();
+
+		// read the next level while this one plays. its track is
+		// opened on entry, so only this level's stays resident
+		if( mCurLevel + 1 < kNumLevels )
+			SLevelLoader.Prefetch( kLevels[mCurLevel + 1], false );
+
+#if RECORD_REPLAYS
+		if( !SReplay.IsPlaying() )
+		{
+			std::string replayFile = std::string( kLevels[mCurLevel] ) + ".replay";
+			SReplay.BeginRecord( replayFile.c_str(), mCurLevel, seed, startTime );
+		}
+#endif
 	}
 
 	void State_Game::Exit()
 	{
+		// finish off any replay before the level is torn down
+		if( SReplay.IsRecording() )
+		{
+			DumpState( ( SReplay.GetFile() + ".end" ).c_str() );
+			SReplay.EndRecord();
+		}
+
+		if( SReplay.IsPlaying() )
+		{
+			DumpState( ( SReplay.GetFile() + ".playback.end" ).c_str() );
+			SReplay.EndPlayback();
+		}
+
+		sTimer.UnlatchTime();
+
 		mEntityGen.ResetGen();
 		mEntityGen.StopGen();
 		mEntityGen.ClearGen();
 
 		mActiveEntities.clear();
 		DestroyEntityDescMap( &mEntityDescMap );
+		mEntityDescMap.clear();
 
 		// save the player settings
 		if( mCurLevel > mSaveFile.mCompletedLevels )
@@ -79,13 +190,84 @@ namespace Game
 			mpMusic = NULL;
 		}
 
+		if( mpMusicStream )
+		{
+			GameX.StopStream();
+
+			delete mpMusicStream;
+			mpMusicStream = NULL;
+		}
+
 #endif
 	}
 
 	void State_Game::Handle()
+	{
+		PROFILE_ZONE( "State_Game::Handle" );
+
+		uint8_t input;
+		F32		now;
+
+		SLevelLoader.Poll();
+
+		if( SReplay.IsPlaying() )
+		{
+			// ran out of recorded ticks, stop where the recording did
+			if( !SReplay.NextTick( input, now ) )
+			{
+				DumpState( ( SReplay.GetFile() + ".playback.end" ).c_str() );
+				SReplay.EndPlayback();
+				return;
+			}
+
+			sTimer.LatchTime( now );
+		}
+		else
+		{
+			input = PollInput();
+			now   = sTimer.LatchTime();
+			SReplay.RecordTick( input, now );
+		}
+
+		UpdateGame( input );
+
+		// playbacks are headless
+		if( !SReplay.IsPlaying() )
+		{
+			// F3 toggles the metrics overlay
+			if( GameX.GetKeyPress( KEY_F3 ) )
+				mShowMetrics = !mShowMetrics;
+
+			// F4 toggles sprite batching, to compare against drawing each sprite
+			if( GameX.GetKeyPress( KEY_F4 ) )
+				SSpriteBatch.SetEnabled( !SSpriteBatch.IsEnabled() );
+
+			DrawGame();
+		}
+	}
+
+	// sample the keyboard into kInput_* bits
+	uint8_t State_Game::PollInput()
+	{
+		uint8_t input = 0;
+
+		if( GameX.IsKeyDown( KEY_SPACE ) )		input |= kInput_Pause;
+		if( GameX.IsKeyDown( KEY_BACKSPACE ) )	input |= kInput_Back;
+		if( GameX.IsKeyDown( KEY_F5 ) )			input |= kInput_ReloadTuners;
+		if( GameX.IsKeyDown( KEY_UP ) )			input |= kInput_Up;
+		if( GameX.IsKeyDown( KEY_DOWN ) )		input |= kInput_Down;
+		if( GameX.IsKeyDown( KEY_LEFT ) )		input |= kInput_Left;
+		if( GameX.IsKeyDown( KEY_RIGHT ) )		input |= kInput_Right;
+
+		return input;
+	}
+
+	// advance the game one tick. everything that changes game state
+	// lives here so a playback can run it without drawing
+	void State_Game::UpdateGame( uint8_t input )
 	{
 		// handle input
-		if( GameX.IsKeyDown( KEY_SPACE ) )
+		if( input & kInput_Pause )
 		{
 			if( sTimer.IsPaused() )
 				sTimer.UnpauseTimer();
@@ -93,50 +275,55 @@ namespace Game
 				sTimer.PauseTimer();
 		}	
 
-		if( GameX.IsKeyDown( KEY_BACKSPACE ) )
+		if( input & kInput_Back )
 		{
-			SMachine.RequestStateChange( "StartScreen" );
+			SMachine.RequestStateChange( mStartScreenState );
 		}
 
-		//reload tuners
-		if( GameX.IsKeyDown( KEY_F5 ) )
+		//reload tuners, not while a replay has them pinned
+		if( ( input & kInput_ReloadTuners ) && !SReplay.IsRecording() && !SReplay.IsPlaying() )
 		{
 			gTuner.LoadTuners( "tuners.txt" );
 		}
 
-		if( GameX.IsKeyDown( KEY_UP ) )
+		if( input & kInput_Up )
 		{
 			const F32 kInflationRate = gTuner.GetFloat( "kInflationRate" );
 			mPlayer.InflateBalloon( kInflationRate );
 		}
 
-		if( GameX.IsKeyDown( KEY_DOWN ) )
+		if( input & kInput_Down )
 		{
 			const F32 kInflationRate = gTuner.GetFloat( "kInflationRate" );
 			mPlayer.InflateBalloon( -kInflationRate );
 		}
 
-		if( GameX.IsKeyDown( KEY_LEFT ) )
+		if( input & kInput_Left )
 		{
 			const int32_t kMoveAmt = gTuner.GetInt( "kMoveAmt" );
 			mPlayer.MoveByDelta( -kMoveAmt, 0 );
 		}
 
-		if( GameX.IsKeyDown( KEY_RIGHT ) )
+		if( input & kInput_Right )
 		{
 			const int32_t kMoveAmt = gTuner.GetInt( "kMoveAmt" );
 			mPlayer.MoveByDelta( kMoveAmt, 0 );		
 		}
 
 		// update things
-		Entity* newEntity;
-		while( (newEntity = mEntityGen.GenEntity()) != NULL )
 		{
-			// play the generation sound if it exists
-			if( newEntity->GetBaseType() == kEntBase_Arrow )
-				( (Arrow*)newEntity )->PlayGenSound();
+			PROFILE_ZONE( "Spawn" );
+
+			Entity* newEntity;
+			while( (newEntity = mEntityGen.GenEntity()) != NULL )
+			{
+				// play the generation sound if it exists
+				if( newEntity->GetBaseType() == kEntBase_Arrow && !SReplay.IsPlaying() )
+					( (Arrow*)newEntity )->PlayGenSound();
 
-			mActiveEntities.push_back(newEntity);		
+				mActiveEntities.push_back(newEntity);		
+				mSpawned->Add();
+			}
 		}
 		
 		// check for pauses
@@ -148,103 +335,212 @@ namespace Game
 			++mCurLevel;
 			sTimer.ResetAndStopTimer();
 
-			if( mCurLevel > kNumLevels )
-				SMachine.RequestStateChange( "StartScreen" );
+			if( mCurLevel >= kNumLevels )
+				SMachine.RequestStateChange( mStartScreenState );
 			else
-				SMachine.RequestStateChange( "Game" );
+				SMachine.RequestStateChange( mGameState );
 		}
 
+		uint32_t numActive = 0;
+		std::list<Entity*>::iterator itr;	
+
+		{
+			PROFILE_ZONE( "Update" );
+
+			for( itr = mActiveEntities.begin(); itr != mActiveEntities.end(); ++itr )
+			{
+				// TODO : We should probably remove arrows that are not alive...
+				if( !sTimer.IsPaused() && (*itr)->IsActive() )
+				{					
+					(*itr)->Update( sTimer.GetTimeElapsed() );
+
+					if( (*itr)->IsActive() )
+						++numActive;
+					else
+						mRetired->Add();
+
+					// collision is switched off. a "Collision" zone goes
+					// around the tests when they come back
+					//if( mPlayer.Collide( *(*itr)->GetBBox() ) ) 
+					//{
+					//	mPlayer.Pop();
+					//}
+					//	SMachine.RequestStateChange( "StartScreen" );
+				}						
+			}
+		}
+
+		if( !sTimer.IsPaused() )
+			mNumActive->Set( (F32)numActive );
+
+		mPlayer.Update( sTimer.GetTimeElapsed() );
+	}
+
+	// draw the current tick
+	void State_Game::DrawGame()
+	{
+		PROFILE_ZONE( "Draw" );
+
 		GameX.ClearScreen();		
 
 		// draw the background
 		if( mBackground )
 			GameX.DrawImage( mBackground, 0, 0 );
 
-		// draw things
+		// draw things. entities queue into the sprite batch, so the
+		// bounding boxes go in a second pass to stay on top of them
 		std::list<Entity*>::iterator itr;	
 
-		uint32_t yoffset = 50;
-
 		for( itr = mActiveEntities.begin(); itr != mActiveEntities.end(); ++itr )
 		{
-			// update and draw it
-			// TODO : We should probably remove arrows that are not alive...
 			if( !sTimer.IsPaused() && (*itr)->IsActive() )
-			{					
-				(*itr)->Update( sTimer.GetTimeElapsed() );
-				
-				//if( mPlayer.Collide( *(*itr)->GetBBox() ) ) 
-				//{
-				//	mPlayer.Pop();
-				//}
-				//	SMachine.RequestStateChange( "StartScreen" );
-
 				(*itr)->Draw();	
-				
-				if( (*itr)->GetBBox() )
-				{
-					//Draw Bounding Boxes
-					(*itr)->GetBBox()->Draw();
-				
-					//// Draw Debug Status
-					//BoundingBoxf* bbox = (*itr)->GetBBox();
-					//char debugBuffer[256];
+		}
 
-					//sprintf( debugBuffer, "( %i, %i )", (int32_t)bbox->mX, (int32_t)bbox->mY );
-					//GameX.DrawText( 5, yoffset, debugBuffer, 255, 0, 0 );
-					//yoffset += 20;				
-				}
-			}						
+		DrawStress();
+		SSpriteBatch.Flush();
+
+		for( itr = mActiveEntities.begin(); itr != mActiveEntities.end(); ++itr )
+		{
+			if( !sTimer.IsPaused() && (*itr)->IsActive() && (*itr)->GetBBox() )
+				(*itr)->GetBBox()->Draw();
 		}
 
 		// draw the player
-		mPlayer.Update( sTimer.GetTimeElapsed() );
 		mPlayer.Draw();
 
 		// draw the timer
-#if _DEBUG
-		char timer[64];
-		sprintf( timer, "Time: %.3f", sTimer.GetTimeElapsed() );
-		GameX.DrawText( 5, kWindowHeight - 20, timer, 255, 0, 0 );
-
-		sprintf( timer, "Num Active: %i", (int32_t)mActiveEntities.size() );
-		GameX.DrawText( 200, kWindowHeight - 20, timer, 255, 0, 0 );
-#endif
-
 		GameX.DrawImage( mTimerImg, (kWindowWidth - mTimerImg->GetWidth())/2, 10, 
 			             (int32_t)( mTimerImg->GetWidth()  * sTimer.GetTimeElapsed() / mLevelEndTime ), 
 						 mTimerImg->GetHeight() );			
+
+		// GameX counts calls as they reach the card, these are from the last frame shown
+		int quads, calls, textures;
+		GameX.GetDrawStats( quads, calls, textures );
+		mDrawCalls->Set( (F32)calls );
+		mDrawQuads->Set( (F32)quads );
+		mTextureSwitches->Set( (F32)textures );
+		mSpriteRuns->Set( (F32)SSpriteBatch.GetNumRuns() );
+
+		// generation sounds go through GameX's throttle, these are its running totals
+		int voices, merged, dropped;
+		GameX.GetSoundStats( voices, merged, dropped );
+		mSoundVoices->Set( (F32)voices );
+		mSoundsMerged->Set( (F32)merged );
+		mSoundsDropped->Set( (F32)dropped );
+
+		if( mShowMetrics )
+			DrawMetrics();
 	}
 
-	// load the arrow description file
-	bool State_Game::LoadEntityDesc()
+	// draws kDrawStressCount extra sprites to load up the renderer. the
+	// images alternate so unsorted, every draw is a texture switch
+	void State_Game::DrawStress()
 	{
-		PackFile::PackElement packedEntityDesc;
+		const uint32_t kCount = gTuner.GetUint( "kDrawStressCount" );
+		if( !kCount )
+			return;
 
-		if( !SPackFile.GetPackElement( "EntityDescriptions", packedEntityDesc ) )
-			return false;
+		ImageX* images [] = { GetImage( "textures/Ball.tga" ),
+							  GetImage( "textures/FireArrow.tga" ),
+							  GetImage( "textures/IceArrow.tga" ),
+							  GetImage( "textures/GreenArrow.tga" ) };
+		const uint32_t kNumImages = sizeof(images) / sizeof(images[0]);
 
-		if( !EntityDescFile::Import( (uint8_t*)packedEntityDesc.mData, packedEntityDesc.mSize, &mEntityDescMap ) )
-			return false;	
+		const F32 kTime	 = sTimer.GetTimeElapsed();
+		const uint32_t kDrift = (uint32_t)( kTime * 40.0f );
 
-		return true;
+		for( uint32_t i = 0; i < kCount; ++i )
+		{
+			int32_t x = (int32_t)( ( i * 7919 + kDrift ) % kWindowWidth );
+			int32_t y = (int32_t)( ( i * 104729 ) % kWindowHeight );
+			F32 angle = (F32)( ( i * 37 ) % 360 ) + kTime * 90.0f;
+
+			SSpriteBatch.Draw( images[ i % kNumImages ], x, y, angle, 1.0f );
+		}
 	}
 
-	// load a level from the pak file
-	bool State_Game::LoadLevel( const char* levelName )
+	// draw the telemetry overlay from the metrics registry
+	void State_Game::DrawMetrics()
 	{
-		char buffer[512];
-		LevelFile::LevelEntry 		level;
-		EntitySetFile::EntitySetList  arrowSet;
+		const int32_t kLineHeight = 16;
+		int32_t y = kWindowHeight - 20;
+
+		MetricHistogram* frameTime = SMetrics.GetHistogram( "FrameTimeMs" );
+
+		char line[128];
+		sprintf( line, "Time: %.3f  Active: %i  Draws: %i  Textures: %i", sTimer.GetTimeElapsed(),
+				 (int32_t)mNumActive->GetValue(), (int32_t)mDrawCalls->GetValue(),
+				 (int32_t)mTextureSwitches->GetValue() );
+		GameX.DrawText( 5, y, line, 255, 0, 0 );
+		y -= kLineHeight;
+
+		sprintf( line, "Quads: %i  Sprite runs: %i  Batching: %s", (int32_t)mDrawQuads->GetValue(),
+				 (int32_t)mSpriteRuns->GetValue(), SSpriteBatch.IsEnabled() ? "on" : "off" );
+		GameX.DrawText( 5, y, line, 255, 0, 0 );
+		y -= kLineHeight;
+
+		sprintf( line, "Frame p50: %.2f ms  p99: %.2f ms", frameTime->GetPercentile( 0.5f ),
+				 frameTime->GetPercentile( 0.99f ) );
+		GameX.DrawText( 5, y, line, 255, 0, 0 );
+		y -= kLineHeight;
+
+		sprintf( line, "Spawned: %u  Retired: %u  Cache Misses: %u",
+				 mSpawned->GetValue(), mRetired->GetValue(),
+				 SMetrics.GetCounter( "CacheMisses" )->GetValue() );
+		GameX.DrawText( 5, y, line, 255, 0, 0 );
+		y -= kLineHeight;
+
+		sprintf( line, "Sounds: %i  Merged: %i  Dropped: %i", (int32_t)mSoundVoices->GetValue(),
+				 (int32_t)mSoundsMerged->GetValue(), (int32_t)mSoundsDropped->GetValue() );
+		GameX.DrawText( 5, y, line, 255, 0, 0 );
+		y -= kLineHeight;
+
+#if ENABLE_PROFILER
+		sprintf( line, "Profiler overhead: %.2f%%", SProfiler.GetOverheadPercent() );
+		GameX.DrawText( 5, y, line, 255, 0, 0 );
+#endif
+	}
 
-		// get the packed level
-		PackFile::PackElement packedLevel;
-		if( !SPackFile.GetPackElement( levelName, packedLevel ) )
+	// write out the game state so a recording and its playback can be diffed
+	bool State_Game::DumpState( const char* szFile )
+	{
+		FILE* file = fopen( szFile, "w" );
+		if( !file )
 			return false;
 
-		// import the level
-        if( !LevelFile::Import( (uint8_t*)packedLevel.mData, packedLevel.mSize, level ) )
-			return false;
+		fprintf( file, "Level: %u\n", mCurLevel );
+		fprintf( file, "Time: %.6f\n", sTimer.GetTimeElapsed() );
+
+		BoundingBoxf* player = mPlayer.GetBBox();
+		fprintf( file, "Player: %i %.6f %.6f %.6f %.6f\n", (int32_t)mPlayer.GetState(),
+				 player->mX, player->mY, player->mWidth, player->mHeight );
+
+		fprintf( file, "Entities: %u\n", (uint32_t)mActiveEntities.size() );
+
+		std::list<Entity*>::iterator itr;
+		for( itr = mActiveEntities.begin(); itr != mActiveEntities.end(); ++itr )
+		{
+			BoundingBoxf* bbox = (*itr)->GetBBox();
+			fprintf( file, "%u %i", (*itr)->GetBaseType(), (int32_t)(*itr)->IsActive() );
+
+			if( bbox )
+				fprintf( file, " %.6f %.6f %.6f", bbox->mX, bbox->mY, bbox->mRotation );
+
+			fprintf( file, "\n" );
+		}
+
+		fclose( file );
+		return true;
+	}
+
+	// set up a loaded level, the parts of it that need the frame thread
+	bool State_Game::LoadLevel( LevelAssets& assets )
+	{
+		const LevelFile::LevelEntry& level = assets.mLevel;
+
+		// take the entity descriptions, ours were emptied by Exit
+		mEntityDescMap.swap( assets.mEntityDescs );
 
 		// save the length time length
 		mLevelEndTime = level.mTimeLength;
@@ -263,7 +559,25 @@ namespace Game
 
 #if PLAY_MUSIC
 		// load and play the music
-		if( level.mMusic != "" )
+		if( level.mMusic != "" && !SReplay.IsPlaying() )
+		{
+			// a packed track streams through the mixer. a prefetched
+			// level comes without its track, which is opened here
+			mpMusicStream = assets.mpMusicStream;
+			assets.mpMusicStream = NULL;
+
+			if( !mpMusicStream )
+				mpMusicStream = OpenMusic( level.mMusic.c_str() );
+
+			if( mpMusicStream && !GameX.PlayStream( mpMusicStream ) )
+			{
+				delete mpMusicStream;
+				mpMusicStream = NULL;
+			}
+		}
+
+		// anything else is played off disk
+		if( level.mMusic != "" && !SReplay.IsPlaying() && !mpMusicStream )
 		{				
 			mpMusic = new MusicX();
 			if( !mpMusic->Load( (char*)( std::string( "audio/" ) + level.mMusic ).c_str() ) )
@@ -278,22 +592,10 @@ namespace Game
 		}
 #endif
 
-		// clean up the arrow set name		
-		jbsCommon::Algorithm::RemoveFileExtension( buffer, (char*)level.mEntitySet.c_str() );
-
-		// get the packet arrow set
-		PackFile::PackElement packedEntitySet;
-		if( !SPackFile.GetPackElement( buffer, packedEntitySet ) )
-			return false;
-
-		// import the arrow set
-		if( !EntitySetFile::Import( (uint8_t*)packedEntitySet.mData, packedEntitySet.mSize, arrowSet ) )
-			return false;
-
 		// create arrow creation entries to setup EntityGen
-		CreateEntityGen( arrowSet );
+		CreateEntityGen( assets.mEntitySet );
 		
-		return true;
+		return assets.mLoaded;
 	}
 
 	// create the arrow generation events from an arrow set
@@ -14,6 +14,8 @@
 #include "FileIO.h"
 #include "Character.h"
 #include "MasterFile.h"
+#include "LevelLoader.h"
+#include "Util/Metrics.h"
 
 #include <list>
 
@@ -30,13 +32,22 @@ namespace Game
 		void Enter();
 		void Exit();
 		void Handle();
+		void Preload();
 
 	private:
 
-		bool LoadEntityDesc();
-		bool LoadLevel( const char* levelName );
+		uint32_t GetEnterLevel();
+		bool LoadLevel( LevelAssets& assets );
 		bool CreateEntityGen( EntitySetFile::EntitySetList& arrowSet );				
 
+		// a tick is split so replays can feed recorded input and skip drawing
+		uint8_t PollInput();
+		void	UpdateGame( uint8_t input );
+		void	DrawGame();
+		void	DrawStress();
+		void	DrawMetrics();
+		bool	DumpState( const char* szFile );
+
 	private:
 
 		EntityGen					mEntityGen;
@@ -48,12 +59,30 @@ namespace Game
 		ImageX*						mBackground;
 		ImageX*						mTimerImg;
 		MusicX*						mpMusic;
+		MusicStream*				mpMusicStream;
 
 		Character					mPlayer;
 
 		uint32_t					mCurLevel;
 
 		GameSaveFile::SaveFile	    mSaveFile;
+		bool						mSaveFileLoaded;
+
+		StateMachine::StateID		mGameState;
+		StateMachine::StateID		mStartScreenState;
+
+		// telemetry, shared with headless runs through SMetrics
+		MetricCounter*				mSpawned;
+		MetricCounter*				mRetired;
+		MetricGauge*				mNumActive;
+		MetricGauge*				mDrawCalls;
+		MetricGauge*				mDrawQuads;
+		MetricGauge*				mSpriteRuns;
+		MetricGauge*				mTextureSwitches;
+		MetricGauge*				mSoundVoices;
+		MetricGauge*				mSoundsMerged;
+		MetricGauge*				mSoundsDropped;
+		bool						mShowMetrics;
 	};	
 	
 }; //end Game
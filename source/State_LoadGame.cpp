@@ -14,28 +14,94 @@
 #include "GameConstants.h"
 #include "GameXExt.h"
 #include "MasterFile.h"
+#include "Util/Profiler.h"
+#include "Log.h"
+#include "AtlasPacker.h"
+#include "LevelLoader.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
 
 
 
 namespace Game
 {
+	// a texture waiting for a place in the atlas
+	struct AtlasInput
+	{
+		uint32_t	mImgNameHash;
+		uint32_t	mWidth;
+		uint32_t	mHeight;
+	};
+
+	// tall ones first, the skyline packs them tightest
+	static bool TallerFirst( const AtlasInput& a, const AtlasInput& b )
+	{
+		if( a.mHeight != b.mHeight )
+			return a.mHeight > b.mHeight;
+
+		return a.mWidth > b.mWidth;
+	}
+
+	// reads the size of an uncompressed 32-bit targa from its header
+	static bool ReadTGASize( const char* szFile, uint32_t& width, uint32_t& height )
+	{
+		FILE* file = fopen( szFile, "rb" );
+		if( !file )
+			return false;
+
+		uint8_t header[18];
+		bool read = fread( header, sizeof(header), 1, file ) == 1;
+		fclose( file );
+
+		if( !read || header[2] != 2 || header[16] != 32 )
+			return false;
+
+		width  = header[13] * 256 + header[12];
+		height = header[15] * 256 + header[14];
+		return width > 0 && height > 0;
+	}
+
 	void State_LoadGame::Enter()
 	{
+		PROFILE_ZONE( "State_LoadGame::Enter" );
+
 #if COMPILE_FILES
 
+		clock_t buildStart = clock();
+
+		// what the inputs looked like at the last build
+		LoadBuildState();
+
 		// compile the arrow descriptions
 		CompileEntityDesc();			
 		
 		// parse and compile all level files
 		CompileLevelFiles();		
 
-		// now pack all of the level files into 1 file
-		PackFiles();
+		// now pack all of the level files into 1 file. if the pack
+		// isn't written, what changed must look changed next time too
+		if( !PackFiles() )
+			ForgetDirtyInputs();
+
+		SaveBuildState();
+
+		char msg[256];
+		sprintf( msg, "LoadGame: asset build took %.3f s, %u of %u inputs changed",
+				 (F32)( clock() - buildStart ) / CLOCKS_PER_SEC, mNumDirty, mNumInputs );
+		SLog->Print( msg );
 #endif
 
 		// Import our pack file
-		SPackFile.HardClearData();
-		SPackFile.Import( kGamePackFile );
+		{
+			PROFILE_ZONE( "ImportPackFile" );
+			SLevelLoader.Clear();
+			SPackFile.HardClearData();
+			SPackFile.SetStreamed( "MusicPackFile" );
+			SPackFile.SetStreamed( "StreamPackFile" );
+			SPackFile.Import( kGamePackFile );
+		}
 
 		//Clear our resource cache and then refill it
 		ResCache.Flush();
@@ -56,16 +122,173 @@ namespace Game
 		jbsCommon::Algorithm::RemoveFileExtension( cleaned, cleaned1 );
 	}
 
+	//-----------------------------------------------------------
+	// Name: LoadBuildState
+	// Desc:  reads the manifest and previous pack so unchanged
+	//		  inputs can be skipped
+	//-----------------------------------------------------------
+	void State_LoadGame::LoadBuildState()
+	{
+		mPrevManifest.clear();
+		mManifest.clear();
+		mPrevPack.clear();
+		mDirtyInputs.clear();
+		mNumInputs = 0;
+		mNumDirty  = 0;
+		mPackDirty = false;
+		mPackFailed = false;
+
+		// without the old pack nothing can be reused, so start clean
+		if( !PackFile::ImportIndex( kGamePackFile, mPrevPack ) )
+		{
+			mPrevPack.clear();
+			return;
+		}
+
+		if( !ManifestFile::Import( kManifestFile, mPrevManifest ) )
+			SLog->Print( "LoadGame: no usable build manifest, rebuilding everything" );
+	}
+
+	//-----------------------------------------------------------
+	// Name: SaveBuildState
+	// Desc:  writes the new manifest
+	//-----------------------------------------------------------
+	void State_LoadGame::SaveBuildState()
+	{
+		ManifestFile::Export( kManifestFile, mManifest );
+
+		mPrevPack.clear();
+		mPrevManifest.clear();
+		mDirtyInputs.clear();
+	}
+
+	//-----------------------------------------------------------
+	// Name: ForgetInput
+	// Desc:  leaves an input out of the new manifest, so the next
+	//		  build sees it as new. for inputs that failed to build
+	//-----------------------------------------------------------
+	void State_LoadGame::ForgetInput( const char* szFile )
+	{
+		mManifest.erase( szFile );
+	}
+
+	//-----------------------------------------------------------
+	// Name: ForgetDirtyInputs
+	// Desc:  the old pack is kept when the new one can't be
+	//		  written, so only the unchanged inputs still match it
+	//-----------------------------------------------------------
+	void State_LoadGame::ForgetDirtyInputs()
+	{
+		for( uint32_t i = 0; i < mDirtyInputs.size(); ++i )
+			ForgetInput( mDirtyInputs[i].c_str() );
+
+		mDirtyInputs.clear();
+	}
+
+	//-----------------------------------------------------------
+	// Name: IsInputDirty
+	// Desc:  records the input in the new manifest and returns
+	//		  whether it changed since the last build. matching
+	//		  size and write time are trusted, otherwise the
+	//		  content hash decides
+	//-----------------------------------------------------------
+	bool State_LoadGame::IsInputDirty( const char* szFile )
+	{
+		ManifestFile::ManifestEntry entry;
+		if( !jbsCommon::Algorithm::GetFileStats( szFile, entry.mSize, entry.mTimeLow, entry.mTimeHigh ) )
+			return true;
+
+		++mNumInputs;
+
+		ManifestFile::ManifestMap::iterator itr = mPrevManifest.find( szFile );
+		bool known = ( itr != mPrevManifest.end() );
+
+		if( known && itr->second.mSize	  == entry.mSize &&
+					 itr->second.mTimeLow  == entry.mTimeLow &&
+					 itr->second.mTimeHigh == entry.mTimeHigh )
+		{
+			mManifest[ szFile ] = itr->second;
+			return false;
+		}
+
+		// touched or new, hash the contents
+		uint8_t* buffer = NULL;
+		uint32_t size = jbsCommon::Algorithm::ReadFileIntoBuffer( szFile, buffer );
+		entry.mHash = jbsCommon::Algorithm::HashBuffer( buffer, size );
+		delete [] buffer;
+
+		mManifest[ szFile ] = entry;
+
+		if( known && itr->second.mSize == entry.mSize && itr->second.mHash == entry.mHash )
+			return false;
+
+		mDirtyInputs.push_back( szFile );
+		++mNumDirty;
+		return true;
+	}
+
+	//-----------------------------------------------------------
+	// Name: FindPrevElement
+	// Desc:  finds where an element sits in the previous pack
+	//-----------------------------------------------------------
+	bool State_LoadGame::FindPrevElement( uint32_t signature, PackSource& source )
+	{
+		PackSourceList::iterator itr;
+		for( itr = mPrevPack.begin(); itr != mPrevPack.end(); ++itr )
+		{
+			if( itr->mSignature == signature )
+			{
+				source = *itr;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//-----------------------------------------------------------
+	// Name: PackInput
+	// Desc:  packs a file, reusing the previous pack's copy when
+	//		  the file has not changed
+	//-----------------------------------------------------------
+	PackSource State_LoadGame::PackInput( const char* szFile, const char* signature )
+	{
+		PackSource source;
+		uint32_t sigHash = ResourceCache::DJBHash( signature );
+
+		if( !IsInputDirty( szFile ) && FindPrevElement( sigHash, source ) )
+			return source;
+
+		uint32_t timeLow, timeHigh;
+		source = PackSource( sigHash, szFile, 0 );
+		jbsCommon::Algorithm::GetFileStats( szFile, source.mSize, timeLow, timeHigh );
+
+		mPackDirty = true;
+		return source;
+	}
+
 	void State_LoadGame::CompileEntityDesc()
 	{
+		PROFILE_ZONE( "CompileEntityDesc" );
+
+		if( !IsInputDirty( "EntityDescriptions.txt" ) && 
+			jbsCommon::Algorithm::FileExists( "EntityDescriptions.bin" ) )
+			return;
+
 		// load all arrow descriptions and export them to binary format		
 		EntityDescMap map;
-		if( EntityDescFile::Parse( "EntityDescriptions.txt", &map ) )
-			EntityDescFile::Export( "EntityDescriptions.bin", &map );	
+		if( !EntityDescFile::Parse( "EntityDescriptions.txt", &map ) ||
+			!EntityDescFile::Export( "EntityDescriptions.bin", &map ) )
+		{
+			ForgetInput( "EntityDescriptions.txt" );
+			SLog->Print( "LoadGame: failed to compile EntityDescriptions.txt" );
+		}
 	}
 
 	void State_LoadGame::CompileLevelFiles()
 	{
+		PROFILE_ZONE( "CompileLevelFiles" );
+
 		std::vector< std::string > levelFiles;		
 		jbsCommon::Algorithm::EnumerateTypedFilesInFolder( ".", ".raw_level", levelFiles );
 		
@@ -74,24 +297,41 @@ namespace Game
 
 		for( itr = levelFiles.begin(); itr != levelFiles.end(); ++itr )
 		{
+			jbsCommon::Algorithm::RemoveFileExtension( buffer, (char*)itr->c_str() );
+			std::string newName = std::string(buffer) + std::string( ".bin_level" );
+
+			if( !IsInputDirty( itr->c_str() ) && 
+				jbsCommon::Algorithm::FileExists( (char*)newName.c_str() ) )
+				continue;
+
 			LevelFile::LevelEntry entry;
-			if( LevelFile::Parse( itr->c_str(), entry ) )
-			{				
-				jbsCommon::Algorithm::RemoveFileExtension( buffer, (char*)itr->c_str() );
-				std::string newName = std::string(buffer) + std::string( ".bin_level" );
-				
-				LevelFile::Export( newName.c_str(), entry );
+			if( !LevelFile::Parse( itr->c_str(), entry ) ||
+				!LevelFile::Export( newName.c_str(), entry ) )
+			{
+				ForgetInput( itr->c_str() );
+
+				std::string msg = "LoadGame: failed to compile " + *itr;
+				SLog->Print( msg.c_str() );
 			}
 		}
 	}
 
-	void State_LoadGame::PackFiles()
+	//-----------------------------------------------------------
+	// Name: PackFiles
+	// Desc:  false if the pack couldn't be written, in which case
+	//		  the previous one is left in place
+	//-----------------------------------------------------------
+	bool State_LoadGame::PackFiles()
 	{
+		PROFILE_ZONE( "PackFiles" );
+
+		PackWriter writer;
+
 		// Pack all of the level files into the pack file
 		std::vector< std::string > levelFiles;		
 		jbsCommon::Algorithm::EnumerateTypedFilesInFolder( ".", ".bin_level", levelFiles );
 
-		PackFile::PackElementList packList;
+		PackSourceList packList;
 
 		std::vector< std::string >::iterator itr;
 		for( itr = levelFiles.begin(); itr != levelFiles.end(); ++itr )
@@ -103,32 +343,13 @@ namespace Game
 				EntitySetFile::EntitySetList arrowSetList;
 				if( EntitySetFile::Import( entry.mEntitySet.c_str(), arrowSetList ) )
 				{
-					PackFile::PackElement packEntitySet;	
-
-					uint8_t* buffer;
-					uint32_t bufferSize;
-
-					bufferSize = jbsCommon::Algorithm::ReadFileIntoBuffer( entry.mEntitySet.c_str(), buffer );
-
 					char cleanName[512];
 
 					CleanFilename( cleanName, (char*)entry.mEntitySet.c_str() );					
-
-					packEntitySet.mVersion = 1;
-					packEntitySet.mSignature = ResourceCache::DJBHash( cleanName );
-					packEntitySet.mSize = bufferSize;
-					packEntitySet.mData = buffer;
-
-					PackFile::PackElement packLevel;					
-
-					bufferSize = jbsCommon::Algorithm::ReadFileIntoBuffer( itr->c_str(), buffer );
+					PackSource packEntitySet = PackInput( entry.mEntitySet.c_str(), cleanName );
 
 					CleanFilename( cleanName, (char*)itr->c_str() );					
-
-					packLevel.mVersion   = 1;
-					packLevel.mSignature = ResourceCache::DJBHash( cleanName );
-					packLevel.mSize      = bufferSize;
-					packLevel.mData      = buffer;
+					PackSource packLevel = PackInput( itr->c_str(), cleanName );
 
 					//push the pack elements
 					packList.push_back( packEntitySet );
@@ -138,55 +359,183 @@ namespace Game
 		}
 
 		// Pack the arrow description file into the pack file
-		{
-			uint8_t* pBuffer = NULL;
-			uint32_t bufferSize = jbsCommon::Algorithm::ReadFileIntoBuffer( "EntityDescriptions.bin", pBuffer );
-
-			PackFile::PackElement packEntityDesc;
-			packEntityDesc.mSignature = ResourceCache::DJBHash( "EntityDescriptions" );
-			packEntityDesc.mVersion	 = 1;
-			packEntityDesc.mSize      = bufferSize;
-			packEntityDesc.mData      = pBuffer;
-			
-			packList.push_back( packEntityDesc );
-		}
+		packList.push_back( PackInput( "EntityDescriptions.bin", "EntityDescriptions" ) );
+
+		// Pack images, and the atlas layout they are loaded into
+		bool packDirty = mPackDirty;
+		mPackDirty = false;
 
-		// Pack images
-		PackFile::PackElement packImages = PackDirectory( "textures", "ImagePackFile.pak" );
-		packList.push_back( packImages );
+		packList.push_back( PackImages( writer ) );
+		packList.push_back( PackAtlas( "textures", mPackDirty ) );
+
+		mPackDirty = mPackDirty || packDirty;
 
 		// Pack audio
-		PackFile::PackElement packMusic = PackDirectory( "audio", "MusicPackFile.pak", ".mp3" );
-		PackFile::PackElement packSound = PackDirectory( "audio", "SoundPackFile.pak", ".wav" );
-		packList.push_back( packMusic );	
-		packList.push_back( packSound );
+		packList.push_back( PackDirectory( writer, "audio", "MusicPackFile.pak", ".mp3" ) );
+		packList.push_back( PackDirectory( writer, "audio", "SoundPackFile.pak", ".wav" ) );
+		packList.push_back( PackDirectory( writer, "music", "StreamPackFile.pak", ".wav" ) );
 
-		// export pack file
-		PackFile::Export( "gameData.pack", packList );
+		// an inner pack that failed would be packed stale or short,
+		// so the old pack is kept instead
+		bool packed = !mPackFailed;
 
-		// go back and delete all the buffers we allocated
-		PackFile::PackElementList::iterator packItr;
-		for( packItr = packList.begin(); packItr != packList.end(); ++packItr )
+		if( mPackFailed )
 		{
-			if( packItr->mData )
-				delete [] packItr->mData;
+			SLog->Print( "LoadGame: keeping the old pack file" );
 		}
+
+		// export pack file, unless every element came back unchanged
+		else if( mPackDirty || packList.size() != mPrevPack.size() )
+		{
+			// unchanged elements are copied out of the old pack, so
+			// the new one is written beside it and swapped in after
+			std::string tempFile = std::string( kGamePackFile ) + ".tmp";
+
+			if( !PackFile::Export( tempFile.c_str(), packList, writer ) )
+			{
+				remove( tempFile.c_str() );
+				SLog->Print( "LoadGame: failed to write the pack file" );
+				packed = false;
+			}
+
+			// a pack that can't be swapped in is as good as unwritten.
+			// with no old pack left either, the next build starts clean
+			else if( ( remove( kGamePackFile ) != 0 && jbsCommon::Algorithm::FileExists( (char*)kGamePackFile ) ) ||
+					 rename( tempFile.c_str(), kGamePackFile ) != 0 )
+			{
+				remove( tempFile.c_str() );
+				SLog->Print( "LoadGame: failed to swap in the pack file" );
+				packed = false;
+			}
+		}
+
+		char msg[256];
+		sprintf( msg, "LoadGame: packed %.1f KB on %d threads, peak read-ahead %.1f KB",
+				 writer.GetBytesWritten() / 1024.0f, writer.GetNumThreads(),
+				 writer.GetPeakMemory() / 1024.0f );
+		SLog->Print( msg );
+
+		return packed;
 	}
 
-	PackFile::PackElement State_LoadGame::PackImages()
+	PackSource State_LoadGame::PackImages( PackWriter& writer )
 	{
-		return PackDirectory( "textures", "ImagePackFile.pak" );
+		return PackDirectory( writer, "textures", "ImagePackFile.pak" );
 	}
 
-	PackFile::PackElement State_LoadGame::PackAudio()
+	//-----------------------------------------------------------
+	// Name: PackAtlas
+	// Desc:  lays the small textures of dir out on atlas pages.
+	//		  only the layout is packed; AddPackedImagesToCache
+	//		  fills the pages as it decodes the images
+	//-----------------------------------------------------------
+	PackSource State_LoadGame::PackAtlas( const char* dir, bool imagesChanged )
 	{
-		return PackDirectory( "audio", "AudioPackFile.pak" );
+		const char* packName = "AtlasPackFile.pak";
+
+		char cleanName[512];
+		jbsCommon::Algorithm::CleanFilePath( cleanName, (char*)packName );
+		uint32_t sigHash = ResCache.DJBHash( cleanName );
+
+		// the layout only depends on the images
+		PackSource prevElem;
+		if( !imagesChanged && FindPrevElement( sigHash, prevElem ) )
+			return prevElem;
+
+		mPackDirty = true;
+
+		std::vector< std::string > files;
+		jbsCommon::Algorithm::EnumerateTypedFilesInFolder( dir, ".tga", files );
+
+		std::vector< AtlasInput > inputs;
+		for( uint32_t i = 0; i < files.size(); ++i )
+		{
+			AtlasInput input;
+			if( !ReadTGASize( files[i].c_str(), input.mWidth, input.mHeight ) )
+				continue;
+
+			if( input.mWidth > kAtlasMaxImageSize || input.mHeight > kAtlasMaxImageSize )
+				continue;
+
+			char cleaned[512];
+			jbsCommon::Algorithm::CleanFilePath( cleaned, (char*)files[i].c_str() );
+			input.mImgNameHash = ResCache.DJBHash( cleaned );
+
+			inputs.push_back( input );
+		}
+
+		std::sort( inputs.begin(), inputs.end(), TallerFirst );
+
+		// first page with room, or a new one
+		std::vector< AtlasPacker > pages;
+		AtlasFile::AtlasLayout layout;
+		layout.mPageWidth  = kAtlasPageSize;
+		layout.mPageHeight = kAtlasPageSize;
+
+		std::vector< AtlasInput >::iterator itr;
+		for( itr = inputs.begin(); itr != inputs.end(); ++itr )
+		{
+			AtlasFile::AtlasEntry entry;
+			entry.mImgNameHash = itr->mImgNameHash;
+			entry.mWidth	   = itr->mWidth;
+			entry.mHeight	   = itr->mHeight;
+
+			uint32_t numPages = (uint32_t)pages.size();
+			for( entry.mPage = 0; entry.mPage < numPages; ++entry.mPage )
+			{
+				if( pages[entry.mPage].Insert( itr->mWidth, itr->mHeight, entry.mX, entry.mY ) )
+					break;
+			}
+
+			if( entry.mPage == numPages )
+			{
+				pages.push_back( AtlasPacker( kAtlasPageSize, kAtlasPageSize, kAtlasPadding ) );
+				if( !pages.back().Insert( itr->mWidth, itr->mHeight, entry.mX, entry.mY ) )
+					continue;
+			}
+
+			layout.mEntries.push_back( entry );
+		}
+
+		layout.mNumPages = (uint32_t)pages.size();
+
+		F32 occupancy = 0.0f;
+		for( uint32_t i = 0; i < pages.size(); ++i )
+			occupancy += pages[i].GetOccupancy() / pages.size();
+
+		char msg[256];
+		sprintf( msg, "LoadGame: atlas holds %u of %u textures on %u pages, %.0f%% full",
+				 (uint32_t)layout.mEntries.size(), (uint32_t)files.size(), layout.mNumPages, occupancy * 100.0f );
+		SLog->Print( msg );
+
+		if( !AtlasFile::Export( packName, layout ) )
+		{
+			SLog->Print( "LoadGame: failed to write AtlasPackFile.pak" );
+			mPackFailed = true;
+		}
+
+		PackSource packElem( sigHash, packName, 0 );
+
+		uint32_t timeLow, timeHigh;
+		jbsCommon::Algorithm::GetFileStats( packName, packElem.mSize, timeLow, timeHigh );
+
+		return packElem;
+	}
+
+	PackSource State_LoadGame::PackAudio( PackWriter& writer )
+	{
+		return PackDirectory( writer, "audio", "AudioPackFile.pak" );
 	}
 
-	PackFile::PackElement State_LoadGame::PackDirectory( const char* dir, 
-														 const char* packName,
-														 char* ext )
+	PackSource State_LoadGame::PackDirectory( PackWriter& writer,
+											  const char* dir, 
+											  const char* packName,
+											  char* ext )
 	{
+		char cleanName[512];
+		jbsCommon::Algorithm::CleanFilePath( cleanName, (char*)packName );
+		uint32_t sigHash = ResCache.DJBHash( cleanName );
+
 		//Step1: Write all files to a single file
 
 		// enumerate all the files in the folder
@@ -200,57 +549,82 @@ namespace Game
 			jbsCommon::Algorithm::EnumerateFilesInFolder( dir, files );
 		}
 
-		ImageFile::ImageEntryList entryList;
+		// find out what changed
+		std::vector< bool > dirty( files.size(), true );
+		bool anyDirty = false;
 
-		// re-use the image entry list code
-		std::vector< std::string >::iterator itr;
-		for( itr = files.begin(); itr != files.end(); ++itr )
+		for( uint32_t i = 0; i < files.size(); ++i )
 		{
-			if( jbsCommon::Algorithm::FileExists( (char*)itr->c_str() ) )
-			{
-				uint8_t* buffer;
-				uint32_t bufferSize = jbsCommon::Algorithm::ReadFileIntoBuffer( itr->c_str(), buffer );
-				if( bufferSize > 0 )
-				{
-					// clean up the name
-					char cleaned[512];
-					jbsCommon::Algorithm::CleanFilePath( cleaned, (char*)itr->c_str() );					
+			dirty[i] = IsInputDirty( files[i].c_str() );
+			anyDirty = anyDirty || dirty[i];
+		}
+
+		// the previous copy of this pack holds the unchanged files
+		PackSource prevElem;
+		PackSourceList prevEntries;
 
-					ImageFile::ImageEntry entry;
-					entry.mImgNameHash = ResCache.DJBHash( cleaned );
-					entry.mpData = buffer;
-					entry.mSize = bufferSize;
+		if( FindPrevElement( sigHash, prevElem ) )
+		{
+			ImageFile::ImportIndex( prevElem.mFile.c_str(), prevElem.mOffset, prevEntries );
+
+			// nothing added, removed or changed, reuse it whole
+			if( !anyDirty && prevEntries.size() == files.size() )
+				return prevElem;
+		}
+
+		mPackDirty = true;
+
+		PackSourceList entryList;
 
-					entryList.push_back(entry);
+		for( uint32_t i = 0; i < files.size(); ++i )
+		{
+			const char* file = files[i].c_str();
+
+			// clean up the name
+			char cleaned[512];
+			jbsCommon::Algorithm::CleanFilePath( cleaned, (char*)file );					
+
+			PackSource entry( ResCache.DJBHash( cleaned ), file, 0 );
+			bool found = false;
+
+			// take unchanged files from the previous pack
+			if( !dirty[i] )
+			{
+				PackSourceList::iterator prevItr;
+				for( prevItr = prevEntries.begin(); prevItr != prevEntries.end(); ++prevItr )
+				{
+					if( prevItr->mSignature == entry.mSignature )
+					{
+						entry = *prevItr;
+						found = true;
+						break;
+					}
 				}
 			}
+
+			if( !found )
+			{
+				uint32_t timeLow, timeHigh;
+				jbsCommon::Algorithm::GetFileStats( file, entry.mSize, timeLow, timeHigh );
+			}
+
+			if( entry.mSize > 0 )
+				entryList.push_back(entry);
 		}
 
 		// export image list		
-		ImageFile::Export( packName, entryList );
-
-		// free all the allocated memory
-		ImageFile::ImageEntryList::iterator ieItr;
-		for( ieItr = entryList.begin(); ieItr != entryList.end(); ++ieItr )
+		if( !ImageFile::Export( packName, entryList, writer ) )
 		{
-			if( ieItr->mpData )
-				delete [] ieItr->mpData;
+			std::string msg = std::string( "LoadGame: failed to write " ) + packName;
+			SLog->Print( msg.c_str() );
+			mPackFailed = true;
 		}
 
+		// Step 2: the outer pack copies this image pack file from disk
+		PackSource packElem( sigHash, packName, 0 );
 
-		// Step 2: pack this image pack file
-
-		uint8_t* pImageBuffer;
-		uint32_t imageBufferSize = jbsCommon::Algorithm::ReadFileIntoBuffer( packName, pImageBuffer );
-        
-		char cleanName[512];
-		jbsCommon::Algorithm::CleanFilePath( cleanName, (char*)packName );
-
-		PackFile::PackElement packElem;
-		packElem.mSignature = ResCache.DJBHash( cleanName );
-		packElem.mVersion	= 1;
-		packElem.mData      = pImageBuffer;
-		packElem.mSize      = imageBufferSize;
+		uint32_t timeLow, timeHigh;
+		jbsCommon::Algorithm::GetFileStats( packName, packElem.mSize, timeLow, timeHigh );
 
 		return packElem;
 	}	
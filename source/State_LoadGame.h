@@ -27,11 +27,38 @@ namespace Game
 
 		void CompileEntityDesc();
 		void CompileLevelFiles();
-		void PackFiles();
+		bool PackFiles();
 
-		PackFile::PackElement PackDirectory( const char* dir, const char* packName, char* ext = NULL );
-		PackFile::PackElement PackImages();
-		PackFile::PackElement PackAudio();
+		// packs are streamed from their sources by a PackWriter, so
+		// only the read-ahead window is ever held in memory
+		PackSource PackDirectory( PackWriter& writer, const char* dir, const char* packName, char* ext = NULL );
+		PackSource PackImages( PackWriter& writer );
+		PackSource PackAtlas( const char* dir, bool imagesChanged );
+		PackSource PackAudio( PackWriter& writer );
+
+		// incremental builds: inputs whose size, write time or hash match
+		// the manifest are not recompiled, and their pack elements are
+		// copied from the previous pack file
+		void LoadBuildState();
+		void SaveBuildState();
+		bool IsInputDirty( const char* szFile );
+		void ForgetInput( const char* szFile );
+		void ForgetDirtyInputs();
+		bool FindPrevElement( uint32_t signature, PackSource& source );
+
+		PackSource PackInput( const char* szFile, const char* signature );
+
+	private:
+
+		ManifestFile::ManifestMap	mPrevManifest;
+		ManifestFile::ManifestMap	mManifest;
+		PackSourceList				mPrevPack;		// the old pack's element table
+		std::vector< std::string >	mDirtyInputs;	// forgotten if the build fails
+
+		uint32_t					mNumInputs;
+		uint32_t					mNumDirty;
+		bool						mPackDirty;		// must the pack be rewritten?
+		bool						mPackFailed;	// an inner pack couldn't be written
 	};
 	
 }; //end Game
@@ -11,6 +11,8 @@
 #include "GameConstants.h"
 #include "Gui.h"
 #include "Action.h"
+#include "Util/Tuner.h"
+#include "Util/Profiler.h"
 
 namespace Game
 {
@@ -108,18 +110,39 @@ namespace Game
 		gc->AddChild(ct);
 		gc->AddChild(qt);
 
+		// stress elements go under the menu, so it still draws on top
+		ImageX* stressImages [] = { start, edit, options, cont, quit };
+		AddStressGui( mainContainer, stressImages, sizeof(stressImages) / sizeof(stressImages[0]) );
+
 		mainContainer->AddChild(gc);
 		mainContainer->AddChild(options_container);
 
 		mGui = mainContainer;
 
+		mGuiLayer.SetRoot( mGui );
+		mRetained = gTuner.GetUint( "kGuiRetained" ) != 0;
+		mMouse	  = jbsCommon::Vec2i( -1, -1 );
+
+#if _DEBUG
+		mShowBounds  = true;
+		mShowMetrics = true;
+#else
+		mShowBounds  = false;
+		mShowMetrics = false;
+#endif
+
 		// load save file to see how many levels have been completed
 		memset( &mSaveFile, 0, sizeof(GameSaveFile::SaveFile) );
 		GameSaveFile::Import( kSaveFile, mSaveFile );
+
+		// start is the likely pick, so the game gets to load its level
+		// while the menu is up
+		SMachine.PreloadState( SMachine.GetStateID( "Game" ) );
 	}
 
 	void State_StartScreen::Exit()
 	{	
+		mGuiLayer.SetRoot( NULL );
 		delete mGui;
 	}
 
@@ -130,27 +153,123 @@ namespace Game
 
 		//get input
 		const bool kLMouseClicked = GameX.GetMouseClick( MOUSE_LEFT );
+		const jbsCommon::Vec2i kMouse( GameX.GetMouseX(), GameX.GetMouseY() );
+		const bool kMouseMoved = kMouse.x != mMouse.x || kMouse.y != mMouse.y;
+
+		mMouse = kMouse;
+
+		// F4 switches between the retained layer and walking the tree
+		if( GameX.GetKeyPress( KEY_F4 ) )
+			mRetained = !mRetained;
+
+		// F2 toggles the element bounds
+		if( GameX.GetKeyPress( KEY_F2 ) )
+			mShowBounds = !mShowBounds;
+
+		// F3 toggles the metrics overlay, as in the game
+		if( GameX.GetKeyPress( KEY_F3 ) )
+			mShowMetrics = !mShowMetrics;
 
-		if( kLMouseClicked )
 		{
-			const int32_t x = GameX.GetMouseX();
-			const int32_t y = GameX.GetMouseY();
+			PROFILE_ZONE( "GuiInput" );
 
-			jbsCommon::Vec2i pos( x, y );
+			if( mRetained )
+			{
+				if( kMouseMoved )
+					mGuiLayer.OnMouseMove( kMouse );
 
-			mGui->OnClick(pos);
+				if( kLMouseClicked )
+					mGuiLayer.OnClick( kMouse );
+			}
+			else
+			{
+				if( kMouseMoved )
+				{
+					mGui->OnMouseOut( kMouse );
+					mGui->OnMouseOver( kMouse );
+				}
+
+				if( kLMouseClicked )
+					mGui->OnClick( kMouse );
+			}
 		}
 
 		GameX.ClearScreen();
 
 		// draw gui
-		mGui->Draw();
-		mGui->DrawBounds();
+		{
+			PROFILE_ZONE( "GuiDraw" );
+
+			if( mRetained )
+				mGuiLayer.Draw();
+			else
+				mGui->Draw();
+		}
+
+		if( mShowBounds )
+			mGui->DrawBounds();
 
 		// draw text
 		char buffer[256];
 		sprintf( buffer, "Levels Completed: %i", (int32_t)mSaveFile.mCompletedLevels );
 		GameX.DrawText( 20, 20, buffer, 255, 0, 0 );
+
+		if( mShowMetrics )
+			DrawMetrics();
+	}
+
+	// kGuiStressCount buttons scattered over the screen, to load
+	// the gui up. each shows the next image while the mouse is over
+	// it, so moving the mouse keeps changing a few of them
+	void State_StartScreen::AddStressGui( GuiContainer* parent, ImageX** images, uint32_t numImages )
+	{
+		const uint32_t kCount = gTuner.GetUint( "kGuiStressCount" );
+		if( !kCount )
+			return;
+
+		GuiContainer* stress = new GuiContainer;
+		stress->SetPosition( jbsCommon::Vec2i( 0, 0 ) );
+		stress->SetExtent( jbsCommon::Vec2i( kWindowWidth, kWindowHeight ) );
+		stress->SetVisible( true );
+
+		for( uint32_t i = 0; i < kCount; ++i )
+		{
+			ImageX* img  = images[ i % numImages ];
+			ImageX* over = images[ ( i + 1 ) % numImages ];
+
+			GuiButtonControl* button = new GuiButtonControl;
+			button->SetImages( img, img, over );
+			button->SetExtentFromImages();
+			button->SetVisible( true );
+
+			jbsCommon::Vec2i ext = button->GetExtent();
+			int32_t x = (int32_t)( ( i * 7919 ) % ( kWindowWidth  - ext.x ) );
+			int32_t y = (int32_t)( ( i * 104729 ) % ( kWindowHeight - ext.y ) );
+			button->SetPosition( jbsCommon::Vec2i( x, y ) );
+
+			stress->AddChild( button );
+		}
+
+		parent->AddChild( stress );
+	}
+
+	// frame times to compare the two ways of drawing the gui
+	void State_StartScreen::DrawMetrics()
+	{
+		MetricHistogram* frameTime = SMetrics.GetHistogram( "FrameTimeMs" );
+
+		char line[256];
+		sprintf( line, "Gui: %s (F4)  Elements: %u  Frame p50: %.2f ms  p99: %.2f ms",
+				 mRetained ? "retained" : "immediate", mGuiLayer.GetNumElements(),
+				 frameTime->GetPercentile( 0.5f ), frameTime->GetPercentile( 0.99f ) );
+		GameX.DrawText( 20, kWindowHeight - 40, line, 255, 0, 0 );
+
+		// the layer only redraws what changed, the tree draws it all
+		if( mRetained )
+		{
+			sprintf( line, "Layer redrawn: %u px", mGuiLayer.GetDirtyPixels() );
+			GameX.DrawText( 20, kWindowHeight - 20, line, 255, 0, 0 );
+		}
 	}
 
 }; // end Game
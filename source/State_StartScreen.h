@@ -14,6 +14,7 @@
 #include "MasterFile.h"
 #include "FileIO.h"
 #include "Gui.h"
+#include "Util/Metrics.h"
 namespace Game
 {
 	class State_StartScreen : public State
@@ -39,11 +40,23 @@ namespace Game
 
 
 
+	private:
+
+		void AddStressGui( GuiContainer* parent, ImageX** images, uint32_t numImages );
+		void DrawMetrics();
+
 	private:
 		
 		GuiElement*			mGui;
 		GameSaveFile::SaveFile mSaveFile;
 
+		// the gui is drawn from a retained layer, or walked each frame
+		GuiLayer			mGuiLayer;
+		bool				mRetained;
+		bool				mShowBounds;
+		bool				mShowMetrics;
+		jbsCommon::Vec2i	mMouse;
+
 	};	
 	
 }; //end Game
@@ -20,6 +20,8 @@ namespace Game
 					, mAccumPauseTime(0)
 					, mPauseStartTime(0)
 					, mUnpauseTime(0)
+					, mLatched(false)
+					, mLatchedTime(0)
 	{}
 
 	//-----------------------------------------------------------
@@ -110,6 +112,36 @@ namespace Game
 		}
 	}
 
+	//-----------------------------------------------------------
+	// Name: LatchTime
+	// Desc:  samples the clock and freezes it at that value
+	//-----------------------------------------------------------
+	F32 Timer::LatchTime()
+	{
+		mLatched = false;
+		LatchTime( GetCurTime() );
+		return mLatchedTime;
+	}
+
+	//-----------------------------------------------------------
+	// Name: LatchTime
+	// Desc:  freezes the clock at a given value
+	//-----------------------------------------------------------
+	void Timer::LatchTime( F32 time )
+	{
+		mLatchedTime = time;
+		mLatched     = true;
+	}
+
+	//-----------------------------------------------------------
+	// Name: UnlatchTime
+	// Desc:  lets the clock run freely again
+	//-----------------------------------------------------------
+	void Timer::UnlatchTime()
+	{
+		mLatched = false;
+	}
+
 	//-----------------------------------------------------------
 	// Name: GetTimer
 	// Desc:  singleton pattern
@@ -126,6 +158,9 @@ namespace Game
 	//-----------------------------------------------------------
 	F32 Timer::GetCurTime()
 	{
+		if( mLatched )
+			return mLatchedTime;
+
 		return (F32)clock() / 1000.0f;
 	}
 	
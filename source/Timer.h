@@ -37,6 +37,12 @@ namespace Game
 
 		void Tick();
 
+		// Freezes the clock so every query within a tick sees the same time.
+		// Replays latch the recorded time instead of sampling the clock.
+		F32  LatchTime();
+		void LatchTime( F32 time );
+		void UnlatchTime();
+
 		// singleton pattern
 		static Timer*	GetTimer();
 
@@ -50,6 +56,9 @@ namespace Game
 		F32			mPauseStartTime;	// when we began the pause
 		F32			mAccumPauseTime;    // how much time we have spent paused
 		F32			mUnpauseTime;       // when to unpause the timer
+
+		bool		mLatched;			// is the clock frozen?
+		F32			mLatchedTime;		// the frozen clock value
 	};	
 
 #define sTimer (*Timer::GetTimer())
@@ -0,0 +1,252 @@
+//---------------------------------------------------
+// Name: Game : Metrics
+// Desc:  named counters, gauges and histograms
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#include "Metrics.h"
+#include "../Log.h"
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+namespace Game
+{
+	//-----------------------------------------------------------
+	// Name: MetricHistogram
+	// Desc:  constructor
+	//-----------------------------------------------------------
+	MetricHistogram::MetricHistogram() : mCount(0)
+	{}
+
+	//-----------------------------------------------------------
+	// Name: Record
+	// Desc:  adds a sample, overwriting the oldest once full
+	//-----------------------------------------------------------
+	void MetricHistogram::Record( F32 sample )
+	{
+		mSamples[ mCount % kNumSamples ] = sample;
+		++mCount;
+	}
+
+	//-----------------------------------------------------------
+	// Name: GetPercentile
+	// Desc:  nearest-rank percentile over the kept samples
+	//-----------------------------------------------------------
+	F32 MetricHistogram::GetPercentile( F32 p ) const
+	{
+		uint32_t num = mCount < kNumSamples ? mCount : kNumSamples;
+		if( !num )
+			return 0.0f;
+
+		F32 sorted[kNumSamples];
+		memcpy( sorted, mSamples, num * sizeof(F32) );
+
+		uint32_t rank = (uint32_t)( p * (num-1) + 0.5f );
+		std::nth_element( sorted, sorted + rank, sorted + num );
+		return sorted[rank];
+	}
+
+	uint32_t MetricHistogram::GetCount() const
+	{
+		return mCount;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Metrics
+	// Desc:  constructor
+	//-----------------------------------------------------------
+	Metrics::Metrics() :  mFrameStart(0)
+						, mFrameNum(0)
+						, mDumpFormat(kDump_CSV)
+						, mDumpFrames(0)
+						, mWroteHeader(false)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency( &frequency );
+		mTicksToMs = 1000.0 / (F64)frequency.QuadPart;
+
+		mFrameTime = GetHistogram( "FrameTimeMs" );
+	}
+
+	MetricCounter* Metrics::GetCounter( const char* name )
+	{
+		CounterMap::iterator itr;
+		if( ( itr = mCounters.find( name ) ) != mCounters.end() )
+			return itr->second;
+
+		MetricCounter* counter = new MetricCounter;
+		mCounters[ name ] = counter;
+		return counter;
+	}
+
+	MetricGauge* Metrics::GetGauge( const char* name )
+	{
+		GaugeMap::iterator itr;
+		if( ( itr = mGauges.find( name ) ) != mGauges.end() )
+			return itr->second;
+
+		MetricGauge* gauge = new MetricGauge;
+		mGauges[ name ] = gauge;
+		return gauge;
+	}
+
+	MetricHistogram* Metrics::GetHistogram( const char* name )
+	{
+		HistogramMap::iterator itr;
+		if( ( itr = mHistograms.find( name ) ) != mHistograms.end() )
+			return itr->second;
+
+		MetricHistogram* histogram = new MetricHistogram;
+		mHistograms[ name ] = histogram;
+		return histogram;
+	}
+
+	//-----------------------------------------------------------
+	// Name: BeginFrame
+	// Desc:  marks the start of a frame
+	//-----------------------------------------------------------
+	void Metrics::BeginFrame()
+	{
+		LARGE_INTEGER time;
+		QueryPerformanceCounter( &time );
+		mFrameStart = time.QuadPart;
+	}
+
+	//-----------------------------------------------------------
+	// Name: EndFrame
+	// Desc:  records the frame time and dumps when it is due
+	//-----------------------------------------------------------
+	void Metrics::EndFrame()
+	{
+		LARGE_INTEGER time;
+		QueryPerformanceCounter( &time );
+		mFrameTime->Record( (F32)( (F64)( time.QuadPart - mFrameStart ) * mTicksToMs ) );
+
+		++mFrameNum;
+
+		if( mDumpFrames && mFrameNum % mDumpFrames == 0 )
+			Dump();
+	}
+
+	void Metrics::SetDump( DumpFormat format, uint32_t numFrames )
+	{
+		mDumpFormat = format;
+		mDumpFrames = numFrames;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Dump
+	// Desc:  writes every metric out through the log
+	//-----------------------------------------------------------
+	void Metrics::Dump()
+	{
+		if( mDumpFormat == kDump_JSON )
+			DumpJSON();
+		else
+			DumpCSV();
+	}
+
+	//-----------------------------------------------------------
+	// Name: DumpCSV
+	// Desc:  one row per value: frame,type,name,value
+	//-----------------------------------------------------------
+	void Metrics::DumpCSV()
+	{
+		char line[512];
+
+		if( !mWroteHeader )
+		{
+			SLog->Print( "frame,type,name,value" );
+			mWroteHeader = true;
+		}
+
+		CounterMap::iterator cItr;
+		for( cItr = mCounters.begin(); cItr != mCounters.end(); ++cItr )
+		{
+			sprintf( line, "%u,counter,%s,%u", mFrameNum, cItr->first.c_str(), cItr->second->GetValue() );
+			SLog->Print( line );
+		}
+
+		GaugeMap::iterator gItr;
+		for( gItr = mGauges.begin(); gItr != mGauges.end(); ++gItr )
+		{
+			sprintf( line, "%u,gauge,%s,%.3f", mFrameNum, gItr->first.c_str(), gItr->second->GetValue() );
+			SLog->Print( line );
+		}
+
+		HistogramMap::iterator hItr;
+		for( hItr = mHistograms.begin(); hItr != mHistograms.end(); ++hItr )
+		{
+			sprintf( line, "%u,p50,%s,%.3f", mFrameNum, hItr->first.c_str(), hItr->second->GetPercentile( 0.5f ) );
+			SLog->Print( line );
+			sprintf( line, "%u,p99,%s,%.3f", mFrameNum, hItr->first.c_str(), hItr->second->GetPercentile( 0.99f ) );
+			SLog->Print( line );
+		}
+	}
+
+	//-----------------------------------------------------------
+	// Name: DumpJSON
+	// Desc:  one JSON object per dump
+	//-----------------------------------------------------------
+	void Metrics::DumpJSON()
+	{
+		char entry[256];
+		std::string json;
+
+		sprintf( entry, "{\"frame\":%u,\"counters\":{", mFrameNum );
+		json += entry;
+
+		CounterMap::iterator cItr;
+		for( cItr = mCounters.begin(); cItr != mCounters.end(); ++cItr )
+		{
+			sprintf( entry, "%s\"%s\":%u", cItr == mCounters.begin() ? "" : ",",
+					 cItr->first.c_str(), cItr->second->GetValue() );
+			json += entry;
+		}
+
+		json += "},\"gauges\":{";
+
+		GaugeMap::iterator gItr;
+		for( gItr = mGauges.begin(); gItr != mGauges.end(); ++gItr )
+		{
+			sprintf( entry, "%s\"%s\":%.3f", gItr == mGauges.begin() ? "" : ",",
+					 gItr->first.c_str(), gItr->second->GetValue() );
+			json += entry;
+		}
+
+		json += "},\"histograms\":{";
+
+		HistogramMap::iterator hItr;
+		for( hItr = mHistograms.begin(); hItr != mHistograms.end(); ++hItr )
+		{
+			sprintf( entry, "%s\"%s\":{\"count\":%u,\"p50\":%.3f,\"p99\":%.3f}", 
+					 hItr == mHistograms.begin() ? "" : ",", hItr->first.c_str(),
+					 hItr->second->GetCount(), hItr->second->GetPercentile( 0.5f ),
+					 hItr->second->GetPercentile( 0.99f ) );
+			json += entry;
+		}
+
+		json += "}}";
+		SLog->Print( json.c_str() );
+	}
+
+	uint32_t Metrics::GetFrameNum() const
+	{
+		return mFrameNum;
+	}
+
+	//-----------------------------------------------------------
+	// Name: GetMetrics
+	// Desc:  singleton pattern
+	//-----------------------------------------------------------
+	Metrics* Metrics::GetMetrics()
+	{
+		static Metrics* metrics = new Metrics();
+		return metrics;
+	}
+
+}; //end Game
@@ -0,0 +1,147 @@
+//---------------------------------------------------
+// Name: Game : Metrics
+// Desc:  named counters, gauges and histograms
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#ifndef _GAME_METRICS_H_
+#define _GAME_METRICS_H_
+
+#include "Types.h"
+
+#include <map>
+#include <string>
+
+namespace Game
+{	
+	// a running total
+	class MetricCounter
+	{
+	public:
+
+		MetricCounter() : mValue(0) {}
+
+		void	 Add( uint32_t amt = 1 )	{ mValue += amt; }
+		uint32_t GetValue() const			{ return mValue; }
+
+	private:
+
+		uint32_t	mValue;
+	};
+
+	// a value that is set rather than accumulated
+	class MetricGauge
+	{
+	public:
+
+		MetricGauge() : mValue(0) {}
+
+		void Set( F32 value )		{ mValue = value; }
+		F32	 GetValue() const		{ return mValue; }
+
+	private:
+
+		F32			mValue;
+	};
+
+	//-----------------------------------------------------------
+	// Name: MetricHistogram
+	// Desc:  keeps the most recent samples of a value so
+	//		  percentiles can be read off them
+	//-----------------------------------------------------------
+	class MetricHistogram
+	{
+	public:
+
+		enum { kNumSamples = 512 };
+
+	public:
+
+		MetricHistogram();
+
+		void	 Record( F32 sample );
+
+		// p in [0,1]. 0 if nothing has been recorded
+		F32		 GetPercentile( F32 p ) const;
+		uint32_t GetCount() const;		// samples ever recorded
+
+	private:
+
+		F32			mSamples[kNumSamples];
+		uint32_t	mCount;
+	};
+
+	//-----------------------------------------------------------
+	// Name: Metrics
+	// Desc:  the registry every system reports into. The overlay,
+	//		  headless replays and the periodic dumps all read the
+	//		  same values. Dumps go out through SLog as CSV rows or
+	//		  one JSON object per dump.
+	//-----------------------------------------------------------
+	class Metrics
+	{
+	public:
+
+		enum DumpFormat
+		{
+			kDump_CSV,
+			kDump_JSON
+		};
+
+	private:
+
+		Metrics();
+
+	public:
+
+		// get or create. the returned pointers stay valid, so hot
+		// paths can look them up once and hold on to them
+		MetricCounter*		GetCounter( const char* name );
+		MetricGauge*		GetGauge( const char* name );
+		MetricHistogram*	GetHistogram( const char* name );
+
+		// records FrameTimeMs and dumps every mDumpFrames frames
+		void BeginFrame();
+		void EndFrame();
+
+		// dump every numFrames frames, 0 to disable
+		void SetDump( DumpFormat format, uint32_t numFrames );
+		void Dump();
+
+		uint32_t GetFrameNum() const;
+
+		// singleton pattern
+		static Metrics*		GetMetrics();
+
+	private:
+
+		void DumpCSV();
+		void DumpJSON();
+
+	private:
+
+		typedef std::map< std::string, MetricCounter* >	  CounterMap;
+		typedef std::map< std::string, MetricGauge* >	  GaugeMap;
+		typedef std::map< std::string, MetricHistogram* > HistogramMap;
+
+		CounterMap			mCounters;
+		GaugeMap			mGauges;
+		HistogramMap		mHistograms;
+
+		MetricHistogram*	mFrameTime;
+		__int64				mFrameStart;
+		F64					mTicksToMs;
+		uint32_t			mFrameNum;
+
+		DumpFormat			mDumpFormat;
+		uint32_t			mDumpFrames;
+		bool				mWroteHeader;	// csv header goes out once
+	};
+
+#define SMetrics (*Metrics::GetMetrics())
+	
+}; //end Game
+
+#endif // end _GAME_METRICS_H_
+    
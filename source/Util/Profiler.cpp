@@ -0,0 +1,391 @@
+//---------------------------------------------------
+// Name: Game : Profiler
+// Desc:  scoped timing zones and trace export
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#include "Profiler.h"
+
+#if ENABLE_PROFILER
+
+#include <windows.h>
+#include <string.h>
+
+namespace Game
+{
+	// each thread finds its own ring without taking a lock
+	static __declspec(thread) ProfileThreadBuffer* tThreadBuffer = NULL;
+
+	//-----------------------------------------------------------
+	// Name: ProfileThreadBuffer
+	// Desc:  constructor
+	//-----------------------------------------------------------
+	ProfileThreadBuffer::ProfileThreadBuffer( uint32_t threadId ) :  mThreadId(threadId)
+																   , mDepth(0)
+																   , mDropped(0)
+																   , mWrite(0)
+																   , mRead(0)
+	{}
+
+	//-----------------------------------------------------------
+	// Name: Push
+	// Desc:  called by the owning thread only. drops the event
+	//		  rather than block when the ring is full
+	//-----------------------------------------------------------
+	bool ProfileThreadBuffer::Push( const ProfileEvent& ev )
+	{
+		long write = mWrite;
+		if( write - mRead >= kNumEvents )
+		{
+			++mDropped;
+			return false;
+		}
+
+		mEvents[ write & (kNumEvents-1) ] = ev;
+
+		// publish the event only once it is fully written
+		InterlockedExchange( (long*)&mWrite, write + 1 );
+		return true;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Pop
+	// Desc:  called by the profiler only
+	//-----------------------------------------------------------
+	bool ProfileThreadBuffer::Pop( ProfileEvent& ev )
+	{
+		long read = mRead;
+		if( read == mWrite )
+			return false;
+
+		ev = mEvents[ read & (kNumEvents-1) ];
+
+		// hand the slot back to the owning thread
+		InterlockedExchange( (long*)&mRead, read + 1 );
+		return true;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Profiler
+	// Desc:  constructor
+	//-----------------------------------------------------------
+	Profiler::Profiler() :  mFrameStart(0)
+						  , mFrameNum(0)
+						  , mFrameEvents(0)
+						  , mFrameMs(0)
+						  , mOverhead(0)
+						  , mCapturing(false)
+						  , mFrameFile(NULL)
+	{
+		CRITICAL_SECTION* lock = new CRITICAL_SECTION;
+		InitializeCriticalSection( lock );
+		mBufferLock = lock;
+
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency( &frequency );
+		mTicksToMs = 1000.0 / (F64)frequency.QuadPart;
+
+		Calibrate();
+	}
+
+	//-----------------------------------------------------------
+	// Name: Calibrate
+	// Desc:  measures what recording a single zone costs so the
+	//		  per-frame overhead can be reported
+	//-----------------------------------------------------------
+	void Profiler::Calibrate()
+	{
+		const uint32_t kNumSamples = 1024;
+
+		ProfileThreadBuffer* buffer = new ProfileThreadBuffer(0);
+		ProfileEvent ev;
+
+		ProfileTick start = GetTick();
+		for( uint32_t i = 0; i < kNumSamples; ++i )
+		{
+			// mirrors ProfileZone's constructor and destructor
+			ev.mName  = "Calibrate";
+			ev.mStart = GetTick();
+			ev.mDepth = buffer->mDepth++;
+			--buffer->mDepth;
+			ev.mEnd   = GetTick();
+			buffer->Push( ev );
+		}
+		ProfileTick end = GetTick();
+
+		mZoneCost = (F64)( end - start ) / kNumSamples;
+		delete buffer;
+	}
+
+	//-----------------------------------------------------------
+	// Name: BeginFrame
+	// Desc:  marks the start of a frame
+	//-----------------------------------------------------------
+	void Profiler::BeginFrame()
+	{
+		mFrameStart = GetTick();
+	}
+
+	//-----------------------------------------------------------
+	// Name: EndFrame
+	// Desc:  drains every thread's ring into the frame summary
+	//		  and the capture, if one is running
+	//-----------------------------------------------------------
+	void Profiler::EndFrame()
+	{
+		ProfileTick frameEnd = GetTick();
+
+		mSummary.clear();
+		mFrameEvents = 0;
+
+		EnterCriticalSection( (CRITICAL_SECTION*)mBufferLock );
+
+		BufferList::iterator itr;
+		for( itr = mBuffers.begin(); itr != mBuffers.end(); ++itr )
+			Drain( *itr );
+
+		LeaveCriticalSection( (CRITICAL_SECTION*)mBufferLock );
+
+		// overhead is the zones recorded during the frame plus the drain itself
+		ProfileTick drainEnd = GetTick();
+		F64 frameTicks	  = (F64)( frameEnd - mFrameStart );
+		F64 overheadTicks = mFrameEvents * mZoneCost + (F64)( drainEnd - frameEnd );
+
+		mFrameMs  = (F32)( frameTicks * mTicksToMs );
+		mOverhead = frameTicks > 0 ? (F32)( 100.0 * overheadTicks / frameTicks ) : 0.0f;
+
+		if( mCapturing )
+			WriteFrameSummary();
+
+		++mFrameNum;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Drain
+	// Desc:  empties one thread's ring
+	//-----------------------------------------------------------
+	void Profiler::Drain( ProfileThreadBuffer* buffer )
+	{
+		ProfileEvent ev;
+		while( buffer->Pop( ev ) )
+		{
+			++mFrameEvents;
+			AddToSummary( ev );
+
+			if( mCapturing )
+			{
+				CapturedEvent captured;
+				captured.mEvent	   = ev;
+				captured.mThreadId = buffer->mThreadId;
+				mCapture.push_back( captured );
+			}
+		}
+	}
+
+	//-----------------------------------------------------------
+	// Name: AddToSummary
+	// Desc:  accumulates an event into its zone's frame totals.
+	//		  zones per frame are few so a linear search is fine
+	//-----------------------------------------------------------
+	void Profiler::AddToSummary( const ProfileEvent& ev )
+	{
+		F32 ms = (F32)( (F64)( ev.mEnd - ev.mStart ) * mTicksToMs );
+
+		ZoneSummaryList::iterator itr;
+		for( itr = mSummary.begin(); itr != mSummary.end(); ++itr )
+		{
+			if( itr->mName == ev.mName || strcmp( itr->mName, ev.mName ) == 0 )
+			{
+				++itr->mCalls;
+				itr->mMs += ms;
+				return;
+			}
+		}
+
+		ZoneSummary summary;
+		summary.mName  = ev.mName;
+		summary.mCalls = 1;
+		summary.mMs	   = ms;
+		mSummary.push_back( summary );
+	}
+
+	//-----------------------------------------------------------
+	// Name: BeginCapture
+	// Desc:  starts recording every zone. the trace is written to
+	//		  szFile and the frame summaries to szFile.frames.txt
+	//-----------------------------------------------------------
+	bool Profiler::BeginCapture( const char* szFile )
+	{
+		if( mCapturing )
+			return false;
+
+		mCaptureFile = std::string( szFile );
+		mFrameFile	 = fopen( ( mCaptureFile + ".frames.txt" ).c_str(), "w" );
+		if( !mFrameFile )
+			return false;
+
+		mCapture.clear();
+		mCapturing = true;
+		return true;
+	}
+
+	//-----------------------------------------------------------
+	// Name: EndCapture
+	// Desc:  stops the capture and writes the trace
+	//-----------------------------------------------------------
+	bool Profiler::EndCapture()
+	{
+		if( !mCapturing )
+			return false;
+
+		mCapturing = false;
+
+		fclose( mFrameFile );
+		mFrameFile = NULL;
+
+		bool written = WriteTrace();
+		mCapture.clear();
+		return written;
+	}
+
+	bool Profiler::IsCapturing() const
+	{
+		return mCapturing;
+	}
+
+	//-----------------------------------------------------------
+	// Name: WriteFrameSummary
+	// Desc:  appends the last frame's totals to the frame file
+	//-----------------------------------------------------------
+	void Profiler::WriteFrameSummary()
+	{
+		fprintf( mFrameFile, "Frame %u: %.3f ms, %u zones, overhead %.3f%%\n",
+				 mFrameNum, mFrameMs, mFrameEvents, mOverhead );
+
+		ZoneSummaryList::iterator itr;
+		for( itr = mSummary.begin(); itr != mSummary.end(); ++itr )
+			fprintf( mFrameFile, "\t%-32s %6u %10.3f ms\n", itr->mName, itr->mCalls, itr->mMs );
+	}
+
+	//-----------------------------------------------------------
+	// Name: WriteTrace
+	// Desc:  writes the capture as Chrome trace-event JSON using
+	//		  complete ("X") events in microseconds
+	//-----------------------------------------------------------
+	bool Profiler::WriteTrace()
+	{
+		FILE* file = fopen( mCaptureFile.c_str(), "w" );
+		if( !file )
+			return false;
+
+		ProfileTick base = mCapture.empty() ? 0 : mCapture[0].mEvent.mStart;
+		for( uint32_t i = 0; i < mCapture.size(); ++i )
+		{
+			if( mCapture[i].mEvent.mStart < base )
+				base = mCapture[i].mEvent.mStart;
+		}
+
+		fprintf( file, "{\"traceEvents\":[\n" );
+
+		for( uint32_t i = 0; i < mCapture.size(); ++i )
+		{
+			const ProfileEvent& ev = mCapture[i].mEvent;
+			F64 ts	= (F64)( ev.mStart - base ) * mTicksToMs * 1000.0;
+			F64 dur = (F64)( ev.mEnd - ev.mStart ) * mTicksToMs * 1000.0;
+
+			fprintf( file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}\n",
+					 i ? "," : "", ev.mName, ts, dur, mCapture[i].mThreadId );
+		}
+
+		fprintf( file, "],\"displayTimeUnit\":\"ms\"}\n" );
+		fclose( file );
+		return true;
+	}
+
+	const Profiler::ZoneSummaryList& Profiler::GetFrameSummary() const
+	{
+		return mSummary;
+	}
+
+	F32 Profiler::GetFrameMs() const
+	{
+		return mFrameMs;
+	}
+
+	F32 Profiler::GetOverheadPercent() const
+	{
+		return mOverhead;
+	}
+
+	//-----------------------------------------------------------
+	// Name: GetThreadBuffer
+	// Desc:  returns the calling thread's ring, creating it on
+	//		  first use
+	//-----------------------------------------------------------
+	ProfileThreadBuffer* Profiler::GetThreadBuffer()
+	{
+		if( !tThreadBuffer )
+		{
+			ProfileThreadBuffer* buffer = new ProfileThreadBuffer( (uint32_t)GetCurrentThreadId() );
+
+			EnterCriticalSection( (CRITICAL_SECTION*)mBufferLock );
+			mBuffers.push_back( buffer );
+			LeaveCriticalSection( (CRITICAL_SECTION*)mBufferLock );
+
+			tThreadBuffer = buffer;
+		}
+
+		return tThreadBuffer;
+	}
+
+	//-----------------------------------------------------------
+	// Name: GetTick
+	// Desc:  high resolution clock
+	//-----------------------------------------------------------
+	ProfileTick Profiler::GetTick()
+	{
+		LARGE_INTEGER time;
+		QueryPerformanceCounter( &time );
+		return (ProfileTick)time.QuadPart;
+	}
+
+	//-----------------------------------------------------------
+	// Name: GetProfiler
+	// Desc:  singleton pattern
+	//-----------------------------------------------------------
+	Profiler* Profiler::GetProfiler()
+	{
+		static Profiler* profiler = new Profiler();
+		return profiler;
+	}
+
+	//-----------------------------------------------------------
+	// Name: ProfileZone
+	// Desc:  starts timing
+	//-----------------------------------------------------------
+	ProfileZone::ProfileZone( const char* name ) :  mBuffer( tThreadBuffer ? tThreadBuffer : SProfiler.GetThreadBuffer() )
+												  , mName(name)
+	{
+		++mBuffer->mDepth;
+		mStart = Profiler::GetTick();
+	}
+
+	//-----------------------------------------------------------
+	// Name: ~ProfileZone
+	// Desc:  stops timing and hands the zone to the thread's ring
+	//-----------------------------------------------------------
+	ProfileZone::~ProfileZone()
+	{
+		ProfileEvent ev;
+		ev.mEnd	  = Profiler::GetTick();
+		ev.mStart = mStart;
+		ev.mName  = mName;
+		ev.mDepth = --mBuffer->mDepth;
+
+		mBuffer->Push( ev );
+	}
+
+}; //end Game
+
+#endif // end ENABLE_PROFILER
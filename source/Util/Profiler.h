@@ -0,0 +1,186 @@
+//---------------------------------------------------
+// Name: Game : Profiler
+// Desc:  scoped timing zones and trace export
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#ifndef _GAME_PROFILER_H_
+#define _GAME_PROFILER_H_
+
+#include "Types.h"
+#include "../MasterFile.h"
+
+#if ENABLE_PROFILER
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+
+namespace Game
+{	
+	typedef __int64 ProfileTick;
+
+	// a finished zone. names must be string literals, only the
+	// pointer is stored
+	struct ProfileEvent
+	{
+		const char*		mName;
+		ProfileTick		mStart;
+		ProfileTick		mEnd;
+		uint32_t		mDepth;		// nesting level on its thread
+	};
+
+	//-----------------------------------------------------------
+	// Name: ProfileThreadBuffer
+	// Desc:  a ring of finished zones for one thread. Only the
+	//		  owning thread pushes and only the profiler pops, so
+	//		  publishing the read/write counters is all the
+	//		  synchronization needed.
+	//-----------------------------------------------------------
+	class ProfileThreadBuffer
+	{
+	public:
+
+		enum { kNumEvents = 4096 };	// must be a power of 2
+
+	public:
+
+		ProfileThreadBuffer( uint32_t threadId );
+
+		bool Push( const ProfileEvent& ev );
+		bool Pop( ProfileEvent& ev );
+
+		uint32_t			mThreadId;
+		uint32_t			mDepth;		// current zone nesting
+		uint32_t			mDropped;	// events lost to a full ring
+
+	private:
+
+		ProfileEvent		mEvents[kNumEvents];
+		volatile long		mWrite;
+		volatile long		mRead;
+	};
+
+	//-----------------------------------------------------------
+	// Name: Profiler
+	// Desc:  collects the zones of every thread once per frame,
+	//		  keeps a summary of the last frame and optionally
+	//		  captures everything to a Chrome trace file
+	//		  (chrome://tracing) plus a per-frame summary file.
+	//-----------------------------------------------------------
+	class Profiler
+	{
+	public:
+
+		struct ZoneSummary
+		{
+			const char*		mName;
+			uint32_t		mCalls;
+			F32				mMs;		// inclusive time this frame
+		};
+
+		typedef std::vector< ZoneSummary > ZoneSummaryList;
+
+	private:
+
+		Profiler();
+
+	public:
+
+		void BeginFrame();
+		void EndFrame();
+
+		bool BeginCapture( const char* szFile );
+		bool EndCapture();
+		bool IsCapturing() const;
+
+		// last completed frame
+		const ZoneSummaryList&	GetFrameSummary() const;
+		F32						GetFrameMs() const;
+		F32						GetOverheadPercent() const;
+
+		ProfileThreadBuffer*	GetThreadBuffer();
+
+		static ProfileTick		GetTick();
+
+		// singleton pattern
+		static Profiler*		GetProfiler();
+
+	private:
+
+		struct CapturedEvent
+		{
+			ProfileEvent	mEvent;
+			uint32_t		mThreadId;
+		};
+
+		typedef std::vector< ProfileThreadBuffer* > BufferList;
+		typedef std::vector< CapturedEvent >		CaptureList;
+
+		void Calibrate();
+		void Drain( ProfileThreadBuffer* buffer );
+		void AddToSummary( const ProfileEvent& ev );
+		void WriteFrameSummary();
+		bool WriteTrace();
+
+	private:
+
+		BufferList			mBuffers;
+		void*				mBufferLock;	// guards mBuffers, only taken on registration / drain
+
+		F64					mTicksToMs;
+		F64					mZoneCost;		// ticks spent recording one zone
+
+		ProfileTick			mFrameStart;
+		uint32_t			mFrameNum;
+		uint32_t			mFrameEvents;
+		F32					mFrameMs;
+		F32					mOverhead;		// percent of the frame spent profiling
+		ZoneSummaryList		mSummary;
+
+		bool				mCapturing;
+		std::string			mCaptureFile;
+		FILE*				mFrameFile;
+		CaptureList			mCapture;
+	};
+
+	//-----------------------------------------------------------
+	// Name: ProfileZone
+	// Desc:  times the scope it lives in
+	//-----------------------------------------------------------
+	class ProfileZone
+	{
+	public:
+
+		ProfileZone( const char* name );
+		~ProfileZone();
+
+	private:
+
+		ProfileThreadBuffer*	mBuffer;
+		const char*				mName;
+		ProfileTick				mStart;
+	};
+
+#define SProfiler (*Profiler::GetProfiler())
+	
+}; //end Game
+
+#define PROFILE_CONCAT2( a, b )		a##b
+#define PROFILE_CONCAT( a, b )		PROFILE_CONCAT2( a, b )
+
+#define PROFILE_ZONE( name )		Game::ProfileZone PROFILE_CONCAT( _profileZone, __LINE__ )( name )
+#define PROFILE_BEGIN_FRAME()		Game::Profiler::GetProfiler()->BeginFrame()
+#define PROFILE_END_FRAME()			Game::Profiler::GetProfiler()->EndFrame()
+
+#else
+
+#define PROFILE_ZONE( name )
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_END_FRAME()
+
+#endif // end ENABLE_PROFILER
+
+#endif // end _GAME_PROFILER_H_
+    
@@ -0,0 +1,310 @@
+//---------------------------------------------------
+// Name: Game : Tokenizer
+// Desc:  single pass, non-copying line tokenizer
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#include "Tokenizer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace Game
+{
+	//-----------------------------------------------------------
+	// Name: StringRef
+	// Desc:  constructors
+	//-----------------------------------------------------------
+	StringRef::StringRef() :  mStr(NULL)
+							, mLength(0)
+	{}
+
+	StringRef::StringRef( const char* str, uint32_t length ) :  mStr(str)
+															  , mLength(length)
+	{}
+
+	bool StringRef::Empty() const
+	{
+		return mLength == 0;
+	}
+
+	bool StringRef::Equals( const char* str ) const
+	{
+		return strncmp( mStr ? mStr : "", str, mLength ) == 0 && str[mLength] == '\0';
+	}
+
+	bool StringRef::StartsWith( const char* str ) const
+	{
+		uint32_t len = (uint32_t)strlen( str );
+		return len <= mLength && strncmp( mStr, str, len ) == 0;
+	}
+
+	std::string StringRef::ToString() const
+	{
+		return mLength ? std::string( mStr, mLength ) : std::string();
+	}
+
+	//-----------------------------------------------------------
+	// Name: ToInt / ToFloat
+	// Desc:  the ref is not terminated, so numbers are copied
+	//		  to the stack before conversion
+	//-----------------------------------------------------------
+	int32_t StringRef::ToInt() const
+	{
+		char buffer[64];
+		uint32_t len = mLength < 63 ? mLength : 63;
+		memcpy( buffer, mStr, len );
+		buffer[len] = '\0';
+		return (int32_t)atoi( buffer );
+	}
+
+	F32 StringRef::ToFloat() const
+	{
+		char buffer[64];
+		uint32_t len = mLength < 63 ? mLength : 63;
+		memcpy( buffer, mStr, len );
+		buffer[len] = '\0';
+		return (F32)atof( buffer );
+	}
+
+	//-----------------------------------------------------------
+	// Name: LineReader
+	// Desc:  constructor
+	//-----------------------------------------------------------
+	LineReader::LineReader( const char* buffer, uint32_t size ) :  mCur(buffer)
+																 , mEnd(buffer + size)
+	{}
+
+	//-----------------------------------------------------------
+	// Name: NextLine
+	// Desc:  returns the next line without its line ending
+	//-----------------------------------------------------------
+	bool LineReader::NextLine( StringRef& line )
+	{
+		if( mCur >= mEnd )
+			return false;
+
+		const char* start = mCur;
+		const char* newline = (const char*)memchr( mCur, '\n', mEnd - mCur );
+		const char* end = newline ? newline : mEnd;
+
+		mCur = newline ? newline + 1 : mEnd;
+
+		if( end > start && end[-1] == '\r' )
+			--end;
+
+		line = StringRef( start, (uint32_t)( end - start ) );
+		return true;
+	}
+
+	//-----------------------------------------------------------
+	// Name: Tokenizer
+	// Desc:  constructor
+	//-----------------------------------------------------------
+	Tokenizer::Tokenizer( char delim, bool stripComments ) :  mDelim(delim)
+															, mStripComments(stripComments)
+															, mNumTokens(0)
+	{}
+
+	//-----------------------------------------------------------
+	// Name: Tokenize
+	// Desc:  splits the line, returning the token count
+	//-----------------------------------------------------------
+	uint32_t Tokenizer::Tokenize( const StringRef& line )
+	{
+		mNumTokens = 0;
+
+		const char* cur = line.mStr;
+		const char* end = line.mStr + line.mLength;
+		const char* tokenStart = NULL;
+
+		for( ; cur < end; ++cur )
+		{
+			char c = *cur;
+
+			if( mStripComments && c == '/' && cur+1 < end && cur[1] == '/' )
+				break;
+
+			bool separator = ( c == mDelim || c == '\t' || c == '\r' || c == '\n' );
+
+			if( separator )
+			{
+				if( tokenStart && mNumTokens < kMaxTokens )
+					mTokens[ mNumTokens++ ] = StringRef( tokenStart, (uint32_t)( cur - tokenStart ) );
+
+				tokenStart = NULL;
+			}
+			else if( !tokenStart )
+			{
+				tokenStart = cur;
+			}
+		}
+
+		if( tokenStart && mNumTokens < kMaxTokens )
+			mTokens[ mNumTokens++ ] = StringRef( tokenStart, (uint32_t)( cur - tokenStart ) );
+
+		return mNumTokens;
+	}
+
+	uint32_t Tokenizer::Tokenize( const std::string& line )
+	{
+		return Tokenize( StringRef( line.c_str(), (uint32_t)line.size() ) );
+	}
+
+	uint32_t Tokenizer::GetNumTokens() const
+	{
+		return mNumTokens;
+	}
+
+	const StringRef& Tokenizer::GetToken( uint32_t idx ) const
+	{
+		return idx < mNumTokens ? mTokens[idx] : mEmpty;
+	}
+
+}; //end Game
+
+#ifdef TOKENIZER_TESTER
+
+	// g++ -O2 -DTOKENIZER_TESTER -Isource -Isource/Util -Iexternal/Common source/Util/Tokenizer.cpp
+
+	#include <stdio.h>
+	#include <stdlib.h>
+
+	#ifdef _WIN32
+		#include <windows.h>
+	#else
+		#include <sys/time.h>
+	#endif
+
+	using namespace Game;
+
+	static double Seconds()
+	{
+	#ifdef _WIN32
+		LARGE_INTEGER freq, now;
+		QueryPerformanceFrequency( &freq );
+		QueryPerformanceCounter( &now );
+		return (double)now.QuadPart / (double)freq.QuadPart;
+	#else
+		struct timeval tv;
+		gettimeofday( &tv, NULL );
+		return tv.tv_sec + tv.tv_usec / 1e6;
+	#endif
+	}
+
+	// the per-word scan the parsers used before, kept for comparison
+	std::string GetWordFromString( uint32_t wordNum, char* str, char delim )
+	{
+		U32 idx = 0;
+		U32 k   = 0;
+		char res[256];
+		strcpy( res, "" );
+
+		while( idx < wordNum )
+		{
+			while( k < strlen(str) && str[k] != delim)	++k;
+			if( k == strlen(str)) break;
+			++idx;
+			++k;
+		}
+
+		idx = 0;
+		while( k < strlen(str) && str[k] != delim )
+		{
+			res[idx] = str[k];
+			++idx;
+			++k;
+		}
+
+		if( idx && res[idx-1] == 10 )	res[idx-1] = '\0';
+		else							res[idx] = '\0';
+		
+		return std::string(res);
+	}
+
+	int main( void )
+	{
+		const uint32_t kTargetSize = 50 * 1024 * 1024;
+
+		// generate a description file in memory
+		std::string desc;
+		desc.reserve( kTargetSize + 256 );
+
+		char entry[256];
+		for( uint32_t i = 0; desc.size() < kTargetSize; ++i )
+		{
+			sprintf( entry, "#Begin Arrow%u\nBaseEntity = Arrow\nVelocity = %u -%u\n"
+							"Lifetime = %u.5f\nGenerationSound = gen%u.wav\n#End\n\n",
+							i, i % 100, i % 50, i % 30, i % 7 );
+			desc += entry;
+		}
+
+		printf( "Generated %.1f MB\n", desc.size() / (1024.0f * 1024.0f) );
+
+		// single pass tokenizer
+		double start = Seconds();
+
+		uint32_t numTokens = 0;
+		int32_t  checksum  = 0;
+
+		LineReader reader( desc.c_str(), (uint32_t)desc.size() );
+		Tokenizer  tokens;
+		StringRef  line;
+
+		while( reader.NextLine( line ) )
+		{
+			numTokens += tokens.Tokenize( line );
+			if( tokens.GetToken(0).Equals( "Velocity" ) )
+				checksum += tokens.GetToken(2).ToInt();
+		}
+
+		double seconds = Seconds() - start;
+		printf( "Tokenizer:         %u tokens, checksum %d, %.3f s, %.1f MB/s\n",
+				numTokens, checksum, seconds, desc.size() / (1024.0 * 1024.0) / seconds );
+
+		const int32_t tokenizerChecksum = checksum;
+
+		// the old per-word rescan, reading the same words the parsers did
+		start = Seconds();
+
+		numTokens = 0;
+		checksum  = 0;
+
+		char buffer[512];
+		LineReader oldReader( desc.c_str(), (uint32_t)desc.size() );
+		while( oldReader.NextLine( line ) )
+		{
+			memcpy( buffer, line.mStr, line.mLength );
+			buffer[line.mLength] = '\0';
+
+			std::string word = GetWordFromString( 0, buffer, ' ' );
+			numTokens += 1;
+
+			if( word == "Velocity" )
+			{
+				checksum += atoi( GetWordFromString( 2, buffer, ' ' ).c_str() );
+				GetWordFromString( 3, buffer, ' ' );
+				numTokens += 2;
+			}
+			else if( word == "#Begin" )
+			{
+				GetWordFromString( 1, buffer, ' ' );
+				numTokens += 1;
+			}
+			else if( word != "#End" && word != "" )
+			{
+				GetWordFromString( 2, buffer, ' ' );
+				numTokens += 1;
+			}
+		}
+
+		seconds = Seconds() - start;
+		printf( "GetWordFromString: %u tokens, checksum %d, %.3f s, %.1f MB/s\n",
+				numTokens, checksum, seconds, desc.size() / (1024.0 * 1024.0) / seconds );
+
+		bool same = checksum == tokenizerChecksum;
+		printf( "%s\n", same ? "OK: checksums match" : "FAILED: checksums differ" );
+		return same ? 0 : 1;
+	}
+#endif
@@ -0,0 +1,96 @@
+//---------------------------------------------------
+// Name: Game : Tokenizer
+// Desc:  single pass, non-copying line tokenizer
+// Author: John Sheblak
+// Contact: jbsheblak@mail.utexas.edu
+//---------------------------------------------------
+
+#ifndef _GAME_TOKENIZER_H_
+#define _GAME_TOKENIZER_H_
+
+#include "Types.h"
+
+#include <string>
+
+namespace Game
+{	
+	//-----------------------------------------------------------
+	// Name: StringRef
+	// Desc:  a view of part of a buffer. does not own or
+	//		  terminate the characters it points at
+	//-----------------------------------------------------------
+	struct StringRef
+	{
+		StringRef();
+		StringRef( const char* str, uint32_t length );
+
+		bool		Empty() const;
+		bool		Equals( const char* str ) const;
+		bool		StartsWith( const char* str ) const;
+
+		std::string	ToString() const;
+		int32_t		ToInt() const;
+		F32			ToFloat() const;
+
+		const char*		mStr;
+		uint32_t		mLength;
+	};
+
+	//-----------------------------------------------------------
+	// Name: LineReader
+	// Desc:  walks the lines of an in-memory text file
+	//-----------------------------------------------------------
+	class LineReader
+	{
+	public:
+
+		LineReader( const char* buffer, uint32_t size );
+
+		// false once the buffer is exhausted
+		bool NextLine( StringRef& line );
+
+	private:
+
+		const char*		mCur;
+		const char*		mEnd;
+	};
+
+	//-----------------------------------------------------------
+	// Name: Tokenizer
+	// Desc:  splits a line into tokens in one pass. Runs of the
+	//		  delimiter, tabs and line endings all separate tokens
+	//		  and never produce empty ones. Tokens point into the
+	//		  line, which must outlive them.
+	//-----------------------------------------------------------
+	class Tokenizer
+	{
+	public:
+
+		enum { kMaxTokens = 32 };	// extra tokens on a line are ignored
+
+	public:
+
+		Tokenizer( char delim = ' ', bool stripComments = false );
+
+		uint32_t Tokenize( const StringRef& line );
+		uint32_t Tokenize( const std::string& line );
+
+		uint32_t		 GetNumTokens() const;
+
+		// an empty ref when idx is out of range
+		const StringRef& GetToken( uint32_t idx ) const;
+
+	private:
+
+		char			mDelim;
+		bool			mStripComments;		// stop at "//"
+
+		StringRef		mTokens[kMaxTokens];
+		uint32_t		mNumTokens;
+		StringRef		mEmpty;
+	};
+	
+}; //end Game
+
+#endif // end _GAME_TOKENIZER_H_
+    
@@ -7,6 +7,8 @@
 
 #include "Tuner.h"
 #include "../FileIO.h"
+#include "../Algorithms.h"
+#include "Tokenizer.h"
 
 namespace Game
 {
@@ -14,30 +16,39 @@ namespace Game
 	{
 		mTunerVariables.clear();
 
-		FILE* file = fopen( szFile, "r+t" );
-		if( !file )
+		uint8_t* buffer = NULL;
+		uint32_t size = jbsCommon::Algorithm::ReadFileIntoBuffer( szFile, buffer );
+		if( !buffer )
 			return false;
 
-		std::string line;
-		while( FileUtils::GetNextLine( line, file ) )
-		{
-			TokenArray tokens;
-			Split( line, tokens, ' ' );
+		// lines look like: name = value // comment
+		LineReader reader( (const char*)buffer, size );
+		Tokenizer  tokens( ' ', true );
+		StringRef  line;
 
-			if( tokens.size() < 3 )
+		while( reader.NextLine( line ) )
+		{
+			if( tokens.Tokenize( line ) < 3 )
 				continue;
 
-			std::string tk0 = tokens[0];
-			std::string tk2 = tokens[2];
-
-			mTunerVariables[ tk0 ] = tk2;
+			mTunerVariables[ tokens.GetToken(0).ToString() ] = tokens.GetToken(2).ToString();
 		}
 
-		fclose(file);
+		delete [] buffer;
 
 		return true;
 	}
 
+	const Tuner::VariableMap& Tuner::GetVariables() const
+	{
+		return mTunerVariables;
+	}
+
+	void Tuner::SetVariables( const VariableMap& vars )
+	{
+		mTunerVariables = vars;
+	}
+
 	int32_t Tuner::GetInt( const char* name )
 	{
 		VariableMap::iterator itr;
@@ -84,36 +95,4 @@ namespace Game
 		return &sTuner;
 	}
 
-	void Tuner::Split( std::string str, TokenArray& tokenArray, char delim )
-	{
-		char buffer[256];
-		int c = 0;
-
-		for( uint32_t i = 0; i < str.length(); ++i )
-		{
-			//check for comments
-			if( i+1 < str.length() && str[i] == '/' && str[i+1] == '/' )
-				break;
-
-			if( str[i] == delim && c != 0 )
-			{
-				buffer[c] = '\0';
-				tokenArray.push_back( std::string(buffer) );
-				c = 0;
-			}
-			else if( str[i] != delim && str[i] != '\n' && str[i] != '\t' && str[i] != '\r' )
-			{
-				buffer[c] = str[i];
-				++c;
-			}
-		}
-
-		//do we need to push the end string?
-		if( c > 0 )
-		{
-			buffer[c] = '\0';
-			tokenArray.push_back( buffer );
-		}
-	}
-
 }; //end Game
@@ -18,10 +18,18 @@ namespace Game
 {	
 	class Tuner
 	{
+	public:
+
+		typedef std::map< std::string, std::string > VariableMap;
+
 	public:
 
 		bool	LoadTuners( const char* szFile );
 
+		// snapshot access, used to pin tuners for replays
+		const VariableMap&	GetVariables() const;
+		void				SetVariables( const VariableMap& vars );
+
 		int32_t		   GetInt( const char* name );
 		F32			   GetFloat( const char* name );
 		uint32_t	   GetUint( const char* name );
@@ -29,14 +37,8 @@ namespace Game
 
 		static Tuner* GetTuner();	
 
-	private:
-
-		typedef std::vector< std::string > TokenArray;
-		void Split( std::string str, TokenArray& tokenArray, char delim );
-
 	private:
         
-		typedef std::map< std::string, std::string > VariableMap;
 		VariableMap	mTunerVariables;
 
 	}; //end Tuner
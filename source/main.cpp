@@ -17,14 +17,91 @@
 #include "State_EditMode.h"
 
 #include "Util/Tuner.h"
+#include "Replay.h"
+#include "Util/Profiler.h"
+#include "Util/Metrics.h"
+#include "Log.h"
+
+#include <string.h>
 
 using namespace Game;
 
+// handles of the states main asks for
+static StateMachine::StateID sLoadGameState;
+static StateMachine::StateID sGameState;
+
+// sends log messages to log.txt
+void LogToFile( const char* msg )
+{
+	static FILE* file = fopen( "log.txt", "w" );
+	if( file )
+	{
+		fprintf( file, "%s\n", msg );
+		fflush( file );
+	}
+}
+
+// periodic metrics dumps are driven by tuners:
+//   kMetricsDumpFrames = 300	(0 disables)
+//   kMetricsDumpFormat = json	(csv otherwise)
+void SetupMetricsDump()
+{
+	Metrics::DumpFormat format = gTuner.GetString( "kMetricsDumpFormat" ) == "json" ? 
+								 Metrics::kDump_JSON : Metrics::kDump_CSV;
+
+	SMetrics.SetDump( format, gTuner.GetUint( "kMetricsDumpFrames" ) );
+}
+
+// looks for "-replay <file>" on the command line
+const char* GetReplayArg()
+{
+	for( int32_t i = 1; i < __argc - 1; ++i )
+	{
+		if( strcmp( __argv[i], "-replay" ) == 0 )
+			return __argv[i+1];
+	}
+
+	return NULL;
+}
+
+// plays a recorded session back without drawing and quits. the end
+// state is dumped next to the replay for comparison with the recording
+void RunReplay( const char* szFile )
+{
+	// run the loader once so the pack file is ready
+	PROFILE_BEGIN_FRAME();
+	SMachine.Handle();
+	PROFILE_END_FRAME();
+
+	if( SReplay.BeginPlayback( szFile ) )
+	{
+		SMachine.RequestStateChange( sGameState );
+
+		do
+		{
+			PROFILE_BEGIN_FRAME();
+			SMetrics.BeginFrame();
+			SMachine.Handle();
+			SMetrics.EndFrame();
+			PROFILE_END_FRAME();
+		}
+		while( SReplay.IsPlaying() );
+
+		// the final totals of the run
+		SMetrics.Dump();
+	}
+
+	GameX.CleanUp();
+	exit(0);
+}
 
 void GameInit()
 {	
+	SLog->RegisterCallback( LogToFile );
+
 	// load our tuner variables
 	gTuner.LoadTuners( "tuners.txt" );
+	SetupMetricsDump();
 
 	// setup init flags
 	uint32_t flags = VIDEO_32BIT;
@@ -32,6 +109,7 @@ void GameInit()
 	flags |= ( kFullscreen? VIDEO_FULLSCREEN : VIDEO_WINDOWED );
 	flags |= ( kUseVSync? VIDEO_ALLOWREFRESHSYNC : 0 );
 	flags |= ( kResizeable? 0 : VIDEO_NORESIZE );
+	flags |= AUDIO_MIXER;	// arrows can start a lot of sounds at once
 
 #if _DEBUG
 	flags |= ( RUN_NOCONFIRMQUIT | RUN_AUTOSHOWINFO );
@@ -41,12 +119,16 @@ void GameInit()
     GameX.Initialize ( (char*)kWindowName, flags, kWindowWidth, kWindowHeight ); 
 
 	// Register our states
-	SMachine.AddState( "LoadGame", new State_LoadGame );
+	sLoadGameState = SMachine.AddState( "LoadGame", new State_LoadGame );
 	SMachine.AddState( "StartScreen", new State_StartScreen );
-	SMachine.AddState( "Game", new State_Game );
+	sGameState = SMachine.AddState( "Game", new State_Game );
 	SMachine.AddState( "EditMode", new State_EditMode );
 
-	SMachine.RequestStateChange( "LoadGame" );
+	SMachine.RequestStateChange( sLoadGameState );
+
+	const char* replayFile = GetReplayArg();
+	if( replayFile )
+		RunReplay( replayFile );
 }
 
 void GameRun (void)
@@ -56,5 +138,22 @@ void GameRun (void)
 
 void GameDraw (void)
 {
+	PROFILE_BEGIN_FRAME();
+	SMetrics.BeginFrame();
+
 	SMachine.Handle();
+
+#if ENABLE_PROFILER
+	// F9 toggles a trace capture
+	if( GameX.GetKeyPress( KEY_F9 ) )
+	{
+		if( SProfiler.IsCapturing() )
+			SProfiler.EndCapture();
+		else
+			SProfiler.BeginCapture( "profile.json" );
+	}
+#endif
+
+	SMetrics.EndFrame();
+	PROFILE_END_FRAME();
 }
\ No newline at end of file